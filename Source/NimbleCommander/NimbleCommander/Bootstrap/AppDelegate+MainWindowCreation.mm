@@ -169,7 +169,8 @@ static std::vector<std::string> CommaSeparatedStrings(const nc::config::Config &
                                directoryAccessProvider:self.directoryAccessProvider
                                    contextMenuProvider:[self makePanelContextMenuProvider]
                                        nativeFSManager:self.nativeFSManager
-                                            nativeHost:self.nativeHost];
+                                            nativeHost:self.nativeHost
+                                        directorySizes:self.directorySizes];
     auto actions_dispatcher = [[NCPanelControllerActionsDispatcher alloc] initWithController:panel
                                                                                andActionsMap:self.panelActionsMap];
     [panel setNextAttachedResponder:actions_dispatcher];
@@ -243,6 +244,15 @@ static PanelController *PanelFactory()
     const auto frame = window.contentView.frame;
     const auto operations_pool = nc::ops::Pool::Make();
     operations_pool->SetConcurrency(self.globalConfig.GetInt("filePanel.operations.concurrencyPerWindow"));
+    operations_pool->SetResourceConcurrency(
+        nc::ops::OperationResource::Kind::Rotational,
+        self.globalConfig.GetInt("filePanel.operations.concurrencyPerRotationalDevice"));
+    operations_pool->SetResourceConcurrency(
+        nc::ops::OperationResource::Kind::SolidState,
+        self.globalConfig.GetInt("filePanel.operations.concurrencyPerSolidStateDevice"));
+    operations_pool->SetResourceConcurrency(nc::ops::OperationResource::Kind::Remote,
+                                            self.globalConfig.GetInt("filePanel.operations.concurrencyPerRemoteHost"));
+    operations_pool->SetTracesDirectory(self.globalConfig.GetString("filePanel.operations.tracesDirectory"));
     operations_pool->SetEnqueuingCallback(
         [filter = &NCAppDelegate.me.poolEnqueueFilter](const nc::ops::Operation &_operation) {
             return filter->ShouldEnqueue(_operation);
@@ -29,6 +29,8 @@ class UTIDB;
 namespace core {
 class VFSInstanceManager;
 class ServicesHandler;
+class FilenameIndexes;
+class DirectorySizes;
 } // namespace core
 
 namespace ops {
@@ -149,4 +151,8 @@ class NativeHost;
 
 @property(nonatomic, readonly) nc::panel::PanelDataPersistency &panelDataPersistency;
 
+@property(nonatomic, readonly) nc::core::FilenameIndexes &filenameIndexes;
+
+@property(nonatomic, readonly) nc::core::DirectorySizes &directorySizes;
+
 @end
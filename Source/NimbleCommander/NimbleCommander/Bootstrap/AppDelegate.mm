@@ -43,6 +43,8 @@
 #include <NimbleCommander/Core/ActionsShortcutsManager.h>
 #include <NimbleCommander/Core/SandboxManager.h>
 #include <NimbleCommander/Core/Dock.h>
+#include <NimbleCommander/Core/FilenameIndexes.h>
+#include <NimbleCommander/Core/DirectorySizes.h>
 #include <NimbleCommander/Core/ServicesHandler.h>
 #include <NimbleCommander/Core/ConfigBackedNetworkConnectionsManager.h>
 #include <NimbleCommander/Core/ConnectionsMenuDelegate.h>
@@ -986,6 +988,29 @@ static void DoTemporaryFileStoragePurge()
     return persistency;
 }
 
+- (nc::core::FilenameIndexes &)filenameIndexes
+{
+    [[clang::no_destroy]] static nc::core::FilenameIndexes indexes{
+        self.stateDirectory / "FilenameIndexes", self.nativeFSManager, self.nativeHost};
+    return indexes;
+}
+
+- (nc::core::DirectorySizes &)directorySizes
+{
+    static const auto instance = [self] {
+        auto inst = new nc::core::DirectorySizes(self.stateDirectory / "DirectorySizes.bin", self.nativeHost);
+        // Save the sizes upon application shutdown, the instance is never destroyed
+        [NSNotificationCenter.defaultCenter addObserverForName:NSApplicationWillTerminateNotification
+                                                        object:nil
+                                                         queue:nil
+                                                    usingBlock:^([[maybe_unused]] NSNotification *_Nonnull note) {
+                                                      inst->Save();
+                                                    }];
+        return inst;
+    }();
+    return *instance;
+}
+
 @end
 
 static std::optional<std::string> Load(const std::string &_filepath)
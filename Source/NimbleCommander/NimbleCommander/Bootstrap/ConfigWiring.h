@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2021 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <Config/Config.h>
@@ -17,6 +17,8 @@ public:
 
 private:
     void SetupOperationsPool();
+    void SetupOperationsPoolResources();
+    void SetupOperationsPoolTraces();
     void SetupOperationsPoolEnqueFilter();
     void SetupNotification();
 
@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "ConfigWiring.h"
 #include <Operations/Pool.h>
 #include <Operations/PoolEnqueueFilter.h>
@@ -19,6 +19,8 @@ ConfigWiring::ConfigWiring(config::Config &_config, ops::PoolEnqueueFilter &_poo
 void ConfigWiring::Wire()
 {
     SetupOperationsPool();
+    SetupOperationsPoolResources();
+    SetupOperationsPoolTraces();
     SetupOperationsPoolEnqueFilter();
     SetupNotification();
 }
@@ -38,6 +40,42 @@ void ConfigWiring::SetupOperationsPool()
     m_Config.ObserveForever(path, update);
 }
 
+void ConfigWiring::SetupOperationsPoolResources()
+{
+    using Kind = ops::OperationResource::Kind;
+    constexpr std::pair<const char *, Kind> paths[] = {
+        {"filePanel.operations.concurrencyPerRotationalDevice", Kind::Rotational},
+        {"filePanel.operations.concurrencyPerSolidStateDevice", Kind::SolidState},
+        {"filePanel.operations.concurrencyPerRemoteHost", Kind::Remote}};
+    const auto config = &m_Config;
+    for( const auto &[path, kind] : paths ) {
+        auto update = [config, path, kind] {
+            const auto new_limit = config->GetInt(path);
+            dispatch_to_main_queue([new_limit, kind] {
+                for( auto wnd : NCAppDelegate.me.mainWindowControllers )
+                    wnd.operationsPool.SetResourceConcurrency(kind, new_limit);
+            });
+        };
+        update();
+        m_Config.ObserveForever(path, update);
+    }
+}
+
+void ConfigWiring::SetupOperationsPoolTraces()
+{
+    constexpr auto path = "filePanel.operations.tracesDirectory";
+    const auto config = &m_Config;
+    auto update = [config] {
+        const auto directory = config->GetString(path);
+        dispatch_to_main_queue([directory] {
+            for( auto wnd : NCAppDelegate.me.mainWindowControllers )
+                wnd.operationsPool.SetTracesDirectory(directory);
+        });
+    };
+    update();
+    m_Config.ObserveForever(path, update);
+}
+
 void ConfigWiring::SetupOperationsPoolEnqueFilter()
 {
     constexpr auto path = "filePanel.operations.concurrencyPerWindowDoesntApplyTo";
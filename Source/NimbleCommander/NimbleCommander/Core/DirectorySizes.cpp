@@ -0,0 +1,190 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "DirectorySizes.h"
+#include <Base/CFPtr.h>
+#include <Base/dispatch_cpp.h>
+#include <VFS/DirectorySizeCache.h>
+#include <VFS/Native.h>
+#include <chrono>
+
+namespace nc::core {
+
+// a changed cache is written to disk after this delay, so that the following changes are written along
+static constexpr auto g_SaveDelay = std::chrono::minutes{1};
+
+// the events are coalesced by FSEvents for this many seconds
+static constexpr CFTimeInterval g_EventsLatency = 5.;
+
+// the calculation checks for cancellation this often while waiting for the missed changes to be applied
+static constexpr auto g_ReplayCheckPeriod = std::chrono::milliseconds{100};
+
+// a change of these kinds can't be tracked down to the directories it affected
+static constexpr FSEventStreamEventFlags g_EventsLostFlags =
+    kFSEventStreamEventFlagUserDropped | kFSEventStreamEventFlagKernelDropped | kFSEventStreamEventFlagEventIdsWrapped |
+    kFSEventStreamEventFlagRootChanged;
+
+DirectorySizes::DirectorySizes(std::filesystem::path _storage_path, vfs::NativeHost &_native_host)
+    : m_StoragePath(std::move(_storage_path)), m_NativeHost(_native_host),
+      m_EventsQueue(dispatch_queue_create("nc::core::DirectorySizes events", DISPATCH_QUEUE_SERIAL))
+{
+}
+
+DirectorySizes::~DirectorySizes()
+{
+    dispatch_sync(m_EventsQueue, [this] {
+        if( m_Stream == nullptr )
+            return;
+        FSEventStreamStop(m_Stream);
+        FSEventStreamInvalidate(m_Stream);
+        FSEventStreamRelease(m_Stream);
+        m_Stream = nullptr;
+    });
+    if( m_Cache )
+        m_Cache->Save(m_StoragePath);
+    dispatch_release(m_EventsQueue);
+}
+
+vfs::DirectorySizeCache &DirectorySizes::Cache()
+{
+    std::call_once(m_LoadOnce, [this] {
+        m_Cache = vfs::DirectorySizeCache::Load(m_StoragePath);
+        if( !m_Cache )
+            m_Cache = std::make_unique<vfs::DirectorySizeCache>();
+        dispatch_async(m_EventsQueue, [this] { StartWatching(); });
+    });
+    return *m_Cache;
+}
+
+std::optional<uint64_t> DirectorySizes::Lookup(std::string_view _path, const Options &_options)
+{
+    if( _options.hardlinks_once )
+        return std::nullopt;
+    return Cache().Lookup(_path, _options.allocated);
+}
+
+ssize_t DirectorySizes::Calculate(std::string_view _path, const CancelChecker &_cancel, const Options &_options)
+{
+    if( _options.hardlinks_once )
+        return m_NativeHost.CalculateDirectorySize(_path, _cancel, _options);
+
+    vfs::DirectorySizeCache &cache = Cache();
+    if( !WaitForReplay(_cancel) )
+        return VFSError::Cancelled;
+    const ssize_t size = cache.Calculate(m_NativeHost, _path, _cancel, _options.allocated);
+    dispatch_async(m_EventsQueue, [this] { ScheduleSaving(); });
+    return size;
+}
+
+void DirectorySizes::Save()
+{
+    dispatch_sync(m_EventsQueue, [this] {
+        if( m_SavingScheduled )
+            m_Cache->Save(m_StoragePath);
+    });
+}
+
+bool DirectorySizes::WaitForReplay(const CancelChecker &_cancel)
+{
+    auto lock = std::unique_lock{m_ReplayLock};
+    while( !m_Replayed ) {
+        if( _cancel && _cancel() )
+            return false;
+        m_ReplayCondition.wait_for(lock, g_ReplayCheckPeriod);
+    }
+    return true;
+}
+
+void DirectorySizes::FinishReplay()
+{
+    {
+        const auto lock = std::lock_guard{m_ReplayLock};
+        m_Replayed = true;
+    }
+    m_ReplayCondition.notify_all();
+}
+
+void DirectorySizes::StartWatching()
+{
+    // a new cache has nothing to replay, otherwise the history since it was saved is replayed first
+    FSEventStreamEventId since = m_Cache->Mark();
+    if( since == 0 ) {
+        since = kFSEventStreamEventIdSinceNow;
+        m_Cache->SetMark(FSEventsGetCurrentEventId());
+        FinishReplay();
+    }
+
+    const void *paths[] = {CFSTR("/")};
+    const auto paths_to_watch =
+        base::CFPtr<CFArrayRef>::adopt(CFArrayCreate(nullptr, paths, 1, &kCFTypeArrayCallBacks));
+    auto context = FSEventStreamContext{0, this, nullptr, nullptr, nullptr};
+    m_Stream = FSEventStreamCreate(nullptr,
+                                   &DirectorySizes::OnEventsFFI,
+                                   &context,
+                                   paths_to_watch.get(),
+                                   since,
+                                   g_EventsLatency,
+                                   kFSEventStreamCreateFlagNone);
+    if( m_Stream != nullptr ) {
+        FSEventStreamSetDispatchQueue(m_Stream, m_EventsQueue);
+        if( FSEventStreamStart(m_Stream) )
+            return;
+        FSEventStreamInvalidate(m_Stream);
+        FSEventStreamRelease(m_Stream);
+        m_Stream = nullptr;
+    }
+
+    // nothing remembered can be trusted without the events
+    m_Cache->InvalidateAll();
+    FinishReplay();
+}
+
+void DirectorySizes::ScheduleSaving()
+{
+    if( m_SavingScheduled )
+        return;
+    m_SavingScheduled = true;
+    dispatch_after(g_SaveDelay, m_EventsQueue, [this] {
+        m_SavingScheduled = false;
+        m_Cache->Save(m_StoragePath);
+    });
+}
+
+void DirectorySizes::OnEvents(size_t _num,
+                              const char *const _paths[],
+                              const FSEventStreamEventFlags _flags[],
+                              const FSEventStreamEventId _ids[])
+{
+    vfs::DirectorySizeCache &cache = *m_Cache;
+    bool changed = false;
+    for( size_t i = 0; i != _num; ++i ) {
+        if( _flags[i] & kFSEventStreamEventFlagHistoryDone ) {
+            FinishReplay();
+            continue;
+        }
+
+        if( _flags[i] & g_EventsLostFlags ) {
+            cache.InvalidateAll();
+            changed = true;
+        }
+        else if( _flags[i] & kFSEventStreamEventFlagMustScanSubDirs ) {
+            changed |= cache.InvalidateSubtree(_paths[i]);
+        }
+        else {
+            changed |= cache.Invalidate(_paths[i]);
+        }
+        cache.SetMark(_ids[i]);
+    }
+    if( changed )
+        ScheduleSaving();
+}
+
+void DirectorySizes::OnEventsFFI([[maybe_unused]] ConstFSEventStreamRef _stream,
+                                 void *_context,
+                                 size_t _num,
+                                 void *_paths,
+                                 const FSEventStreamEventFlags _flags[],
+                                 const FSEventStreamEventId _ids[])
+{
+    static_cast<DirectorySizes *>(_context)->OnEvents(_num, static_cast<const char *const *>(_paths), _flags, _ids);
+}
+
+} // namespace nc::core
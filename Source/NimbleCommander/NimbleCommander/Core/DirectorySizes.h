@@ -0,0 +1,81 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <CoreServices/CoreServices.h>
+#include <VFS/Native.h>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+
+namespace nc::vfs {
+class DirectorySizeCache;
+} // namespace nc::vfs
+
+namespace nc::core {
+
+// Keeps the calculated sizes of the native directories across the app launches. The cache is loaded from the storage
+// file upon the first use and is written back shortly after it changes. The directories reported by FSEvents,
+// including those changed while the app wasn't running, are invalidated so that the next calculation lists them again.
+// The sizes counting the hard-linked files only once can't be composed from the subtotals, thus they are calculated
+// from scratch every time and are not remembered.
+class DirectorySizes
+{
+public:
+    using CancelChecker = std::function<bool()>;
+    using Options = vfs::NativeHost::DirectorySizeOptions;
+
+    DirectorySizes(std::filesystem::path _storage_path, vfs::NativeHost &_native_host);
+    DirectorySizes(const DirectorySizes &) = delete;
+    ~DirectorySizes();
+    DirectorySizes &operator=(const DirectorySizes &) = delete;
+
+    // Returns the remembered size of the native directory, which is possibly outdated.
+    // This method is thread-safe.
+    std::optional<uint64_t> Lookup(std::string_view _path, const Options &_options = {});
+
+    // Calculates the size of the native directory, listing only the directories which changed since the last time.
+    // Returns a negative VFSError on failure.
+    // This method is thread-safe.
+    ssize_t Calculate(std::string_view _path, const CancelChecker &_cancel, const Options &_options = {});
+
+    // Writes the changes waiting for the delayed saving right away, e.g. when the app terminates without destroying
+    // this object.
+    // This method is thread-safe.
+    void Save();
+
+private:
+    vfs::DirectorySizeCache &Cache();
+    bool WaitForReplay(const CancelChecker &_cancel);
+    void FinishReplay();
+    void StartWatching();
+    void ScheduleSaving();
+    void OnEvents(size_t _num,
+                  const char *const _paths[],
+                  const FSEventStreamEventFlags _flags[],
+                  const FSEventStreamEventId _ids[]);
+    static void OnEventsFFI(ConstFSEventStreamRef _stream,
+                            void *_context,
+                            size_t _num,
+                            void *_paths,
+                            const FSEventStreamEventFlags _flags[],
+                            const FSEventStreamEventId _ids[]);
+
+    std::filesystem::path m_StoragePath;
+    vfs::NativeHost &m_NativeHost;
+    dispatch_queue_t m_EventsQueue; // the events and the savings are processed here
+    std::once_flag m_LoadOnce;
+    std::unique_ptr<vfs::DirectorySizeCache> m_Cache;
+    FSEventStreamRef m_Stream = nullptr; // accessed only from m_EventsQueue
+    bool m_SavingScheduled = false;      // accessed only from m_EventsQueue
+
+    // tells whether the changes which happened while the app wasn't running were applied to the cache
+    std::mutex m_ReplayLock;
+    std::condition_variable m_ReplayCondition;
+    bool m_Replayed = false;
+};
+
+} // namespace nc::core
@@ -0,0 +1,257 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "FilenameIndexes.h"
+#include <Base/CFString.h>
+#include <Base/dispatch_cpp.h>
+#include <Utility/NativeFSManager.h>
+#include <VFS/FilenameIndex.h>
+#include <VFS/Native.h>
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+namespace nc::core {
+
+// an index older than this is walked again, since there are changes which the events don't describe precisely enough
+static constexpr auto g_MaxIndexAge = std::chrono::hours{24 * 7};
+
+// a refreshed index is written to disk not more often than this
+static constexpr auto g_SavePeriod = std::chrono::minutes{10};
+
+// the events are coalesced by FSEvents for this many seconds
+static constexpr CFTimeInterval g_EventsLatency = 5.;
+
+static constexpr unsigned g_BuildWorkers = 4;
+
+// a change of these kinds can't be tracked down to the directories it affected
+static constexpr FSEventStreamEventFlags g_EventsLostFlags =
+    kFSEventStreamEventFlagMustScanSubDirs | kFSEventStreamEventFlagUserDropped |
+    kFSEventStreamEventFlagKernelDropped | kFSEventStreamEventFlagEventIdsWrapped | kFSEventStreamEventFlagRootChanged;
+
+struct FilenameIndexes::Volume {
+    FilenameIndexes *owner = nullptr;
+    std::string mount_point; // with a trailing slash
+    std::filesystem::path storage_path;
+
+    // guarded by m_Lock
+    std::shared_ptr<vfs::FilenameIndex> index;
+    bool preparing = false;
+
+    // accessed only from m_EventsQueue
+    FSEventStreamRef stream = nullptr;
+    std::chrono::steady_clock::time_point last_save;
+};
+
+static std::vector<utility::FirmlinksMappingParser::Firmlink> FetchFirmlinks() noexcept
+{
+    try {
+        std::ifstream in("/usr/share/firmlinks", std::ios::in | std::ios::binary);
+        if( !in )
+            return {};
+        const std::string mapping{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+        return utility::FirmlinksMappingParser::Parse(mapping);
+    } catch( ... ) {
+        return {};
+    }
+}
+
+static std::string StorageFilename(std::string_view _mount_point)
+{
+    std::string filename;
+    for( const char c : _mount_point )
+        filename += c == '/' ? '_' : c;
+    return filename + ".index";
+}
+
+FilenameIndexes::FilenameIndexes(std::filesystem::path _storage_directory,
+                                 utility::NativeFSManager &_native_fs_manager,
+                                 vfs::NativeHost &_native_host)
+    : m_StorageDirectory(std::move(_storage_directory)), m_NativeFSManager(_native_fs_manager),
+      m_NativeHost(_native_host),
+      m_EventsQueue(dispatch_queue_create("nc::core::FilenameIndexes events", DISPATCH_QUEUE_SERIAL)),
+      m_Firmlinks(FetchFirmlinks())
+{
+    std::error_code ec;
+    std::filesystem::create_directories(m_StorageDirectory, ec);
+}
+
+FilenameIndexes::~FilenameIndexes()
+{
+    dispatch_sync(m_EventsQueue, [this] {
+        for( auto &volume : m_Volumes )
+            StopWatching(*volume);
+    });
+    dispatch_release(m_EventsQueue);
+}
+
+std::shared_ptr<const vfs::FilenameIndex> FilenameIndexes::IndexFor(std::string_view _path)
+{
+    const auto info = m_NativeFSManager.VolumeFromPath(_path);
+    if( !info || !info->mount_flags.local || info->mounted_at_path.empty() )
+        return nullptr;
+
+    std::string mount_point = info->mounted_at_path;
+    if( mount_point.back() != '/' )
+        mount_point += '/';
+
+    const auto lock = std::lock_guard{m_Lock};
+    auto it = std::ranges::find_if(m_Volumes, [&](const auto &_volume) { return _volume->mount_point == mount_point; });
+    if( it == m_Volumes.end() ) {
+        auto volume = std::make_unique<Volume>();
+        volume->owner = this;
+        volume->storage_path = m_StorageDirectory / StorageFilename(mount_point);
+        volume->mount_point = std::move(mount_point);
+        it = m_Volumes.insert(m_Volumes.end(), std::move(volume));
+    }
+
+    Volume &volume = **it;
+    if( !volume.index ) {
+        if( !volume.preparing ) {
+            volume.preparing = true;
+            dispatch_to_background([this, &volume] { Prepare(volume); });
+        }
+        return nullptr;
+    }
+
+    // an outdated index is still used until a fresh one is ready
+    if( !volume.preparing && std::chrono::system_clock::now() - volume.index->BuildTime() > g_MaxIndexAge ) {
+        volume.preparing = true;
+        dispatch_to_background([this, &volume] { Rebuild(volume); });
+    }
+    return volume.index;
+}
+
+void FilenameIndexes::Prepare(Volume &_volume)
+{
+    // a saved index is brought up to date by the events which happened after it was saved
+    std::shared_ptr<vfs::FilenameIndex> index = vfs::FilenameIndex::Load(_volume.storage_path);
+    if( index && index->Root() == _volume.mount_point &&
+        std::chrono::system_clock::now() - index->BuildTime() < g_MaxIndexAge )
+        Install(_volume, std::move(index));
+    else
+        Rebuild(_volume);
+}
+
+void FilenameIndexes::Rebuild(Volume &_volume)
+{
+    // the events which happen during the walk are replayed afterwards
+    const FSEventStreamEventId since = FSEventsGetCurrentEventId();
+    std::shared_ptr<vfs::FilenameIndex> index =
+        vfs::FilenameIndex::Build(m_NativeHost, _volume.mount_point, g_BuildWorkers);
+    if( !index ) {
+        const auto lock = std::lock_guard{m_Lock};
+        _volume.preparing = false;
+        return;
+    }
+    index->SetMark(since);
+    index->Save(_volume.storage_path);
+    Install(_volume, std::move(index));
+}
+
+void FilenameIndexes::Install(Volume &_volume, std::shared_ptr<vfs::FilenameIndex> _index)
+{
+    // the paths like "/Users/..." belong to the Data volume while being outside of its mount point
+    for( const auto &firmlink : m_Firmlinks ) {
+        const auto info = m_NativeFSManager.VolumeFromPath(firmlink.target);
+        if( info && info->mounted_at_path + "/" == _volume.mount_point )
+            _index->AddFirmlink(firmlink.target, _volume.mount_point + firmlink.source);
+    }
+
+    dispatch_async(m_EventsQueue, [this, &_volume, index = std::move(_index)] {
+        StopWatching(_volume);
+        {
+            const auto lock = std::lock_guard{m_Lock};
+            _volume.index = index;
+            _volume.preparing = false;
+        }
+        _volume.last_save = std::chrono::steady_clock::now();
+        StartWatching(_volume);
+    });
+}
+
+void FilenameIndexes::StartWatching(Volume &_volume)
+{
+    assert(_volume.stream == nullptr);
+    const auto cf_path = base::CFPtr<CFStringRef>::adopt(base::CFStringCreateWithUTF8StdString(_volume.mount_point));
+    if( !cf_path )
+        return;
+    const void *paths[] = {cf_path.get()};
+    const auto paths_to_watch =
+        base::CFPtr<CFArrayRef>::adopt(CFArrayCreate(nullptr, paths, 1, &kCFTypeArrayCallBacks));
+    auto context = FSEventStreamContext{0, &_volume, nullptr, nullptr, nullptr};
+    _volume.stream = FSEventStreamCreate(nullptr,
+                                         &FilenameIndexes::OnEventsFFI,
+                                         &context,
+                                         paths_to_watch.get(),
+                                         _volume.index->Mark(),
+                                         g_EventsLatency,
+                                         kFSEventStreamCreateFlagNone);
+    if( _volume.stream == nullptr )
+        return;
+    FSEventStreamSetDispatchQueue(_volume.stream, m_EventsQueue);
+    if( !FSEventStreamStart(_volume.stream) )
+        StopWatching(_volume);
+}
+
+void FilenameIndexes::StopWatching(Volume &_volume)
+{
+    if( _volume.stream == nullptr )
+        return;
+    FSEventStreamStop(_volume.stream);
+    FSEventStreamInvalidate(_volume.stream);
+    FSEventStreamRelease(_volume.stream);
+    _volume.stream = nullptr;
+}
+
+void FilenameIndexes::SaveIfDue(Volume &_volume)
+{
+    const auto now = std::chrono::steady_clock::now();
+    if( now - _volume.last_save < g_SavePeriod )
+        return;
+    _volume.last_save = now;
+    _volume.index->Save(_volume.storage_path);
+}
+
+void FilenameIndexes::OnEvents(Volume &_volume,
+                               size_t _num,
+                               const char *const _paths[],
+                               const FSEventStreamEventFlags _flags[],
+                               const FSEventStreamEventId _ids[])
+{
+    vfs::FilenameIndex &index = *_volume.index; // the index isn't replaced on this queue while its stream is alive
+    for( size_t i = 0; i != _num; ++i ) {
+        if( _flags[i] & kFSEventStreamEventFlagHistoryDone )
+            continue;
+
+        if( _flags[i] & g_EventsLostFlags ) {
+            // the current index is kept in use until a fresh one replaces it along with its stream
+            StopWatching(_volume);
+            const auto lock = std::lock_guard{m_Lock};
+            if( !_volume.preparing ) {
+                _volume.preparing = true;
+                dispatch_to_background([this, &_volume] { Rebuild(_volume); });
+            }
+            return;
+        }
+
+        // the mounting and unmounting of other volumes inside don't change the index
+        if( (_flags[i] & (kFSEventStreamEventFlagMount | kFSEventStreamEventFlagUnmount)) == 0 )
+            index.Refresh(m_NativeHost, _paths[i]);
+        index.SetMark(_ids[i]);
+    }
+    SaveIfDue(_volume);
+}
+
+void FilenameIndexes::OnEventsFFI([[maybe_unused]] ConstFSEventStreamRef _stream,
+                                  void *_context,
+                                  size_t _num,
+                                  void *_paths,
+                                  const FSEventStreamEventFlags _flags[],
+                                  const FSEventStreamEventId _ids[])
+{
+    Volume &volume = *static_cast<Volume *>(_context);
+    volume.owner->OnEvents(volume, _num, static_cast<const char *const *>(_paths), _flags, _ids);
+}
+
+} // namespace nc::core
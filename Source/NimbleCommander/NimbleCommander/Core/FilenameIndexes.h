@@ -0,0 +1,73 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <CoreServices/CoreServices.h>
+#include <Utility/FirmlinksMappingParser.h>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace nc::utility {
+class NativeFSManager;
+}
+
+namespace nc::vfs {
+class FilenameIndex;
+class NativeHost;
+} // namespace nc::vfs
+
+namespace nc::core {
+
+// Keeps the filename indexes of the local native volumes. An index is loaded from the storage directory or built in
+// background upon the first request for its volume. Afterwards it's refreshed by the FSEvents of the volume, including
+// those which happened while the app wasn't running, and is rebuilt from scratch when the events were lost or when the
+// index is too old. The indexes are saved back to the storage directory after building and periodically after
+// refreshing. The index of the APFS Data volume also serves the paths firmlinked into the root, e.g. "/Users/...".
+class FilenameIndexes
+{
+public:
+    FilenameIndexes(std::filesystem::path _storage_directory,
+                    utility::NativeFSManager &_native_fs_manager,
+                    vfs::NativeHost &_native_host);
+    FilenameIndexes(const FilenameIndexes &) = delete;
+    ~FilenameIndexes();
+    FilenameIndexes &operator=(const FilenameIndexes &) = delete;
+
+    // Returns the index of the volume containing the path if the index is ready. Otherwise returns nullptr and starts
+    // preparing the index in background, so that it can be used next time.
+    // This method is thread-safe.
+    std::shared_ptr<const vfs::FilenameIndex> IndexFor(std::string_view _path);
+
+private:
+    struct Volume;
+
+    void Prepare(Volume &_volume);
+    void Rebuild(Volume &_volume);
+    void Install(Volume &_volume, std::shared_ptr<vfs::FilenameIndex> _index);
+    void StartWatching(Volume &_volume);
+    void StopWatching(Volume &_volume);
+    void SaveIfDue(Volume &_volume);
+    void OnEvents(Volume &_volume,
+                  size_t _num,
+                  const char *const _paths[],
+                  const FSEventStreamEventFlags _flags[],
+                  const FSEventStreamEventId _ids[]);
+    static void OnEventsFFI(ConstFSEventStreamRef _stream,
+                            void *_context,
+                            size_t _num,
+                            void *_paths,
+                            const FSEventStreamEventFlags _flags[],
+                            const FSEventStreamEventId _ids[]);
+
+    std::filesystem::path m_StorageDirectory;
+    utility::NativeFSManager &m_NativeFSManager;
+    vfs::NativeHost &m_NativeHost;
+    dispatch_queue_t m_EventsQueue; // the events are processed here one batch at a time
+    std::mutex m_Lock;
+    std::vector<std::unique_ptr<Volume>> m_Volumes; // never removed, since the FSEvents streams refer to them
+    std::vector<utility::FirmlinksMappingParser::Firmlink> m_Firmlinks; // of the root, e.g. "/Users" -> "Users"
+};
+
+} // namespace nc::core
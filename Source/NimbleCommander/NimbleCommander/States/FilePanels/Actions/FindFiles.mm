@@ -14,6 +14,7 @@
 #include <NimbleCommander/Bootstrap/AppDelegate.h>
 
 static const auto g_ConfigModalInternalViewer = "viewer.modalMode";
+static const auto g_ConfigUseFilenameIndex = "filePanel.findFiles.useFilenameIndex";
 
 namespace nc::panel::actions {
 
@@ -51,6 +52,8 @@ void FindFiles::Perform(PanelController *_target, id /*_sender*/) const
 {
     FindFilesSheetController *const sheet = [FindFilesSheetController new];
     sheet.vfsInstanceManager = &_target.vfsInstanceManager;
+    if( GlobalConfig().GetBool(g_ConfigUseFilenameIndex) )
+        sheet.filenameIndexes = &NCAppDelegate.me.filenameIndexes;
     sheet.host = _target.isUniform ? _target.vfs : _target.view.item.Host();
     sheet.path = _target.isUniform ? _target.currentDirectoryPath : _target.view.item.Directory();
     __weak PanelController *wp = _target;
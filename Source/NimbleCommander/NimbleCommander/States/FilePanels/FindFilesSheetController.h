@@ -13,6 +13,10 @@ namespace nc::config {
 class Config;
 }
 
+namespace nc::core {
+class FilenameIndexes;
+}
+
 namespace nc::panel {
 
 struct FindFilesSheetControllerFoundItem {
@@ -23,6 +27,7 @@ struct FindFilesSheetControllerFoundItem {
     std::string full_filename;
     VFSStat st;
     CFRange content_pos;
+    std::string content_text; // the found word when searching for any of several words
 };
 
 struct FindFilesSheetViewRequest {
@@ -47,6 +52,7 @@ struct FindFilesSheetViewRequest {
 @property(nonatomic) std::function<void(const std::vector<nc::vfs::VFSPath> &_filepaths)> onPanelize;
 @property(nonatomic) std::function<void(const nc::panel::FindFilesSheetViewRequest &)> onView;
 @property(nonatomic) nc::core::VFSInstanceManager *vfsInstanceManager;
+@property(nonatomic) nc::core::FilenameIndexes *filenameIndexes; // the names are looked up there if set
 - (const nc::panel::FindFilesSheetControllerFoundItem *)selectedItem; // may be nullptr
 
 @end
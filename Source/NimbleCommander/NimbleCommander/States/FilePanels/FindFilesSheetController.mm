@@ -4,6 +4,7 @@
 #include <Base/dispatch_cpp.h>
 #include <Config/RapidJSON.h>
 #include <NimbleCommander/Bootstrap/Config.h>
+#include <NimbleCommander/Core/FilenameIndexes.h>
 #include <NimbleCommander/Core/VFSInstanceManager.h>
 #include <NimbleCommander/Core/VFSInstancePromise.h>
 #include <NimbleCommander/States/FilePanels/PanelAux.h>
@@ -228,6 +229,9 @@ private:
     bool m_CaseSensitiveTextSearch;
     bool m_WholePhraseTextSearch;
     bool m_NotContainingTextSearch;
+    bool m_RegExpTextSearch;
+    bool m_BinaryTextSearch;
+    bool m_AnyWordTextSearch;
     nc::utility::Encoding m_TextSearchEncoding;
 
     std::vector<nc::panel::FindFilesMask> m_MaskHistory;
@@ -254,6 +258,7 @@ private:
 @synthesize onPanelize = m_OnPanelize;
 @synthesize onView = m_OnView;
 @synthesize vfsInstanceManager;
+@synthesize filenameIndexes;
 @synthesize didAnySearchStarted;
 @synthesize searchingNow;
 @synthesize CloseButton;
@@ -288,6 +293,9 @@ private:
         m_CaseSensitiveTextSearch = false;
         m_WholePhraseTextSearch = false;
         m_NotContainingTextSearch = false;
+        m_RegExpTextSearch = false;
+        m_BinaryTextSearch = false;
+        m_AnyWordTextSearch = false;
         m_TextSearchEncoding = nc::utility::Encoding::ENCODING_UTF8;
         m_MaskHistory = nc::panel::LoadFindFilesMasks(StateConfig(), g_StateMaskHistory);
         m_TextHistory = std::make_unique<FindFilesSheetComboHistory>(16, g_StateTextHistory);
@@ -471,6 +479,7 @@ private:
     }
 
     const auto text_query = self.textSearchField.stringValue ? self.textSearchField.stringValue : @"";
+    std::vector<std::string> any_words;
     if( text_query.length ) {
         SearchForFiles::FilterContent filter_content;
         filter_content.text = text_query.fileSystemRepresentationSafe;
@@ -478,6 +487,16 @@ private:
         filter_content.case_sensitive = m_CaseSensitiveTextSearch;
         filter_content.whole_phrase = m_WholePhraseTextSearch;
         filter_content.not_containing = m_NotContainingTextSearch;
+        filter_content.regular_expression = m_RegExpTextSearch;
+        filter_content.binary = m_BinaryTextSearch;
+        if( m_AnyWordTextSearch ) {
+            // all the words are looked for in a single pass over each file
+            const auto separators = NSCharacterSet.whitespaceAndNewlineCharacterSet;
+            for( NSString *word in [text_query componentsSeparatedByCharactersInSet:separators] )
+                if( word.length )
+                    any_words.emplace_back(word.UTF8String);
+            filter_content.any_of_texts = any_words;
+        }
         m_FileSearch->SetFilterContent(filter_content);
 
         // memorize the query
@@ -486,13 +505,25 @@ private:
 
     m_FileSearch->SetFilterSize(self.searchFilterSizeFromUI);
 
-    auto found_callback = [=](const char *_filename, const char *_in_path, VFSHost &_in_host, CFRange _cont_pos) {
+    // the index of the volume is used once it's ready, until then the directories are walked
+    std::shared_ptr<const nc::vfs::FilenameIndex> filename_index;
+    if( self.filenameIndexes && m_Host->IsNativeFS() )
+        filename_index = self.filenameIndexes->IndexFor(m_Path);
+    m_FileSearch->SetFilenameIndex(std::move(filename_index));
+
+    auto found_callback = [=](const char *_filename,
+                              const char *_in_path,
+                              VFSHost &_in_host,
+                              CFRange _cont_pos,
+                              size_t _text_found) {
         FindFilesSheetControllerFoundItem it;
         it.host = _in_host.SharedPtr();
         it.filename = _filename;
         it.dir_path = ensure_no_tr_slash(_in_path);
         it.full_filename = ensure_tr_slash(_in_path) + it.filename;
         it.content_pos = _cont_pos;
+        if( _cont_pos.location >= 0 && _text_found < any_words.size() )
+            it.content_text = any_words[_text_found];
         it.rel_path =
             to_relative_path(it.host, ensure_tr_slash(_in_path), fmt::format("{}{}", m_Host->JunctionPath(), m_Path));
 
@@ -673,7 +704,8 @@ private:
         request.content_mark.emplace();
         request.content_mark->bytes_offset = data.content_pos.location;
         request.content_mark->bytes_length = data.content_pos.length;
-        request.content_mark->search_term = self.textSearchField.stringValue.UTF8String;
+        request.content_mark->search_term =
+            data.content_text.empty() ? self.textSearchField.stringValue.UTF8String : data.content_text;
     }
     m_OnView(request);
 }
@@ -859,6 +891,24 @@ private:
     not_containing.state = m_NotContainingTextSearch ? NSControlStateValueOn : NSControlStateValueOff;
     not_containing.indentationLevel = 1;
 
+    const auto regexp = [menu addItemWithTitle:NSLocalizedString(@"Regular Expression", "")
+                                        action:@selector(onTextMenuRegExpClicked:)
+                                 keyEquivalent:@""];
+    regexp.state = m_RegExpTextSearch ? NSControlStateValueOn : NSControlStateValueOff;
+    regexp.indentationLevel = 1;
+
+    const auto binary = [menu addItemWithTitle:NSLocalizedString(@"Hex Bytes", "")
+                                        action:@selector(onTextMenuBinaryClicked:)
+                                 keyEquivalent:@""];
+    binary.state = m_BinaryTextSearch ? NSControlStateValueOn : NSControlStateValueOff;
+    binary.indentationLevel = 1;
+
+    const auto any_word = [menu addItemWithTitle:NSLocalizedString(@"Any of the Words", "")
+                                          action:@selector(onTextMenuAnyWordClicked:)
+                                   keyEquivalent:@""];
+    any_word.state = m_AnyWordTextSearch ? NSControlStateValueOn : NSControlStateValueOff;
+    any_word.indentationLevel = 1;
+
     const auto encoding_menu = [[NSMenu alloc] initWithTitle:@""];
     for( const auto &i : nc::utility::LiteralEncodingsList() ) {
         auto item = [encoding_menu addItemWithTitle:(__bridge NSString *)i.second
@@ -944,6 +994,39 @@ private:
     [self onSearchSettingsUIChanged:_sender];
 }
 
+- (void)onTextMenuRegExpClicked:(id) [[maybe_unused]] _sender
+{
+    m_RegExpTextSearch = !m_RegExpTextSearch;
+    if( m_RegExpTextSearch ) {
+        m_BinaryTextSearch = false;
+        m_AnyWordTextSearch = false;
+    }
+    [self updateTextMenu];
+    [self onSearchSettingsUIChanged:_sender];
+}
+
+- (void)onTextMenuBinaryClicked:(id) [[maybe_unused]] _sender
+{
+    m_BinaryTextSearch = !m_BinaryTextSearch;
+    if( m_BinaryTextSearch ) {
+        m_RegExpTextSearch = false;
+        m_AnyWordTextSearch = false;
+    }
+    [self updateTextMenu];
+    [self onSearchSettingsUIChanged:_sender];
+}
+
+- (void)onTextMenuAnyWordClicked:(id) [[maybe_unused]] _sender
+{
+    m_AnyWordTextSearch = !m_AnyWordTextSearch;
+    if( m_AnyWordTextSearch ) {
+        m_RegExpTextSearch = false;
+        m_BinaryTextSearch = false;
+    }
+    [self updateTextMenu];
+    [self onSearchSettingsUIChanged:_sender];
+}
+
 - (void)onMaskMenuHistoryEntryClicked:(id)_sender
 {
     const auto item = nc::objc_cast<NSMenuItem>(_sender);
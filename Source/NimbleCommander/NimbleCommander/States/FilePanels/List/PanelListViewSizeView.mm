@@ -28,7 +28,12 @@ static uint64_t ExtractSizeFromInfos(const VFSListingItem &_dirent, const data::
     }
 }
 
-static NSString *SizeStringFromEncodedSize(uint64_t _sz)
+static bool IsSizePossiblyStale(const VFSListingItem &_dirent, const data::ItemVolatileData &_vd)
+{
+    return _dirent.IsDir() && _vd.is_size_calculated() && _vd.is_size_stale();
+}
+
+static NSString *SizeStringFromEncodedSize(uint64_t _sz, bool _possibly_stale)
 {
     if( _sz == g_InvalidSize )
         return @"";
@@ -38,13 +43,15 @@ static NSString *SizeStringFromEncodedSize(uint64_t _sz)
     if( _sz == g_NonCalculatedSizeForDotDot )
         return NSLocalizedString(@"__MODERNPRESENTATION_UP_WORD", "Upper-level in directory, for English is 'Up'");
 
-    return ByteCountFormatter::Instance().ToNSString(_sz, GetFileSizeFormat());
+    NSString *const size = ByteCountFormatter::Instance().ToNSString(_sz, GetFileSizeFormat());
+    return _possibly_stale ? [@"\u2248 " stringByAppendingString:size] : size;
 }
 
 @implementation PanelListViewSizeView {
     NSString *m_String;
     NSDictionary *m_TextAttributes;
     uint64_t m_Size;
+    bool m_SizeIsStale;
     __weak PanelListViewRowView *m_RowView;
 }
 
@@ -53,6 +60,7 @@ static NSString *SizeStringFromEncodedSize(uint64_t _sz)
     self = [super initWithFrame:frameRect];
     if( self ) {
         m_Size = g_InvalidSize;
+        m_SizeIsStale = false;
         m_String = @"";
     }
     return self;
@@ -91,6 +99,7 @@ static NSString *SizeStringFromEncodedSize(uint64_t _sz)
 {
     [super prepareForReuse];
     m_Size = g_InvalidSize;
+    m_SizeIsStale = false;
     m_String = @"";
 }
 
@@ -132,9 +141,11 @@ static NSParagraphStyle *PStyle()
         return;
 
     const auto new_sz = ExtractSizeFromInfos(_dirent, _vd);
-    if( new_sz != m_Size ) {
+    const bool new_stale = IsSizePossiblyStale(_dirent, _vd);
+    if( new_sz != m_Size || new_stale != m_SizeIsStale ) {
         m_Size = new_sz;
-        m_String = SizeStringFromEncodedSize(m_Size);
+        m_SizeIsStale = new_stale;
+        m_String = SizeStringFromEncodedSize(m_Size, m_SizeIsStale);
         [self setNeedsDisplay:true];
     }
 }
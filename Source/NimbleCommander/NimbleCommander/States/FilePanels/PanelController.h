@@ -22,6 +22,7 @@ namespace nc {
 namespace core {
 class VFSInstancePromise;
 class VFSInstanceManager;
+class DirectorySizes;
 } // namespace core
 
 namespace utility {
@@ -155,7 +156,8 @@ using ContextMenuProvider =
      directoryAccessProvider:(nc::panel::DirectoryAccessProvider &)_directory_access_provider
          contextMenuProvider:(nc::panel::ContextMenuProvider)_context_menu_provider
              nativeFSManager:(nc::utility::NativeFSManager &)_native_fs_mgr
-                  nativeHost:(nc::vfs::NativeHost &)_native_host;
+                  nativeHost:(nc::vfs::NativeHost &)_native_host
+              directorySizes:(nc::core::DirectorySizes &)_directory_sizes;
 
 - (void)refreshPanel;                 // reload panel contents
 - (void)forceRefreshPanel;            // user pressed cmd+r by default
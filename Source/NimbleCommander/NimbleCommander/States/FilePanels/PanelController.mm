@@ -24,6 +24,7 @@
 #include <Panel/PanelDataExternalEntryKey.h>
 #include "PanelDataPersistency.h"
 #include <NimbleCommander/Core/VFSInstanceManager.h>
+#include <NimbleCommander/Core/DirectorySizes.h>
 #include "Actions/OpenFile.h"
 #include "Actions/GoToFolder.h"
 #include "Actions/Enter.h"
@@ -39,6 +40,9 @@
 #include <Base/mach_time.h>
 
 #include <algorithm>
+#include <atomic>
+#include <span>
+#include <unordered_map>
 
 using namespace nc;
 using namespace nc::core;
@@ -52,6 +56,8 @@ static const auto g_ConfigShowDotDotEntry = "filePanel.general.showDotDotEntry";
 static const auto g_ConfigIgnoreDirectoriesOnMaskSelection = "filePanel.general.ignoreDirectoriesOnSelectionWithMask";
 static const auto g_ConfigShowLocalizedFilenames = "filePanel.general.showLocalizedFilenames";
 static const auto g_ConfigEnableFinderTags = "filePanel.FinderTags.enable";
+static const auto g_ConfigCalculateAllocatedSizes = "filePanel.general.calculateAllocatedSizes";
+static const auto g_ConfigCountHardlinksOnce = "filePanel.general.countHardlinksOnce";
 
 namespace nc::panel {
 
@@ -93,11 +99,55 @@ void ActivityTicket::Reset()
     ticket = 0;
 }
 
+// Copies the tags of the former listing to the same-named entries of the refreshed one, so that the tags don't blink
+// while being loaded again.
+static VFSListingPtr CarryOverTags(const VFSListingPtr &_refreshed, const VFSListing &_former)
+{
+    std::unordered_map<std::string_view, std::span<const utility::Tags::Tag>> former_tags;
+    for( unsigned ind = 0; ind != _former.Count(); ++ind )
+        if( _former.HasTags(ind) )
+            former_tags.emplace(_former.Filename(ind), _former.Tags(ind));
+    if( former_tags.empty() )
+        return _refreshed;
+
+    std::vector<std::pair<unsigned, std::vector<utility::Tags::Tag>>> tags;
+    for( unsigned ind = 0; ind != _refreshed->Count(); ++ind )
+        if( const auto it = former_tags.find(_refreshed->Filename(ind)); it != former_tags.end() )
+            tags.emplace_back(ind, std::vector<utility::Tags::Tag>(it->second.begin(), it->second.end()));
+    return tags.empty() ? _refreshed : VFSListing::WithTags(*_refreshed, tags);
+}
+
 struct CalculatedSizesBatch {
     std::vector<VFSListingItem> items;
     std::vector<uint64_t> sizes;
+    bool possibly_stale = false;
+};
+
+struct RememberedSizes {
+    std::vector<unsigned> indices;
+    std::vector<uint64_t> sizes;
 };
 
+// Looks up the sizes of the native directories of the listing calculated earlier, so that they can be shown right away.
+static RememberedSizes LookUpRememberedSizes(const VFSListing &_listing,
+                                             core::DirectorySizes &_sizes,
+                                             const core::DirectorySizes::Options &_options)
+{
+    RememberedSizes remembered;
+    if( !_listing.HasCommonHost() || !_listing.Host()->IsNativeFS() )
+        return remembered;
+    for( unsigned ind = 0; ind != _listing.Count(); ++ind ) {
+        if( !_listing.IsDir(ind) )
+            continue;
+        const auto path = !_listing.IsDotDot(ind) ? _listing.Path(ind) : _listing.Directory(ind);
+        if( const auto size = _sizes.Lookup(path, _options) ) {
+            remembered.indices.emplace_back(ind);
+            remembered.sizes.emplace_back(*size);
+        }
+    }
+    return remembered;
+}
+
 } // namespace nc::panel
 
 #define MAKE_AUTO_UPDATING_BOOL_CONFIG_VALUE(_name, _path)                                                             \
@@ -114,12 +164,21 @@ struct CalculatedSizesBatch {
 MAKE_AUTO_UPDATING_BOOL_CONFIG_VALUE(ConfigShowDotDotEntry, g_ConfigShowDotDotEntry);
 MAKE_AUTO_UPDATING_BOOL_CONFIG_VALUE(ConfigShowLocalizedFilenames, g_ConfigShowLocalizedFilenames);
 MAKE_AUTO_UPDATING_BOOL_CONFIG_VALUE(ConfigEnableFinderTags, g_ConfigEnableFinderTags);
+MAKE_AUTO_UPDATING_BOOL_CONFIG_VALUE(ConfigCalculateAllocatedSizes, g_ConfigCalculateAllocatedSizes);
+MAKE_AUTO_UPDATING_BOOL_CONFIG_VALUE(ConfigCountHardlinksOnce, g_ConfigCountHardlinksOnce);
 
 static void HeatUpConfigValues()
 {
     ConfigShowDotDotEntry();
     ConfigShowLocalizedFilenames();
     ConfigEnableFinderTags();
+    ConfigCalculateAllocatedSizes();
+    ConfigCountHardlinksOnce();
+}
+
+static nc::core::DirectorySizes::Options ConfigDirectorySizeOptions()
+{
+    return {.allocated = ConfigCalculateAllocatedSizes(), .hardlinks_once = ConfigCountHardlinksOnce()};
 }
 
 @interface PanelController ()
@@ -143,6 +202,8 @@ static void HeatUpConfigValues()
     nc::base::SerialQueue m_DirectorySizeCountingQ;
     nc::base::SerialQueue m_DirectoryLoadingQ;
     nc::base::SerialQueue m_DirectoryReLoadingQ;
+    nc::base::SerialQueue m_TagsLoadingQ;
+    std::atomic_uint64_t m_TagsLoadingGeneration; // a pass of tags loading is abandoned once this changes
 
     NCPanelQuickSearch *m_QuickSearch;
 
@@ -187,6 +248,7 @@ static void HeatUpConfigValues()
     ContextMenuProvider m_ContextMenuProvider;
     nc::utility::NativeFSManager *m_NativeFSManager;
     nc::vfs::NativeHost *m_NativeHost;
+    nc::core::DirectorySizes *m_DirectorySizes;
 
     unsigned long m_DataGeneration;
 }
@@ -205,6 +267,7 @@ static void HeatUpConfigValues()
          contextMenuProvider:(nc::panel::ContextMenuProvider)_context_menu_provider
              nativeFSManager:(nc::utility::NativeFSManager &)_native_fs_mgr
                   nativeHost:(nc::vfs::NativeHost &)_native_host
+              directorySizes:(nc::core::DirectorySizes &)_directory_sizes
 {
     assert(_layouts);
     assert(_context_menu_provider);
@@ -218,6 +281,7 @@ static void HeatUpConfigValues()
         m_VFSInstanceManager = &_vfs_mgr;
         m_NativeFSManager = &_native_fs_mgr;
         m_NativeHost = &_native_host;
+        m_DirectorySizes = &_directory_sizes;
         m_DirectoryAccessProvider = &_directory_access_provider;
         m_ContextMenuProvider = std::move(_context_menu_provider);
         m_History.SetVFSInstanceManager(_vfs_mgr);
@@ -376,6 +440,62 @@ static void HeatUpConfigValues()
     }
 }
 
+- (unsigned long)fetchingFlagsForHost:(const VFSHost &)_host
+{
+    // the native listings are shown without the tags, which are loaded afterwards by loadTagsInBackground
+    if( _host.IsNativeFS() )
+        return m_VFSFetchingFlags & ~VFSFlags::F_LoadTags;
+    return m_VFSFetchingFlags;
+}
+
+- (void)loadTagsInBackground
+{
+    dispatch_assert_main_queue();
+    const uint64_t generation = ++m_TagsLoadingGeneration;
+    const VFSListingPtr listing = m_Data.ListingPtr();
+    if( !(m_VFSFetchingFlags & VFSFlags::F_LoadTags) || !listing->IsUniform() )
+        return;
+    const auto host = std::dynamic_pointer_cast<vfs::NativeHost>(listing->Host());
+    if( !host )
+        return;
+
+    // the tags of the visible entries are loaded first
+    std::vector<unsigned> visible;
+    for( const int pos : [m_View visibleSortedPositions] )
+        if( const int ind = m_Data.RawIndexForSortIndex(pos); ind >= 0 )
+            visible.push_back(static_cast<unsigned>(ind));
+
+    m_TagsLoadingQ.Run([=] {
+        const auto abandoned = [&] { return m_TagsLoadingGeneration != generation; };
+        if( abandoned() )
+            return;
+        // each batch is applied on top of the listing which the previous one has produced
+        VFSListingPtr current = listing;
+        const auto apply = [&](vfs::NativeHost::TagsBatch &&_batch) {
+            VFSListingPtr previous = std::exchange(current, VFSListing::WithTags(*current, _batch));
+            dispatch_to_main_queue([=, previous = std::move(previous), updated = current] {
+                if( &m_Data.Listing() != previous.get() )
+                    return; // the panel has moved on, the following batches would be discarded as well
+                [self reloadListingWithLoadedTags:updated];
+            });
+        };
+        const int rc = host->FetchTags(*listing, visible, apply, abandoned);
+        if( rc != VFSError::Ok && rc != VFSError::Cancelled )
+            Log::Warn("Failed to load the tags of '{}', error code: {}", listing->Directory(), rc);
+    });
+}
+
+- (void)reloadListingWithLoadedTags:(const VFSListingPtr &)_ptr
+{
+    assert(dispatch_is_main_queue());
+    const auto pers = CursorBackup{m_View.curpos, m_Data};
+    m_Data.ReLoad(_ptr);
+    [m_View dataUpdated];
+    [m_QuickSearch dataUpdated];
+    m_View.curpos = pers.RestoredCursorPosition();
+    [m_View setNeedsDisplay];
+}
+
 - (void)reloadRefreshedListing:(const VFSListingPtr &)_ptr
 {
     assert(dispatch_is_main_queue());
@@ -396,6 +516,7 @@ static void HeatUpConfigValues()
 
     [self onCursorChanged];
     [m_View setNeedsDisplay];
+    [self loadTagsInBackground];
 }
 
 - (void)refreshPanelDiscardingCaches:(bool)_force
@@ -421,9 +542,11 @@ static void HeatUpConfigValues()
     // later: maybe check PanelType somehow
 
     if( self.isUniform ) {
-        const auto fetch_flags = m_VFSFetchingFlags | (_force ? VFSFlags::F_ForceRefresh : 0);
-        const auto dirpath = m_Data.DirectoryPathWithTrailingSlash();
         const auto vfs = self.vfs;
+        const auto fetch_flags = [self fetchingFlagsForHost:*vfs] | (_force ? VFSFlags::F_ForceRefresh : 0);
+        const bool carry_over_tags = (m_VFSFetchingFlags & ~fetch_flags & VFSFlags::F_LoadTags) != 0;
+        const auto dirpath = m_Data.DirectoryPathWithTrailingSlash();
+        const auto former_listing = m_Data.ListingPtr();
 
         m_DirectoryReLoadingQ.Run([=] {
             if( m_DirectoryReLoadingQ.IsStopped() ) {
@@ -437,6 +560,8 @@ static void HeatUpConfigValues()
                 Log::Trace("[PanelController refreshPanelDiscardingCaches] cancelled the refresh");
                 return;
             }
+            if( ret >= 0 && carry_over_tags )
+                listing = CarryOverTags(listing, *former_listing);
             dispatch_to_main_queue([=] {
                 if( self.currentDirectoryPath != dirpath ) {
                     Log::Debug(
@@ -520,6 +645,57 @@ static void HeatUpConfigValues()
     dispatch_assert_background_queue();
     assert(!_items.empty());
 
+    auto commit = [=](panel::CalculatedSizesBatch _calculated) {
+        auto commit_batch = [=, calculated = std::move(_calculated)] {
+            assert(!calculated.items.empty());
+
+            // may cause re-sorting if current sorting is by size so save the cursor
+            const auto pers = CursorBackup{m_View.curpos, m_Data};
+
+            size_t num_set = 0;
+            if( &m_Data.Listing() == calculated.items.front().Listing().get() ) {
+                // the listing is the same, can use indices directly
+                std::vector<unsigned> raw_indices(calculated.items.size());
+                std::ranges::transform(calculated.items, raw_indices.begin(), [](auto &i) { return i.Index(); });
+                num_set =
+                    m_Data.SetCalculatedSizesForDirectories(raw_indices, calculated.sizes, calculated.possibly_stale);
+            }
+            else {
+                // the listing has changed, need to use indirects: filename and directory
+                std::vector<std::string_view> filenames(calculated.items.size());
+                std::vector<std::string_view> directories(calculated.items.size());
+                std::ranges::transform(
+                    calculated.items, filenames.begin(), [](auto &i) { return std::string_view{i.Filename()}; });
+                std::ranges::transform(
+                    calculated.items, directories.begin(), [](auto &i) { return std::string_view{i.Directory()}; });
+                num_set = m_Data.SetCalculatedSizesForDirectories(
+                    filenames, directories, calculated.sizes, calculated.possibly_stale);
+            }
+            if( num_set != 0 ) {
+                [m_View dataUpdated];
+                [m_View volatileDataChanged];
+                m_View.curpos = pers.RestoredCursorPosition();
+            }
+        };
+        dispatch_to_main_queue(std::move(commit_batch));
+    };
+
+    const auto options = ConfigDirectorySizeOptions();
+
+    // the remembered sizes of the native directories are shown at once and then replaced by the recalculated ones
+    panel::CalculatedSizesBatch remembered;
+    remembered.possibly_stale = true;
+    for( auto &i : _items ) {
+        if( !i.IsDir() || !i.Host()->IsNativeFS() )
+            continue;
+        if( const auto size = m_DirectorySizes->Lookup(!i.IsDotDot() ? i.Path() : i.Directory(), options) ) {
+            remembered.items.emplace_back(i);
+            remembered.sizes.emplace_back(*size);
+        }
+    }
+    if( !remembered.items.empty() )
+        commit(std::move(remembered));
+
     // divide all items into maximum of g_MaxSizeCalculationCommitBatches batches as equally as
     // possible
     const size_t items_count = _items.size();
@@ -543,11 +719,19 @@ static void HeatUpConfigValues()
             if( !i.IsDir() )
                 continue;
 
-            const auto result = i.Host()->CalculateDirectorySize(!i.IsDotDot() ? i.Path() : i.Directory(),
-                                                                 [=] { return m_DirectorySizeCountingQ.IsStopped(); });
+            const auto path = !i.IsDotDot() ? i.Path() : i.Directory();
+            const auto cancel_checker = [=] { return m_DirectorySizeCountingQ.IsStopped(); };
+            const auto result = i.Host()->IsNativeFS() ? m_DirectorySizes->Calculate(path, cancel_checker, options)
+                                                       : i.Host()->CalculateDirectorySize(path, cancel_checker);
 
-            if( result < 0 )
-                continue; // silently skip items that caused erros while calculating size
+            if( result < 0 ) {
+                // silently skip items that caused erros while calculating size, dropping their remembered sizes
+                if( result != VFSError::Cancelled && i.Host()->IsNativeFS() ) {
+                    calculated.items.emplace_back(i);
+                    calculated.sizes.emplace_back(data::ItemVolatileData::invalid_size);
+                }
+                continue;
+            }
 
             calculated.items.emplace_back(i);
             calculated.sizes.emplace_back(static_cast<uint64_t>(result));
@@ -556,36 +740,7 @@ static void HeatUpConfigValues()
         if( calculated.items.empty() )
             continue;
 
-        auto commit_batch = [=, calculated = std::move(calculated)] {
-            assert(!calculated.items.empty());
-
-            // may cause re-sorting if current sorting is by size so save the cursor
-            const auto pers = CursorBackup{m_View.curpos, m_Data};
-
-            size_t num_set = 0;
-            if( &m_Data.Listing() == calculated.items.front().Listing().get() ) {
-                // the listing is the same, can use indices directly
-                std::vector<unsigned> raw_indices(calculated.items.size());
-                std::ranges::transform(calculated.items, raw_indices.begin(), [](auto &i) { return i.Index(); });
-                num_set = m_Data.SetCalculatedSizesForDirectories(raw_indices, calculated.sizes);
-            }
-            else {
-                // the listing has changed, need to use indirects: filename and directory
-                std::vector<std::string_view> filenames(calculated.items.size());
-                std::vector<std::string_view> directories(calculated.items.size());
-                std::ranges::transform(
-                    calculated.items, filenames.begin(), [](auto &i) { return std::string_view{i.Filename()}; });
-                std::ranges::transform(
-                    calculated.items, directories.begin(), [](auto &i) { return std::string_view{i.Directory()}; });
-                num_set = m_Data.SetCalculatedSizesForDirectories(filenames, directories, calculated.sizes);
-            }
-            if( num_set != 0 ) {
-                [m_View dataUpdated];
-                [m_View volatileDataChanged];
-                m_View.curpos = pers.RestoredCursorPosition();
-            }
-        };
-        dispatch_to_main_queue(std::move(commit_batch));
+        commit(std::move(calculated));
     }
 }
 
@@ -594,6 +749,7 @@ static void HeatUpConfigValues()
     m_DirectorySizeCountingQ.Stop();
     m_DirectoryLoadingQ.Stop();
     m_DirectoryReLoadingQ.Stop();
+    ++m_TagsLoadingGeneration;
 }
 
 - (void)updateSpinningIndicator
@@ -917,7 +1073,8 @@ static void ShowAlertAboutInvalidFilename(const std::string &_filename)
         auto &vfs = *_request->VFS;
         const auto canceller = VFSCancelChecker([&] { return m_DirectoryLoadingQ.IsStopped(); });
         VFSListingPtr listing;
-        const auto fetch_result = vfs.FetchDirectoryListing(directory, listing, m_VFSFetchingFlags, canceller);
+        const auto fetch_result =
+            vfs.FetchDirectoryListing(directory, listing, [self fetchingFlagsForHost:vfs], canceller);
         _request->LoadingResultCode = fetch_result;
         if( _request->LoadingResultCallback )
             _request->LoadingResultCallback(fetch_result);
@@ -925,12 +1082,16 @@ static void ShowAlertAboutInvalidFilename(const std::string &_filename)
         if( fetch_result < 0 )
             return;
 
+        const auto remembered = panel::LookUpRememberedSizes(*listing, *m_DirectorySizes, ConfigDirectorySizeOptions());
+
         // TODO: need an ability to show errors at least
 
         [self CancelBackgroundOperations]; // clean running operations if any
         dispatch_or_run_in_main_queue([=] {
             [m_View savePathState];
             m_Data.Load(listing, data::Model::PanelType::Directory);
+            if( !remembered.indices.empty() )
+                m_Data.SetCalculatedSizesForDirectories(remembered.indices, remembered.sizes, true);
             for( auto &i : _request->RequestSelectedEntries )
                 m_Data.CustomFlagsSelectSorted(m_Data.SortedIndexForName(i), true);
             m_DataGeneration++;
@@ -938,6 +1099,7 @@ static void ShowAlertAboutInvalidFilename(const std::string &_filename)
             [m_View panelChangedWithFocusedFilename:_request->RequestFocusedEntry
                                   loadPreviousState:_request->LoadPreviousViewState];
             [self onPathChanged];
+            [self loadTagsInBackground];
         });
     } catch( std::exception &e ) {
         ShowExceptionAlert(e);
@@ -989,6 +1151,7 @@ static void ShowAlertAboutInvalidFilename(const std::string &_filename)
         [m_View dataUpdated];
         [m_View panelChangedWithFocusedFilename:"" loadPreviousState:false];
         [self onPathChanged];
+        [self loadTagsInBackground];
     });
 }
 
@@ -94,6 +94,9 @@ class Model;
 // Will return std::nullopt if the position is invalid.
 - (std::optional<NSRect>)frameOfItemAtSortPos:(int)_sorted_position;
 
+// Returns the sorted positions of the items which are currently visible, in ascending order.
+- (std::vector<int>)visibleSortedPositions;
+
 /*
  * PanelView implementation hooks.
  * Later: add hit-test info flags here.
@@ -1156,4 +1156,22 @@ struct StateStorage {
     return [self convertRect:*frame fromView:m_ItemsView];
 }
 
+- (std::vector<int>)visibleSortedPositions
+{
+    dispatch_assert_main_queue();
+    std::vector<int> positions;
+    if( !m_Data )
+        return positions;
+
+    // the visible items can't be farther from the cursor than a screen
+    const auto total_items = static_cast<int>(m_Data->SortedDirectoryEntries().size());
+    const auto items_per_screen = m_ItemsView.maxNumberOfVisibleItems;
+    const auto first = std::max(m_CursorPos - items_per_screen, 0);
+    const auto last = std::min(std::max(m_CursorPos, 0) + items_per_screen, total_items - 1);
+    for( int pos = first; pos <= last; ++pos )
+        if( [m_ItemsView isItemVisible:pos] )
+            positions.push_back(pos);
+    return positions;
+}
+
 @end
@@ -19,7 +19,8 @@ static NSString *FileSizeToString(const VFSListingItem &_dirent,
 {
     if( _dirent.IsDir() ) {
         if( _vd.is_size_calculated() ) {
-            return _fmter.ToNSString(_vd.size, _format);
+            NSString *const size = _fmter.ToNSString(_vd.size, _format);
+            return _vd.is_size_stale() ? [@"\u2248 " stringByAppendingString:size] : size;
         }
         else {
             if( _dirent.IsDotDot() ) {
@@ -17,6 +17,8 @@ using Callbacks = AttrsChangingJobCallbacks;
 
 AttrsChanging::AttrsChanging(AttrsChangingCommand _command)
 {
+    SetResources(ResolveOperationResources(_command.items));
+
     m_Job = std::make_unique<AttrsChangingJob>(std::move(_command));
     m_Job->m_OnSourceAccessError = [this](int _err, const std::string &_path, VFSHost &_vfs) {
         return (Callbacks::SourceAccessErrorResolution)OnSourceAccessError(_err, _path, _vfs);
@@ -1,15 +1,66 @@
-// Copyright (C) 2017-2021 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "AttrsChangingJob.h"
 #include <Utility/PathManip.h>
+#include <VFS/Native.h>
+#include <RoutedIO/RoutedIO.h>
+#include <Base/DispatchGroup.h>
+#include <ankerl/unordered_dense.h>
+#include <sys/attr.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <typeinfo>
 
 namespace nc::ops {
 
+// the number of consecutive items claimed by a worker at once, they likely share the same directory
+static constexpr size_t g_ChangingBatchSize = 64;
+
 struct AttrsChangingJob::Meta {
     VFSStat stat;
     int origin_item;
 };
 
+// The items being altered by the workers. The items are claimed in batches, in their original order, while the
+// number of items being altered simultaneously is limited per host.
+struct AttrsChangingJob::ChangingQueue {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<const base::chained_strings::node *> filenames; // indexed as m_Metas
+    std::vector<bool> done;
+    size_t next = 0;        // the first item which is not claimed yet
+    size_t done_before = 0; // all items before this one are done
+    ankerl::unordered_dense::map<const VFSHost *, unsigned> busy;
+    std::mutex reports_lock; // the item reports are delivered one at a time
+};
+
+// A descriptor of the directory which contains the recently altered item, the next one is likely to be its sibling.
+struct AttrsChangingJob::NativeDirectoryCache {
+    std::string path;
+    int fd = -1;
+    NativeDirectoryCache() = default;
+    NativeDirectoryCache(const NativeDirectoryCache &) = delete;
+    ~NativeDirectoryCache();
+    int Get(std::string_view _path); // returns AT_FDCWD if the directory can't be opened
+};
+
+// Accumulates the common attributes set by a single setattrlist call, they must be added in the order of their bits.
+struct SetAttrListCall {
+    attrlist attrs;
+    std::array<std::byte, 128> buffer;
+    size_t size = 0;
+    SetAttrListCall() noexcept;
+    template <class T>
+    void Add(attrgroup_t _attr, const T &_value) noexcept;
+    bool Apply(int _dir_fd, const char *_name) noexcept;
+};
+
 static std::pair<uint16_t, uint16_t> PermissionsValueAndMask(const AttrsChangingCommand::Permissions &_p);
 static std::pair<uint32_t, uint32_t> FlagsValueAndMask(const AttrsChangingCommand::Flags &_f);
 
@@ -161,25 +212,263 @@ void AttrsChangingJob::ScanItem(const std::string &_full_path,
 
 void AttrsChangingJob::DoChange()
 {
-    int n = 0;
-    for( auto i = std::begin(m_Filenames), e = std::end(m_Filenames); i != e; ++i, ++n ) {
-        const auto &meta = m_Metas[n];
-        const auto &origin_item = m_Command.items[meta.origin_item];
-        const auto path = EnsureNoTrailingSlash(origin_item.Directory() + (*i).to_str_with_pref());
+    ChangingQueue queue;
+    queue.filenames.reserve(m_Metas.size());
+    for( const auto &filename : m_Filenames )
+        queue.filenames.emplace_back(&filename);
+    queue.done.resize(m_Metas.size(), false);
+
+    unsigned workers_number = 1;
+    for( const auto &item : m_Command.items )
+        workers_number = std::max(workers_number, ConcurrencyLimit(*item.Host()));
+    workers_number = static_cast<unsigned>(std::min<size_t>(workers_number, m_Metas.size()));
+
+    const base::DispatchGroup workers;
+    for( unsigned i = 1; i < workers_number; ++i )
+        workers.Run([&] { RunChangingWorker(queue); });
+    RunChangingWorker(queue);
+    workers.Wait();
+}
 
-        const auto success = AlterSingleItem(path, *origin_item.Host(), meta.stat);
+void AttrsChangingJob::RunChangingWorker(ChangingQueue &_queue)
+{
+    NativeDirectoryCache native_dir;
+    while( true ) {
+        if( BlockIfPaused(); IsStopped() )
+            break;
 
-        if( success ) {
-            Statistics().CommitProcessed(Statistics::SourceType::Items, 1);
+        // claiming the next batch of items which share the same host, provided the host isn't saturated yet
+        size_t first = 0;
+        size_t last = 0;
+        const VFSHost *host = nullptr;
+        {
+            auto lock = std::unique_lock{_queue.lock};
+            const auto host_of = [&](size_t _index) {
+                return m_Command.items[m_Metas[_index].origin_item].Host().get();
+            };
+            _queue.cv.wait(lock, [&] {
+                return IsStopped() || _queue.next == m_Metas.size() ||
+                       _queue.busy[host_of(_queue.next)] < ConcurrencyLimit(*host_of(_queue.next));
+            });
+            if( IsStopped() || _queue.next == m_Metas.size() )
+                break;
+            first = last = _queue.next;
+            host = host_of(first);
+            while( last != m_Metas.size() && last - first < g_ChangingBatchSize && host_of(last) == host )
+                ++last;
+            _queue.next = last;
+            ++_queue.busy[host];
+        }
 
-            // for now reports only about successful processing
-            const ItemStateReport report{.host = *origin_item.Host(), .path = path, .status = ItemStatus::Processed};
-            TellItemReport(report);
+        for( size_t index = first; index != last; ++index ) {
+            if( BlockIfPaused(); !IsStopped() )
+                AlterItem(index, _queue, native_dir);
+
+            const auto lock = std::lock_guard{_queue.lock};
+            _queue.done[index] = true;
+            while( _queue.done_before != _queue.done.size() && _queue.done[_queue.done_before] )
+                ++_queue.done_before;
+            if( index + 1 == last )
+                --_queue.busy[host];
+            _queue.cv.notify_all();
         }
+    }
 
-        if( BlockIfPaused(); IsStopped() )
+    const auto lock = std::lock_guard{_queue.lock};
+    _queue.cv.notify_all();
+}
+
+void AttrsChangingJob::AlterItem(size_t _index, ChangingQueue &_queue, NativeDirectoryCache &_native_dir)
+{
+    const auto &meta = m_Metas[_index];
+    const auto &origin_item = m_Command.items[meta.origin_item];
+    auto &vfs = *origin_item.Host();
+    const auto path = EnsureNoTrailingSlash(origin_item.Directory() + _queue.filenames[_index]->to_str_with_pref());
+
+    // the attributes are first set without consulting the callbacks, on native volumes - relative to the directory
+    bool success = false;
+    if( CanAlterNatively(vfs) ) {
+        const auto slash = path.rfind('/');
+        if( slash != std::string::npos && slash + 1 != path.size() ) {
+            const auto dir_fd = _native_dir.Get(std::string_view(path).substr(0, std::max<size_t>(slash, 1)));
+            success = TryAlterSingleNativeItem(dir_fd, dir_fd == AT_FDCWD ? path.c_str() : &path[slash + 1], meta.stat);
+        }
+    }
+    else {
+        success = TryAlterSingleItem(path, vfs, meta.stat);
+    }
+
+    if( !success ) {
+        // the errors are resolved in the order of the items, so this one waits for all the previous ones
+        {
+            auto lock = std::unique_lock{_queue.lock};
+            _queue.cv.wait(lock, [&] { return IsStopped() || _queue.done_before == _index; });
+        }
+        if( IsStopped() )
             return;
+        success = AlterSingleItem(path, vfs, meta.stat);
     }
+
+    if( success ) {
+        Statistics().CommitProcessed(Statistics::SourceType::Items, 1);
+
+        // for now reports only about successful processing
+        const ItemStateReport report{.host = vfs, .path = path, .status = ItemStatus::Processed};
+        const auto lock = std::lock_guard{_queue.reports_lock};
+        TellItemReport(report);
+    }
+}
+
+bool AttrsChangingJob::TryAlterSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat) const
+{
+    if( const auto mode = ModeToSet(_stat); mode && _vfs.SetPermissions(_path, *mode) != VFSError::Ok )
+        return false;
+
+    if( const auto owner = OwnershipToSet(_stat);
+        owner && _vfs.SetOwnership(_path, owner->first, owner->second) != VFSError::Ok )
+        return false;
+
+    if( const auto flags = FlagsToSet(_stat); flags && _vfs.SetFlags(_path, *flags, vfs::Flags::None) != VFSError::Ok )
+        return false;
+
+    if( m_Command.times ) {
+        const auto &times = *m_Command.times;
+        if( _vfs.SetTimes(_path, times.btime, times.mtime, times.ctime, times.atime) != VFSError::Ok )
+            return false;
+    }
+
+    return true;
+}
+
+bool AttrsChangingJob::TryAlterSingleNativeItem(int _dir_fd, const char *_name, const VFSStat &_stat) const
+{
+    // The changes are coalesced into as few setattrlist calls as possible. The flags are set separately after the
+    // permissions and the ownership since they can make the item immutable, and the times are set after the flags in
+    // that case, mimicking the order of the separate calls.
+    const auto mode = ModeToSet(_stat);
+    const auto owner = OwnershipToSet(_stat);
+    const auto flags = FlagsToSet(_stat);
+
+    const auto add_times = [this](SetAttrListCall &_call) {
+        if( !m_Command.times )
+            return;
+        const auto &times = *m_Command.times;
+        const std::pair<attrgroup_t, const std::optional<long> &> all[] = {{ATTR_CMN_CRTIME, times.btime},
+                                                                           {ATTR_CMN_MODTIME, times.mtime},
+                                                                           {ATTR_CMN_CHGTIME, times.ctime},
+                                                                           {ATTR_CMN_ACCTIME, times.atime}};
+        for( const auto &[attr, time] : all )
+            if( time )
+                _call.Add(attr, timespec{.tv_sec = *time, .tv_nsec = 0});
+    };
+
+    SetAttrListCall first;
+    if( !flags )
+        add_times(first);
+    if( owner ) {
+        first.Add(ATTR_CMN_OWNERID, static_cast<uid_t>(owner->first));
+        first.Add(ATTR_CMN_GRPID, static_cast<gid_t>(owner->second));
+    }
+    if( mode )
+        first.Add(ATTR_CMN_ACCESSMASK, static_cast<uint32_t>(*mode & ~S_IFMT));
+    if( !first.Apply(_dir_fd, _name) )
+        return false;
+
+    if( flags ) {
+        SetAttrListCall second;
+        second.Add(ATTR_CMN_FLAGS, static_cast<uint32_t>(*flags));
+        if( !second.Apply(_dir_fd, _name) )
+            return false;
+
+        SetAttrListCall third;
+        add_times(third);
+        if( !third.Apply(_dir_fd, _name) )
+            return false;
+    }
+
+    return true;
+}
+
+std::optional<uint16_t> AttrsChangingJob::ModeToSet(const VFSStat &_stat) const noexcept
+{
+    if( !m_ChmodCommand )
+        return std::nullopt;
+    const auto [new_mode, mask] = *m_ChmodCommand;
+    const uint16_t mode = (_stat.mode & ~mask) | (new_mode & mask);
+    if( mode == _stat.mode )
+        return std::nullopt;
+    return mode;
+}
+
+std::optional<std::pair<unsigned, unsigned>> AttrsChangingJob::OwnershipToSet(const VFSStat &_stat) const noexcept
+{
+    if( !m_Command.ownage )
+        return std::nullopt;
+    const auto new_uid = m_Command.ownage->uid ? *m_Command.ownage->uid : _stat.uid;
+    const auto new_gid = m_Command.ownage->gid ? *m_Command.ownage->gid : _stat.gid;
+    if( new_uid == _stat.uid && new_gid == _stat.gid )
+        return std::nullopt;
+    return std::pair{new_uid, new_gid};
+}
+
+std::optional<uint32_t> AttrsChangingJob::FlagsToSet(const VFSStat &_stat) const noexcept
+{
+    if( !m_ChflagCommand )
+        return std::nullopt;
+    const auto [new_flags, mask] = *m_ChflagCommand;
+    const uint32_t flags = (_stat.flags & ~mask) | (new_flags & mask);
+    if( flags == _stat.flags )
+        return std::nullopt;
+    return flags;
+}
+
+unsigned AttrsChangingJob::ConcurrencyLimit(const VFSHost &_host) const noexcept
+{
+    return std::max(1u, _host.IsNativeFS() ? m_Command.concurrency.native : m_Command.concurrency.other);
+}
+
+bool AttrsChangingJob::CanAlterNatively(const VFSHost &_host) noexcept
+{
+    // the native calls bypass the VFS layer and can't go through the privileged helper, so they're used only with the
+    // plain native host and without the routed I/O
+    return typeid(_host) == typeid(vfs::NativeHost) && !routedio::RoutedIO::Default.isrouted();
+}
+
+SetAttrListCall::SetAttrListCall() noexcept
+{
+    std::memset(&attrs, 0, sizeof(attrs));
+    attrs.bitmapcount = ATTR_BIT_MAP_COUNT;
+}
+
+template <class T>
+void SetAttrListCall::Add(attrgroup_t _attr, const T &_value) noexcept
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    attrs.commonattr |= _attr;
+    std::memcpy(buffer.data() + size, &_value, sizeof(_value));
+    size += sizeof(_value);
+}
+
+bool SetAttrListCall::Apply(int _dir_fd, const char *_name) noexcept
+{
+    return attrs.commonattr == 0 || setattrlistat(_dir_fd, _name, &attrs, buffer.data(), size, 0) == 0;
+}
+
+AttrsChangingJob::NativeDirectoryCache::~NativeDirectoryCache()
+{
+    if( fd >= 0 )
+        close(fd);
+}
+
+int AttrsChangingJob::NativeDirectoryCache::Get(std::string_view _path)
+{
+    if( fd >= 0 && path == _path )
+        return fd;
+    if( fd >= 0 )
+        close(fd);
+    path = _path;
+    fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    return fd >= 0 ? fd : AT_FDCWD;
 }
 
 bool AttrsChangingJob::AlterSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat)
@@ -205,10 +494,10 @@ bool AttrsChangingJob::AlterSingleItem(const std::string &_path, VFSHost &_vfs,
 
 bool AttrsChangingJob::ChmodSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat)
 {
-    const auto [new_mode, mask] = *m_ChmodCommand;
-    const uint16_t mode = (_stat.mode & ~mask) | (new_mode & mask);
-    if( mode == _stat.mode )
+    const auto to_set = ModeToSet(_stat);
+    if( !to_set )
         return true;
+    const auto mode = *to_set;
 
     while( true ) {
         const auto chmod_rc = _vfs.SetPermissions(_path, mode);
@@ -231,10 +520,10 @@ bool AttrsChangingJob::ChmodSingleItem(const std::string &_path, VFSHost &_vfs,
 
 bool AttrsChangingJob::ChownSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat)
 {
-    const auto new_uid = m_Command.ownage->uid ? *m_Command.ownage->uid : _stat.uid;
-    const auto new_gid = m_Command.ownage->gid ? *m_Command.ownage->gid : _stat.gid;
-    if( new_uid == _stat.uid && new_gid == _stat.gid )
+    const auto to_set = OwnershipToSet(_stat);
+    if( !to_set )
         return true;
+    const auto [new_uid, new_gid] = *to_set;
 
     while( true ) {
         const auto chown_rc = _vfs.SetOwnership(_path, new_uid, new_gid);
@@ -257,10 +546,10 @@ bool AttrsChangingJob::ChownSingleItem(const std::string &_path, VFSHost &_vfs,
 
 bool AttrsChangingJob::ChflagSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat)
 {
-    const auto [new_flags, mask] = *m_ChflagCommand;
-    const uint32_t flags = (_stat.flags & ~mask) | (new_flags & mask);
-    if( flags == _stat.flags )
+    const auto to_set = FlagsToSet(_stat);
+    if( !to_set )
         return true;
+    const auto flags = *to_set;
 
     while( true ) {
         const auto chflags_rc = _vfs.SetFlags(_path, flags, vfs::Flags::None);
@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2019 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include "../Job.h"
@@ -57,6 +57,9 @@ public:
     ~AttrsChangingJob();
 
 private:
+    struct ChangingQueue;
+    struct NativeDirectoryCache;
+
     virtual void Perform() override;
     void DoScan();
     void ScanItem(unsigned _origin_item);
@@ -65,6 +68,15 @@ private:
                   unsigned _origin_item,
                   const base::chained_strings::node *_prefix);
     void DoChange();
+    void RunChangingWorker(ChangingQueue &_queue);
+    void AlterItem(size_t _index, ChangingQueue &_queue, NativeDirectoryCache &_native_dir);
+    bool TryAlterSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat) const;
+    bool TryAlterSingleNativeItem(int _dir_fd, const char *_name, const VFSStat &_stat) const;
+    std::optional<uint16_t> ModeToSet(const VFSStat &_stat) const noexcept;
+    std::optional<std::pair<unsigned, unsigned>> OwnershipToSet(const VFSStat &_stat) const noexcept;
+    std::optional<uint32_t> FlagsToSet(const VFSStat &_stat) const noexcept;
+    unsigned ConcurrencyLimit(const VFSHost &_host) const noexcept;
+    static bool CanAlterNatively(const VFSHost &_host) noexcept;
     bool AlterSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat);
     bool ChmodSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat);
     bool ChownSingleItem(const std::string &_path, VFSHost &_vfs, const VFSStat &_stat);
@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2019 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <VFS/VFS.h>
@@ -57,6 +57,13 @@ struct AttrsChangingCommand {
 
     std::vector<VFSListingItem> items;
     bool apply_to_subdirs = false;
+
+    // The maximum number of items being altered simultaneously on a single host, 1 means a serial processing.
+    struct Concurrency {
+        unsigned native = 8;
+        unsigned other = 4;
+    };
+    Concurrency concurrency;
 };
 
 } // namespace nc::ops
@@ -7,7 +7,9 @@
 #include "../GenericErrorDialog.h"
 #include "../Internal.h"
 #include "../ModalDialogResponses.h"
+#include <filesystem>
 #include <memory>
+#include <set>
 
 // TODO: remove once callback results are no longer wrapped into 'int'
 #pragma clang diagnostic ignored "-Wold-style-cast"
@@ -17,6 +19,7 @@ namespace nc::ops {
 using Callbacks = BatchRenamingJobCallbacks;
 
 static std::string Caption(const std::vector<std::string> &_paths);
+static std::vector<OperationResource> ResolveResources(const std::vector<std::string> &_paths, const VFSHost &_vfs);
 
 BatchRenaming::BatchRenaming(std::vector<std::string> _src_paths,
                              std::vector<std::string> _dst_paths,
@@ -26,6 +29,7 @@ BatchRenaming::BatchRenaming(std::vector<std::string> _src_paths,
         throw std::logic_error("BatchRenaming: invalid parameters");
 
     SetTitle(Caption(_src_paths));
+    SetResources(ResolveResources(_src_paths, *_vfs));
 
     m_Job = std::make_unique<BatchRenamingJob>(std::move(_src_paths), std::move(_dst_paths), _vfs);
     m_Job->m_OnRenameError = [this](int _err, const std::string &_path, VFSHost &_vfs) {
@@ -76,4 +80,18 @@ static std::string Caption(const std::vector<std::string> &_paths)
         .UTF8String;
 }
 
+static std::vector<OperationResource> ResolveResources(const std::vector<std::string> &_paths, const VFSHost &_vfs)
+{
+    // the renamed items usually share the same directory
+    std::set<std::string> directories;
+    for( const auto &path : _paths )
+        directories.emplace(std::filesystem::path(path).parent_path().native());
+
+    std::vector<OperationResource> resources;
+    for( const auto &directory : directories )
+        if( auto resource = ResolveOperationResource(_vfs, directory) )
+            resources.emplace_back(std::move(*resource));
+    return resources;
+}
+
 } // namespace nc::ops
@@ -4,6 +4,7 @@
 #include "BatchRenamingDialog.h"
 #include "BatchRenamingRangeSelectionPopover.h"
 #include "BatchRenamingScheme.h"
+#include "BatchRenamingPreview.h"
 #include <Base/dispatch_cpp.h>
 #include <Utility/ObjCpp.h>
 #include <Utility/StringExtras.h>
@@ -153,12 +154,13 @@ static auto g_MyPrivateTableViewDataType = @"com.magnumbytes.nc.ops.BatchRenameS
 
 @end
 
-using SourceReverseMappingStorage =
-    ankerl::unordered_dense::map<std::string, size_t, nc::UnorderedStringHashEqual, nc::UnorderedStringHashEqual>;
+using SourceReverseMappingStorage = ankerl::unordered_dense::map<std::u16string, size_t>;
+using DestinationReverseMappingStorage = ankerl::unordered_dense::map<std::u16string_view, size_t>;
 
 @implementation NCOpsBatchRenamingDialog {
-    std::vector<BatchRenamingScheme::FileInfo> m_FileInfos;
+    std::shared_ptr<const BatchRenamingPreview::FileInfos> m_FileInfos; // copied on changes, previews may use it
     SourceReverseMappingStorage m_SourceReverseMapping;
+    std::shared_ptr<BatchRenamingPreview> m_Preview;
 
     std::vector<NSTextField *> m_LabelsBefore;
     std::vector<NSTextField *> m_LabelsAfter;
@@ -207,13 +209,15 @@ using SourceReverseMappingStorage =
         if( _items.empty() )
             throw std::logic_error("empty files list");
 
+        auto file_infos = std::make_shared<BatchRenamingPreview::FileInfos>();
         for( auto &entry : _items ) {
-            m_FileInfos.emplace_back(entry);
+            file_infos->emplace_back(entry);
             m_ResultSource.emplace_back(entry.Directory() + entry.Filename());
         }
+        m_FileInfos = std::move(file_infos);
 
-        for( size_t i = 0; i != m_FileInfos.size(); ++i )
-            m_SourceReverseMapping.emplace(m_FileInfos[i].filename.UTF8String, i);
+        for( size_t i = 0; i != m_FileInfos->size(); ++i )
+            m_SourceReverseMapping.emplace((*m_FileInfos)[i].filename, i);
 
         for( auto &e : _items ) {
 
@@ -323,6 +327,11 @@ using SourceReverseMappingStorage =
 }
 
 - (void)updateRenamedFilenames
+{
+    [self updateRenamedFilenamesWaitingForCompletion:false];
+}
+
+- (void)updateRenamedFilenamesWaitingForCompletion:(bool)_wait
 {
     NSString *filename_mask = self.FilenameMask.stringValue ? self.FilenameMask.stringValue : @"";
 
@@ -336,56 +345,91 @@ using SourceReverseMappingStorage =
         static_cast<BatchRenamingScheme::CaseTransform>(self.CaseProcessing.selectedTag);
     bool ct_with_ext = self.CaseProcessingWithExtension.state == NSControlStateValueOn;
 
-    BatchRenamingScheme br;
-    br.SetReplacingOptions(search_for, replace_with, search_case_sens, search_once, search_in_ext, search_regexp);
-    br.SetCaseTransform(ct, ct_with_ext);
-    br.SetDefaultCounter(m_CounterStartsAt, m_CounterStepsBy, 1, static_cast<unsigned>(self.CounterDigits.selectedTag));
+    auto br = std::make_shared<BatchRenamingScheme>();
+    br->SetReplacingOptions(search_for, replace_with, search_case_sens, search_once, search_in_ext, search_regexp);
+    br->SetCaseTransform(ct, ct_with_ext);
+    br->SetDefaultCounter(
+        m_CounterStartsAt, m_CounterStepsBy, 1, static_cast<unsigned>(self.CounterDigits.selectedTag));
 
-    if( !br.BuildActionsScript(filename_mask) ) {
+    // the previous preview is of no use anymore, even if it's still being computed
+    if( m_Preview ) {
+        m_Preview->Cancel();
+        m_Preview.reset();
+    }
+
+    if( !br->BuildActionsScript(filename_mask) ) {
         for( auto &l : m_LabelsAfter )
             l.stringValue = @"<Error!>";
         self.isValidRenaming = false;
         return;
     }
 
-    // apply the renaming scheme to the source filenames
-    std::vector<NSString *> renamed_names;
-    renamed_names.reserve(m_FileInfos.size());
-    for( size_t index = 0, e = m_FileInfos.size(); index != e; ++index ) {
-        NSString *renamed_name = br.Rename(m_FileInfos[index], static_cast<int>(index));
-        renamed_names.emplace_back(renamed_name);
+    auto preview = std::make_shared<BatchRenamingPreview>(std::move(br), m_FileInfos);
+    m_Preview = preview;
+
+    // the visible rows are renamed right away so that editing the mask gets an immediate response
+    const NSRange visible_rows = [self.FilenamesTable rowsInRect:self.FilenamesTable.visibleRect];
+    const size_t visible_first = std::min<size_t>(visible_rows.location, preview->Size());
+    const size_t visible_last = std::min<size_t>(NSMaxRange(visible_rows), preview->Size());
+    preview->Compute(visible_first, visible_last);
+    for( size_t index = visible_first; index != visible_last; ++index )
+        m_LabelsAfter[index].stringValue = BatchRenamingScheme::ToNSString(preview->Filename(index));
+
+    if( _wait ) {
+        preview->ComputeRemaining();
+        [self acceptPreview:preview];
+        return;
     }
 
+    // the renaming can't be validated until all the filenames are known
+    self.isValidRenaming = false;
+    __weak NCOpsBatchRenamingDialog *weak_self = self;
+    dispatch_to_default([preview, weak_self] {
+        if( !preview->ComputeRemaining() )
+            return;
+        dispatch_to_main_queue([preview, weak_self] {
+            if( NCOpsBatchRenamingDialog *const strong_self = weak_self )
+                [strong_self acceptPreview:preview];
+        });
+    });
+}
+
+- (void)acceptPreview:(const std::shared_ptr<BatchRenamingPreview> &)_preview
+{
+    dispatch_assert_main_queue();
+    if( _preview != m_Preview )
+        return; // this preview was superseded by a newer one
+
     // build the reverse mapping to check for duplicates later
-    SourceReverseMappingStorage dest_reverse_mapping;
-    dest_reverse_mapping.reserve(m_FileInfos.size());
-    for( size_t index = 0, e = renamed_names.size(); index != e; ++index )
-        dest_reverse_mapping.emplace(renamed_names[index].UTF8String, index);
+    const size_t size = _preview->Size();
+    DestinationReverseMappingStorage dest_reverse_mapping;
+    dest_reverse_mapping.reserve(size);
+    for( size_t index = 0; index != size; ++index )
+        dest_reverse_mapping.emplace(_preview->Filename(index), index);
 
     // transfer the results to the labels
-    for( size_t index = 0, e = renamed_names.size(); index != e; ++index )
-        m_LabelsAfter[index].stringValue = renamed_names[index];
+    for( size_t index = 0; index != size; ++index )
+        m_LabelsAfter[index].stringValue = BatchRenamingScheme::ToNSString(_preview->Filename(index));
 
     self.isValidRenaming = true;
 
     // validate the resulting filenames
-    for( size_t index = 0, e = m_FileInfos.size(); index != e; ++index ) {
+    for( size_t index = 0; index != size; ++index ) {
         bool is_valid = true;
-        NSString *renamed_into = renamed_names[index];
-        if( renamed_into.length == 0 ) {
+        const std::u16string &renamed_into = _preview->Filename(index);
+        if( renamed_into.empty() ) {
             // don't allow empty filenames
             is_valid = false;
         }
         else {
             // now check for duplicates
-            const char *utf8 = renamed_into.UTF8String;
-            const auto source_reverse_it = m_SourceReverseMapping.find(utf8);
+            const auto source_reverse_it = m_SourceReverseMapping.find(renamed_into);
             if( source_reverse_it != m_SourceReverseMapping.end() && source_reverse_it->second != index ) {
                 // prohibit renaming into filenames which might already exist initially.
                 is_valid = false;
             }
 
-            const auto dest_reverse_it = dest_reverse_mapping.find(utf8);
+            const auto dest_reverse_it = dest_reverse_mapping.find(renamed_into);
             assert(dest_reverse_it != dest_reverse_mapping.end());
             if( dest_reverse_it->second != index ) {
                 // prohibit the renamed set from having duplicates
@@ -421,15 +465,15 @@ using SourceReverseMappingStorage =
     if( self.FilenamesTable.selectedRow >= 0 ) {
         // pick the filename of the select item
         const auto index = self.FilenamesTable.selectedRow;
-        pc.string = m_FileInfos[index].name;
+        pc.string = BatchRenamingScheme::ToNSString((*m_FileInfos)[index].name);
     }
     else {
         // pick the longest filename
         const auto longest_it = std::ranges::max_element(
-            m_FileInfos, [](const BatchRenamingScheme::FileInfo &lhs, const BatchRenamingScheme::FileInfo &rhs) {
-                return lhs.name.length < rhs.name.length;
+            *m_FileInfos, [](const BatchRenamingScheme::FileInfo &lhs, const BatchRenamingScheme::FileInfo &rhs) {
+                return lhs.name.length() < rhs.name.length();
             });
-        pc.string = longest_it->name;
+        pc.string = BatchRenamingScheme::ToNSString(longest_it->name);
     }
 
     m_Popover = [NSPopover new];
@@ -594,7 +638,9 @@ using SourceReverseMappingStorage =
         return false;
 
     // don't forget to swap items in ALL containers!
-    std::swap(m_FileInfos[drag_to], m_FileInfos[drag_from]);
+    auto file_infos = std::make_shared<BatchRenamingPreview::FileInfos>(*m_FileInfos);
+    std::swap((*file_infos)[drag_to], (*file_infos)[drag_from]);
+    m_FileInfos = std::move(file_infos);
     std::swap(m_LabelsBefore[drag_to], m_LabelsBefore[drag_from]);
     std::swap(m_LabelsAfter[drag_to], m_LabelsAfter[drag_from]);
     std::swap(m_ResultSource[drag_to], m_ResultSource[drag_from]);
@@ -609,14 +655,14 @@ using SourceReverseMappingStorage =
 - (void)buildResultDestinations
 {
     m_ResultDestination.clear();
-    for( size_t i = 0, e = m_FileInfos.size(); i != e; ++i )
-        m_ResultDestination.emplace_back(m_FileInfos[i].item.Directory() +
+    for( size_t i = 0, e = m_FileInfos->size(); i != e; ++i )
+        m_ResultDestination.emplace_back((*m_FileInfos)[i].item.Directory() +
                                          m_LabelsAfter[i].stringValue.fileSystemRepresentationSafe);
 }
 
 - (IBAction)OnOK:(id) [[maybe_unused]] _sender
 {
-    [self updateRenamedFilenames];
+    [self updateRenamedFilenamesWaitingForCompletion:true];
     [self buildResultDestinations];
 
     [m_RenamePatternDataSource reportEnteredItem:self.FilenameMask.stringValue];
@@ -650,8 +696,8 @@ using SourceReverseMappingStorage =
 
 - (void)removeItemAtIndex:(size_t)_index
 {
-    assert(_index < m_FileInfos.size());
-    if( _index == 0 && m_FileInfos.size() == 1 ) {
+    assert(_index < m_FileInfos->size());
+    if( _index == 0 && m_FileInfos->size() == 1 ) {
         NSAlert *alert = [[NSAlert alloc] init];
         [alert setMessageText:NSLocalizedString(
                                   @"Cannot remove the last item being renamed",
@@ -661,7 +707,9 @@ using SourceReverseMappingStorage =
     }
 
     // don't forget to erase items in ALL containers!
-    m_FileInfos.erase(std::next(m_FileInfos.begin(), _index));
+    auto file_infos = std::make_shared<BatchRenamingPreview::FileInfos>(*m_FileInfos);
+    file_infos->erase(std::next(file_infos->begin(), _index));
+    m_FileInfos = std::move(file_infos);
     m_LabelsBefore.erase(std::next(m_LabelsBefore.begin(), _index));
     m_LabelsAfter.erase(std::next(m_LabelsAfter.begin(), _index));
     m_ResultSource.erase(std::next(m_ResultSource.begin(), _index));
@@ -1,9 +1,24 @@
-// Copyright (C) 2017-2021 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "BatchRenamingJob.h"
 #include <Utility/StringExtras.h>
+#include <Base/CFString.h>
+#include <Base/DispatchGroup.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 namespace nc::ops {
 
+// the number of chains renamed simultaneously on native volumes, other hosts rename the chains one by one
+static constexpr unsigned g_NativeConcurrencyLimit = 8;
+
+struct BatchRenamingJob::Execution {
+    std::atomic_size_t next_chain = 0;
+    std::mutex callbacks_lock; // the errors are resolved one at a time
+};
+
+static std::string FoldCase(std::string_view _path);
+
 BatchRenamingJob::BatchRenamingJob(std::vector<std::string> _src_paths,
                                    std::vector<std::string> _dst_paths,
                                    std::shared_ptr<VFSHost> _vfs)
@@ -19,20 +34,109 @@ void BatchRenamingJob::Perform()
 {
     Statistics().CommitEstimated(Statistics::SourceType::Items, m_Source.size());
 
-    for( int i = 0, e = static_cast<int>(m_Source.size()); i != e; ++i ) {
-        if( BlockIfPaused(); IsStopped() )
-            return;
+    const BatchRenamingPlan plan = BuildPlan();
+    Execution execution;
+    const auto workers_number = static_cast<unsigned>(std::min<size_t>(ConcurrencyLimit(), plan.ChainsCount()));
+
+    const base::DispatchGroup workers;
+    for( unsigned i = 1; i < workers_number; ++i )
+        workers.Run([&] { RunWorker(plan, execution); });
+    RunWorker(plan, execution);
+    workers.Wait();
+}
+
+BatchRenamingPlan BatchRenamingJob::BuildPlan() const
+{
+    // the case sensitivity is checked once per directory, the items normally share the same one
+    std::string directory;
+    bool case_sensitive = true;
 
-        Rename(m_Source[i], m_Destination[i]);
+    BatchRenamingPlanOptions options;
+    options.key = [&](std::string_view _path) {
+        const auto slash = _path.rfind('/');
+        const auto path_directory = _path.substr(0, slash == std::string_view::npos ? 0 : slash + 1);
+        if( path_directory != directory ) {
+            directory = path_directory;
+            case_sensitive = m_VFS->IsCaseSensitiveAtPath(directory);
+        }
+        return case_sensitive ? std::string(_path) : FoldCase(_path);
+    };
+    options.exists = [&](const std::string &_path) { return m_VFS->Exists(_path); };
+
+    return BatchRenamingPlan(m_Source, m_Destination, options);
+}
+
+void BatchRenamingJob::RunWorker(const BatchRenamingPlan &_plan, Execution &_execution)
+{
+    while( true ) {
+        const size_t index = _execution.next_chain.fetch_add(1);
+        if( index >= _plan.ChainsCount() || IsStopped() )
+            return;
+        PerformChain(_plan, _plan.Chain(index), _execution);
     }
 }
 
-void BatchRenamingJob::Rename(const std::string &_src, const std::string &_dst)
+void BatchRenamingJob::PerformChain(const BatchRenamingPlan &_plan,
+                                    std::span<const BatchRenamingPlan::Step> _chain,
+                                    Execution &_execution)
 {
-    if( _src == _dst ) {
-        Statistics().CommitProcessed(Statistics::SourceType::Items, 1);
+    // The item moved aside to break a cycle is the first one in the chain and is moved into its destination by the last
+    // step. The chain is not rolled back if stopped in between, the item then stays under its temporary name.
+    using StepKind = BatchRenamingPlan::StepKind;
+    bool moved_aside = false;
+    for( size_t index = 0; index != _chain.size(); ++index ) {
+        if( BlockIfPaused(); IsStopped() )
+            return;
+
+        const auto &step = _chain[index];
+        const auto &src = m_Source[step.item];
+        const auto &dst = m_Destination[step.item];
+        bool renamed = false;
+        switch( step.kind ) {
+            case StepKind::Direct:
+                renamed = Rename(src, dst, _execution);
+                break;
+            case StepKind::ToTemporary:
+                renamed = moved_aside = Rename(src, _plan.Temporary(step.item), _execution);
+                break;
+            case StepKind::FromTemporary:
+                renamed = Rename(_plan.Temporary(step.item), dst, _execution);
+                break;
+        }
+
+        if( renamed ) {
+            if( step.kind != StepKind::ToTemporary )
+                Statistics().CommitProcessed(Statistics::SourceType::Items, 1);
+            continue;
+        }
+        if( IsStopped() )
+            return;
+        if( !_plan.IsOrdered() ) {
+            // the renames of the degenerate plan don't depend on each other
+            Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
+            continue;
+        }
+
+        // Each following step would move its item onto the name still occupied by the item which wasn't renamed, so
+        // the rest of the chain is skipped. The item moved aside gets back its original name if that's still free.
+        if( moved_aside && step.kind == StepKind::Direct ) {
+            const size_t aside = _chain.front().item;
+            if( !m_VFS->Exists(m_Source[aside]) )
+                m_VFS->Rename(_plan.Temporary(aside), m_Source[aside]);
+        }
+        const auto is_pending = [&](const BatchRenamingPlan::Step &_step) {
+            return _step.kind == StepKind::Direct || (_step.kind == StepKind::FromTemporary && moved_aside);
+        };
+        const auto pending = std::ranges::count_if(_chain.subspan(index + 1), is_pending);
+        Statistics().CommitSkipped(Statistics::SourceType::Items, 1 + static_cast<size_t>(pending));
         return;
     }
+}
+
+bool BatchRenamingJob::Rename(const std::string &_src, const std::string &_dst, Execution &_execution)
+{
+    if( _src == _dst )
+        return true;
 
     while( true ) {
         const auto dst_exists = m_VFS->Exists(_dst);
@@ -44,21 +148,40 @@ void BatchRenamingJob::Rename(const std::string &_src, const std::string &_dst)
             rc = m_VFS->Rename(_src, _dst);
 
         if( rc == VFSError::Ok )
-            break;
+            return true;
 
+        const auto lock = std::lock_guard{_execution.callbacks_lock};
+        if( IsStopped() )
+            return false;
         switch( m_OnRenameError(rc, _dst, *m_VFS) ) {
             case RenameErrorResolution::Skip:
-                Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
-                return;
+                return false;
             case RenameErrorResolution::Stop:
                 Stop();
-                return;
+                return false;
             case RenameErrorResolution::Retry:
                 continue;
         }
     }
+}
 
-    Statistics().CommitProcessed(Statistics::SourceType::Items, 1);
+unsigned BatchRenamingJob::ConcurrencyLimit() const noexcept
+{
+    return m_VFS->IsNativeFS() ? g_NativeConcurrencyLimit : 1;
+}
+
+static std::string FoldCase(std::string_view _path)
+{
+    // mimics the comparison of the names on case-insensitive volumes: case-folded and decomposed
+    const base::CFString str(_path);
+    if( !str )
+        return std::string(_path);
+    const auto folded = base::CFPtr<CFMutableStringRef>::adopt(CFStringCreateMutableCopy(nullptr, 0, *str));
+    if( !folded )
+        return std::string(_path);
+    CFStringFold(folded.get(), kCFCompareCaseInsensitive, nullptr);
+    CFStringNormalize(folded.get(), kCFStringNormalizationFormD);
+    return base::CFStringGetUTF8StdString(folded.get());
 }
 
 } // namespace nc::ops
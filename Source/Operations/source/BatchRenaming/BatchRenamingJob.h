@@ -1,7 +1,8 @@
-// Copyright (C) 2017-2019 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include "../Job.h"
+#include "BatchRenamingPlan.h"
 #include <VFS/VFS.h>
 
 namespace nc::ops {
@@ -25,8 +26,16 @@ public:
     ~BatchRenamingJob();
 
 private:
+    struct Execution;
+
     virtual void Perform() override;
-    void Rename(const std::string &_src, const std::string &_dst);
+    BatchRenamingPlan BuildPlan() const;
+    void RunWorker(const BatchRenamingPlan &_plan, Execution &_execution);
+    void PerformChain(const BatchRenamingPlan &_plan,
+                      std::span<const BatchRenamingPlan::Step> _chain,
+                      Execution &_execution);
+    bool Rename(const std::string &_src, const std::string &_dst, Execution &_execution);
+    unsigned ConcurrencyLimit() const noexcept;
 
     std::vector<std::string> m_Source;
     std::vector<std::string> m_Destination;
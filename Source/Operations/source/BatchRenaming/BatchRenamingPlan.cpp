@@ -0,0 +1,138 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "BatchRenamingPlan.h"
+#include <ankerl/unordered_dense.h>
+#include <fmt/format.h>
+#include <algorithm>
+#include <cassert>
+#include <limits>
+
+namespace nc::ops {
+
+using KeysMap = ankerl::unordered_dense::map<std::string, size_t>;
+
+static constexpr size_t g_NoItem = std::numeric_limits<size_t>::max();
+
+static std::string MakeTemporary(const std::string &_src_path,
+                                 const KeysMap &_src,
+                                 const KeysMap &_dst,
+                                 const BatchRenamingPlanOptions &_opts)
+{
+    // the temporary item is placed next to the source and is named after it to be recognizable if left behind
+    const auto slash = _src_path.rfind('/');
+    const auto directory = std::string_view(_src_path).substr(0, slash == std::string::npos ? 0 : slash + 1);
+    const auto filename = std::string_view(_src_path).substr(directory.size());
+    for( int index = 1; /*noop*/; ++index ) {
+        auto path = index == 1 ? fmt::format("{}.{}.renaming", directory, filename)
+                               : fmt::format("{}.{}.renaming {}", directory, filename, index);
+        const auto key = _opts.key ? _opts.key(path) : path;
+        if( _src.contains(key) || _dst.contains(key) )
+            continue;
+        if( _opts.exists && _opts.exists(path) )
+            continue;
+        return path;
+    }
+}
+
+BatchRenamingPlan::BatchRenamingPlan(std::span<const std::string> _src_paths,
+                                     std::span<const std::string> _dst_paths,
+                                     const BatchRenamingPlanOptions &_options)
+{
+    assert(_src_paths.size() == _dst_paths.size());
+    const size_t items_count = _src_paths.size();
+    const auto key_of = [&](const std::string &_path) { return _options.key ? _options.key(_path) : _path; };
+
+    KeysMap src_keys;
+    KeysMap dst_keys;
+    src_keys.reserve(items_count);
+    dst_keys.reserve(items_count);
+    for( size_t i = 0; i != items_count; ++i ) {
+        if( !src_keys.emplace(key_of(_src_paths[i]), i).second || !dst_keys.emplace(key_of(_dst_paths[i]), i).second ) {
+            BuildSequential(items_count);
+            return;
+        }
+    }
+
+    // An item depends on the item which currently occupies its destination. Since the destinations are unique, every
+    // item has at most one dependent. A case-only rename depends on nothing since it occupies its own destination.
+    std::vector<size_t> dependent(items_count, g_NoItem);
+    std::vector<uint8_t> blocked(items_count, 0);
+    for( const auto &[key, item] : dst_keys ) {
+        if( const auto it = src_keys.find(key); it != src_keys.end() && it->second != item ) {
+            dependent[it->second] = item;
+            blocked[item] = 1;
+        }
+    }
+
+    m_Steps.reserve(items_count);
+    std::vector<uint8_t> planned(items_count, 0);
+
+    // the chains start from the items whose destinations are free
+    for( size_t i = 0; i != items_count; ++i ) {
+        if( blocked[i] )
+            continue;
+        m_ChainOffsets.emplace_back(m_Steps.size());
+        for( size_t item = i; item != g_NoItem; item = dependent[item] ) {
+            m_Steps.emplace_back(Step{item, StepKind::Direct});
+            planned[item] = 1;
+        }
+    }
+
+    // everything else forms cycles, each one is broken by moving its first item aside
+    for( size_t i = 0; i != items_count; ++i ) {
+        if( planned[i] )
+            continue;
+        m_ChainOffsets.emplace_back(m_Steps.size());
+        m_Steps.emplace_back(Step{i, StepKind::ToTemporary});
+        planned[i] = 1;
+        for( size_t item = dependent[i]; item != i; item = dependent[item] ) {
+            assert(item != g_NoItem);
+            m_Steps.emplace_back(Step{item, StepKind::Direct});
+            planned[item] = 1;
+        }
+        m_Steps.emplace_back(Step{i, StepKind::FromTemporary});
+        m_Temporaries.emplace_back(i, MakeTemporary(_src_paths[i], src_keys, dst_keys, _options));
+    }
+
+    m_ChainOffsets.emplace_back(m_Steps.size());
+}
+
+void BatchRenamingPlan::BuildSequential(size_t _items_count)
+{
+    m_Ordered = false;
+    m_Steps.clear();
+    m_Steps.reserve(_items_count);
+    for( size_t i = 0; i != _items_count; ++i )
+        m_Steps.emplace_back(Step{i, StepKind::Direct});
+    m_ChainOffsets = {0, _items_count};
+}
+
+size_t BatchRenamingPlan::ChainsCount() const noexcept
+{
+    return m_ChainOffsets.empty() ? 0 : m_ChainOffsets.size() - 1;
+}
+
+std::span<const BatchRenamingPlan::Step> BatchRenamingPlan::Chain(size_t _index) const noexcept
+{
+    assert(_index < ChainsCount());
+    return std::span<const Step>(m_Steps).subspan(m_ChainOffsets[_index],
+                                                  m_ChainOffsets[_index + 1] - m_ChainOffsets[_index]);
+}
+
+size_t BatchRenamingPlan::TemporariesCount() const noexcept
+{
+    return m_Temporaries.size();
+}
+
+const std::string &BatchRenamingPlan::Temporary(size_t _item) const noexcept
+{
+    const auto it = std::ranges::lower_bound(m_Temporaries, _item, {}, &std::pair<size_t, std::string>::first);
+    assert(it != m_Temporaries.end() && it->first == _item);
+    return it->second;
+}
+
+bool BatchRenamingPlan::IsOrdered() const noexcept
+{
+    return m_Ordered;
+}
+
+} // namespace nc::ops
@@ -0,0 +1,71 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nc::ops {
+
+struct BatchRenamingPlanOptions {
+    // Maps a path into the form in which the filesystem compares the names, e.g. case-folded on case-insensitive
+    // volumes. The paths are compared verbatim if not set.
+    std::function<std::string(std::string_view _path)> key;
+
+    // Tells whether something outside of the batch already occupies the path, used when picking temporary names.
+    std::function<bool(const std::string &_path)> exists;
+};
+
+// Orders the renames of a batch so that no item is moved onto a name which is still occupied by another item of the
+// same batch.
+// Each rename depends on at most one other rename - the one which moves away the item currently occupying its
+// destination. These dependencies form independent chains and cycles. A chain is performed starting from the rename
+// whose destination is free, e.g. "2"->"3", "1"->"2". A cycle is broken with exactly one temporary name, e.g. the swap
+// "a"->"b", "b"->"a" becomes "a"->"tmp", "b"->"a", "tmp"->"b".
+// Different chains never touch the same names and can be performed concurrently, while the steps of a chain must be
+// performed in order.
+// If the batch has duplicate sources or destinations there is no such ordering, then the plan degenerates into a
+// single chain of the renames in their original order.
+class BatchRenamingPlan
+{
+public:
+    enum class StepKind : uint8_t {
+        Direct,       // source -> destination
+        ToTemporary,  // source -> temporary
+        FromTemporary // temporary -> destination
+    };
+
+    struct Step {
+        size_t item;
+        StepKind kind;
+    };
+
+    BatchRenamingPlan(std::span<const std::string> _src_paths,
+                      std::span<const std::string> _dst_paths,
+                      const BatchRenamingPlanOptions &_options = {});
+
+    size_t ChainsCount() const noexcept;
+    std::span<const Step> Chain(size_t _index) const noexcept;
+
+    // The number of the cycles which were broken with temporary names.
+    size_t TemporariesCount() const noexcept;
+
+    // Returns the temporary path assigned to the item, requires the item to be renamed via a temporary name.
+    const std::string &Temporary(size_t _item) const noexcept;
+
+    // Tells whether the renames could be ordered, i.e. whether the chains are independent.
+    bool IsOrdered() const noexcept;
+
+private:
+    void BuildSequential(size_t _items_count);
+
+    std::vector<Step> m_Steps;
+    std::vector<size_t> m_ChainOffsets; // the chains are stored contiguously in m_Steps, with the sentinel at the end
+    std::vector<std::pair<size_t, std::string>> m_Temporaries; // sorted by the item index
+    bool m_Ordered = true;
+};
+
+} // namespace nc::ops
@@ -0,0 +1,77 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "BatchRenamingPreview.h"
+#include <Base/dispatch_cpp.h>
+#include <algorithm>
+#include <cassert>
+
+namespace nc::ops {
+
+BatchRenamingPreview::BatchRenamingPreview(std::shared_ptr<const BatchRenamingScheme> _scheme,
+                                           std::shared_ptr<const FileInfos> _files)
+    : m_Scheme(std::move(_scheme)), m_Files(std::move(_files))
+{
+    assert(m_Scheme);
+    assert(m_Files);
+    m_Filenames.resize(m_Files->size());
+    m_Computed.resize(m_Files->size(), 0);
+}
+
+void BatchRenamingPreview::Rename(size_t _index)
+{
+    if( m_Computed[_index] )
+        return;
+    m_Scheme->Rename((*m_Files)[_index], static_cast<int>(_index), m_Filenames[_index]);
+    m_Computed[_index] = 1;
+}
+
+void BatchRenamingPreview::Compute(size_t _first, size_t _last)
+{
+    _last = std::min(_last, Size());
+    for( size_t index = _first; index < _last; ++index )
+        Rename(index);
+}
+
+bool BatchRenamingPreview::ComputeRemaining(size_t _chunk_size)
+{
+    _chunk_size = std::max(_chunk_size, size_t(1));
+    const size_t size = Size();
+    const size_t chunks = (size + _chunk_size - 1) / _chunk_size;
+    dispatch_apply(chunks, [&](size_t _chunk) {
+        const size_t last = std::min((_chunk + 1) * _chunk_size, size);
+        for( size_t index = _chunk * _chunk_size; index < last; ++index ) {
+            if( m_Cancelled.load(std::memory_order_relaxed) )
+                return;
+            Rename(index);
+        }
+    });
+    return !IsCancelled();
+}
+
+void BatchRenamingPreview::Cancel() noexcept
+{
+    m_Cancelled = true;
+}
+
+bool BatchRenamingPreview::IsCancelled() const noexcept
+{
+    return m_Cancelled;
+}
+
+size_t BatchRenamingPreview::Size() const noexcept
+{
+    return m_Filenames.size();
+}
+
+bool BatchRenamingPreview::IsComputed(size_t _index) const noexcept
+{
+    assert(_index < Size());
+    return m_Computed[_index] != 0;
+}
+
+const std::u16string &BatchRenamingPreview::Filename(size_t _index) const noexcept
+{
+    assert(IsComputed(_index));
+    return m_Filenames[_index];
+}
+
+} // namespace nc::ops
@@ -0,0 +1,52 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include "BatchRenamingScheme.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace nc::ops {
+
+// Computes the filenames a renaming scheme produces for a set of files.
+// The rows the user can see are supposed to be computed first via Compute(), while the rest is computed by
+// ComputeRemaining() in parallel chunks and can be cancelled at any moment, e.g. when the mask was changed while the
+// previous preview was still being computed.
+// Compute() and ComputeRemaining() must not overlap, Cancel() can be called from any thread at any time.
+class BatchRenamingPreview
+{
+public:
+    using FileInfos = std::vector<BatchRenamingScheme::FileInfo>;
+    static constexpr size_t DefaultChunkSize = 256;
+
+    BatchRenamingPreview(std::shared_ptr<const BatchRenamingScheme> _scheme,
+                         std::shared_ptr<const FileInfos> _files);
+
+    // Renames the files in [_first, _last) which were not renamed yet, the range is clamped by Size().
+    void Compute(size_t _first, size_t _last);
+
+    // Renames all the files which were not renamed yet, in parallel chunks of _chunk_size files.
+    // Returns false if the preview was cancelled before all the files were renamed.
+    bool ComputeRemaining(size_t _chunk_size = DefaultChunkSize);
+
+    void Cancel() noexcept;
+    bool IsCancelled() const noexcept;
+
+    size_t Size() const noexcept;
+    bool IsComputed(size_t _index) const noexcept;
+
+    // Returns the new filename of the file, requires IsComputed(_index).
+    const std::u16string &Filename(size_t _index) const noexcept;
+
+private:
+    void Rename(size_t _index);
+
+    std::shared_ptr<const BatchRenamingScheme> m_Scheme;
+    std::shared_ptr<const FileInfos> m_Files;
+    std::vector<std::u16string> m_Filenames;
+    std::vector<uint8_t> m_Computed; // not a vector<bool> as the chunks are written concurrently
+    std::atomic_bool m_Cancelled = false;
+};
+
+} // namespace nc::ops
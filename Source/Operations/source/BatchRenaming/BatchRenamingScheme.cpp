@@ -0,0 +1,968 @@
+// Copyright (C) 2015-2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "BatchRenamingScheme.h"
+#include <Utility/Encodings.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <filesystem>
+
+namespace nc::ops {
+
+static constexpr char16_t g_EscapedOpenBracket = 0xE001;
+static constexpr char16_t g_EscapedCloseBracket = 0xE002;
+
+static bool IsASCII(std::u16string_view _str) noexcept
+{
+    return std::ranges::all_of(_str, [](char16_t _c) { return _c < 0x80; });
+}
+
+static char16_t ToUpperASCII(char16_t _c) noexcept
+{
+    return _c >= u'a' && _c <= u'z' ? static_cast<char16_t>(_c - u'a' + u'A') : _c;
+}
+
+static char16_t ToLowerASCII(char16_t _c) noexcept
+{
+    return _c >= u'A' && _c <= u'Z' ? static_cast<char16_t>(_c - u'A' + u'a') : _c;
+}
+
+static void AppendASCII(std::u16string &_to, std::string_view _ascii)
+{
+    for( const char c : _ascii )
+        _to.push_back(static_cast<char16_t>(c));
+}
+
+static std::u16string FromUTF8(std::string_view _utf8)
+{
+    std::u16string str(_utf8.size() + 1, u'\0');
+    size_t length = 0;
+    utility::InterpretUTF8BufferAsUTF16(reinterpret_cast<const uint8_t *>(_utf8.data()),
+                                        _utf8.size(),
+                                        reinterpret_cast<uint16_t *>(str.data()),
+                                        &length,
+                                        0xFFFD);
+    str.resize(length);
+    return str;
+}
+
+// Returns the position of the extension's dot or npos. Cases like "filename." and ".filename" have no extension.
+static size_t ExtensionDotPosition(std::u16string_view _filename) noexcept
+{
+    const size_t dot = _filename.rfind(u'.');
+    if( dot == std::u16string_view::npos || dot == 0 || dot == _filename.size() - 1 )
+        return std::u16string_view::npos;
+    return dot;
+}
+
+static void ReplaceAll(std::u16string &_str, std::u16string_view _what, std::u16string_view _with)
+{
+    for( size_t pos = _str.find(_what); pos != std::u16string::npos; pos = _str.find(_what, pos + _with.size()) )
+        _str.replace(pos, _what.size(), _with);
+}
+
+static std::pair<size_t, size_t> FindASCII(std::u16string_view _where, std::u16string_view _what, bool _case_sensitive)
+{
+    const auto it =
+        _case_sensitive
+            ? std::ranges::search(_where, _what).begin()
+            : std::ranges::search(_where, _what, [](char16_t _a, char16_t _b) {
+                  return ToLowerASCII(_a) == ToLowerASCII(_b);
+              }).begin();
+    if( it == _where.end() )
+        return {std::u16string_view::npos, 0};
+    return {static_cast<size_t>(std::distance(_where.begin(), it)), _what.size()};
+}
+
+static std::u16string TransformCasePortable(std::u16string_view _str, BatchRenamingScheme::CaseTransform _ct)
+{
+    std::u16string str(_str);
+    switch( _ct ) {
+        case BatchRenamingScheme::CaseTransform::Uppercase:
+            std::ranges::transform(str, str.begin(), ToUpperASCII);
+            break;
+        case BatchRenamingScheme::CaseTransform::Lowercase:
+            std::ranges::transform(str, str.begin(), ToLowerASCII);
+            break;
+        case BatchRenamingScheme::CaseTransform::Capitalized: {
+            bool word_start = true;
+            for( auto &c : str ) {
+                c = word_start ? ToUpperASCII(c) : ToLowerASCII(c);
+                word_start = c == u' ' || c == u'\t' || c == u'\n' || c == u'\r';
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    return str;
+}
+
+static std::u16string FormatTimePortable(time_t _time, const char *_format)
+{
+    struct tm tm;
+    localtime_r(&_time, &tm);
+    char buf[32];
+    const size_t length = strftime(buf, sizeof(buf), _format, &tm);
+    std::u16string str;
+    AppendASCII(str, std::string_view(buf, length));
+    return str;
+}
+
+const BatchRenamingScheme::Platform &BatchRenamingScheme::Platform::Portable() noexcept
+{
+    static const Platform platform = [] {
+        Platform p;
+        p.transform_case = &TransformCasePortable;
+        p.find = &FindASCII;
+        p.format_date = [](time_t _time) { return FormatTimePortable(_time, "%Y-%m-%d"); };
+        p.format_time = [](time_t _time) { return FormatTimePortable(_time, "%H:%M"); };
+        return p;
+    }();
+    return platform;
+}
+
+BatchRenamingScheme::BatchRenamingScheme(const Platform &_platform) noexcept : m_Platform(&_platform)
+{
+}
+
+std::optional<std::vector<BatchRenamingScheme::MaskDecomposition>>
+BatchRenamingScheme::DecomposeMaskIntoPlaceholders(std::u16string_view _mask)
+{
+    std::u16string mask(_mask);
+    if( mask.contains(u"[[") || mask.contains(u"]]") ) {
+        // Escape double brackets by converting them into private characters.
+        // Thats's rather brute-force and stupid, but since the masks are normally very short it shouldn't be a problem
+        ReplaceAll(mask, u"[[", std::u16string_view(&g_EscapedOpenBracket, 1));
+        ReplaceAll(mask, u"]]", std::u16string_view(&g_EscapedCloseBracket, 1));
+    }
+
+    constexpr auto npos = std::u16string::npos;
+    std::vector<BatchRenamingScheme::MaskDecomposition> result;
+    const size_t length = mask.size();
+    size_t location = 0;
+    while( location < length ) {
+        const size_t open = mask.find(u'[', location);
+        if( open == location ) {
+            // this part starts with placeholder
+            size_t close = mask.find(u']', location + 1);
+            if( close == npos )
+                return std::nullopt; // invalid mask
+            while( close < length - 1 && mask[close + 1] == u']' )
+                close++;
+
+            const size_t l = close - (open + 1);
+            result.emplace_back(std::u16string_view(mask).substr(open + 1, l), true);
+            location += l + 2;
+        }
+        else if( open == npos ) {
+            // have no more placeholders
+            if( mask.find(u']', location) != npos )
+                return std::nullopt; // invalid mask
+            result.emplace_back(std::u16string_view(mask).substr(location), false);
+            break;
+        }
+        else {
+            // we have placeholder somewhere further
+            const size_t close = mask.find(u']', location);
+            if( close == npos || close < open )
+                return std::nullopt; // invalid mask
+            const size_t l = open - location;
+            result.emplace_back(std::u16string_view(mask).substr(location, l), false);
+            location += l;
+        }
+    }
+
+    // Convert the private characters back into square brackets
+    for( auto &part : result ) {
+        std::ranges::replace(part.string, g_EscapedOpenBracket, u'[');
+        std::ranges::replace(part.string, g_EscapedCloseBracket, u']');
+    }
+
+    return result;
+}
+
+bool BatchRenamingScheme::BuildActionsScript(std::u16string_view _mask)
+{
+    if( _mask.empty() )
+        return false;
+
+    auto opt_decomposition = DecomposeMaskIntoPlaceholders(_mask);
+    if( !opt_decomposition )
+        return false;
+    auto decomposition = std::move(*opt_decomposition);
+
+    bool ok = true;
+
+    for( auto &di : decomposition ) {
+        if( !di.is_placeholder ) {
+            AddStaticText(di.string);
+        }
+        else {
+            if( !ParsePlaceholder(di.string) ) {
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    // need to clean action on failed parsing
+    return ok;
+}
+
+bool BatchRenamingScheme::ParsePlaceholder(std::u16string_view _ph)
+{
+    const auto length = _ph.size();
+    size_t position = 0;
+
+    while( position < length ) {
+        auto c = _ph[position];
+        switch( c ) {
+            case ' ':
+                position++;
+                continue;
+            case '[':
+                position++;
+                m_Steps.emplace_back(ActionType::OpenBracket);
+                continue;
+            case ']':
+                position++;
+                m_Steps.emplace_back(ActionType::CloseBracket);
+                continue;
+            case 'U':
+                position++;
+                m_Steps.emplace_back(ActionType::Uppercase);
+                continue;
+            case 'L':
+                position++;
+                m_Steps.emplace_back(ActionType::Lowercase);
+                continue;
+            case 'F':
+                position++;
+                m_Steps.emplace_back(ActionType::Capitalized);
+                continue;
+            case 'n':
+                position++;
+                m_Steps.emplace_back(ActionType::UnchangedCase);
+                continue;
+            case 's':
+                position++;
+                m_Steps.emplace_back(ActionType::TimeSeconds);
+                continue;
+            case 'm':
+                position++;
+                m_Steps.emplace_back(ActionType::TimeMinutes);
+                continue;
+            case 'h':
+                position++;
+                m_Steps.emplace_back(ActionType::TimeHours);
+                continue;
+            case 'D':
+                position++;
+                m_Steps.emplace_back(ActionType::TimeDay);
+                continue;
+            case 'M':
+                position++;
+                m_Steps.emplace_back(ActionType::TimeMonth);
+                continue;
+            case 'y':
+                position++;
+                m_Steps.emplace_back(ActionType::TimeYear2);
+                continue;
+            case 'Y':
+                position++;
+                m_Steps.emplace_back(ActionType::TimeYear4);
+                continue;
+            case 'd':
+                position++;
+                m_Steps.emplace_back(ActionType::Date);
+                continue;
+            case 't':
+                position++;
+                m_Steps.emplace_back(ActionType::Time);
+                continue;
+            case 'N': {
+                position++;
+                auto v = ParsePlaceholder_TextExtraction(_ph, position);
+                if( !v )
+                    break;
+                AddInsertName(v->first);
+                position += v->second;
+                continue;
+            }
+            case 'E': {
+                position++;
+                auto v = ParsePlaceholder_TextExtraction(_ph, position);
+                if( !v )
+                    break;
+                AddInsertExtension(v->first);
+                position += v->second;
+                continue;
+            }
+            case 'A': {
+                position++;
+                auto v = ParsePlaceholder_TextExtraction(_ph, position);
+                if( !v )
+                    break;
+                AddInsertFilename(v->first);
+                position += v->second;
+                continue;
+            }
+            case 'P': {
+                position++;
+                auto v = ParsePlaceholder_TextExtraction(_ph, position);
+                if( !v )
+                    break;
+                AddInsertParent(v->first);
+                position += v->second;
+                continue;
+            }
+            case 'G': {
+                position++;
+                auto v = ParsePlaceholder_TextExtraction(_ph, position);
+                if( !v )
+                    break;
+                AddInsertGrandparent(v->first);
+                position += v->second;
+                continue;
+            }
+            case 'C': {
+                position++;
+                auto v = ParsePlaceholder_Counter(_ph,
+                                                  position,
+                                                  m_DefaultCounter.start,
+                                                  m_DefaultCounter.step,
+                                                  m_DefaultCounter.width,
+                                                  m_DefaultCounter.stripe);
+                if( !v )
+                    break;
+                AddInsertCounter(v->first);
+                position += v->second;
+                continue;
+            }
+            default:
+                break;
+        }
+        return false;
+    }
+
+    return true;
+}
+
+// parsed short -> characters consumed
+static std::optional<std::pair<unsigned short, short>> EatUShort(std::u16string_view s, const size_t pos)
+{
+    const auto l = s.size();
+    if( pos == l )
+        return std::nullopt;
+    size_t n = 0;
+    auto c = s[pos + n];
+    if( c < '0' || c > '9' )
+        return std::nullopt;
+
+    unsigned short r = 0;
+    do {
+        c = s[pos + n];
+        if( c < '0' || c > '9' )
+            break;
+        r = static_cast<unsigned short>(r * 10 + c - '0');
+        n++;
+    } while( pos + n < l );
+
+    return std::make_pair(r, short(n));
+}
+
+// parsed short -> characters consumed
+static std::optional<std::pair<int, short>> EatInt(std::u16string_view s, const size_t pos)
+{
+    const auto l = s.size();
+    if( pos == l )
+        return std::nullopt;
+
+    size_t n = 0;
+    bool minus = false;
+
+    auto c = s[pos + n];
+    if( c == '-' ) {
+        minus = true;
+        n++;
+    }
+
+    if( pos + n == l )
+        return std::nullopt;
+
+    c = s[pos + n];
+    if( c < '0' || c > '9' )
+        return std::nullopt;
+
+    int r = 0;
+    do {
+        c = s[pos + n];
+        if( c < '0' || c > '9' )
+            break;
+        r = r * 10 + c - '0';
+        n++;
+    } while( pos + n < l );
+
+    return std::make_pair(r * (minus ? -1 : 1), short(n));
+}
+
+static std::optional<std::pair<int, short>> EatIntWithPreffix(std::u16string_view s, const size_t pos, char prefix)
+{
+    const auto l = s.size();
+    if( pos == l )
+        return std::nullopt;
+
+    auto c = s[pos];
+    if( c != static_cast<char16_t>(prefix) )
+        return std::nullopt;
+
+    auto num_if = EatInt(s, pos + 1);
+    if( !num_if )
+        return std::nullopt;
+
+    return std::make_pair(num_if->first, short(num_if->second + 1));
+}
+
+//[N] old file name, WITHOUT extension
+//[N1] The first character of the original name
+//[N2-5] Characters 2 to 5 from the old name (totals to 4 characters). Double byte characters (e.g.
+// Chinese, Japanese) are counted as 1 character! The first letter is accessed with '1'. [N2,5] 5
+// characters starting at character 2 [N2-] All characters starting at character 2 [N02-9]
+// Characters 2-9, fill from left with zeroes if name shorter than requested (8 in this example):
+// "abc" -> "000000bc" [N 2-9] Characters 2-9, fill from left with spaces if name shorter than
+// requested (8 in this example): "abc" -> "      bc" [N-8,5] 5 characters starting at the 8-last
+// character (counted from the end of the name) [N-8-5] Characters from the 8th-last to the 5th-last
+// character [N-5-] Characters from the 5th-last character to the end of the name [N2--5] Characters
+// from the 2nd to the 5th-last character
+std::optional<std::pair<BatchRenamingScheme::TextExtraction, int>>
+BatchRenamingScheme::ParsePlaceholder_TextExtraction(std::u16string_view _ph, size_t _pos)
+{
+    const auto l = _ph.size();
+    if( l == _pos ) // [N]
+        return std::make_pair(TextExtraction(), 0);
+
+    auto zero_flag = false;
+    auto minus_flag = false;
+    auto space_flag = false;
+
+    auto n = 0;
+    auto c = _ph[_pos + n];
+
+    if( c == '0' ) {
+        zero_flag = true;
+        n++;
+    }
+    else if( c == '-' ) {
+        minus_flag = true;
+        n++;
+    }
+    else if( c == ' ' ) {
+        space_flag = true;
+        n++;
+    }
+
+    auto num_if = EatUShort(_ph, _pos + n);
+    if( !num_if ) {
+        if( n != 0 )
+            return std::nullopt;
+        return std::make_pair(TextExtraction(), n); // [N
+    }
+    else { // [N123....
+        auto first_num = num_if->first;
+        if( first_num < 1 )
+            return std::nullopt;
+        first_num--;
+        n += num_if->second;
+
+        if( _pos + n == l ) { //  [N567]
+            TextExtraction ins;
+            ins.direct_range = Range(first_num, 1);
+            return std::make_pair(ins, n);
+        }
+
+        c = _ph[_pos + n];
+        if( !minus_flag ) { //[N5... or [N 5.... or [N05....
+            if( c == '-' ) {
+                n++;
+                TextExtraction ins;
+                num_if = EatUShort(_ph, _pos + n);
+                if( num_if ) { // [N5-10
+                    auto second_num = num_if->first;
+                    if( second_num < 1 )
+                        return std::nullopt;
+                    second_num--;
+                    n += num_if->second;
+                    ins.zero_flag = zero_flag;
+                    ins.space_flag = space_flag;
+                    ins.direct_range = Range(first_num, second_num >= first_num ? second_num - first_num + 1 : 0);
+                }
+                else {                    // [N5-
+                    if( _pos + n == l ) { // [N5-]
+                        ins.direct_range = Range(first_num, Range::max_length());
+                    }
+                    else {
+                        c = _ph[_pos + n];
+                        if( c != '-' ) { // [N5-something
+                            ins.direct_range = Range(first_num, Range::max_length());
+                        }
+                        else { // N[5--
+                            n++;
+                            num_if = EatUShort(_ph, _pos + n);
+                            if( !num_if )
+                                return std::nullopt; // [N5--something <- invalid
+
+                            auto second_num = num_if->first; // [N5--3
+                            if( second_num < 1 )
+                                return std::nullopt;
+                            --second_num;
+                            n += num_if->second;
+
+                            ins.direct_range = std::nullopt;
+                            ins.from_first = first_num;
+                            ins.to_last = second_num;
+                        }
+                    }
+                }
+                return std::make_pair(ins, n);
+            }
+            else if( c == ',' ) {
+                n++;
+                num_if = EatUShort(_ph, _pos + n);
+
+                if( !num_if ) // [N5,  <- invalid
+                    return std::nullopt;
+
+                auto second_num = num_if->first; // [N5,10
+                n += num_if->second;
+                TextExtraction ins;
+                ins.zero_flag = zero_flag;
+                ins.space_flag = space_flag;
+                ins.direct_range = Range(first_num, second_num);
+                return std::make_pair(ins, n);
+            }
+            else { // [N123something
+                TextExtraction ins;
+                ins.direct_range = Range(first_num, 1);
+                return std::make_pair(ins, n);
+            }
+        }
+        else {               // [N-5....
+            if( c == '-' ) { // [N-5-...
+                n++;
+                TextExtraction ins;
+                ins.direct_range = std::nullopt;
+
+                num_if = EatUShort(_ph, _pos + n);
+                if( !num_if ) { // [N-5-something
+                    ins.reverse_range = Range(first_num, Range::max_length());
+                }
+                else { // [N-5-2
+                    auto second_num = num_if->first;
+                    if( second_num < 1 )
+                        return std::nullopt;
+                    second_num--;
+                    n += num_if->second;
+                    ins.reverse_range = Range(first_num, second_num <= first_num ? first_num - second_num + 1 : 0);
+                }
+                return std::make_pair(ins, n);
+            }
+            else if( c == ',' ) { // [N-5,...
+                n++;
+                num_if = EatUShort(_ph, _pos + n);
+                if( !num_if )
+                    return std::nullopt; // [N-5,something <- invalid
+
+                auto second_num = num_if->first; // [N-5,4
+                n += num_if->second;
+
+                TextExtraction ins;
+                ins.direct_range = std::nullopt;
+                ins.reverse_range = Range(first_num, second_num);
+                return std::make_pair(ins, n);
+            }
+        }
+    }
+
+    return std::nullopt;
+}
+
+// maximum possible construction: [C10+1/15:5]
+//[C] Paste counter, as defined in Define counter field
+//[C10+5:3] Paste counter, define counter settings directly. In this example, start at 10, step by
+// 5, use 3 digits width. Partial definitions like [C10] or [C+5] or [C:3] are also accepted. Hint:
+// The fields in Define counter will be ignored if you specify options directly in the [C] field.
+//[C+1/100] New: Fractional number: Paste counter, but increase it only every n files (in this
+// example: every 100 files). Can be used to move a specific number of files to a subdirectory,e.g.
+// [C+1/100]\[N]
+
+// not yet:
+//[Caa+1] Paste counter, define counter settings directly. In this example, start at aa, step 1
+// letter, use 2 digits (defined by 'aa' width) [C:a] Paste counter, determine digits width
+// automatically, depending on the number of files. Combinations like [C10+10:a] are also allowed.
+std::optional<std::pair<BatchRenamingScheme::Counter, int>>
+BatchRenamingScheme::ParsePlaceholder_Counter(std::u16string_view _ph,
+                                              size_t _pos,
+                                              long _default_start,
+                                              long _default_step,
+                                              int _default_width,
+                                              unsigned _default_stripe)
+{
+    Counter counter;
+    counter.start = _default_start;
+    counter.step = _default_step;
+    counter.width = _default_width;
+    counter.stripe = _default_stripe;
+
+    const auto l = _ph.size();
+    if( l == _pos ) // [C]
+        return std::make_pair(counter, 0);
+
+    auto n = 0;
+    if( auto start = EatInt(_ph, _pos + n) ) {
+        counter.start = start->first;
+        n += start->second;
+    }
+    if( auto step = EatIntWithPreffix(_ph, _pos + n, '+') ) {
+        counter.step = step->first;
+        n += step->second;
+    }
+    if( auto stripe = EatIntWithPreffix(_ph, _pos + n, '/') ) {
+        counter.stripe = stripe->first;
+        n += stripe->second;
+    }
+    if( auto width = EatIntWithPreffix(_ph, _pos + n, ':') ) {
+        counter.width = std::min<unsigned int>(width->first, 30);
+        n += width->second;
+    }
+
+    return std::make_pair(counter, n);
+}
+
+void BatchRenamingScheme::ExtractText(std::u16string_view _from, const TextExtraction &_te, std::u16string &_to)
+{
+    auto length = static_cast<unsigned short>(_from.size());
+    if( length == 0 )
+        return;
+
+    if( _te.direct_range ) {
+        auto rr = *_te.direct_range;
+        auto sr = Range(0, length);
+        if( !sr.intersects(rr) )
+            return;
+
+        auto res = sr.intersection(rr);
+        if( (_te.zero_flag || _te.space_flag) && rr.length != Range::max_length() && res.length < rr.length ) {
+            const size_t insufficient = std::min(rr.length - res.length, 300);
+            _to.append(insufficient, _te.zero_flag ? u'0' : u' ');
+        }
+        _to.append(_from.substr(res.location, res.length));
+    }
+    else if( _te.reverse_range ) {
+        auto rr = *_te.reverse_range;
+        auto sr = Range(0, length);
+        if( rr.location + 1 > sr.length )
+            rr.location = 0;
+        else
+            rr.location = static_cast<unsigned short>(sr.length - rr.location - 1);
+
+        if( !sr.intersects(rr) )
+            return;
+
+        auto res = sr.intersection(rr);
+        _to.append(_from.substr(res.location, res.length));
+    }
+    else {
+        if( _te.to_last + 1 >= length )
+            return;
+        const unsigned start = _te.from_first;
+        const unsigned end = length - _te.to_last - 1;
+        if( start > end )
+            return;
+
+        _to.append(_from.substr(start, end - start + 1));
+    }
+}
+
+void BatchRenamingScheme::FormatCounter(const Counter &_c, int _file_number, std::u16string &_to)
+{
+    if( _c.stripe == 0 )
+        return;
+
+    fmt::basic_memory_buffer<char, 64> buf; // no heap allocs, for great justice!
+    fmt::format_to(std::back_inserter(buf), "{:0{}}", _c.start + (_c.step * (_file_number / _c.stripe)), _c.width);
+    AppendASCII(_to, std::string_view(buf.data(), buf.size()));
+}
+
+void BatchRenamingScheme::SetReplacingOptions(std::u16string_view _search_for,
+                                              std::u16string_view _replace_with,
+                                              bool _case_sensitive,
+                                              bool _only_first,
+                                              bool _search_in_ext,
+                                              bool _use_regexp)
+{
+    m_SearchReplace.search_for = _search_for;
+    m_SearchReplace.replace_with = _replace_with;
+    m_SearchReplace.case_sensitive = _case_sensitive;
+    m_SearchReplace.only_first = _only_first;
+    m_SearchReplace.search_in_ext = _search_in_ext;
+    m_SearchReplace.use_regexp = _use_regexp;
+}
+
+void BatchRenamingScheme::SetDefaultCounter(long _start, long _step, unsigned _stripe, unsigned _width)
+{
+    m_DefaultCounter.start = _start;
+    m_DefaultCounter.step = _step;
+    m_DefaultCounter.stripe = _stripe;
+    m_DefaultCounter.width = _width;
+}
+
+void BatchRenamingScheme::SetCaseTransform(CaseTransform _ct, bool _apply_to_ext)
+{
+    m_CaseTransform = _ct;
+    m_CaseTransformWithExt = _apply_to_ext;
+}
+
+void BatchRenamingScheme::AppendTransformed(std::u16string_view _str, CaseTransform _ct, std::u16string &_to) const
+{
+    // Upper- and lowercasing of ASCII is unambiguous, everything else is up to the platform
+    if( _ct == CaseTransform::Unchanged ) {
+        _to.append(_str);
+    }
+    else if( _ct != CaseTransform::Capitalized && IsASCII(_str) ) {
+        const size_t offset = _to.size();
+        _to.append(_str);
+        std::transform(_to.begin() + offset,
+                       _to.end(),
+                       _to.begin() + offset,
+                       _ct == CaseTransform::Uppercase ? &ToUpperASCII : &ToLowerASCII);
+    }
+    else {
+        const auto transform = m_Platform->transform_case ? m_Platform->transform_case : &TransformCasePortable;
+        _to.append(transform(_str, _ct));
+    }
+}
+
+void BatchRenamingScheme::TransformCase(std::u16string &_str, CaseTransform _ct, bool _apply_to_ext) const
+{
+    if( _ct == CaseTransform::Unchanged )
+        return;
+
+    const size_t dot = _apply_to_ext ? std::u16string::npos : ExtensionDotPosition(_str);
+    const size_t length = dot == std::u16string::npos ? _str.size() : dot;
+    std::u16string transformed;
+    transformed.reserve(_str.size());
+    AppendTransformed(std::u16string_view(_str).substr(0, length), _ct, transformed);
+    transformed.append(std::u16string_view(_str).substr(length));
+    _str = std::move(transformed);
+}
+
+std::pair<size_t, size_t> BatchRenamingScheme::Find(std::u16string_view _where, std::u16string_view _what) const
+{
+    if( (IsASCII(_what) && IsASCII(_where)) || m_Platform->find == nullptr )
+        return FindASCII(_where, _what, m_SearchReplace.case_sensitive);
+    return m_Platform->find(_where, _what, m_SearchReplace.case_sensitive);
+}
+
+void BatchRenamingScheme::DoSearchReplace(std::u16string &_str) const
+{
+    const ReplaceOptions &opts = m_SearchReplace;
+    if( opts.search_for.empty() )
+        return;
+
+    size_t length = _str.size();
+    if( !opts.search_in_ext ) {
+        if( const size_t dot = ExtensionDotPosition(_str); dot != std::u16string::npos )
+            length = dot;
+    }
+
+    if( opts.use_regexp ) {
+        if( m_Platform->replace_regexp )
+            m_Platform->replace_regexp(_str, length, opts);
+        return;
+    }
+
+    size_t pos = 0;
+    while( pos <= length ) {
+        const auto [location, matched] = Find(std::u16string_view(_str).substr(pos, length - pos), opts.search_for);
+        if( location == std::u16string_view::npos || matched == 0 )
+            break;
+        _str.replace(pos + location, matched, opts.replace_with);
+        if( opts.only_first )
+            break;
+        pos += location + opts.replace_with.size();
+        length = length - matched + opts.replace_with.size();
+    }
+}
+
+void BatchRenamingScheme::AddStaticText(std::u16string_view s)
+{
+    m_Steps.emplace_back(ActionType::Static, m_ActionsStatic.size());
+    m_ActionsStatic.emplace_back(s);
+}
+
+void BatchRenamingScheme::AddInsertName(const TextExtraction &t)
+{
+    m_Steps.emplace_back(ActionType::Name, m_ActionsTextExtraction.size());
+    m_ActionsTextExtraction.emplace_back(t);
+}
+
+void BatchRenamingScheme::AddInsertExtension(const TextExtraction &t)
+{
+    m_Steps.emplace_back(ActionType::Extension, m_ActionsTextExtraction.size());
+    m_ActionsTextExtraction.emplace_back(t);
+}
+
+void BatchRenamingScheme::AddInsertFilename(const TextExtraction &t)
+{
+    m_Steps.emplace_back(ActionType::Filename, m_ActionsTextExtraction.size());
+    m_ActionsTextExtraction.emplace_back(t);
+}
+
+void BatchRenamingScheme::AddInsertCounter(const Counter &t)
+{
+    m_Steps.emplace_back(ActionType::Counter, m_ActionsCounter.size());
+    m_ActionsCounter.emplace_back(t);
+}
+
+void BatchRenamingScheme::AddInsertParent(const TextExtraction &t)
+{
+    m_Steps.emplace_back(ActionType::ParentFilename, m_ActionsTextExtraction.size());
+    m_ActionsTextExtraction.emplace_back(t);
+}
+
+void BatchRenamingScheme::AddInsertGrandparent(const TextExtraction &t)
+{
+    m_Steps.emplace_back(ActionType::GrandparentFilename, m_ActionsTextExtraction.size());
+    m_ActionsTextExtraction.emplace_back(t);
+}
+
+static void FormatTwoDigits(int _value, std::u16string &_to)
+{
+    char buf[16];
+    AppendASCII(_to, std::string_view(buf, fmt::format_to(buf, "{:02}", _value)));
+}
+
+static void AppendReplacing(std::u16string_view _str, char16_t _separator_replacement, std::u16string &_to)
+{
+    for( const char16_t c : _str )
+        _to.push_back(c == u'/' || c == u'\\' || c == u':' ? _separator_replacement : c);
+}
+
+void BatchRenamingScheme::Rename(const FileInfo &_fi, int _number, std::u16string &_to) const
+{
+    _to.clear();
+
+    CaseTransform case_transform = CaseTransform::Unchanged;
+    std::u16string next;
+
+    for( auto step : m_Steps ) {
+        next.clear();
+        switch( step.type ) {
+            case ActionType::Static:
+                next = m_ActionsStatic[step.index];
+                break;
+            case ActionType::Name:
+                ExtractText(_fi.name, m_ActionsTextExtraction[step.index], next);
+                break;
+            case ActionType::Extension:
+                ExtractText(_fi.extension, m_ActionsTextExtraction[step.index], next);
+                break;
+            case ActionType::Filename:
+                ExtractText(_fi.filename, m_ActionsTextExtraction[step.index], next);
+                break;
+            case ActionType::ParentFilename:
+                ExtractText(_fi.parent_filename, m_ActionsTextExtraction[step.index], next);
+                break;
+            case ActionType::GrandparentFilename:
+                ExtractText(_fi.grandparent_filename, m_ActionsTextExtraction[step.index], next);
+                break;
+            case ActionType::Counter:
+                FormatCounter(m_ActionsCounter[step.index], _number, next);
+                break;
+            case ActionType::OpenBracket:
+                next = u"[";
+                break;
+            case ActionType::CloseBracket:
+                next = u"]";
+                break;
+            case ActionType::TimeSeconds:
+                FormatTwoDigits(_fi.mod_time_tm.tm_sec, next);
+                break;
+            case ActionType::TimeMinutes:
+                FormatTwoDigits(_fi.mod_time_tm.tm_min, next);
+                break;
+            case ActionType::TimeHours:
+                FormatTwoDigits(_fi.mod_time_tm.tm_hour, next);
+                break;
+            case ActionType::TimeDay:
+                FormatTwoDigits(_fi.mod_time_tm.tm_mday, next);
+                break;
+            case ActionType::TimeMonth:
+                FormatTwoDigits(_fi.mod_time_tm.tm_mon + 1, next);
+                break;
+            case ActionType::TimeYear2:
+                FormatTwoDigits(_fi.mod_time_tm.tm_year % 100, next);
+                break;
+            case ActionType::TimeYear4: {
+                char buf[16];
+                AppendASCII(next, std::string_view(buf, fmt::format_to(buf, "{:04}", _fi.mod_time_tm.tm_year + 1900)));
+                break;
+            }
+            case ActionType::Date: {
+                const auto &platform = m_Platform->format_date ? *m_Platform : Platform::Portable();
+                AppendReplacing(platform.format_date(_fi.mod_time), u'-', next);
+                break;
+            }
+            case ActionType::Time: {
+                const auto &platform = m_Platform->format_time ? *m_Platform : Platform::Portable();
+                AppendReplacing(platform.format_time(_fi.mod_time), u'.', next);
+                break;
+            }
+            case ActionType::UnchangedCase:
+                case_transform = CaseTransform::Unchanged;
+                break;
+            case ActionType::Uppercase:
+                case_transform = CaseTransform::Uppercase;
+                break;
+            case ActionType::Lowercase:
+                case_transform = CaseTransform::Lowercase;
+                break;
+            case ActionType::Capitalized:
+                case_transform = CaseTransform::Capitalized;
+                break;
+            default:
+                break;
+        }
+
+        if( !next.empty() )
+            AppendTransformed(next, case_transform, _to);
+    }
+
+    DoSearchReplace(_to);
+    TransformCase(_to, m_CaseTransform, m_CaseTransformWithExt);
+}
+
+BatchRenamingScheme::FileInfo::FileInfo(std::u16string _filename, std::string_view _directory, time_t _mod_time)
+    : filename(std::move(_filename)), mod_time(_mod_time)
+{
+    localtime_r(&mod_time, &mod_time_tm);
+
+    if( const size_t dot = ExtensionDotPosition(filename); dot != std::u16string::npos ) {
+        name = filename.substr(0, dot);
+        extension = filename.substr(dot + 1);
+    }
+    else {
+        name = filename;
+    }
+
+    std::filesystem::path parent_path(_directory);
+    if( parent_path.filename().empty() ) { // play around trailing slash
+        if( !parent_path.has_parent_path() )
+            return; // wtf?
+        parent_path = parent_path.parent_path();
+    }
+    parent_filename = FromUTF8(parent_path.filename().native());
+    grandparent_filename = FromUTF8(parent_path.parent_path().filename().native());
+}
+
+} // namespace nc::ops
@@ -1,10 +1,23 @@
-// Copyright (C) 2015-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2015-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <VFS/VFS.h>
+#include <algorithm>
+#include <ctime>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace nc::ops {
 
+// Composes new filenames from a mask with placeholders, e.g. "[N]_[C].[E]", followed by optional search/replace and a
+// case transform. The text is processed as UTF-16 code units, i.e. positions and lengths in the placeholders count the
+// same units as NSString does.
+// The processing itself is pure C++, the bits which require Unicode tables or the current locale are delegated to a
+// Platform. Once built, a scheme can rename from multiple threads concurrently.
 class BatchRenamingScheme
 {
 public:
@@ -15,7 +28,9 @@ public:
         Range(unsigned short loc, unsigned short len);
 
         constexpr static unsigned short max_length();
+#ifdef __OBJC__
         NSRange toNSRange() const;
+#endif
         Range intersection(const Range _rhs) const;
         bool intersects(const Range _rhs) const;
         unsigned max() const;
@@ -39,29 +54,29 @@ public:
     };
 
     struct MaskDecomposition {
-        NSString *string = nil;
+        std::u16string string;
         bool is_placeholder = false;
 
-        MaskDecomposition(NSString *_s, bool _b) : string(_s), is_placeholder(_b) {}
-        bool operator==(const MaskDecomposition &_rhs) const noexcept
-        {
-            return [string isEqualToString:_rhs.string] && is_placeholder == _rhs.is_placeholder;
-        }
-        bool operator!=(const MaskDecomposition &_rhs) const noexcept { return !(*this == _rhs); }
+        MaskDecomposition(std::u16string_view _s, bool _b) : string(_s), is_placeholder(_b) {}
+#ifdef __OBJC__
+        MaskDecomposition(NSString *_s, bool _b);
+#endif
+        bool operator==(const MaskDecomposition &_rhs) const noexcept = default;
     };
 
     struct FileInfo {
         FileInfo() = default;
         FileInfo(VFSListingItem _item);
-        NSString *ParentFilename() const;
-        NSString *GrandparentFilename() const;
+        FileInfo(std::u16string _filename, std::string_view _directory, time_t _mod_time);
 
         VFSListingItem item;
-        NSString *filename;  // filename.txt
-        NSString *name;      // filename
-        NSString *extension; // txt
-        time_t mod_time;
-        struct tm mod_time_tm;
+        std::u16string filename;             // filename.txt
+        std::u16string name;                 // filename
+        std::u16string extension;            // txt
+        std::u16string parent_filename;      // i.e. /foo/bar/baz.txt -> bar
+        std::u16string grandparent_filename; // i.e. /foo/bar/baz.txt -> foo
+        time_t mod_time = 0;
+        struct tm mod_time_tm = {};
     };
 
     enum class CaseTransform {
@@ -71,28 +86,67 @@ public:
         Capitalized = 3
     };
 
-    static std::optional<std::vector<MaskDecomposition>> DecomposeMaskIntoPlaceholders(NSString *_mask);
+    struct ReplaceOptions {
+        std::u16string search_for;
+        std::u16string replace_with;
+        bool case_sensitive = false;
+        bool only_first = false;
+        bool search_in_ext = true;
+        bool use_regexp = false;
+    };
+
+    // The text processing which depends on Unicode tables or on the current locale.
+    // The functions must be thread-safe, a missing one falls back to the portable behaviour.
+    struct Platform {
+        // Returns the string with the case transformed as a whole.
+        std::u16string (*transform_case)(std::u16string_view _str, CaseTransform _ct) = nullptr;
+
+        // Returns the location and the length of the first match of _what in _where, or npos as the location.
+        // The length of the match can differ from the length of _what, e.g. for canonically equivalent strings.
+        std::pair<size_t, size_t> (*find)(std::u16string_view _where,
+                                          std::u16string_view _what,
+                                          bool _case_sensitive) = nullptr;
+
+        // Replaces the matches of the regular expression in the first _length code units of _str.
+        void (*replace_regexp)(std::u16string &_str, size_t _length, const ReplaceOptions &_options) = nullptr;
+
+        // Return the date and the time in the user's short format.
+        std::u16string (*format_date)(time_t _time) = nullptr;
+        std::u16string (*format_time)(time_t _time) = nullptr;
+
+        // ASCII-only case transforms and search, no regular expressions and the ISO-like date and time.
+        static const Platform &Portable() noexcept;
+
+        // Foundation-backed processing, the same as NSString does. Provided by BatchRenamingScheme.mm.
+        static const Platform &Native() noexcept;
+    };
+
+    BatchRenamingScheme(const Platform &_platform = Platform::Native()) noexcept;
+
+    static std::optional<std::vector<MaskDecomposition>> DecomposeMaskIntoPlaceholders(std::u16string_view _mask);
 
     static std::optional<std::pair<TextExtraction, int>>
-    ParsePlaceholder_TextExtraction(NSString *_ph,
-                                    unsigned long _pos); // action and number of chars eaten if no errors
+    ParsePlaceholder_TextExtraction(std::u16string_view _ph,
+                                    size_t _pos); // action and number of chars eaten if no errors
 
     static std::optional<std::pair<Counter, int>>
-    ParsePlaceholder_Counter(NSString *_ph,
-                             unsigned long _pos,
+    ParsePlaceholder_Counter(std::u16string_view _ph,
+                             size_t _pos,
                              long _default_start,
                              long _default_step,
                              int _default_width,
                              unsigned _default_stripe); // action and number of chars eaten if no errors
 
-    static NSString *ExtractText(NSString *_from, const TextExtraction &_te);
+    // Appends the extracted text to _to.
+    static void ExtractText(std::u16string_view _from, const TextExtraction &_te, std::u16string &_to);
 
-    static NSString *FormatCounter(const Counter &_c, int _file_number);
+    // Appends the formatted counter value to _to.
+    static void FormatCounter(const Counter &_c, int _file_number, std::u16string &_to);
 
-    bool BuildActionsScript(NSString *_mask);
+    bool BuildActionsScript(std::u16string_view _mask);
 
-    void SetReplacingOptions(NSString *_search_for,
-                             NSString *_replace_with,
+    void SetReplacingOptions(std::u16string_view _search_for,
+                             std::u16string_view _replace_with,
                              bool _case_sensitive,
                              bool _only_first,
                              bool _search_in_ext,
@@ -102,7 +156,33 @@ public:
 
     void SetDefaultCounter(long _start, long _step, unsigned _stripe, unsigned _width);
 
+    // Composes a new filename for the file, _number is its index in the renamed set.
+    // The previous contents of _to are discarded, while its capacity is reused.
+    void Rename(const FileInfo &_fi, int _number, std::u16string &_to) const;
+
+#ifdef __OBJC__
+    static NSString *ToNSString(std::u16string_view _str);
+    static std::u16string ToU16String(NSString *_str);
+
+    static std::optional<std::vector<MaskDecomposition>> DecomposeMaskIntoPlaceholders(NSString *_mask);
+    static std::optional<std::pair<TextExtraction, int>> ParsePlaceholder_TextExtraction(NSString *_ph,
+                                                                                         unsigned long _pos);
+    static std::optional<std::pair<Counter, int>> ParsePlaceholder_Counter(NSString *_ph,
+                                                                           unsigned long _pos,
+                                                                           long _default_start,
+                                                                           long _default_step,
+                                                                           int _default_width,
+                                                                           unsigned _default_stripe);
+    static NSString *ExtractText(NSString *_from, const TextExtraction &_te);
+    bool BuildActionsScript(NSString *_mask);
+    void SetReplacingOptions(NSString *_search_for,
+                             NSString *_replace_with,
+                             bool _case_sensitive,
+                             bool _only_first,
+                             bool _search_in_ext,
+                             bool _use_regexp);
     NSString *Rename(const FileInfo &_fi, int _number) const;
+#endif
 
 private:
     enum class ActionType : short {
@@ -137,15 +217,6 @@ private:
         Step(ActionType t) : type(t), index(-1) {}
     };
 
-    struct ReplaceOptions {
-        NSString *search_for = @"";
-        NSString *replace_with = @"";
-        bool case_sensitive = false;
-        bool only_first = false;
-        bool search_in_ext = true;
-        bool use_regexp = false;
-    };
-
     struct DefaultCounter {
         long start = 1;
         long step = 1;
@@ -153,18 +224,22 @@ private:
         unsigned width = 1;
     };
 
-    void AddStaticText(NSString *s);
+    void AddStaticText(std::u16string_view s);
     void AddInsertName(const TextExtraction &t);
     void AddInsertExtension(const TextExtraction &t);
     void AddInsertFilename(const TextExtraction &t);
     void AddInsertParent(const TextExtraction &t);
     void AddInsertGrandparent(const TextExtraction &t);
     void AddInsertCounter(const Counter &t);
-    bool ParsePlaceholder(NSString *_ph);
-    static NSString *DoSearchReplace(const ReplaceOptions &_opts, NSString *_source);
+    bool ParsePlaceholder(std::u16string_view _ph);
+    void AppendTransformed(std::u16string_view _str, CaseTransform _ct, std::u16string &_to) const;
+    void TransformCase(std::u16string &_str, CaseTransform _ct, bool _apply_to_ext) const;
+    void DoSearchReplace(std::u16string &_str) const;
+    std::pair<size_t, size_t> Find(std::u16string_view _where, std::u16string_view _what) const;
 
+    const Platform *m_Platform;
     std::vector<Step> m_Steps;
-    std::vector<NSString *> m_ActionsStatic;
+    std::vector<std::u16string> m_ActionsStatic;
     std::vector<TextExtraction> m_ActionsTextExtraction;
     std::vector<Counter> m_ActionsCounter;
     ReplaceOptions m_SearchReplace;
@@ -186,10 +261,12 @@ inline constexpr unsigned short BatchRenamingScheme::Range::max_length()
     return std::numeric_limits<unsigned short>::max();
 }
 
+#ifdef __OBJC__
 inline NSRange BatchRenamingScheme::Range::toNSRange() const
 {
     return NSMakeRange(location, length);
 }
+#endif
 
 inline BatchRenamingScheme::Range BatchRenamingScheme::Range::intersection(const Range _rhs) const
 {
@@ -24,6 +24,11 @@ Compression::Compression(std::vector<VFSListingItem> _src_files,
 {
     m_InitialSourceItemsAmount = (int)_src_files.size();
     m_InitialSingleItemFilename = m_InitialSourceItemsAmount == 1 ? _src_files.front().DisplayName() : "";
+    auto resources = ResolveOperationResources(_src_files);
+    if( auto destination = ResolveOperationResource(*_dst_vfs, _dst_root) )
+        resources.emplace_back(std::move(*destination));
+    SetResources(std::move(resources));
+
     m_Job = std::make_unique<CompressionJob>(std::move(_src_files), _dst_root, _dst_vfs, _passphrase);
     m_Job->m_TargetPathDefined = [this] { OnTargetPathDefined(); };
     m_Job->m_TargetWriteError = [this](int _err, const std::string &_path, VFSHost &_vfs) {
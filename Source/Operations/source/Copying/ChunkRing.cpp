@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "ChunkRing.h"
+#include <stdexcept>
+
+namespace nc::ops::copying {
+
+ChunkRing::ChunkRing(std::span<uint8_t *const> _buffers, uint32_t _buffer_size)
+    : m_BufferSize(_buffer_size), m_Free(_buffers.begin(), _buffers.end())
+{
+    if( m_Free.empty() || _buffer_size == 0 )
+        throw std::invalid_argument("ChunkRing: at least one non-empty buffer is required");
+}
+
+uint32_t ChunkRing::BufferSize() const noexcept
+{
+    return m_BufferSize;
+}
+
+uint8_t *ChunkRing::AcquireFree()
+{
+    auto lock = std::unique_lock{m_Lock};
+    m_CV.wait(lock, [this] { return m_Aborted || !m_Free.empty(); });
+    if( m_Aborted )
+        return nullptr;
+    uint8_t *const buffer = m_Free.back();
+    m_Free.pop_back();
+    return buffer;
+}
+
+void ChunkRing::Push(const Chunk &_chunk)
+{
+    {
+        const auto lock = std::lock_guard{m_Lock};
+        m_Filled.emplace_back(_chunk);
+    }
+    m_CV.notify_all();
+}
+
+void ChunkRing::Finish()
+{
+    {
+        const auto lock = std::lock_guard{m_Lock};
+        m_Finished = true;
+    }
+    m_CV.notify_all();
+}
+
+std::optional<ChunkRing::Chunk> ChunkRing::Pop()
+{
+    auto lock = std::unique_lock{m_Lock};
+    m_CV.wait(lock, [this] { return m_Aborted || m_Finished || !m_Filled.empty(); });
+    if( m_Aborted || m_Filled.empty() )
+        return std::nullopt;
+    const Chunk chunk = m_Filled.front();
+    m_Filled.pop_front();
+    return chunk;
+}
+
+void ChunkRing::Release(const Chunk &_chunk)
+{
+    m_ConsumedBytes += _chunk.size;
+    {
+        const auto lock = std::lock_guard{m_Lock};
+        m_Free.emplace_back(_chunk.data);
+    }
+    m_CV.notify_all();
+}
+
+void ChunkRing::Abort()
+{
+    {
+        const auto lock = std::lock_guard{m_Lock};
+        m_Aborted = true;
+    }
+    m_CV.notify_all();
+}
+
+bool ChunkRing::IsAborted() const noexcept
+{
+    const auto lock = std::lock_guard{m_Lock};
+    return m_Aborted;
+}
+
+uint64_t ChunkRing::ConsumedBytes() const noexcept
+{
+    return m_ConsumedBytes;
+}
+
+} // namespace nc::ops::copying
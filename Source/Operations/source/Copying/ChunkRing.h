@@ -0,0 +1,69 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace nc::ops::copying {
+
+// A bounded ring of buffers which passes chunks of data from a single producer (reader) to a single consumer (writer).
+// The producer blocks when all buffers are filled and the consumer blocks when there's nothing to consume, so both
+// sides can run at their own pace while their latencies overlap.
+// The ring doesn't own the memory of the buffers.
+class ChunkRing
+{
+public:
+    struct Chunk {
+        uint8_t *data = nullptr; // points to a buffer acquired via AcquireFree()
+        uint32_t size = 0;       // amount of valid bytes in the buffer
+        uint64_t offset = 0;     // an arbitrary offset attached by the producer, e.g. a destination file position
+    };
+
+    // _buffers must contain at least one buffer, each _buffer_size bytes long.
+    ChunkRing(std::span<uint8_t *const> _buffers, uint32_t _buffer_size);
+
+    uint32_t BufferSize() const noexcept;
+
+    // Producer side. Blocks until a free buffer is available.
+    // Returns nullptr if the ring was aborted.
+    uint8_t *AcquireFree();
+
+    // Producer side. Passes a filled buffer to the consumer.
+    void Push(const Chunk &_chunk);
+
+    // Producer side. Tells the consumer that no more chunks will come.
+    void Finish();
+
+    // Consumer side. Blocks until a chunk is available.
+    // Returns nullopt if the producer has finished and everything was consumed, or if the ring was aborted.
+    std::optional<Chunk> Pop();
+
+    // Consumer side. Gives the buffer of a consumed chunk back to the producer.
+    void Release(const Chunk &_chunk);
+
+    // Either side. Fails all pending and further AcquireFree() and Pop() calls.
+    void Abort();
+
+    bool IsAborted() const noexcept;
+
+    // Total amount of bytes released by the consumer so far, can be read from any thread.
+    uint64_t ConsumedBytes() const noexcept;
+
+private:
+    const uint32_t m_BufferSize;
+    mutable std::mutex m_Lock;
+    std::condition_variable m_CV;
+    std::vector<uint8_t *> m_Free;
+    std::deque<Chunk> m_Filled;
+    bool m_Finished = false;
+    bool m_Aborted = false;
+    std::atomic_uint64_t m_ConsumedBytes = 0;
+};
+
+} // namespace nc::ops::copying
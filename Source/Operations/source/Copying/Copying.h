@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2022 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <VFS/VFS.h>
@@ -21,6 +21,9 @@ public:
 
     void SetCallbackHooks(const CopyingJobCallbacks *_callbacks);
 
+    // Amount of hardlinks which were recreated at the destination instead of copying the files' data.
+    size_t RecreatedHardlinksAmount() const noexcept;
+
 private:
     using CB = CopyingJobCallbacks;
 
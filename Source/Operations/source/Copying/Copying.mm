@@ -22,6 +22,11 @@ Copying::Copying(std::vector<VFSListingItem> _source_files,
     m_ExistBehavior = _options.exist_behavior;
     m_LockedBehaviour = _options.locked_items_behaviour;
 
+    auto resources = ResolveOperationResources(_source_files);
+    if( auto destination = ResolveOperationResource(*_destination_host, _destination_path) )
+        resources.emplace_back(std::move(*destination));
+    SetResources(std::move(resources));
+
     m_Job = std::make_unique<CopyingJob>(_source_files, _destination_path, _destination_host, _options);
     SetupCallbacks();
     OnStageChanged();
@@ -666,4 +671,9 @@ void Copying::SetCallbackHooks(const CopyingJobCallbacks *_callbacks)
     m_CallbackHooks = _callbacks;
 }
 
+size_t Copying::RecreatedHardlinksAmount() const noexcept
+{
+    return m_Job->RecreatedHardlinksAmount();
+}
+
 } // namespace nc::ops
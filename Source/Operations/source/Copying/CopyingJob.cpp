@@ -1,6 +1,8 @@
 // Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "CopyingJob.h"
+#include "../OperationResource.h"
 #include "../Statistics.h"
+#include "ChunkRing.h"
 #include "Helpers.h"
 #include "NativeFSHelpers.h"
 #include <Base/Hash.h>
@@ -10,14 +12,17 @@
 #include <Utility/StringExtras.h>
 #include <VFS/Native.h>
 #include <algorithm>
+#include <array>
 #include <fmt/format.h>
 #include <iostream>
+#include <numeric>
 #include <ranges>
 #include <sys/mount.h>
 #include <sys/param.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/xattr.h>
+#include <utility>
 
 using namespace nc::ops::copying;
 
@@ -138,7 +143,7 @@ void CopyingJob::ProcessItems()
 
     Statistics().CommitEstimated(Statistics::SourceType::Bytes, m_SourceItems.TotalRegBytes());
 
-    for( int index = 0, index_end = m_SourceItems.ItemsAmount(); index != index_end; ++index ) {
+    for( const int index : ComposeProcessingOrder() ) {
         const auto step_result = ProcessItemNo(index);
 
         // check current item result
@@ -183,6 +188,29 @@ void CopyingJob::ProcessItems()
     }
 }
 
+std::vector<int> CopyingJob::ComposeProcessingOrder() const
+{
+    std::vector<int> order(m_SourceItems.ItemsAmount());
+    std::iota(order.begin(), order.end(), 0);
+
+    using ProcessingOrder = CopyingOptions::ProcessingOrder;
+    if( m_Options.processing_order == ProcessingOrder::AsScanned ||
+        (m_Options.processing_order == ProcessingOrder::Auto && !IsOnRotationalMedia(m_VFSListingItems)) )
+        return order;
+
+    // Directories go first in the scan order, so that the parents are still processed before their children.
+    // Then go the files of native sources sorted by their inode numbers, which roughly follow the physical placement
+    // of their metadata and data and thus save a lot of head seeking on rotational media.
+    // The sort is stable, so the primary of a set of hardlinks is still processed before the others.
+    const auto inode = [this](int _item_no) -> uint64_t {
+        return m_SourceItems.ItemHost(_item_no).IsNativeFS() ? m_SourceItems.ItemInode(_item_no) : 0;
+    };
+    const auto is_dir = [this](int _item_no) { return S_ISDIR(m_SourceItems.ItemMode(_item_no)); };
+    const auto files = std::ranges::stable_partition(order, is_dir);
+    std::ranges::stable_sort(files, [&](int _lhs, int _rhs) { return inode(_lhs) < inode(_rhs); });
+    return order;
+}
+
 CopyingJob::StepResult CopyingJob::ProcessItemNo(int _item_number)
 {
     m_CurrentlyProcessingSourceItemIndex = _item_number;
@@ -191,6 +219,7 @@ CopyingJob::StepResult CopyingJob::ProcessItemNo(int _item_number)
     auto source_size = m_SourceItems.ItemSize(_item_number);
     auto destination_path = ComposeDestinationNameForItem(_item_number);
     auto source_path = m_SourceItems.ComposeFullPath(_item_number);
+    auto item_span = TraceSpan("Item", "copying", {{"path", source_path}, {"bytes", source_size}});
     const auto nonexistent_dst_req_handler = RequestNonexistentDst([&] {
         auto new_path = FindNonExistingItemPath(destination_path, *m_DestinationHost, [&] { return IsStopped(); });
         if( !new_path.empty() )
@@ -223,7 +252,22 @@ CopyingJob::StepResult CopyingJob::ProcessItemNo(int _item_number)
             data_feedback = hash_feedback;
         }
 
-        if( source_host.IsNativeFS() && m_IsDestinationHostNative ) { // native -> native ///////////////////////
+        // a hardlink to a file which was already copied is recreated instead of copying its data once again
+        const bool can_recreate_hardlinks =
+            source_host.IsNativeFS() && m_IsDestinationHostNative && CanRecreateHardlinks(is_same_native_volume());
+        const int hardlink_primary = can_recreate_hardlinks ? m_SourceItems.ItemHardlinkPrimary(_item_number) : -1;
+        const bool remember_hardlink_primary =
+            hardlink_primary == _item_number && !m_DestinationHost->Exists(destination_path);
+
+        if( hardlink_primary >= 0 && hardlink_primary != _item_number &&
+            TryToRecreateHardlink(hardlink_primary, destination_path) ) {
+            step_result = StepResult::Ok;
+            ++m_RecreatedHardlinks;
+            Statistics().CommitProcessed(Statistics::SourceType::Bytes, source_size);
+            if( !m_Options.docopy )
+                m_SourceItemsToDelete.emplace_back(_item_number); // mark source file for deletion
+        }
+        else if( source_host.IsNativeFS() && m_IsDestinationHostNative ) { // native -> native ///////////////////
             // native fs processing
             if( m_Options.docopy ) { // copy
                 step_result = CopyNativeFileToNativeFile(dynamic_cast<vfs::NativeHost &>(source_host),
@@ -288,6 +332,9 @@ CopyingJob::StepResult CopyingJob::ProcessItemNo(int _item_number)
             }
         }
 
+        if( remember_hardlink_primary && step_result == StepResult::Ok )
+            m_HardlinkPrimaryDestinations.emplace(_item_number, destination_path);
+
         // check step result?
         if( hash )
             m_Checksums.emplace_back(_item_number, destination_path, hash->Final());
@@ -297,6 +344,9 @@ CopyingJob::StepResult CopyingJob::ProcessItemNo(int _item_number)
     else if( S_ISLNK(source_mode) )
         step_result = ProcessSymlinkItem(source_host, source_path, destination_path, nonexistent_dst_req_handler);
 
+    if( step_result != StepResult::Ok )
+        item_span.AddArg({"result", step_result == StepResult::Skipped ? "skipped" : "stopped"});
+
     if( step_result == StepResult::Ok || step_result == StepResult::Skipped ) {
         const ItemStatus status = step_result == StepResult::Ok ? ItemStatus::Processed : ItemStatus::Skipped;
         const ItemStateReport report{.host = source_host, .path = std::string_view(source_path), .status = status};
@@ -692,6 +742,18 @@ std::tuple<CopyingJob::StepResult, SourceItems> CopyingJob::ScanSourceItems()
 // native file -> native file copying routine
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+// Holes of sparse files are read as zeros, so the checksum has to be fed with them as well
+static void FeedZerosIntoChecksum(const std::function<void(const void *_data, unsigned _sz)> &_feedback,
+                                  uint64_t _amount)
+{
+    static const std::array<uint8_t, 65536> zeros{};
+    while( _amount > 0 ) {
+        const auto chunk = static_cast<unsigned>(std::min(_amount, uint64_t(zeros.size())));
+        _feedback(zeros.data(), chunk);
+        _amount -= chunk;
+    }
+}
+
 static void TurnIntoBlockingOrThrow(const int _fd)
 {
     // get current file descriptor's open flags
@@ -860,6 +922,8 @@ CopyingJob::StepResult CopyingJob::CopyNativeFileToNativeFile(vfs::NativeHost &_
             return resolution;
     }
 
+    TraceMark("Opened", "io");
+
     // don't forget ot close destination file descriptor anyway
     auto close_destination = at_scope_end([&] {
         if( destination_fd != -1 ) {
@@ -890,7 +954,13 @@ CopyingJob::StepResult CopyingJob::CopyNativeFileToNativeFile(vfs::NativeHost &_
         return StepResult::Stop; // something VERY BAD has happened, can't go on
     auto &dst_fs_info = *dst_fs_info_holder;
 
-    if( ShouldPreallocateSpace(preallocate_delta, dst_fs_info) ) {
+    // sparse files are copied extent-by-extent, holes are recreated on the destination by ftruncate()
+    std::optional<std::vector<DataExtent>> src_data_extents;
+    if( dst_fs_info.format.sparse_files )
+        src_data_extents = FindSparseFileDataExtents(source_fd, src_stat_buffer);
+    const bool is_sparse_copy = src_data_extents.has_value();
+
+    if( !is_sparse_copy && ShouldPreallocateSpace(preallocate_delta, dst_fs_info) ) {
         // tell the system to preallocate a space for data since we dont want to trash our disk
         if( TryToPreallocateSpace(preallocate_delta, destination_fd) ) {
             if( SupportsFastTruncationAfterPreallocation(dst_fs_info) ) {
@@ -935,6 +1005,24 @@ CopyingJob::StepResult CopyingJob::CopyNativeFileToNativeFile(vfs::NativeHost &_
         }
     }
 
+    // drop any previous content past the writing offset and extend the destination to its final size at once,
+    // thus every region which is not written afterwards becomes a hole
+    if( is_sparse_copy ) {
+        while( true ) {
+            if( ftruncate(destination_fd, initial_writing_offset) == 0 &&
+                ftruncate(destination_fd, total_dst_size) == 0 )
+                break;
+            switch( m_OnDestinationFileWriteError(VFSError::FromErrno(), _dst_path, _native_host) ) {
+                case DestinationFileWriteErrorResolution::Skip:
+                    return StepResult::Skipped;
+                case DestinationFileWriteErrorResolution::Stop:
+                    return StepResult::Stop;
+                case DestinationFileWriteErrorResolution::Retry:
+                    continue;
+            }
+        }
+    }
+
     auto read_buffer = m_Buffers[0].get();
     auto write_buffer = m_Buffers[1].get();
     const uint32_t src_preferred_io_size =
@@ -943,8 +1031,13 @@ CopyingJob::StepResult CopyingJob::CopyNativeFileToNativeFile(vfs::NativeHost &_
         dst_fs_info.basic.io_size < m_BufferSize ? dst_fs_info.basic.io_size : m_BufferSize;
     constexpr int max_io_loops = 5; // looked in Apple's copyfile() - treat 5 zero-resulting reads/writes as an error
     uint32_t bytes_to_write = 0;
+    uint64_t bytes_to_write_offset = 0; // destination offset of the pending bytes, used only for sparse copying
     uint64_t source_bytes_read = 0;
     uint64_t destination_bytes_written = 0;
+    uint64_t source_data_end = is_sparse_copy ? 0 : src_stat_buffer.st_size; // end of the current data extent
+    size_t source_next_extent = 0;
+
+    bool traced_first_byte = false;
 
     // read from source within current thread and write to destination within secondary queue
     while( static_cast<uint64_t>(src_stat_buffer.st_size) != destination_bytes_written ) {
@@ -957,6 +1050,8 @@ CopyingJob::StepResult CopyingJob::CopyNativeFileToNativeFile(vfs::NativeHost &_
         std::optional<StepResult> write_return; // optional storage for error returning
         m_IOGroup.Run([this,
                        bytes_to_write,
+                       bytes_to_write_offset,
+                       is_sparse_copy,
                        destination_fd,
                        write_buffer,
                        dst_preferred_io_size,
@@ -968,8 +1063,11 @@ CopyingJob::StepResult CopyingJob::CopyNativeFileToNativeFile(vfs::NativeHost &_
             uint32_t has_written = 0; // amount of bytes written into destination this time
             int write_loops = 0;
             while( left_to_write > 0 ) {
+                const auto chunk = std::min(left_to_write, dst_preferred_io_size);
                 const int64_t n_written =
-                    write(destination_fd, write_buffer + has_written, std::min(left_to_write, dst_preferred_io_size));
+                    is_sparse_copy
+                        ? pwrite(destination_fd, write_buffer + has_written, chunk, bytes_to_write_offset + has_written)
+                        : write(destination_fd, write_buffer + has_written, chunk);
                 if( n_written > 0 ) {
                     has_written += n_written;
                     left_to_write -= n_written;
@@ -991,17 +1089,35 @@ CopyingJob::StepResult CopyingJob::CopyNativeFileToNativeFile(vfs::NativeHost &_
         });
 
         // <<<--- reading in current thread --->>>
+        // jump over a hole in the sparse source, if we've reached the end of the current data extent
+        uint64_t hole_size = 0;
+        if( is_sparse_copy && source_bytes_read == source_data_end ) {
+            const auto &extents = *src_data_extents;
+            const bool has_more = source_next_extent < extents.size();
+            const uint64_t next_data = has_more ? extents[source_next_extent].offset : src_stat_buffer.st_size;
+            hole_size = next_data - source_bytes_read;
+            if( _source_data_feedback )
+                FeedZerosIntoChecksum(_source_data_feedback, hole_size);
+            source_bytes_read = next_data;
+            source_data_end = has_more ? next_data + extents[source_next_extent++].length : next_data;
+        }
+        const uint64_t read_offset = source_bytes_read;
+
         // here we handle the case in which source io size is much smaller than dest's io size
         uint32_t to_read = std::max(src_preferred_io_size, dst_preferred_io_size);
-        if( src_stat_buffer.st_size - source_bytes_read < to_read )
-            to_read = uint32_t(src_stat_buffer.st_size - source_bytes_read);
+        if( source_data_end - source_bytes_read < to_read )
+            to_read = uint32_t(source_data_end - source_bytes_read);
         uint32_t has_read = 0;                 // amount of bytes read into buffer this time
         int read_loops = 0;                    // amount of zero-resulting reads
         std::optional<StepResult> read_return; // optional storage for error returning
         while( to_read != 0 ) {
-            const int64_t read_result = read(source_fd, read_buffer + has_read, to_read);
+            const int64_t read_result = is_sparse_copy
+                                            ? pread(source_fd, read_buffer + has_read, to_read, source_bytes_read)
+                                            : read(source_fd, read_buffer + has_read, to_read);
             assert(read_result <= static_cast<int64_t>(to_read));
             if( read_result > 0 ) {
+                if( !std::exchange(traced_first_byte, true) )
+                    TraceMark("First byte", "io");
                 if( _source_data_feedback )
                     _source_data_feedback(read_buffer + has_read, static_cast<unsigned>(read_result));
                 source_bytes_read += read_result;
@@ -1031,16 +1147,22 @@ CopyingJob::StepResult CopyingJob::CopyNativeFileToNativeFile(vfs::NativeHost &_
         if( read_return )
             return *read_return;
 
-        Statistics().CommitProcessed(Statistics::SourceType::Bytes, bytes_to_write);
+        // holes are not written, but they count as processed
+        destination_bytes_written += hole_size;
+        Statistics().CommitProcessed(Statistics::SourceType::Bytes, bytes_to_write + hole_size);
 
         // swap buffers ang go again
         bytes_to_write = has_read;
+        bytes_to_write_offset = initial_writing_offset + read_offset;
         std::swap(read_buffer, write_buffer);
     }
 
     // we're ok, turn off destination cleaning
     clean_destination.disengage();
 
+    TraceMark("Last byte", "io");
+    const auto setattr_span = TraceSpan("Set attributes", "io");
+
     // do xattr things
     // crazy OSX stuff: setting some xattrs like FinderInfo may actually change file's BSD flags
     if( m_Options.copy_xattrs ) {
@@ -1236,6 +1358,8 @@ CopyingJob::StepResult CopyingJob::CopyVFSFileToNativeFile(VFSHost &_src_vfs,
             return resolution;
     }
 
+    TraceMark("Opened", "io");
+
     // don't forget ot close destination file descriptor anyway
     const auto close_destination = at_scope_end([&] {
         if( destination_fd != -1 ) {
@@ -1324,6 +1448,8 @@ CopyingJob::StepResult CopyingJob::CopyVFSFileToNativeFile(VFSHost &_src_vfs,
     uint64_t source_bytes_read = 0;
     uint64_t destination_bytes_written = 0;
 
+    bool traced_first_byte = false;
+
     // read from source within current thread and write to destination within secondary queue
     while( src_stat_buffer.size != destination_bytes_written ) {
 
@@ -1380,6 +1506,8 @@ CopyingJob::StepResult CopyingJob::CopyVFSFileToNativeFile(VFSHost &_src_vfs,
             const int64_t read_result =
                 src_file->Read(read_buffer + has_read, std::min(to_read, src_preffered_io_size));
             if( read_result > 0 ) {
+                if( !std::exchange(traced_first_byte, true) )
+                    TraceMark("First byte", "io");
                 if( _source_data_feedback )
                     _source_data_feedback(read_buffer + has_read, static_cast<unsigned>(read_result));
                 source_bytes_read += read_result;
@@ -1420,6 +1548,9 @@ CopyingJob::StepResult CopyingJob::CopyVFSFileToNativeFile(VFSHost &_src_vfs,
     // we're ok, turn off destination cleaning
     clean_destination.disengage();
 
+    TraceMark("Last byte", "io");
+    const auto setattr_span = TraceSpan("Set attributes", "io");
+
     // erase destination's xattrs
     if( m_Options.copy_xattrs && do_erase_xattrs )
         EraseXattrsFromNativeFD(destination_fd);
@@ -1617,6 +1748,8 @@ CopyingJob::StepResult CopyingJob::CopyVFSFileToVFSFile(VFSHost &_src_vfs,
         }
     }
 
+    TraceMark("Opened", "io");
+
     // for some circumstances we have to clean up remains if anything goes wrong
     // and do it BEFORE close_destination fires
     auto clean_destination = at_scope_end([&] {
@@ -1649,73 +1782,149 @@ CopyingJob::StepResult CopyingJob::CopyVFSFileToVFSFile(VFSHost &_src_vfs,
         }
     }
 
-    auto read_buffer = m_Buffers[0].get();
-    auto write_buffer = m_Buffers[1].get();
-    const uint32_t dst_preffered_io_size = m_BufferSize;
-    const uint32_t src_preffered_io_size = m_BufferSize;
+    // a sparse native file can be copied without its holes if the destination is able to seek while writing
+    std::optional<std::vector<DataExtent>> src_data_extents;
+    if( _src_vfs.IsNativeFS() && initial_writing_offset == 0 &&
+        dst_file->GetWriteParadigm() >= VFSFile::WriteParadigm::Seek &&
+        src_file->GetReadParadigm() >= VFSFile::ReadParadigm::Random ) {
+        if( const int fd = routedio::RoutedIO::Default.open(_src_path.c_str(), O_RDONLY); fd >= 0 ) {
+            struct stat st;
+            if( fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) == src_stat_buffer.size )
+                src_data_extents = FindSparseFileDataExtents(fd, st);
+            close(fd);
+        }
+    }
+    const bool is_sparse_copy = src_data_extents.has_value();
+
+    // the reader and the writer are decoupled by a ring of buffers, so the latencies of the source and of the
+    // destination overlap instead of adding up - both VFSes can be remote and slow in their own ways
+    constexpr int ring_slices_per_buffer = 4;
+    constexpr uint32_t ring_buffer_size = m_BufferSize / ring_slices_per_buffer;
+    std::array<uint8_t *, std::extent_v<decltype(m_Buffers)> * ring_slices_per_buffer> ring_buffers;
+    for( size_t i = 0; i != ring_buffers.size(); ++i )
+        ring_buffers[i] = m_Buffers[i / ring_slices_per_buffer].get() + (i % ring_slices_per_buffer) * ring_buffer_size;
+    ChunkRing ring(ring_buffers, ring_buffer_size);
+
+    const uint32_t dst_preffered_io_size = ring_buffer_size;
+    const uint32_t src_preffered_io_size = ring_buffer_size;
     constexpr int max_io_loops = 5; // looked in Apple's copyfile() - treat 5 zero-resulting reads/writes as an error
-    uint32_t bytes_to_write = 0;
     uint64_t source_bytes_read = 0;
-    uint64_t destination_bytes_written = 0;
-
-    // read from source within current thread and write to destination within secondary queue
-    while( src_stat_buffer.size != destination_bytes_written ) {
+    uint64_t source_data_end = is_sparse_copy ? 0 : src_stat_buffer.size; // end of the current data extent
+    size_t source_next_extent = 0;
+
+    // <<<--- writing in secondary thread --->>>
+    std::optional<StepResult> write_return; // optional storage for error returning
+    m_IOGroup.Run([this, &ring, is_sparse_copy, &dst_file, dst_preffered_io_size, &write_return, &_dst_path] {
+        while( const auto chunk = ring.Pop() ) {
+            if( IsStopped() ) {
+                write_return = StepResult::Stop;
+                ring.Abort();
+                return;
+            }
 
-        // check user decided to pause operation or discard it
-        if( BlockIfPaused(); IsStopped() )
-            return StepResult::Stop;
+            // skip a hole in the destination, if any
+            const auto dst_offset = static_cast<ssize_t>(chunk->offset);
+            while( is_sparse_copy && chunk->size > 0 && dst_file->Pos() != dst_offset ) {
+                const auto rc = dst_file->Seek(chunk->offset, VFSFile::Seek_Set);
+                if( rc >= 0 )
+                    break;
+                switch( m_OnDestinationFileWriteError(static_cast<int>(rc), _dst_path, *m_DestinationHost) ) {
+                    case DestinationFileWriteErrorResolution::Skip:
+                        write_return = StepResult::Skipped;
+                        ring.Abort();
+                        return;
+                    case DestinationFileWriteErrorResolution::Stop:
+                        write_return = StepResult::Stop;
+                        ring.Abort();
+                        return;
+                    case DestinationFileWriteErrorResolution::Retry:
+                        continue;
+                }
+            }
 
-        // <<<--- writing in secondary thread --->>>
-        std::optional<StepResult> write_return; // optional storage for error returning
-        m_IOGroup.Run([this,
-                       bytes_to_write,
-                       &dst_file,
-                       write_buffer,
-                       dst_preffered_io_size,
-                       &destination_bytes_written,
-                       &write_return,
-                       &_dst_path] {
-            uint32_t left_to_write = bytes_to_write;
-            uint32_t has_written = 0; // amount of bytes written into destination this time
+            uint32_t left_to_write = chunk->size;
+            uint32_t has_written = 0; // amount of bytes written into destination from this chunk
             int write_loops = 0;
             while( left_to_write > 0 ) {
-                //                int64_t n_written = write(destination_fd, write_buffer +
-                //                has_written, min(left_to_write, dst_preffered_io_size) );
                 const int64_t n_written =
-                    dst_file->Write(write_buffer + has_written, std::min(left_to_write, dst_preffered_io_size));
+                    dst_file->Write(chunk->data + has_written, std::min(left_to_write, dst_preffered_io_size));
                 if( n_written > 0 ) {
                     has_written += n_written;
                     left_to_write -= n_written;
-                    destination_bytes_written += n_written;
                 }
                 else if( n_written < 0 || (++write_loops > max_io_loops) ) {
                     switch(
                         m_OnDestinationFileWriteError(static_cast<int>(n_written), _dst_path, *m_DestinationHost) ) {
                         case DestinationFileWriteErrorResolution::Skip:
                             write_return = StepResult::Skipped;
+                            ring.Abort();
                             return;
                         case DestinationFileWriteErrorResolution::Stop:
                             write_return = StepResult::Stop;
+                            ring.Abort();
                             return;
                         case DestinationFileWriteErrorResolution::Retry:
                             continue;
                     }
                 }
             }
-        });
+            ring.Release(*chunk);
+        }
+    });
 
-        // <<<--- reading in current thread --->>>
-        // here we handle the case in which source io size is much smaller than dest's io size
-        uint32_t to_read = std::max(src_preffered_io_size, dst_preffered_io_size);
-        if( src_stat_buffer.size - source_bytes_read < to_read )
-            to_read = uint32_t(src_stat_buffer.size - source_bytes_read);
-        uint32_t has_read = 0;                 // amount of bytes read into buffer this time
-        int read_loops = 0;                    // amount of zero-resulting reads
-        std::optional<StepResult> read_return; // optional storage for error returning
+    // <<<--- reading in current thread --->>>
+    // the statistics are committed only from this thread, as the writer releases its chunks
+    uint64_t committed_written_bytes = 0;
+    const auto commit_written_bytes = [&] {
+        const uint64_t written_bytes = ring.ConsumedBytes();
+        Statistics().CommitProcessed(Statistics::SourceType::Bytes, written_bytes - committed_written_bytes);
+        committed_written_bytes = written_bytes;
+    };
+    std::optional<StepResult> read_return; // optional storage for error returning
+    bool traced_first_byte = false;
+    while( !read_return && source_bytes_read != src_stat_buffer.size ) {
+
+        // check user decided to pause operation or discard it
+        if( BlockIfPaused(); IsStopped() ) {
+            read_return = StepResult::Stop;
+            break;
+        }
+
+        // jump over a hole in the sparse source, if we've reached the end of the current data extent.
+        // holes are not written, but they count as processed
+        if( is_sparse_copy && source_bytes_read == source_data_end ) {
+            const auto &extents = *src_data_extents;
+            const bool has_more = source_next_extent < extents.size();
+            const uint64_t next_data = has_more ? extents[source_next_extent].offset : src_stat_buffer.size;
+            const uint64_t hole_size = next_data - source_bytes_read;
+            if( _source_data_feedback )
+                FeedZerosIntoChecksum(_source_data_feedback, hole_size);
+            Statistics().CommitProcessed(Statistics::SourceType::Bytes, hole_size);
+            source_bytes_read = next_data;
+            source_data_end = has_more ? next_data + extents[source_next_extent++].length : next_data;
+            if( source_bytes_read == src_stat_buffer.size )
+                break;
+        }
+
+        uint8_t *const read_buffer = ring.AcquireFree();
+        if( read_buffer == nullptr )
+            break; // the writer has failed, its result will be returned below
+        commit_written_bytes();
+
+        const uint64_t read_offset = source_bytes_read;
+        uint32_t to_read = ring.BufferSize();
+        if( source_data_end - source_bytes_read < to_read )
+            to_read = uint32_t(source_data_end - source_bytes_read);
+        uint32_t has_read = 0; // amount of bytes read into buffer this time
+        int read_loops = 0;    // amount of zero-resulting reads
         while( to_read != 0 ) {
-            const int64_t read_result =
-                src_file->Read(read_buffer + has_read, std::min(to_read, src_preffered_io_size));
+            const auto chunk = std::min(to_read, src_preffered_io_size);
+            const int64_t read_result = is_sparse_copy
+                                            ? src_file->ReadAt(source_bytes_read, read_buffer + has_read, chunk)
+                                            : src_file->Read(read_buffer + has_read, chunk);
             if( read_result > 0 ) {
+                if( !std::exchange(traced_first_byte, true) )
+                    TraceMark("First byte", "io");
                 if( _source_data_feedback )
                     _source_data_feedback(read_buffer + has_read, static_cast<unsigned>(read_result));
                 source_bytes_read += read_result;
@@ -1737,24 +1946,50 @@ CopyingJob::StepResult CopyingJob::CopyVFSFileToVFSFile(VFSHost &_src_vfs,
             }
         }
 
-        m_IOGroup.Wait();
+        if( !read_return )
+            ring.Push({.data = read_buffer, .size = has_read, .offset = read_offset});
+    }
 
-        // if something bad happened in reading or writing - return from this routine
-        if( write_return )
-            return *write_return;
-        if( read_return )
-            return *read_return;
+    if( read_return )
+        ring.Abort();
+    else
+        ring.Finish();
+    m_IOGroup.Wait();
+    commit_written_bytes();
 
-        Statistics().CommitProcessed(Statistics::SourceType::Bytes, bytes_to_write);
+    // if something bad happened in reading or writing - return from this routine
+    if( write_return )
+        return *write_return;
+    if( read_return )
+        return *read_return;
 
-        // swap buffers ang go again
-        bytes_to_write = has_read;
-        std::swap(read_buffer, write_buffer);
+    // if the sparse source ends with a hole - write the last byte explicitly to give the destination its size
+    if( is_sparse_copy && src_stat_buffer.size > 0 &&
+        dst_file->Pos() != static_cast<ssize_t>(src_stat_buffer.size) ) {
+        static constexpr uint8_t zero = 0;
+        while( true ) {
+            ssize_t rc = dst_file->Seek(src_stat_buffer.size - 1, VFSFile::Seek_Set);
+            if( rc >= 0 )
+                rc = dst_file->Write(&zero, 1);
+            if( rc > 0 )
+                break;
+            switch( m_OnDestinationFileWriteError(static_cast<int>(rc), _dst_path, *m_DestinationHost) ) {
+                case DestinationFileWriteErrorResolution::Skip:
+                    return StepResult::Skipped;
+                case DestinationFileWriteErrorResolution::Stop:
+                    return StepResult::Stop;
+                case DestinationFileWriteErrorResolution::Retry:
+                    continue;
+            }
+        }
     }
 
     // we're ok, turn off destination cleaning
     clean_destination.disengage();
 
+    TraceMark("Last byte", "io");
+    const auto setattr_span = TraceSpan("Set attributes", "io");
+
     // TODO:
     // xattrs
     // owners
@@ -2563,6 +2798,40 @@ void CopyingJob::ApplyTimestampsFixups()
     }
 }
 
+bool CopyingJob::CanRecreateHardlinks(bool _is_same_native_volume) const
+{
+    if( !m_Options.preserve_hardlinks )
+        return false;
+
+    // renaming within the same volume keeps hardlinks intact anyway
+    if( !m_Options.docopy && _is_same_native_volume )
+        return false;
+
+    return m_DestinationNativeFSInfo && m_DestinationNativeFSInfo->format.hard_links;
+}
+
+bool CopyingJob::TryToRecreateHardlink(int _hardlink_primary, const std::string &_dst_path) const
+{
+    const auto primary = m_HardlinkPrimaryDestinations.find(_hardlink_primary);
+    if( primary == m_HardlinkPrimaryDestinations.end() )
+        return false; // the primary item wasn't copied, so this one has to be copied as a regular file
+
+    auto &io = routedio::RoutedIO::Default;
+
+    // let the regular copying logic deal with an already existing destination
+    struct stat st;
+    if( io.lstat(_dst_path.c_str(), &st) == 0 )
+        return false;
+
+    // any failure here, e.g. EXDEV or EMLINK, means falling back to copying
+    return io.link(primary->second.c_str(), _dst_path.c_str()) == 0;
+}
+
+size_t CopyingJob::RecreatedHardlinksAmount() const noexcept
+{
+    return m_RecreatedHardlinks;
+}
+
 CopyingJob::StepResult CopyingJob::VerifyCopiedFile(const ChecksumExpectation &_exp, bool &_matched)
 {
     _matched = false;
@@ -2919,10 +3188,27 @@ CopyingJob::StepResult CopyingJob::CopyVFSSymlinkToVFS(VFSHost &_src_vfs,
     return StepResult::Ok;
 }
 
+static std::string_view StageName(enum CopyingJob::Stage _stage) noexcept
+{
+    switch( _stage ) {
+        case CopyingJob::Stage::Preparing:
+            return "Preparing";
+        case CopyingJob::Stage::Process:
+            return "Process";
+        case CopyingJob::Stage::Verify:
+            return "Verify";
+        case CopyingJob::Stage::Cleaning:
+            return "Cleaning";
+        default:
+            return {};
+    }
+}
+
 void CopyingJob::SetStage(enum Stage _stage)
 {
     if( m_Stage != _stage ) {
         m_Stage = _stage;
+        TraceStage(StageName(_stage));
         m_OnStageChanged();
     }
 }
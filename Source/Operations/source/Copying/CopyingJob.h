@@ -4,6 +4,7 @@
 #include <Base/algo.h>
 #include <Base/SerialQueue.h>
 #include <Base/DispatchGroup.h>
+#include <ankerl/unordered_dense.h>
 #include <Utility/NativeFSManager.h>
 #include <VFS/VFS.h>
 #include <VFS/Native.h>
@@ -39,6 +40,9 @@ public:
     const std::string &DestinationPath() const noexcept;
     const CopyingOptions &Options() const noexcept;
 
+    // Amount of items which were recreated as hardlinks to already copied files instead of being copied.
+    size_t RecreatedHardlinksAmount() const noexcept;
+
 private:
     using ChecksumVerification = CopyingOptions::ChecksumVerification;
 
@@ -81,6 +85,7 @@ private:
 
     void Perform() override;
     void ProcessItems();
+    std::vector<int> ComposeProcessingOrder() const;
     StepResult ProcessItemNo(int _item_number);
     StepResult ProcessSymlinkItem(VFSHost &_source_host,
                                   const std::string &_source_path,
@@ -156,6 +161,9 @@ private:
                              const std::string &_src_path,
                              const std::string &_dst_path,
                              const RequestNonexistentDst &_new_dst_callback) const;
+    bool CanRecreateHardlinks(bool _is_same_native_volume) const;
+    bool TryToRecreateHardlink(int _hardlink_primary, const std::string &_dst_path) const;
+
     StepResult VerifyCopiedFile(const copying::ChecksumExpectation &_exp, bool &_matched);
     void ClearSourceItems();
     void ClearSourceItem(const std::string &_path, mode_t _mode, VFSHost &_host);
@@ -181,6 +189,8 @@ private:
     std::vector<unsigned> m_SourceItemsToDelete;
     mutable std::vector<PermissionFixup> m_TargetPermissionsFixupEpilogue;
     mutable std::vector<TimestampFixup> m_TargetTimestampFixupEpilogue;
+    ankerl::unordered_dense::map<int, std::string> m_HardlinkPrimaryDestinations; // source item -> its copy
+    std::atomic_size_t m_RecreatedHardlinks = 0;
     const VFSHostPtr m_DestinationHost;
     const bool m_IsDestinationHostNative;
     std::shared_ptr<const utility::NativeFileSystemInfo> m_DestinationNativeFSInfo; // used only for native vfs
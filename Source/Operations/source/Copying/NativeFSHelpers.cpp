@@ -1,8 +1,10 @@
-// Copyright (C) 2017-2020 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "NativeFSHelpers.h"
 #include <sys/stat.h>
 #include <sys/param.h>
 #include <sys/mount.h>
+#include <unistd.h>
+#include <algorithm>
 
 namespace nc::ops::copying {
 
@@ -76,6 +78,50 @@ void AdjustFileTimesForNativeFD(int _target_fd, const VFSStat &_with_times)
     AdjustFileTimesForNativeFD(_target_fd, st);
 }
 
+std::optional<std::vector<DataExtent>> FindSparseFileDataExtents(int _fd, const struct stat &_st)
+{
+    const int64_t file_size = _st.st_size;
+    if( file_size <= 0 )
+        return std::nullopt;
+
+    // a cheap check first - a file which has all its blocks allocated can't have any holes
+    if( static_cast<int64_t>(_st.st_blocks) * S_BLKSIZE >= file_size )
+        return std::nullopt;
+
+    // now verify that there's at least one hole before the end of file.
+    // compressed files can have st_blocks smaller than their size without being sparse.
+    const off_t first_hole = lseek(_fd, 0, SEEK_HOLE);
+    if( first_hole < 0 || first_hole >= file_size ) {
+        lseek(_fd, 0, SEEK_SET);
+        return std::nullopt;
+    }
+
+    std::vector<DataExtent> extents;
+    int64_t offset = 0;
+    while( offset < file_size ) {
+        const off_t data_start = lseek(_fd, offset, SEEK_DATA);
+        if( data_start < 0 ) {
+            if( errno == ENXIO )
+                break; // no more data till the end of the file - it ends with a hole
+            lseek(_fd, 0, SEEK_SET);
+            return std::nullopt;
+        }
+        if( data_start >= file_size )
+            break;
+        off_t data_end = lseek(_fd, data_start, SEEK_HOLE);
+        if( data_end < 0 ) {
+            lseek(_fd, 0, SEEK_SET);
+            return std::nullopt;
+        }
+        data_end = std::min(static_cast<int64_t>(data_end), file_size);
+        extents.emplace_back(DataExtent{.offset = data_start, .length = data_end - data_start});
+        offset = data_end;
+    }
+
+    lseek(_fd, 0, SEEK_SET);
+    return extents;
+}
+
 bool IsAnExternalExtenedAttributesStorage(VFSHost &_host,
                                           const std::string &_path,
                                           const std::string &_item_name,
@@ -1,11 +1,19 @@
-// Copyright (C) 2017-2020 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <Utility/NativeFSManager.h>
 #include <VFS/VFS.h>
+#include <optional>
+#include <vector>
 
 namespace nc::ops::copying {
 
+// A contiguous range of a file which contains actual data, i.e. is not a hole.
+struct DataExtent {
+    int64_t offset = 0;
+    int64_t length = 0;
+};
+
 bool ShouldPreallocateSpace(int64_t _bytes_to_write, const utility::NativeFileSystemInfo &_fs_info) noexcept;
 bool TryToPreallocateSpace(int64_t _preallocate_delta, int _file_des) noexcept;
 bool SupportsFastTruncationAfterPreallocation(const utility::NativeFileSystemInfo &_fs_info) noexcept;
@@ -15,6 +23,11 @@ void AdjustFileTimesForNativePath(const char *_target_path, const VFSStat &_with
 void AdjustFileTimesForNativeFD(int _target_fd, struct stat &_with_times);
 void AdjustFileTimesForNativeFD(int _target_fd, const VFSStat &_with_times);
 
+// Returns a list of data extents of a file if it is sparse, i.e. has at least one hole within _file_size.
+// Returns nullopt for dense files or if the underlying filesystem doesn't support SEEK_HOLE/SEEK_DATA.
+// Restores the file position to the beginning of the file afterwards.
+std::optional<std::vector<DataExtent>> FindSparseFileDataExtents(int _fd, const struct stat &_st);
+
 bool IsAnExternalExtenedAttributesStorage(VFSHost &_host,
                                           const std::string &_path,
                                           const std::string &_item_name,
@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2021 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 namespace nc::ops {
@@ -27,8 +27,15 @@ struct CopyingOptions {
         Stop,      // abort entire operation
     };
 
+    enum class ProcessingOrder : char {
+        Auto,             // default - order by physical locality only when the source is on rotational media
+        AsScanned,        // process the items in the order they were scanned
+        PhysicalLocality, // always order the native source files by their inode numbers
+    };
+
     bool docopy = true; // it it false then operation will do renaming/moving
     bool preserve_symlinks = true;
+    bool preserve_hardlinks = true; // recreate hardlinks between copied native files when the target supports it
     bool copy_xattrs = true;
     bool copy_file_times = true;
     bool copy_unix_flags = true;
@@ -36,6 +43,7 @@ struct CopyingOptions {
     ChecksumVerification verification = ChecksumVerification::Never;
     ExistBehavior exist_behavior = ExistBehavior::Ask;
     LockedItemBehavior locked_items_behaviour = LockedItemBehavior::Ask;
+    ProcessingOrder processing_order = ProcessingOrder::Auto;
 };
 
 } // namespace nc::ops
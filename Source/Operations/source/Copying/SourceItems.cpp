@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "SourceItems.h"
 #include <sys/stat.h>
 #include <Base/algo.h>
@@ -19,6 +19,14 @@ int SourceItems::InsertItem(uint16_t _host_index,
     if( S_ISREG(_stat.mode) )
         m_TotalRegBytes += _stat.size;
 
+    const int index = static_cast<int>(m_Items.size());
+    int hardlink_primary = -1;
+    if( S_ISREG(_stat.mode) && _stat.meaning.nlink && _stat.meaning.inode && _stat.meaning.dev && _stat.nlink > 1 &&
+        m_SourceItemsHosts[_host_index]->IsNativeFS() ) {
+        const HardlinkKey key{.inode = _stat.inode, .dev = _stat.dev, .host_index = _host_index};
+        hardlink_primary = m_HardlinkPrimaries.try_emplace(key, index).first->second;
+    }
+
     SourceItem it;
     it.item_name = S_ISDIR(_stat.mode) ? EnsureTrailingSlash(std::move(_item_name)) : std::move(_item_name);
     it.parent_index = _parent_index;
@@ -26,10 +34,12 @@ int SourceItems::InsertItem(uint16_t _host_index,
     it.host_index = _host_index;
     it.mode = _stat.mode;
     it.item_size = _stat.size;
+    it.inode = _stat.meaning.inode ? _stat.inode : 0;
+    it.hardlink_primary = hardlink_primary;
 
     m_Items.emplace_back(std::move(it));
 
-    return int(m_Items.size() - 1);
+    return index;
 }
 
 std::string SourceItems::ComposeFullPath(int _item_no) const
@@ -83,6 +93,22 @@ uint64_t SourceItems::ItemSize(int _item_no) const
     return m_Items.at(_item_no).item_size;
 }
 
+int SourceItems::ItemHardlinkPrimary(int _item_no) const
+{
+    return m_Items.at(_item_no).hardlink_primary;
+}
+
+uint64_t SourceItems::ItemInode(int _item_no) const
+{
+    return m_Items.at(_item_no).inode;
+}
+
+size_t SourceItems::HardlinkKeyHash::operator()(const HardlinkKey &_key) const noexcept
+{
+    const uint64_t dev_and_host = (static_cast<uint64_t>(static_cast<uint32_t>(_key.dev)) << 16) | _key.host_index;
+    return ankerl::unordered_dense::hash<uint64_t>{}(_key.inode ^ (dev_and_host * 0x9E3779B97F4A7C15ull));
+}
+
 const std::string &SourceItems::ItemName(int _item_no) const
 {
     return m_Items.at(_item_no).item_name;
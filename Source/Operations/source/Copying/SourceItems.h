@@ -1,7 +1,8 @@
-// Copyright (C) 2017-2020 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <VFS/VFS.h>
+#include <ankerl/unordered_dense.h>
 
 namespace nc::ops::copying {
 
@@ -24,6 +25,14 @@ public:
     uint64_t ItemSize(int _item_no) const;
     VFSHost &ItemHost(int _item_no) const;
 
+    // Returns -1 if the item is not a hardlink to a native file, i.e. its nlink is 1 or unknown.
+    // Otherwise returns an index of the first inserted item which refers to the same (dev, inode) pair,
+    // which can be the item itself.
+    int ItemHardlinkPrimary(int _item_no) const;
+
+    // Returns a file serial number of the item or 0 if the source host didn't provide it.
+    uint64_t ItemInode(int _item_no) const;
+
     VFSHost &Host(uint16_t _host_ind) const;
     uint16_t InsertOrFindHost(const VFSHostPtr &_host);
 
@@ -38,15 +47,30 @@ private:
         //             item_name;
         std::string item_name;
         uint64_t item_size;
+        uint64_t inode;
         int parent_index;
         unsigned base_dir_index;
+        int hardlink_primary;
         uint16_t host_index;
         uint16_t mode;
     };
 
+    struct HardlinkKey {
+        uint64_t inode;
+        int32_t dev;
+        uint16_t host_index;
+        bool operator==(const HardlinkKey &) const noexcept = default;
+    };
+
+    struct HardlinkKeyHash {
+        using is_avalanching = void;
+        size_t operator()(const HardlinkKey &_key) const noexcept;
+    };
+
     std::vector<SourceItem> m_Items;
     std::vector<VFSHostPtr> m_SourceItemsHosts;
     std::vector<std::string> m_SourceItemsBaseDirectories;
+    ankerl::unordered_dense::map<HardlinkKey, int, HardlinkKeyHash> m_HardlinkPrimaries;
     uint64_t m_TotalRegBytes = 0;
 };
 
@@ -20,7 +20,9 @@ Deletion::Deletion(std::vector<VFSListingItem> _items, DeletionOptions _options)
     SetTitle(Caption(_items).UTF8String);
     m_LockedItemBehaviour = m_OrigOptions.locked_items_behaviour;
 
-    m_Job = std::make_unique<DeletionJob>(std::move(_items), _options.type);
+    SetResources(ResolveOperationResources(_items));
+
+    m_Job = std::make_unique<DeletionJob>(std::move(_items), _options.type, _options.processing_order);
     m_Job->m_OnReadDirError = [this](int _err, const std::string &_path, VFSHost &_vfs) {
         return OnReadDirError(_err, _path, _vfs);
     };
@@ -1,20 +1,66 @@
 // Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "DeletionJob.h"
+#include "../OperationResource.h"
 #include <Utility/PathManip.h>
 #include <Utility/NativeFSManager.h>
+#include <VFS/Native.h>
+#include <RoutedIO/RoutedIO.h>
+#include <Base/DispatchGroup.h>
+#include <condition_variable>
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <algorithm>
+#include <ranges>
+#include <string_view>
+#include <thread>
+#include <typeinfo>
 
 namespace nc::ops {
 
+// the upper bound of the threads walking a native directory tree
+static constexpr unsigned g_MaxNativeTreeWorkers = 8;
+
+// A directory being removed by the native tree walk. Its descriptor is kept open while its entries are being removed,
+// so that they are addressed relative to it instead of via their full paths.
+struct DeletionJob::NativeDirectory {
+    std::shared_ptr<NativeDirectory> parent; // nullptr for the root directory
+    std::string name;                        // a full path for the root directory
+    int fd = -1;
+    std::atomic_int pending{1};         // the listing itself plus the subdirectories which are not removed yet
+    std::atomic_bool incomplete{false}; // some of the entries were left in place, so this can't be removed
+    NativeDirectory() = default;
+    NativeDirectory(const NativeDirectory &) = delete;
+    ~NativeDirectory() { Close(); }
+    void Close() noexcept;
+    std::string Path() const; // with a trailing slash, used only to report errors
+};
+
+struct DeletionJob::NativeTreeWalk {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<std::shared_ptr<NativeDirectory>> queue; // processed as LIFO to go depth-first and keep few fds open
+    unsigned busy = 0;
+};
+
+struct NativeDirEntry {
+    std::string name;
+    uint8_t type;
+};
+
 static bool IsEAStorage(VFSHost &_host, const std::string &_directory, const char *_filename, uint8_t _unix_type);
+static bool IsAppleDoubleFilename(std::string_view _filename) noexcept;
+static int ReadNativeDirectory(int _parent_fd, const char *_name, int &_fd, std::vector<NativeDirEntry> &_entries);
 
-DeletionJob::DeletionJob(std::vector<VFSListingItem> _items, DeletionType _type)
+DeletionJob::DeletionJob(std::vector<VFSListingItem> _items,
+                         DeletionType _type,
+                         DeletionOptions::ProcessingOrder _order)
 {
     m_SourceItems = std::move(_items);
     m_Type = _type;
+    m_ProcessingOrder = _order;
     if( _type == DeletionType::Trash &&
         !std::ranges::all_of(m_SourceItems, [](auto &i) { return i.Host()->IsNativeFS(); }) )
         throw std::invalid_argument("DeletionJob: invalid work mode for the provided items");
@@ -25,15 +71,22 @@ DeletionJob::~DeletionJob() = default;
 
 void DeletionJob::Perform()
 {
-    DoScan();
+    // The physical locality order requires to know all the files upfront, otherwise the native directories are walked
+    // and removed in parallel without a preliminary scanning.
+    const bool order_by_locality = m_Type == DeletionType::Permanent && ShouldOrderByPhysicalLocality();
+
+    DoScan(!order_by_locality);
 
     if( BlockIfPaused(); IsStopped() )
         return;
 
+    if( order_by_locality )
+        OrderScriptByPhysicalLocality();
+
     DoDelete();
 }
 
-void DeletionJob::DoScan()
+void DeletionJob::DoScan(bool _walk_native_trees)
 {
     for( int i = 0, e = static_cast<int>(m_SourceItems.size()); i != e; ++i ) {
         if( BlockIfPaused(); IsStopped() )
@@ -48,10 +101,12 @@ void DeletionJob::DoScan()
             si.listing_item_index = i;
             si.filename = &m_Paths.back();
             si.type = m_Type;
+            si.native_tree =
+                m_Type == DeletionType::Permanent && _walk_native_trees && IsEligibleForNativeTreeWalk(item);
             m_Script.emplace(si);
 
             const auto nonempty_rm = bool(item.Host()->Features() & vfs::HostFeatures::NonEmptyRmDir);
-            if( m_Type == DeletionType::Permanent && !nonempty_rm )
+            if( m_Type == DeletionType::Permanent && !nonempty_rm && !si.native_tree )
                 ScanDirectory(item.Path(), i, si.filename);
         }
         else {
@@ -120,12 +175,40 @@ void DeletionJob::ScanDirectory(const std::string &_path,
                 si.listing_item_index = _listing_item_index;
                 si.filename = &m_Paths.back();
                 si.type = DeletionType::Permanent;
+                si.inode = e.inode;
                 m_Script.emplace(si);
             }
         }
     }
 }
 
+void DeletionJob::OrderScriptByPhysicalLocality()
+{
+    // Unlinking the files in the order of their inode numbers roughly follows the physical placement of their
+    // metadata, which saves a lot of head seeking on rotational media. All files are removed before any directory, so
+    // the directories stay in their original order which guarantees that children are removed before their parents.
+    std::vector<SourceItem> items;
+    items.reserve(m_Script.size());
+    for( ; !m_Script.empty(); m_Script.pop() )
+        items.emplace_back(m_Script.top());
+
+    const auto is_file = [](const SourceItem &_item) { return !IsPathWithTrailingSlash(_item.filename->c_str()); };
+    const auto dirs = std::ranges::stable_partition(items, is_file);
+    std::ranges::stable_sort(items.begin(), dirs.begin(), [](const SourceItem &_lhs, const SourceItem &_rhs) {
+        return _lhs.inode < _rhs.inode;
+    });
+
+    for( const auto &item : std::ranges::reverse_view(items) )
+        m_Script.emplace(item);
+}
+
+bool DeletionJob::ShouldOrderByPhysicalLocality() const
+{
+    using ProcessingOrder = DeletionOptions::ProcessingOrder;
+    return m_ProcessingOrder == ProcessingOrder::PhysicalLocality ||
+           (m_ProcessingOrder == ProcessingOrder::Auto && IsOnRotationalMedia(m_SourceItems));
+}
+
 void DeletionJob::DoDelete()
 {
     while( !m_Script.empty() ) {
@@ -141,7 +224,9 @@ void DeletionJob::DoDelete()
 
         if( type == DeletionType::Permanent ) {
             const auto is_dir = IsPathWithTrailingSlash(path);
-            if( is_dir )
+            if( entry.native_tree )
+                DoDeleteNativeTree(path, *vfs);
+            else if( is_dir )
                 DoRmDir(path, *vfs);
             else
                 DoUnlink(path, *vfs);
@@ -174,82 +259,242 @@ bool DeletionJob::DoUnlock(const std::string &_path, VFSHost &_vfs)
 
 void DeletionJob::DoUnlink(const std::string &_path, VFSHost &_vfs)
 {
+    DoRemove([&] { return _vfs.Unlink(_path); }, false, [&] { return _path; }, _vfs);
+}
+
+void DeletionJob::DoRmDir(const std::string &_path, VFSHost &_vfs)
+{
+    DoRemove([&] { return _vfs.RemoveDirectory(_path); }, true, [&] { return _path; }, _vfs);
+}
+
+bool DeletionJob::DoRemove(const std::function<int()> &_remove,
+                           bool _is_dir,
+                           const std::function<std::string()> &_path,
+                           VFSHost &_vfs)
+{
+    std::string path; // composed only when a failure has to be reported
     while( true ) {
-        const auto rc = _vfs.Unlink(_path);
+        const auto rc = _remove();
         if( rc == VFSError::Ok ) {
             Statistics().CommitProcessed(Statistics::SourceType::Items, 1);
-            break;
+            return true;
         }
-        else if( IsNativeLockedItem(rc, _path, _vfs) ) {
-            switch( m_OnLockedItem(rc, _path, _vfs, DeletionType::Permanent) ) {
+
+        const auto lock = std::lock_guard{m_CallbacksLock};
+        if( IsStopped() )
+            return false;
+        if( path.empty() )
+            path = _path();
+
+        if( IsNativeLockedItem(rc, path, _vfs) ) {
+            switch( m_OnLockedItem(rc, path, _vfs, DeletionType::Permanent) ) {
                 case LockedItemResolution::Unlock: {
-                    if( !DoUnlock(_path, _vfs) )
-                        return;
+                    if( !DoUnlock(path, _vfs) )
+                        return false;
                     continue;
                 }
                 case LockedItemResolution::Retry:
                     continue;
                 case LockedItemResolution::Skip:
                     Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
-                    return;
+                    return false;
                 case LockedItemResolution::Stop:
                     Stop();
-                    return;
+                    return false;
+            }
+        }
+        else if( _is_dir ) {
+            switch( m_OnRmdirError(rc, path, _vfs) ) {
+                case RmdirErrorResolution::Retry:
+                    continue;
+                case RmdirErrorResolution::Skip:
+                    Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
+                    return false;
+                case RmdirErrorResolution::Stop:
+                    Stop();
+                    return false;
             }
         }
         else {
-            switch( m_OnUnlinkError(rc, _path, _vfs) ) {
+            switch( m_OnUnlinkError(rc, path, _vfs) ) {
                 case UnlinkErrorResolution::Retry:
                     continue;
                 case UnlinkErrorResolution::Skip:
                     Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
-                    return;
+                    return false;
                 case UnlinkErrorResolution::Stop:
                     Stop();
-                    return;
+                    return false;
             }
         }
     }
 }
 
-void DeletionJob::DoRmDir(const std::string &_path, VFSHost &_vfs)
+void DeletionJob::DoDeleteNativeTree(const std::string &_path, VFSHost &_vfs)
+{
+    // The tree is walked with the descriptors of its directories: the entries are addressed relative to their parents,
+    // so the kernel doesn't have to resolve full paths over and over again. The files are removed right after their
+    // directory is read and each directory is removed as soon as it becomes empty, while the independent subdirectories
+    // are processed in parallel.
+    const auto span = TraceSpan("Native tree", "deletion", {{"path", _path}});
+    auto root = std::make_shared<NativeDirectory>();
+    root->name = _path;
+
+    NativeTreeWalk walk;
+    walk.queue.emplace_back(root);
+    ++m_NativeDirectoriesQueued;
+    {
+        const auto workers_number = std::clamp(std::thread::hardware_concurrency(), 1u, g_MaxNativeTreeWorkers);
+        const base::DispatchGroup workers;
+        for( unsigned i = 1; i < workers_number; ++i )
+            workers.Run([&] { RunNativeTreeWorker(walk, _vfs); });
+        RunNativeTreeWorker(walk, _vfs);
+        workers.Wait();
+    }
+    m_NativeDirectoriesQueued -= static_cast<int>(walk.queue.size());
+    walk.queue.clear();
+
+    if( IsStopped() )
+        return;
+
+    if( root->incomplete ) {
+        Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
+        return;
+    }
+    root->Close();
+    DoRmDir(_path, _vfs);
+}
+
+void DeletionJob::RunNativeTreeWorker(NativeTreeWalk &_walk, VFSHost &_vfs)
 {
+    auto lock = std::unique_lock{_walk.lock};
     while( true ) {
-        const auto rc = _vfs.RemoveDirectory(_path);
-        if( rc == VFSError::Ok ) {
-            Statistics().CommitProcessed(Statistics::SourceType::Items, 1);
+        // the walk is over when there's nothing queued and nobody can queue anything else
+        _walk.cv.wait(lock, [&] { return !_walk.queue.empty() || _walk.busy == 0; });
+        if( _walk.queue.empty() || IsStopped() )
             break;
+
+        auto dir = std::move(_walk.queue.back());
+        _walk.queue.pop_back();
+        --m_NativeDirectoriesQueued;
+        ++_walk.busy;
+        lock.unlock();
+
+        ProcessNativeDirectory(dir, _walk, _vfs);
+        dir.reset();
+
+        lock.lock();
+        --_walk.busy;
+        _walk.cv.notify_all();
+    }
+    _walk.cv.notify_all();
+}
+
+void DeletionJob::ProcessNativeDirectory(const std::shared_ptr<NativeDirectory> &_dir,
+                                         NativeTreeWalk &_walk,
+                                         VFSHost &_vfs)
+{
+    std::vector<NativeDirEntry> entries;
+    while( true ) {
+        if( BlockIfPaused(); IsStopped() )
+            return;
+
+        const int parent_fd = _dir->parent ? _dir->parent->fd : AT_FDCWD;
+        const int rc = ReadNativeDirectory(parent_fd, _dir->name.c_str(), _dir->fd, entries);
+        if( rc == VFSError::Ok )
+            break;
+
+        const auto lock = std::lock_guard{m_CallbacksLock};
+        if( IsStopped() )
+            return;
+        _dir->Close();
+        entries.clear();
+        const auto resolution = m_OnReadDirError(rc, _dir->Path(), _vfs);
+        if( resolution == ReadDirErrorResolution::Retry )
+            continue;
+        if( resolution == ReadDirErrorResolution::Stop ) {
+            Stop();
+            return;
         }
-        else if( IsNativeLockedItem(rc, _path, _vfs) ) {
-            switch( m_OnLockedItem(rc, _path, _vfs, DeletionType::Permanent) ) {
-                case LockedItemResolution::Unlock: {
-                    if( !DoUnlock(_path, _vfs) )
-                        return;
-                    continue;
-                }
-                case LockedItemResolution::Retry:
-                    continue;
-                case LockedItemResolution::Skip:
-                    Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
-                    return;
-                case LockedItemResolution::Stop:
-                    Stop();
-                    return;
+        break; // skipping the contents, but trying to remove the directory itself anyway
+    }
+
+    for( const auto &entry : entries ) {
+        if( BlockIfPaused(); IsStopped() )
+            return;
+
+        if( entry.type == DT_DIR ) {
+            Statistics().CommitEstimated(Statistics::SourceType::Items, 1);
+            auto subdir = std::make_shared<NativeDirectory>();
+            subdir->parent = _dir;
+            subdir->name = entry.name;
+            ++_dir->pending;
+            {
+                const auto lock = std::lock_guard{_walk.lock};
+                _walk.queue.emplace_back(std::move(subdir));
+                ++m_NativeDirectoriesQueued;
             }
+            _walk.cv.notify_one();
         }
         else {
-            switch( m_OnRmdirError(rc, _path, _vfs) ) {
-                case RmdirErrorResolution::Retry:
-                    continue;
-                case RmdirErrorResolution::Skip:
-                    Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
-                    return;
-                case RmdirErrorResolution::Stop:
-                    Stop();
-                    return;
-            }
+            Statistics().CommitEstimated(Statistics::SourceType::Items, 1);
+            const auto unlink = [&] {
+                if( unlinkat(_dir->fd, entry.name.c_str(), 0) == 0 )
+                    return VFSError::Ok;
+                // an AppleDouble storage file can be removed by the filesystem along with its origin
+                if( errno == ENOENT && entry.type == DT_REG && IsAppleDoubleFilename(entry.name) )
+                    return VFSError::Ok;
+                return VFSError::FromErrno();
+            };
+            if( !DoRemove(unlink, false, [&] { return _dir->Path() + entry.name; }, _vfs) )
+                _dir->incomplete = true;
         }
     }
+
+    if( --_dir->pending == 0 )
+        FinishNativeDirectory(_dir, _vfs);
+}
+
+void DeletionJob::FinishNativeDirectory(std::shared_ptr<NativeDirectory> _dir, VFSHost &_vfs)
+{
+    // removing the empty directory and then going upwards while its ancestors become empty as well,
+    // the root directory is removed by the walk itself
+    while( _dir->parent ) {
+        if( IsStopped() )
+            return;
+
+        _dir->Close();
+        const auto parent = _dir->parent;
+        bool removed = false;
+        if( _dir->incomplete ) {
+            Statistics().CommitSkipped(Statistics::SourceType::Items, 1);
+        }
+        else {
+            const auto rmdir = [&] {
+                return unlinkat(parent->fd, _dir->name.c_str(), AT_REMOVEDIR) == 0 ? VFSError::Ok
+                                                                                   : VFSError::FromErrno();
+            };
+            removed = DoRemove(rmdir, true, [&] { return _dir->Path(); }, _vfs);
+        }
+        if( !removed )
+            parent->incomplete = true;
+        if( --parent->pending != 0 )
+            return;
+        _dir = parent;
+    }
+}
+
+void DeletionJob::NativeDirectory::Close() noexcept
+{
+    if( fd >= 0 ) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+std::string DeletionJob::NativeDirectory::Path() const
+{
+    return parent ? parent->Path() + name + '/' : EnsureTrailingSlash(name);
 }
 
 void DeletionJob::DoTrash(const std::string &_path, VFSHost &_vfs, SourceItem _src)
@@ -302,7 +547,7 @@ void DeletionJob::DoTrash(const std::string &_path, VFSHost &_vfs, SourceItem _s
 
 int DeletionJob::ItemsInScript() const
 {
-    return static_cast<int>(m_Script.size());
+    return static_cast<int>(m_Script.size()) + m_NativeDirectoriesQueued;
 }
 
 bool DeletionJob::IsNativeLockedItem(int vfs_err, const std::string &_path, VFSHost &_vfs)
@@ -321,6 +566,14 @@ bool DeletionJob::IsNativeLockedItem(int vfs_err, const std::string &_path, VFSH
     return st.flags & UF_IMMUTABLE;
 }
 
+bool DeletionJob::IsEligibleForNativeTreeWalk(const VFSListingItem &_item)
+{
+    // the walk bypasses the VFS layer and can't go through the privileged helper, so it's used only with the plain
+    // native host and without the routed I/O
+    const VFSHost &host = *_item.Host();
+    return typeid(host) == typeid(vfs::NativeHost) && !routedio::RoutedIO::Default.isrouted();
+}
+
 int DeletionJob::UnlockItem(const std::string &_path, VFSHost &_vfs)
 {
     // this is kind of stupid to call stat() essentially twice :-|
@@ -348,4 +601,50 @@ static bool IsEAStorage(VFSHost &_host, const std::string &_directory, const cha
     return _host.Exists(origin_file_path);
 }
 
+static bool IsAppleDoubleFilename(std::string_view _filename) noexcept
+{
+    return _filename.size() > 2 && _filename.starts_with("._");
+}
+
+// Opens the directory relative to its parent and reads all its entries at once, since removing the entries while
+// iterating the directory stream can make the stream skip some of them.
+static int ReadNativeDirectory(int _parent_fd, const char *_name, int &_fd, std::vector<NativeDirEntry> &_entries)
+{
+    _fd = openat(_parent_fd, _name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if( _fd < 0 )
+        return VFSError::FromErrno();
+
+    const int stream_fd = dup(_fd);
+    if( stream_fd < 0 )
+        return VFSError::FromErrno();
+
+    DIR *const dir = fdopendir(stream_fd);
+    if( dir == nullptr ) {
+        const int rc = VFSError::FromErrno();
+        close(stream_fd);
+        return rc;
+    }
+
+    while( true ) {
+        errno = 0;
+        const dirent *const entry = readdir(dir);
+        if( entry == nullptr )
+            break;
+        if( entry->d_name[0] == '.' &&
+            (entry->d_name[1] == 0 || (entry->d_name[1] == '.' && entry->d_name[2] == 0)) )
+            continue;
+
+        uint8_t type = entry->d_type;
+        if( type == DT_UNKNOWN ) {
+            struct stat st;
+            if( fstatat(_fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 )
+                type = static_cast<uint8_t>(IFTODT(st.st_mode));
+        }
+        _entries.emplace_back(NativeDirEntry{entry->d_name, type});
+    }
+    const int read_errno = errno;
+    closedir(dir);
+    return read_errno == 0 ? VFSError::Ok : VFSError::FromErrno(read_errno);
+}
+
 } // namespace nc::ops
@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include "../Job.h"
@@ -6,6 +6,10 @@
 #include "DeletionJobCallbacks.h"
 #include <VFS/VFS.h>
 #include <Base/chained_strings.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <stack>
 
 namespace nc::ops {
@@ -13,7 +17,9 @@ namespace nc::ops {
 class DeletionJob final : public Job, public DeletionJobCallbacks
 {
 public:
-    DeletionJob(std::vector<VFSListingItem> _items, DeletionType _type);
+    DeletionJob(std::vector<VFSListingItem> _items,
+                DeletionType _type,
+                DeletionOptions::ProcessingOrder _order = DeletionOptions::ProcessingOrder::Auto);
     ~DeletionJob();
 
     int ItemsInScript() const;
@@ -23,23 +29,42 @@ private:
         int listing_item_index;
         DeletionType type;
         const base::chained_strings::node *filename;
+        uint64_t inode = 0;       // zero if unknown
+        bool native_tree = false; // a native directory which is walked while being deleted instead of being scanned
     };
 
+    struct NativeDirectory;
+    struct NativeTreeWalk;
+
     virtual void Perform() override;
-    void DoScan();
+    void DoScan(bool _walk_native_trees);
+    void OrderScriptByPhysicalLocality();
+    bool ShouldOrderByPhysicalLocality() const;
     void DoDelete();
     void DoRmDir(const std::string &_path, VFSHost &_vfs);
     void DoUnlink(const std::string &_path, VFSHost &_vfs);
+    bool DoRemove(const std::function<int()> &_remove,
+                  bool _is_dir,
+                  const std::function<std::string()> &_path,
+                  VFSHost &_vfs);
+    void DoDeleteNativeTree(const std::string &_path, VFSHost &_vfs);
+    void RunNativeTreeWorker(NativeTreeWalk &_walk, VFSHost &_vfs);
+    void ProcessNativeDirectory(const std::shared_ptr<NativeDirectory> &_dir, NativeTreeWalk &_walk, VFSHost &_vfs);
+    void FinishNativeDirectory(std::shared_ptr<NativeDirectory> _dir, VFSHost &_vfs);
     void DoTrash(const std::string &_path, VFSHost &_vfs, SourceItem _src);
     bool DoUnlock(const std::string &_path, VFSHost &_vfs);
     void ScanDirectory(const std::string &_path, int _listing_item_index, const base::chained_strings::node *_prefix);
     static bool IsNativeLockedItem(int vfs_err, const std::string &_path, VFSHost &_vfs);
+    static bool IsEligibleForNativeTreeWalk(const VFSListingItem &_item);
     static int UnlockItem(const std::string &_path, VFSHost &_vfs);
 
     std::vector<VFSListingItem> m_SourceItems;
     DeletionType m_Type;
+    DeletionOptions::ProcessingOrder m_ProcessingOrder;
     base::chained_strings m_Paths;
     std::stack<SourceItem> m_Script;
+    std::atomic_int m_NativeDirectoriesQueued{0};
+    std::mutex m_CallbacksLock; // the native tree walk runs on several threads, the callbacks are called one at a time
 };
 
 } // namespace nc::ops
@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2021 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 namespace nc::ops {
@@ -16,11 +16,18 @@ struct DeletionOptions {
         Stop,      // abort entire operation
     };
 
+    enum class ProcessingOrder : char {
+        Auto,             // default - order by physical locality only when the items are on rotational media
+        AsScanned,        // delete the items in the order they were scanned
+        PhysicalLocality, // always order the native files by their inode numbers
+    };
+
     DeletionOptions() = default;
     DeletionOptions(DeletionType _type) noexcept;
 
     DeletionType type = DeletionType::Permanent;
     LockedItemBehavior locked_items_behaviour = LockedItemBehavior::Ask;
+    ProcessingOrder processing_order = ProcessingOrder::Auto;
 };
 
 inline DeletionOptions::DeletionOptions(DeletionType _type) noexcept : type(_type)
@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "DirectoryCreation.h"
 #include "../AsyncDialogResponse.h"
 #include "../Internal.h"
@@ -19,6 +19,8 @@ using Callbacks = DirectoryCreationJobCallbacks;
 DirectoryCreation::DirectoryCreation(std::string _directory_name, std::string _root_folder, VFSHost &_vfs)
 {
     m_Directories = Split(_directory_name);
+    if( auto resource = ResolveOperationResource(_vfs, _root_folder) )
+        SetResources({std::move(*resource)});
 
     m_Job = std::make_unique<DirectoryCreationJob>(m_Directories, _root_folder, _vfs.shared_from_this());
     m_Job->m_OnError = [this](int _err, const std::string &_path, VFSHost &_vfs) {
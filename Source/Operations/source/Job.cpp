@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "../include/Operations/Job.h"
 #include <Base/IdleSleepPreventer.h>
 #include <boost/core/demangle.hpp>
@@ -35,6 +35,7 @@ void Job::Execute()
     const auto sleep_preventer = base::IdleSleepPreventer::GetPromise();
     m_Stats.StartTiming();
 
+    auto perform_span = m_Trace ? TraceSpan(boost::core::demangle(typeid(*this).name()), "job") : JobTrace::Span{};
     try {
         Perform();
     } catch( const std::exception &e ) {
@@ -49,6 +50,13 @@ void Job::Execute()
     if( !IsStopped() )
         SetCompleted();
 
+    perform_span.AddArg({"completed", IsCompleted()});
+    perform_span.AddArg({"bytes", m_Stats.VolumeProcessed(Statistics::SourceType::Bytes)});
+    perform_span.AddArg({"items", m_Stats.VolumeProcessed(Statistics::SourceType::Items)});
+    perform_span.End();
+    if( m_Trace )
+        m_Trace->SetStage({});
+
     m_IsRunning = false;
 
     m_Stats.StopTiming();
@@ -152,6 +160,7 @@ void Job::BlockIfPaused()
         std::unique_lock<std::mutex> lock{mutex};
         const auto predicate = [this] { return !m_IsPaused; };
 
+        const auto pause_span = TraceSpan("Paused", "job");
         m_Stats.PauseTiming();
         m_PauseCV.wait(lock, predicate);
         m_Stats.ResumeTiming();
@@ -178,9 +187,51 @@ void Job::SetItemStateReportCallback(ItemStateReportCallback _callback)
 
 void Job::TellItemReport(ItemStateReport _report)
 {
+    if( m_Trace ) {
+        const std::string_view status = _report.status == ItemStatus::Processed ? "processed" : "skipped";
+        m_Trace->Mark("Item", "item", {{"path", _report.path}, {"status", status}});
+    }
     if( m_OnItemStateReport ) {
         m_OnItemStateReport(_report);
     }
 }
 
+void Job::EnableTracing()
+{
+    if( m_IsRunning )
+        throw std::logic_error("Job::EnableTracing should be only called before job start");
+    if( !m_Trace )
+        m_Trace = std::make_unique<JobTrace>();
+}
+
+JobTrace *Job::Trace() noexcept
+{
+    return m_Trace.get();
+}
+
+const JobTrace *Job::Trace() const noexcept
+{
+    return m_Trace.get();
+}
+
+JobTrace::Span
+Job::TraceSpan(std::string_view _name, std::string_view _category, std::initializer_list<JobTrace::Arg> _args) const
+{
+    return JobTrace::Span{m_Trace.get(), _name, _category, _args};
+}
+
+void Job::TraceMark(std::string_view _name,
+                    std::string_view _category,
+                    std::initializer_list<JobTrace::Arg> _args) const
+{
+    if( m_Trace )
+        m_Trace->Mark(_name, _category, _args);
+}
+
+void Job::TraceStage(std::string_view _stage) const
+{
+    if( m_Trace )
+        m_Trace->SetStage(_stage);
+}
+
 } // namespace nc::ops
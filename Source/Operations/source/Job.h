@@ -1,12 +1,14 @@
-// Copyright (C) 2017-2020 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <atomic>
 #include <functional>
 #include <mutex>
+#include <memory>
 #include <Base/spinlock.h>
 #include "Statistics.h"
 #include "ItemStateReport.h"
+#include "JobTrace.h"
 
 namespace nc::ops {
 
@@ -33,6 +35,13 @@ public:
     class Statistics &Statistics();
     const class Statistics &Statistics() const;
 
+    // Turns on recording of a trace of this job, should be only called before the job starts.
+    void EnableTracing();
+
+    // Returns the recorded trace or nullptr if the tracing wasn't enabled.
+    JobTrace *Trace() noexcept;
+    const JobTrace *Trace() const noexcept;
+
 protected:
     Job();
     virtual void Perform();
@@ -43,6 +52,15 @@ protected:
     void BlockIfPaused();
     void TellItemReport(ItemStateReport _report);
 
+    // Tracing facilities for the subclasses, these are no-ops unless the tracing is enabled.
+    JobTrace::Span TraceSpan(std::string_view _name,
+                             std::string_view _category,
+                             std::initializer_list<JobTrace::Arg> _args = {}) const;
+    void TraceMark(std::string_view _name,
+                   std::string_view _category,
+                   std::initializer_list<JobTrace::Arg> _args = {}) const;
+    void TraceStage(std::string_view _stage) const;
+
 private:
     std::atomic_bool m_IsRunning;
     std::atomic_bool m_IsPaused;
@@ -57,6 +75,7 @@ private:
     spinlock m_CallbackLock;
 
     class Statistics m_Stats;
+    std::unique_ptr<JobTrace> m_Trace;
 };
 
 } // namespace nc::ops
@@ -0,0 +1,268 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "JobTrace.h"
+#include <Base/mach_time.h>
+#include <fmt/format.h>
+#include <pthread.h>
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+namespace nc::ops {
+
+static void AppendJSONString(std::string &_json, std::string_view _string)
+{
+    _json += '"';
+    for( const char c : _string ) {
+        switch( c ) {
+            case '"':
+                _json += "\\\"";
+                break;
+            case '\\':
+                _json += "\\\\";
+                break;
+            case '\n':
+                _json += "\\n";
+                break;
+            case '\t':
+                _json += "\\t";
+                break;
+            default:
+                if( static_cast<unsigned char>(c) < 0x20 )
+                    fmt::format_to(std::back_inserter(_json), "\\u{:04x}", static_cast<unsigned>(c));
+                else
+                    _json += c;
+        }
+    }
+    _json += '"';
+}
+
+static void AppendMicroseconds(std::string &_json, std::chrono::nanoseconds _time)
+{
+    fmt::format_to(std::back_inserter(_json), "{:.3f}", static_cast<double>(_time.count()) / 1000.);
+}
+
+JobTrace::Span::Span(JobTrace *_trace,
+                     std::string_view _name,
+                     std::string_view _category,
+                     std::initializer_list<Arg> _args)
+    : m_Trace(_trace)
+{
+    if( m_Trace == nullptr )
+        return;
+    m_Name = _name;
+    m_Category = _category;
+    for( const auto &arg : _args )
+        AppendArg(m_Args, arg);
+    m_Start = base::machtime();
+}
+
+JobTrace::Span::Span(Span &&_rhs) noexcept
+    : m_Trace(std::exchange(_rhs.m_Trace, nullptr)), m_Name(std::move(_rhs.m_Name)),
+      m_Category(std::move(_rhs.m_Category)), m_Args(std::move(_rhs.m_Args)), m_Start(_rhs.m_Start)
+{
+}
+
+JobTrace::Span &JobTrace::Span::operator=(Span &&_rhs) noexcept
+{
+    if( this != &_rhs ) {
+        End();
+        m_Trace = std::exchange(_rhs.m_Trace, nullptr);
+        m_Name = std::move(_rhs.m_Name);
+        m_Category = std::move(_rhs.m_Category);
+        m_Args = std::move(_rhs.m_Args);
+        m_Start = _rhs.m_Start;
+    }
+    return *this;
+}
+
+JobTrace::Span::~Span()
+{
+    End();
+}
+
+void JobTrace::Span::AddArg(const Arg &_arg)
+{
+    if( m_Trace )
+        AppendArg(m_Args, _arg);
+}
+
+void JobTrace::Span::End()
+{
+    if( m_Trace == nullptr )
+        return;
+    m_Trace->Complete(m_Name, m_Category, m_Args, m_Start, base::machtime());
+    m_Trace = nullptr;
+}
+
+JobTrace::JobTrace(size_t _max_events) : m_MaxEvents(_max_events), m_Origin(base::machtime())
+{
+}
+
+JobTrace::~JobTrace() = default;
+
+void JobTrace::AppendArg(std::string &_json_members, const Arg &_arg)
+{
+    if( !_json_members.empty() )
+        _json_members += ',';
+    AppendJSONString(_json_members, _arg.key);
+    _json_members += ':';
+    if( const auto number = std::get_if<int64_t>(&_arg.value) )
+        fmt::format_to(std::back_inserter(_json_members), "{}", *number);
+    else
+        AppendJSONString(_json_members, std::get<std::string_view>(_arg.value));
+}
+
+void JobTrace::Complete(std::string_view _name,
+                        std::string_view _category,
+                        std::string_view _args,
+                        std::chrono::nanoseconds _start,
+                        std::chrono::nanoseconds _end)
+{
+    Event event;
+    event.name = _name;
+    event.category = _category;
+    event.args = _args;
+    event.start = _start;
+    event.duration = _end - _start;
+    event.phase = 'X';
+    Push(std::move(event));
+}
+
+void JobTrace::Mark(std::string_view _name, std::string_view _category, std::initializer_list<Arg> _args)
+{
+    Event event;
+    event.name = _name;
+    event.category = _category;
+    for( const auto &arg : _args )
+        AppendArg(event.args, arg);
+    event.start = base::machtime();
+    event.duration = std::chrono::nanoseconds{0};
+    event.phase = 'i';
+    Push(std::move(event));
+}
+
+void JobTrace::SetStage(std::string_view _stage)
+{
+    const auto now = base::machtime();
+    const auto lock = std::lock_guard{m_Lock};
+    if( !m_Stage.empty() && m_Events.size() < m_MaxEvents ) {
+        Event event;
+        event.name = m_Stage;
+        event.category = "stage";
+        event.start = m_StageStart;
+        event.duration = now - m_StageStart;
+        event.thread = m_StageThread;
+        event.phase = 'X';
+        m_Events.emplace_back(std::move(event));
+    }
+    else if( !m_Stage.empty() ) {
+        ++m_Dropped;
+    }
+    m_Stage = _stage;
+    m_StageStart = now;
+    m_StageThread = ThreadIndex();
+}
+
+void JobTrace::Push(Event _event)
+{
+    const auto lock = std::lock_guard{m_Lock};
+    if( m_Events.size() >= m_MaxEvents ) {
+        ++m_Dropped;
+        return;
+    }
+    _event.thread = ThreadIndex();
+    m_Events.emplace_back(std::move(_event));
+}
+
+uint32_t JobTrace::ThreadIndex()
+{
+    const auto id = std::this_thread::get_id();
+    const auto it = std::ranges::find(m_Threads, id, &std::pair<std::thread::id, std::string>::first);
+    if( it != m_Threads.end() )
+        return static_cast<uint32_t>(std::distance(m_Threads.begin(), it));
+
+    char name[64] = {0};
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+    m_Threads.emplace_back(id, name[0] != 0 ? std::string(name) : fmt::format("Thread #{}", m_Threads.size()));
+    return static_cast<uint32_t>(m_Threads.size() - 1);
+}
+
+size_t JobTrace::EventsCount() const
+{
+    const auto lock = std::lock_guard{m_Lock};
+    return m_Events.size();
+}
+
+size_t JobTrace::DroppedEventsCount() const
+{
+    const auto lock = std::lock_guard{m_Lock};
+    return m_Dropped;
+}
+
+std::string JobTrace::ExportChromeTrace() const
+{
+    const auto now = base::machtime();
+    const auto lock = std::lock_guard{m_Lock};
+
+    std::string json;
+    json.reserve(256 + m_Events.size() * 128);
+    fmt::format_to(std::back_inserter(json),
+                   R"({{"displayTimeUnit":"ms","otherData":{{"dropped_events":{}}},"traceEvents":[)",
+                   m_Dropped);
+    bool first = true;
+    const auto separate = [&] {
+        if( !first )
+            json += ',';
+        first = false;
+    };
+
+    for( size_t i = 0; i != m_Threads.size(); ++i ) {
+        separate();
+        fmt::format_to(
+            std::back_inserter(json), R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":)", i);
+        AppendJSONString(json, m_Threads[i].second);
+        json += "}}";
+    }
+
+    const auto append_event = [&](const Event &_event) {
+        separate();
+        json += R"({"name":)";
+        AppendJSONString(json, _event.name);
+        json += R"(,"cat":)";
+        AppendJSONString(json, _event.category);
+        fmt::format_to(std::back_inserter(json), R"(,"ph":"{}","pid":1,"tid":{},"ts":)", _event.phase, _event.thread);
+        AppendMicroseconds(json, _event.start - m_Origin);
+        if( _event.phase == 'X' ) {
+            json += R"(,"dur":)";
+            AppendMicroseconds(json, _event.duration);
+        }
+        else {
+            json += R"(,"s":"t")";
+        }
+        if( !_event.args.empty() ) {
+            json += R"(,"args":{)";
+            json += _event.args;
+            json += '}';
+        }
+        json += '}';
+    };
+    for( const auto &event : m_Events )
+        append_event(event);
+
+    // the current stage is still open, show it as lasting until now
+    if( !m_Stage.empty() ) {
+        Event event;
+        event.name = m_Stage;
+        event.category = "stage";
+        event.start = m_StageStart;
+        event.duration = now - m_StageStart;
+        event.thread = m_StageThread;
+        event.phase = 'X';
+        append_event(event);
+    }
+
+    json += "]}";
+    return json;
+}
+
+} // namespace nc::ops
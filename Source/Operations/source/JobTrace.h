@@ -0,0 +1,107 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace nc::ops {
+
+// Records a timeline of what a job was doing: its stages, processed items, I/O milestones, pauses and waits for the
+// user's decisions. The recorded trace is exported in the Chrome trace event format, which can be opened by
+// chrome://tracing or ui.perfetto.dev for a post-mortem performance analysis.
+// All methods are thread-safe.
+class JobTrace
+{
+public:
+    struct Arg {
+        Arg(std::string_view _key, std::string_view _value) noexcept : key(_key), value(_value) {}
+        Arg(std::string_view _key, std::integral auto _value) noexcept : key(_key), value(static_cast<int64_t>(_value))
+        {
+        }
+        std::string_view key;
+        std::variant<int64_t, std::string_view> value;
+    };
+
+    // An RAII scope which records a complete event spanning its lifetime, does nothing if constructed without a trace.
+    class Span
+    {
+    public:
+        Span() noexcept = default;
+        Span(JobTrace *_trace,
+             std::string_view _name,
+             std::string_view _category,
+             std::initializer_list<Arg> _args = {});
+        Span(Span &&_rhs) noexcept;
+        Span &operator=(Span &&_rhs) noexcept;
+        ~Span();
+
+        void AddArg(const Arg &_arg);
+        void End();
+
+    private:
+        JobTrace *m_Trace = nullptr;
+        std::string m_Name;
+        std::string m_Category;
+        std::string m_Args;
+        std::chrono::nanoseconds m_Start{0};
+    };
+
+    // A trace keeps at most _max_events events, the ones past the limit are dropped and counted.
+    JobTrace(size_t _max_events = 1'000'000);
+    JobTrace(const JobTrace &) = delete;
+    ~JobTrace();
+    JobTrace &operator=(const JobTrace &) = delete;
+
+    // Records an instant event on the current thread.
+    void Mark(std::string_view _name, std::string_view _category, std::initializer_list<Arg> _args = {});
+
+    // Closes the span of the previous stage, if any, and opens a span of a new one.
+    // An empty _stage only closes the previous stage.
+    void SetStage(std::string_view _stage);
+
+    size_t EventsCount() const;
+    size_t DroppedEventsCount() const;
+
+    // Composes a JSON object with the recorded events in the Chrome trace event format.
+    std::string ExportChromeTrace() const;
+
+private:
+    struct Event {
+        std::string name;
+        std::string category;
+        std::string args; // comma-separated JSON members
+        std::chrono::nanoseconds start;
+        std::chrono::nanoseconds duration;
+        uint32_t thread;
+        char phase;
+    };
+
+    static void AppendArg(std::string &_json_members, const Arg &_arg);
+    void Complete(std::string_view _name,
+                  std::string_view _category,
+                  std::string_view _args,
+                  std::chrono::nanoseconds _start,
+                  std::chrono::nanoseconds _end);
+    void Push(Event _event);
+    uint32_t ThreadIndex(); // must be called with m_Lock held
+
+    const size_t m_MaxEvents;
+    const std::chrono::nanoseconds m_Origin;
+    mutable std::mutex m_Lock;
+    std::vector<Event> m_Events;
+    size_t m_Dropped = 0;
+    std::vector<std::pair<std::thread::id, std::string>> m_Threads; // index in this vector is the thread number
+    std::string m_Stage;
+    std::chrono::nanoseconds m_StageStart{0};
+    uint32_t m_StageThread = 0;
+};
+
+} // namespace nc::ops
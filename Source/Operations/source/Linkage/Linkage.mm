@@ -1,4 +1,5 @@
 // Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include <filesystem>
 #include <memory>
 
 #include "Linkage.h"
@@ -16,6 +17,9 @@ Linkage::Linkage(const std::string &_link_path,
                  const std::shared_ptr<VFSHost> &_vfs,
                  LinkageType _type)
 {
+    if( auto resource = ResolveOperationResource(*_vfs, std::filesystem::path(_link_path).parent_path().native()) )
+        SetResources({std::move(*resource)});
+
     m_Job = std::make_unique<LinkageJob>(_link_path, _link_value, _vfs, _type);
     m_Job->m_OnCreateSymlinkError = [this](int _err, const std::string &_path, VFSHost &_vfs) {
         OnCreateSymlinkError(_err, _path, _vfs);
@@ -1,4 +1,4 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <Base/ScopedObservable.h>
@@ -6,6 +6,7 @@
 #include <string_view>
 
 #include "ItemStateReport.h"
+#include "OperationResource.h"
 
 #ifdef __OBJC__
 @class NSWindow;
@@ -50,6 +51,15 @@ public:
     OperationState State() const;
     const class Statistics &Statistics() const;
 
+    // Devices which this operation does its I/O against, used by a pool to limit the concurrency per device.
+    std::vector<OperationResource> Resources() const;
+
+    // Turns on recording of a trace of the underlying job, should be called before the operation starts.
+    void EnableTracing();
+
+    // Returns the recorded trace in the Chrome trace event format or an empty string if the tracing wasn't enabled.
+    std::string ExportTrace() const;
+
     void Wait() const;
     bool Wait(std::chrono::nanoseconds _wait_for_time) const;
 
@@ -100,6 +110,8 @@ protected:
     void WaitForDialogResponse(std::shared_ptr<AsyncDialogResponse> _response);
     void ReportHaltReason(NSString *_message, int _error, const std::string &_path, VFSHost &_vfs);
     void SetTitle(std::string _title);
+    // Should be called before the operation is enqueued into a pool, duplicates are removed.
+    void SetResources(std::vector<OperationResource> _resources);
 
 private:
     Operation(const Operation &) = delete;
@@ -119,6 +131,9 @@ private:
 
     std::string m_Title;
     mutable spinlock m_TitleLock;
+
+    std::vector<OperationResource> m_Resources;
+    mutable spinlock m_ResourcesLock;
 };
 
 } // namespace nc::ops
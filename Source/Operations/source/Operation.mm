@@ -8,6 +8,7 @@
 #include "GenericErrorDialog.h"
 #include "Statistics.h"
 #include "Internal.h"
+#include <algorithm>
 #include <iostream>
 #include <Base/dispatch_cpp.h>
 
@@ -253,6 +254,42 @@ void Operation::ShowGenericDialog(GenericDialog _dialog_type,
     Show(sheet.window, _ctx);
 }
 
+static std::string_view DialogResponseName(long _response) noexcept
+{
+    switch( _response ) {
+        case NSModalResponseOK:
+            return "OK";
+        case NSModalResponseCancel:
+            return "Cancel";
+        case NSModalResponseStop:
+            return "Stop";
+        case NSModalResponseAbort:
+            return "Abort";
+        case NSModalResponseContinue:
+            return "Continue";
+        case NSModalResponseSkip:
+            return "Skip";
+        case NSModalResponseSkipAll:
+            return "SkipAll";
+        case NSModalResponseDeletePermanently:
+            return "DeletePermanently";
+        case NSModalResponseOverwrite:
+            return "Overwrite";
+        case NSModalResponseOverwriteOld:
+            return "OverwriteOld";
+        case NSModalResponseAppend:
+            return "Append";
+        case NSModalResponseRetry:
+            return "Retry";
+        case NSModalResponseKeepBoth:
+            return "KeepBoth";
+        case NSModalResponseUnlock:
+            return "Unlock";
+        default:
+            return "Other";
+    }
+}
+
 void Operation::WaitForDialogResponse(std::shared_ptr<AsyncDialogResponse> _response)
 {
     dispatch_assert_background_queue();
@@ -260,6 +297,7 @@ void Operation::WaitForDialogResponse(std::shared_ptr<AsyncDialogResponse> _resp
         return;
 
     const StatisticsTimingPauser timing_pauser{GetJob()->Statistics()};
+    auto wait_span = JobTrace::Span{GetJob()->Trace(), "Waiting for a dialog response", "dialog"};
 
     {
         const auto guard = std::lock_guard{m_PendingResponseLock};
@@ -268,6 +306,7 @@ void Operation::WaitForDialogResponse(std::shared_ptr<AsyncDialogResponse> _resp
 
     _response->Wait();
     assert(_response->response);
+    wait_span.AddArg({"response", DialogResponseName(_response->response.value_or(NSModalResponseAbort))});
 
     {
         const auto guard = std::lock_guard{m_PendingResponseLock};
@@ -324,6 +363,35 @@ void Operation::SetTitle(std::string _title)
     FireObservers(NotifyAboutTitleChange);
 }
 
+std::vector<OperationResource> Operation::Resources() const
+{
+    const auto guard = std::lock_guard{m_ResourcesLock};
+    return m_Resources;
+}
+
+void Operation::SetResources(std::vector<OperationResource> _resources)
+{
+    std::ranges::sort(_resources);
+    const auto duplicates = std::ranges::unique(_resources);
+    _resources.erase(duplicates.begin(), duplicates.end());
+
+    const auto guard = std::lock_guard{m_ResourcesLock};
+    m_Resources = std::move(_resources);
+}
+
+void Operation::EnableTracing()
+{
+    if( auto job = GetJob() )
+        job->EnableTracing();
+}
+
+std::string Operation::ExportTrace() const
+{
+    if( auto job = GetJob(); job && job->Trace() )
+        return job->Trace()->ExportChromeTrace();
+    return {};
+}
+
 void Operation::SetItemStatusCallback(ItemStateReportCallback _callback)
 {
     if( auto job = GetJob() ) {
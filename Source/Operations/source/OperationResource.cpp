@@ -0,0 +1,106 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "OperationResource.h"
+#include <Utility/NativeFSManager.h>
+#include <VFS/Native.h>
+#include <algorithm>
+#include <cctype>
+
+namespace nc::ops {
+
+// "/dev/disk3s1s1" -> "disk3", i.e. the whole disk which the slices of the same physical device share.
+// Any other kind of a mount source, e.g. "//user@server/share", is returned as-is.
+static std::string WholeDiskName(std::string_view _mounted_from)
+{
+    constexpr std::string_view dev_prefix = "/dev/";
+    constexpr std::string_view disk_prefix = "disk";
+    if( !_mounted_from.starts_with(dev_prefix) )
+        return std::string(_mounted_from);
+
+    const auto bsd_name = _mounted_from.substr(dev_prefix.length());
+    if( !bsd_name.starts_with(disk_prefix) )
+        return std::string(bsd_name);
+
+    const auto digits_end = std::find_if_not(bsd_name.begin() + disk_prefix.length(), bsd_name.end(), [](char _c) {
+        return std::isdigit(static_cast<unsigned char>(_c));
+    });
+    return std::string(bsd_name.begin(), digits_end);
+}
+
+static std::optional<OperationResource> ResolveNativeResource(const vfs::NativeHost &_host, std::string_view _path)
+{
+    const auto &fs_man = _host.NativeFSManager();
+    auto volume = fs_man.VolumeFromPath(_path);
+    if( !volume )
+        volume = fs_man.VolumeFromPathFast(_path); // the path might not exist yet, e.g. a destination of copying
+    if( !volume )
+        return std::nullopt;
+
+    OperationResource resource;
+    resource.device = WholeDiskName(volume->mounted_from_name);
+    if( !volume->mount_flags.local )
+        resource.kind = OperationResource::Kind::Remote;
+    else if( volume->mount_flags.rotational )
+        resource.kind = OperationResource::Kind::Rotational;
+    else
+        resource.kind = OperationResource::Kind::SolidState;
+    return resource;
+}
+
+std::optional<OperationResource> ResolveOperationResource(const VFSHost &_host, std::string_view _path)
+{
+    if( _host.IsNativeFS() )
+        return ResolveNativeResource(dynamic_cast<const vfs::NativeHost &>(_host), _path);
+
+    if( const auto &parent = _host.Parent() )
+        return ResolveOperationResource(*parent, _host.JunctionPath());
+
+    // a root non-native VFS with a junction is some kind of a server
+    if( _host.JunctionPath().empty() )
+        return std::nullopt;
+
+    OperationResource resource;
+    resource.kind = OperationResource::Kind::Remote;
+    resource.device = std::string(_host.Tag()) + ":" + std::string(_host.JunctionPath());
+    return resource;
+}
+
+std::vector<OperationResource> ResolveOperationResources(std::span<const VFSListingItem> _items)
+{
+    std::vector<OperationResource> resources;
+    const VFSHost *last_host = nullptr;
+    const std::string *last_directory = nullptr;
+    for( const auto &item : _items ) {
+        // items usually come from the same directory, don't bother resolving it over and over again
+        if( last_host == item.Host().get() && *last_directory == item.Directory() )
+            continue;
+        last_host = item.Host().get();
+        last_directory = &item.Directory();
+
+        if( auto resource = ResolveOperationResource(*item.Host(), item.Directory()) )
+            resources.emplace_back(std::move(*resource));
+    }
+    std::ranges::sort(resources);
+    const auto duplicates = std::ranges::unique(resources);
+    resources.erase(duplicates.begin(), duplicates.end());
+    return resources;
+}
+
+bool IsOnRotationalMedia(std::span<const VFSListingItem> _items)
+{
+    const std::string *last_checked_directory = nullptr;
+    for( const auto &item : _items ) {
+        if( !item.Host()->IsNativeFS() )
+            continue;
+        if( last_checked_directory && *last_checked_directory == item.Directory() )
+            continue;
+        last_checked_directory = &item.Directory();
+
+        const auto &host = dynamic_cast<const vfs::NativeHost &>(*item.Host());
+        const auto resource = ResolveNativeResource(host, item.Directory());
+        if( resource && resource->kind == OperationResource::Kind::Rotational )
+            return true;
+    }
+    return false;
+}
+
+} // namespace nc::ops
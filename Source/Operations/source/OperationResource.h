@@ -0,0 +1,42 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <VFS/VFS.h>
+#include <compare>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace nc::ops {
+
+// A device which an operation does its I/O against - either a local storage device or a remote server.
+// Operations declare the resources they touch, so that the pool can limit how many of them hit the same device at the
+// same time while letting the independent ones run in parallel.
+struct OperationResource {
+    enum class Kind : unsigned char {
+        Rotational = 0, // a local hard disk drive or an optical drive
+        SolidState = 1, // any other local storage device
+        Remote = 2      // a network server, either mounted natively or accessed via a VFS
+    };
+
+    Kind kind = Kind::SolidState;
+    std::string device; // an identifier of the device, e.g. "disk3" or "ftp:ftp.example.com"
+
+    auto operator<=>(const OperationResource &) const = default;
+};
+
+// Figures out which device the I/O against _path on _host would go to.
+// Archives and other nested VFSes are resolved to the device of their parents.
+// Returns nullopt if there's no physical device behind the host, e.g. for the processes list.
+std::optional<OperationResource> ResolveOperationResource(const VFSHost &_host, std::string_view _path);
+
+// Resolves the resources behind the directories of the items, without duplicates.
+std::vector<OperationResource> ResolveOperationResources(std::span<const VFSListingItem> _items);
+
+// Tells whether any of the native items resides on a rotational device, where processing them in the order of their
+// physical locality pays off.
+bool IsOnRotationalMedia(std::span<const VFSListingItem> _items);
+
+} // namespace nc::ops
@@ -1,9 +1,11 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include "Operation.h"
 #include <Cocoa/Cocoa.h>
+#include <array>
 #include <deque>
+#include <filesystem>
 
 namespace nc::ops {
 
@@ -42,6 +44,13 @@ public:
     // By default all operation are assumed to be queued and obey the concurrency limits.
     // A client can customise this behaviour and decide it on a per-operation level.
     void SetEnqueuingCallback(std::function<bool(const Operation &_operation)> _should_be_queued);
+    // Limits of operations running at the same time against a single device of a particular kind, e.g. one per HDD.
+    // These are applied on top of the overall concurrency limit to the queued operations which declare their resources.
+    int ResourceConcurrency(OperationResource::Kind _kind) const;
+    void SetResourceConcurrency(OperationResource::Kind _kind, int _maximum_current_operations);
+    // When set, the operations enqueued afterwards record traces of their jobs, which are saved into this directory
+    // once the operations finish. An empty path turns the tracing off.
+    void SetTracesDirectory(std::filesystem::path _directory);
 
     bool IsInteractive() const;
     void SetDialogCallback(std::function<void(NSWindow *, std::function<void(NSModalResponse)>)> _callback);
@@ -54,11 +63,15 @@ private:
     void OperationDidFinish(const std::shared_ptr<Operation> &_operation);
     bool ShowDialog(NSWindow *_dialog, std::function<void(NSModalResponse)> _callback);
     void StartPendingOperations();
+    void SaveTrace(const Operation &_operation) const;
+    std::vector<std::shared_ptr<Operation>> GatherAdmissibleOperations();
 
     std::vector<std::shared_ptr<Operation>> m_RunningOperations;
     std::deque<std::shared_ptr<Operation>> m_PendingOperations;
     mutable std::mutex m_Lock;
     std::atomic_int m_Concurrency{5};
+    std::array<int, 3> m_ResourceConcurrency{1, 4, 2}; // indexed by OperationResource::Kind, guarded by m_Lock
+    std::filesystem::path m_TracesDirectory; // guarded by m_Lock
 
     std::function<bool(const Operation &_operation)> m_ShouldBeQueuedCallback;
 
@@ -1,8 +1,16 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "Pool.h"
 #include "Operation.h"
 #include <Base/dispatch_cpp.h>
+#include <fmt/chrono.h>
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include <thread>
+#include <unistd.h>
 
 namespace nc::ops {
 
@@ -50,6 +58,8 @@ void Pool::Enqueue(std::shared_ptr<Operation> _operation)
 
     {
         const auto guard = std::lock_guard{m_Lock};
+        if( !m_TracesDirectory.empty() )
+            _operation->EnableTracing();
         m_PendingOperations.push_back(_operation);
     }
 
@@ -71,10 +81,57 @@ void Pool::OperationDidFinish([[maybe_unused]] const std::shared_ptr<Operation>
     FireObservers(NotifyAboutRemoval);
     StartPendingOperations();
 
+    SaveTrace(*_operation);
+
     if( _operation->State() == OperationState::Completed && m_OperationCompletionCallback )
         m_OperationCompletionCallback(_operation);
 }
 
+// Cuts the string to at most _max_bytes without splitting a UTF-8 sequence.
+static std::string_view TruncateUTF8(std::string_view _string, size_t _max_bytes) noexcept
+{
+    if( _string.size() <= _max_bytes )
+        return _string;
+    size_t length = _max_bytes;
+    while( length > 0 && (static_cast<unsigned char>(_string[length]) & 0xC0) == 0x80 )
+        --length; // the first byte left out continues a sequence, which has to be left out as a whole
+    return _string.substr(0, length);
+}
+
+void Pool::SaveTrace(const Operation &_operation) const
+{
+    auto directory = std::filesystem::path{};
+    {
+        const auto guard = std::lock_guard{m_Lock};
+        directory = m_TracesDirectory;
+    }
+    if( directory.empty() )
+        return;
+
+    const auto trace = _operation.ExportTrace();
+    if( trace.empty() )
+        return;
+
+    // the pid and the counter keep apart the traces of same-titled operations finished within the same second
+    static std::atomic_uint64_t traces_saved{0};
+    auto title = std::string(TruncateUTF8(_operation.Title(), 64));
+    std::ranges::replace_if(title, [](char _c) { return _c == '/' || _c == ':'; }, '_');
+    const auto filename = fmt::format("{:%Y-%m-%d %H.%M.%S} {} ({}-{}).json",
+                                      fmt::localtime(std::time(nullptr)),
+                                      title,
+                                      getpid(),
+                                      ++traces_saved);
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    std::ofstream file(directory / filename, std::ios::binary);
+    if( !file ) {
+        std::cerr << "Pool: failed to save an operation trace into " << directory << '\n';
+        return;
+    }
+    file << trace;
+}
+
 void Pool::StartPendingOperations()
 {
     std::vector<std::shared_ptr<Operation>> to_start;
@@ -96,15 +153,7 @@ void Pool::StartPendingOperations()
     // 2nd - gather any other operations until the pool has enough running operations
     {
         const auto guard = std::lock_guard{m_Lock};
-        const auto running_now = static_cast<int>(m_RunningOperations.size());
-        auto gathered = 0;
-        while( running_now + gathered < m_Concurrency && !m_PendingOperations.empty() ) {
-            const auto op = m_PendingOperations.front();
-            m_PendingOperations.pop_front();
-            to_start.emplace_back(op);
-            m_RunningOperations.emplace_back(op);
-            ++gathered;
-        }
+        std::ranges::move(GatherAdmissibleOperations(), std::back_inserter(to_start));
     }
 
     // now kickstart all these operations
@@ -112,6 +161,41 @@ void Pool::StartPendingOperations()
         op->Start();
 }
 
+std::vector<std::shared_ptr<Operation>> Pool::GatherAdmissibleOperations()
+{
+    // how many running operations are using each resource now
+    std::vector<std::pair<OperationResource, int>> busy_resources;
+    const auto busy = [&](const OperationResource &_resource) -> int & {
+        const auto it = std::ranges::find(busy_resources, _resource, &std::pair<OperationResource, int>::first);
+        return it != busy_resources.end() ? it->second : busy_resources.emplace_back(_resource, 0).second;
+    };
+    for( const auto &operation : m_RunningOperations )
+        for( const auto &resource : operation->Resources() )
+            ++busy(resource);
+
+    // go through the queue in order, but let through an operation which doesn't contend for a saturated device even
+    // if some operation before it has to wait
+    std::vector<std::shared_ptr<Operation>> admitted;
+    auto running_now = static_cast<int>(m_RunningOperations.size());
+    for( auto it = m_PendingOperations.begin(); it != m_PendingOperations.end() && running_now < m_Concurrency; ) {
+        const auto resources = (*it)->Resources();
+        const auto fits = [&](const OperationResource &_resource) {
+            return busy(_resource) < m_ResourceConcurrency[static_cast<size_t>(_resource.kind)];
+        };
+        if( !std::ranges::all_of(resources, fits) ) {
+            ++it;
+            continue;
+        }
+        for( const auto &resource : resources )
+            ++busy(resource);
+        admitted.emplace_back(*it);
+        m_RunningOperations.emplace_back(*it);
+        it = m_PendingOperations.erase(it);
+        ++running_now;
+    }
+    return admitted;
+}
+
 Pool::ObservationTicket Pool::Observe(uint64_t _notification_mask, std::function<void()> _callback)
 {
     return AddTicketedObserver(std::move(_callback), _notification_mask);
@@ -182,6 +266,24 @@ void Pool::SetConcurrency(int _maximum_current_operations)
     m_Concurrency = std::max(_maximum_current_operations, 1);
 }
 
+int Pool::ResourceConcurrency(OperationResource::Kind _kind) const
+{
+    const auto guard = std::lock_guard{m_Lock};
+    return m_ResourceConcurrency.at(static_cast<size_t>(_kind));
+}
+
+void Pool::SetResourceConcurrency(OperationResource::Kind _kind, int _maximum_current_operations)
+{
+    const auto guard = std::lock_guard{m_Lock};
+    m_ResourceConcurrency.at(static_cast<size_t>(_kind)) = std::max(_maximum_current_operations, 1);
+}
+
+void Pool::SetTracesDirectory(std::filesystem::path _directory)
+{
+    const auto guard = std::lock_guard{m_Lock};
+    m_TracesDirectory = std::move(_directory);
+}
+
 void Pool::SetEnqueuingCallback(std::function<bool(const Operation &_operation)> _should_be_queued)
 {
     assert(Empty());
@@ -1,11 +1,21 @@
-// Copyright (C) 2017-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "Progress.h"
 #include <iostream>
+#include <algorithm>
 #include <Base/mach_time.h>
 
 namespace nc::ops {
 
-Progress::Progress() : m_Estimated{0}, m_Processed{0}, m_BaseTimePoint{0}, m_LastCommitTimePoint{0}
+static constexpr uint64_t N = Progress::TimelineLevelSamples;
+
+static std::chrono::nanoseconds PeriodStart(std::chrono::nanoseconds _resolution, uint64_t _period) noexcept
+{
+    return _resolution * static_cast<int64_t>(_period);
+}
+
+Progress::Progress()
+    : m_Estimated{0}, m_Processed{0}, m_BaseTimePoint{std::chrono::nanoseconds{0}},
+      m_LastCommitElapsed{std::chrono::nanoseconds{0}}
 {
 }
 
@@ -31,75 +41,181 @@ void Progress::CommitSkipped(uint64_t _delta)
 
 void Progress::CommitProcessed(uint64_t _delta)
 {
-    const auto current_time = base::machtime();
-    m_TimepointsLock.lock();
-    const auto delta_time = current_time - m_LastCommitTimePoint;
-    m_LastCommitTimePoint = current_time;
+    CommitProcessed(_delta, base::machtime());
+}
+
+void Progress::CommitProcessed(uint64_t _delta, std::chrono::nanoseconds _time_point)
+{
     m_Processed += _delta;
-    m_TimepointsLock.unlock();
-
-    const auto fp_bytes = double(_delta);
-    const auto fp_delta_time = static_cast<double>(delta_time.count()) / 1000000000.;
-    auto fp_left_delta_time = fp_delta_time;
-    if( !m_Timeline.empty() && m_Timeline.back().fraction < 1. ) {
-        auto &last = m_Timeline.back();
-        const auto dt = std::min(1. - last.fraction, fp_left_delta_time);
-        const auto db = fp_bytes * dt / fp_delta_time;
-        last.value = static_cast<float>(last.value + db);
-        last.fraction = static_cast<float>(last.fraction + dt);
-        fp_left_delta_time -= dt;
+
+    // The flag and the volume are accessed sequentially consistent: either the recorder sees the volume committed by
+    // a thread which has failed to get the flag, or that thread gets the flag after the recorder has released it.
+    while( true ) {
+        if( m_Recording.test_and_set() )
+            return; // someone else is recording right now, the volume will be picked up by them
+
+        // the processed volume is read under the flag so that the recorded one never goes backwards
+        const auto elapsed = std::max(_time_point - m_BaseTimePoint.load(), m_RecordedElapsed);
+        Record(m_Processed.load(), elapsed);
+        const uint64_t recorded = m_RecordedProcessed;
+
+        m_Recording.clear();
+        if( m_Processed.load() == recorded )
+            return;
     }
+}
+
+void Progress::Record(uint64_t _processed, std::chrono::nanoseconds _elapsed) noexcept
+{
+    for( size_t level = 0; level != TimelineLevels; ++level )
+        Record(m_Timeline[level],
+               TimelineResolution(level),
+               m_RecordedProcessed,
+               m_RecordedElapsed,
+               _processed,
+               _elapsed);
+    m_RecordedProcessed = _processed;
+    m_RecordedElapsed = _elapsed;
+    m_LastCommitElapsed = _elapsed;
+}
 
-    while( fp_left_delta_time > 0. ) {
-        const auto dt = std::min(1., fp_left_delta_time);
-        const auto db = fp_bytes * dt / fp_delta_time;
-        fp_left_delta_time -= dt;
-        TimePoint sp;
-        sp.value = static_cast<float>(db);
-        sp.fraction = static_cast<float>(dt);
-        m_Timeline.emplace_back(sp);
+void Progress::Record(Level &_level,
+                      std::chrono::nanoseconds _resolution,
+                      uint64_t _prev_processed,
+                      std::chrono::nanoseconds _prev_elapsed,
+                      uint64_t _processed,
+                      std::chrono::nanoseconds _elapsed) noexcept
+{
+    const uint64_t period = _elapsed / _resolution;
+    const uint64_t head = _level.head.load(std::memory_order_relaxed);
+    if( period <= head ) {
+        // still in the same period, just update its volume - readers are fine with either the old or the new value
+        _level.volumes[head % N].store(_processed, std::memory_order_relaxed);
+        return;
+    }
+
+    // the periods since the last commit get the volume in proportion to their time, as if it was processed evenly
+    const auto volume_at = [&](std::chrono::nanoseconds _time) -> uint64_t {
+        if( _time <= _prev_elapsed )
+            return _prev_processed;
+        const auto dt = static_cast<double>((_elapsed - _prev_elapsed).count());
+        const auto t = static_cast<double>((_time - _prev_elapsed).count());
+        return _prev_processed + static_cast<uint64_t>(static_cast<double>(_processed - _prev_processed) * t / dt);
+    };
+
+    const uint64_t sequence = _level.sequence.load(std::memory_order_relaxed);
+    _level.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // only the last N periods survive, no need to write the ones which would be overwritten immediately
+    for( uint64_t p = std::max(head, period >= N ? period - N + 1 : 0); p < period; ++p )
+        _level.volumes[p % N].store(volume_at(PeriodStart(_resolution, p + 1)), std::memory_order_relaxed);
+    _level.volumes[period % N].store(_processed, std::memory_order_relaxed);
+    _level.head.store(period, std::memory_order_relaxed);
+
+    _level.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+Progress::LevelSnapshot Progress::Snapshot(const Level &_level) noexcept
+{
+    LevelSnapshot snapshot;
+    while( true ) {
+        const uint64_t sequence = _level.sequence.load(std::memory_order_acquire);
+        if( sequence % 2 != 0 )
+            continue;
+        snapshot.head = _level.head.load(std::memory_order_relaxed);
+        for( size_t i = 0; i != N; ++i )
+            snapshot.volumes[i] = _level.volumes[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if( _level.sequence.load(std::memory_order_relaxed) == sequence )
+            return snapshot;
     }
 }
 
 void Progress::ReportSleptDelta(std::chrono::nanoseconds _delta)
 {
-    auto lock = std::lock_guard{m_TimepointsLock};
-    m_LastCommitTimePoint += _delta;
-    m_BaseTimePoint += _delta;
+    while( m_Recording.test_and_set(std::memory_order_acquire) )
+        ;
+    m_BaseTimePoint = m_BaseTimePoint.load() + _delta;
+    m_Recording.clear(std::memory_order_release);
 }
 
 void Progress::SetupTiming()
 {
-    auto lock = std::lock_guard{m_TimepointsLock};
-    m_BaseTimePoint = base::machtime();
-    m_LastCommitTimePoint = m_BaseTimePoint;
+    SetupTiming(base::machtime());
+}
+
+void Progress::SetupTiming(std::chrono::nanoseconds _time_point)
+{
+    while( m_Recording.test_and_set(std::memory_order_acquire) )
+        ;
+    for( auto &level : m_Timeline ) {
+        const uint64_t sequence = level.sequence.load(std::memory_order_relaxed);
+        level.sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for( auto &volume : level.volumes )
+            volume.store(0, std::memory_order_relaxed);
+        level.head.store(0, std::memory_order_relaxed);
+        level.sequence.store(sequence + 2, std::memory_order_release);
+    }
+    m_RecordedProcessed = 0;
+    m_RecordedElapsed = {};
+    m_LastCommitElapsed = std::chrono::nanoseconds{0};
+    m_BaseTimePoint = _time_point;
+    m_Recording.clear(std::memory_order_release);
+}
+
+std::chrono::nanoseconds Progress::TimelineResolution(size_t _level) noexcept
+{
+    std::chrono::nanoseconds resolution = std::chrono::seconds{1};
+    for( size_t i = 0; i < _level; ++i )
+        resolution *= TimelineDecimation;
+    return resolution;
 }
 
 double Progress::VolumePerSecondDirect() const noexcept
 {
     if( m_Processed == 0 )
         return 0.;
-    auto lock = std::lock_guard{m_TimepointsLock};
-    const auto dt = m_LastCommitTimePoint - m_BaseTimePoint;
-    if( dt.count() == 0 )
+    const auto dt = m_LastCommitElapsed.load();
+    if( dt.count() <= 0 )
         return 0;
     return double(m_Processed) / (double(dt.count()) / 1000000000.);
 }
 
 double Progress::VolumePerSecondAverage() const noexcept
 {
+    // The speed is averaged over the samples which cover at least half of their period.
+    // The recent history is taken from the finest level, while the older history which has already gone out of it is
+    // taken from the coarser levels. Each sample is weighted by the time it covers.
     const auto min_fraction = 0.5;
-    double vps = 0;
-    int n = 0;
-    for( auto &v : m_Timeline )
-        if( v.fraction >= min_fraction ) {
-            vps += (v.value / v.fraction);
-            n++;
+    const auto last_elapsed = m_LastCommitElapsed.load();
+    auto covered_since = std::chrono::nanoseconds::max();
+    double volume = 0.;
+    double time = 0.;
+    for( size_t level = 0; level != TimelineLevels; ++level ) {
+        const auto resolution = TimelineResolution(level);
+        const auto snapshot = Snapshot(m_Timeline[level]);
+        const uint64_t first = snapshot.head < N ? 0 : snapshot.head - N + 2; // the oldest one with a known start
+        auto level_covered_since = covered_since;
+        for( uint64_t p = snapshot.head + 1; p-- > first; ) {
+            const auto start = PeriodStart(resolution, p);
+            if( PeriodStart(resolution, p + 1) > covered_since )
+                continue; // this period is already covered by a finer level
+            const auto duration = std::min(PeriodStart(resolution, p + 1), last_elapsed) - start;
+            if( double(duration.count()) < double(resolution.count()) * min_fraction )
+                continue;
+            const auto end_volume = snapshot.volumes[p % N];
+            const auto start_volume = p == 0 ? 0 : snapshot.volumes[(p - 1) % N];
+            volume += double(end_volume - start_volume);
+            time += double(duration.count()) / 1000000000.;
+            level_covered_since = std::min(level_covered_since, start);
         }
-    if( !n )
+        covered_since = level_covered_since;
+    }
+    if( time == 0. )
         return 0.;
-    vps /= n;
-    return vps;
+    return volume / time;
 }
 
 double Progress::DoneFraction() const noexcept
@@ -122,9 +238,29 @@ std::optional<std::chrono::nanoseconds> Progress::ETA() const noexcept
     return std::chrono::nanoseconds{static_cast<long long>(eta * 1000000000.)};
 }
 
-const std::vector<Progress::TimePoint> &Progress::Data() const
+std::vector<Progress::TimePoint> Progress::Data(size_t _level) const
 {
-    return m_Timeline;
+    if( _level >= TimelineLevels )
+        return {};
+    const auto resolution = TimelineResolution(_level);
+    const auto last_elapsed = m_LastCommitElapsed.load();
+    const auto snapshot = Snapshot(m_Timeline[_level]);
+    const uint64_t first = snapshot.head < N ? 0 : snapshot.head - N + 2;
+
+    std::vector<TimePoint> data;
+    data.reserve(snapshot.head - first + 1);
+    for( uint64_t p = first; p <= snapshot.head; ++p ) {
+        const auto covered = std::min(PeriodStart(resolution, p + 1), last_elapsed) - PeriodStart(resolution, p);
+        if( covered.count() <= 0 )
+            break;
+        const auto end_volume = snapshot.volumes[p % N];
+        const auto start_volume = p == 0 ? 0 : snapshot.volumes[(p - 1) % N];
+        TimePoint tp;
+        tp.value = static_cast<float>(end_volume - start_volume);
+        tp.fraction = static_cast<float>(double(covered.count()) / double(resolution.count()));
+        data.emplace_back(tp);
+    }
+    return data;
 }
 
 uint64_t Progress::VolumeTotal() const noexcept
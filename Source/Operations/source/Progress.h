@@ -1,17 +1,29 @@
-// Copyright (C) 2017-2018 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <stdint.h>
+#include <array>
+#include <atomic>
 #include <optional>
 #include <chrono>
 #include <vector>
-#include <Base/spinlock.h>
 
 namespace nc::ops {
 
+// Tracks the progress of processing some volume (bytes or items) and a timeline of its speed.
+// The timeline is kept in a fixed amount of memory regardless of how long the operation runs: it consists of several
+// rings of samples with decreasing resolution - the recent history is available per-second, while the older one is
+// available only at coarser granularity.
+// The commit methods are wait-free and can be called from any thread, the reading methods can be called from any
+// thread concurrently with them.
 class Progress
 {
 public:
+    // The number of the timeline levels, each next one being TimelineDecimation times coarser than the previous one.
+    static constexpr size_t TimelineLevels = 4;
+    static constexpr size_t TimelineLevelSamples = 64;
+    static constexpr uint64_t TimelineDecimation = 16;
+
     Progress();
     ~Progress();
 
@@ -30,20 +42,59 @@ public:
 
     void CommitEstimated(uint64_t _volume_delta);
     void CommitProcessed(uint64_t _volume_delta);
+    void CommitProcessed(uint64_t _volume_delta, std::chrono::nanoseconds _time_point);
     void CommitSkipped(uint64_t _volume_delta);
 
     void SetupTiming();
+    void SetupTiming(std::chrono::nanoseconds _time_point);
     void ReportSleptDelta(std::chrono::nanoseconds _time_delta);
 
-    const std::vector<TimePoint> &Data() const;
+    // Returns the resolution of the timeline samples on the specified level, 1s for the level #0.
+    static std::chrono::nanoseconds TimelineResolution(size_t _level) noexcept;
 
-public:
-    std::atomic_ulong m_Estimated;
-    std::atomic_ulong m_Processed;
-    std::chrono::nanoseconds m_BaseTimePoint;
-    std::chrono::nanoseconds m_LastCommitTimePoint;
-    mutable spinlock m_TimepointsLock;
-    std::vector<TimePoint> m_Timeline;
+    // Returns the samples of the timeline at the specified level, from the oldest to the most recent one.
+    // Each sample holds the volume processed during its period, the last one can cover only a fraction of it.
+    std::vector<TimePoint> Data(size_t _level = 0) const;
+
+private:
+    struct Level {
+        // cumulative processed volume at the end of each period, indexed by period % TimelineLevelSamples
+        std::array<std::atomic_uint64_t, TimelineLevelSamples> volumes;
+        // the index of the most recent period which has a sample
+        std::atomic_uint64_t head = 0;
+        // odd while the recorder is moving the head and overwriting the old samples, readers retry in that case
+        std::atomic_uint64_t sequence = 0;
+    };
+
+    struct LevelSnapshot {
+        uint64_t head = 0;
+        std::array<uint64_t, TimelineLevelSamples> volumes;
+    };
+
+    void Record(uint64_t _processed, std::chrono::nanoseconds _elapsed) noexcept;
+    static LevelSnapshot Snapshot(const Level &_level) noexcept;
+    static void Record(Level &_level,
+                       std::chrono::nanoseconds _resolution,
+                       uint64_t _prev_processed,
+                       std::chrono::nanoseconds _prev_elapsed,
+                       uint64_t _processed,
+                       std::chrono::nanoseconds _elapsed) noexcept;
+
+    std::atomic_uint64_t m_Estimated;
+    std::atomic_uint64_t m_Processed;
+
+    // the starting time point, shifted forward by the slept time, only changed under m_Recording
+    std::atomic<std::chrono::nanoseconds> m_BaseTimePoint;
+
+    // the time elapsed since the base time point at the moment of the last recorded commit
+    std::atomic<std::chrono::nanoseconds> m_LastCommitElapsed;
+
+    // only one thread at a time records the timeline, others just skip the recording and let it catch up later
+    std::atomic_flag m_Recording = ATOMIC_FLAG_INIT;
+    uint64_t m_RecordedProcessed = 0;              // guarded by m_Recording
+    std::chrono::nanoseconds m_RecordedElapsed{0}; // guarded by m_Recording
+
+    std::array<Level, TimelineLevels> m_Timeline;
 };
 
 } // namespace nc::ops
@@ -1,11 +1,16 @@
-// Copyright (C) 2017-2020 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2017-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "Tests.h"
 #include "TestEnv.h"
 #include <sys/stat.h>
 #include "../source/AttrsChanging/AttrsChanging.h"
+#include "../source/AttrsChanging/AttrsChangingJob.h"
+#include "../include/Operations/Operation.h"
 #include <VFS/Native.h>
 #include <chrono>
+#include <mutex>
+#include <random>
 #include <set>
+#include <thread>
 
 using namespace nc;
 using namespace nc::ops;
@@ -173,6 +178,105 @@ TEST_CASE(PREFIX "Item reporting")
     CHECK(processed == expected);
 }
 
+TEST_CASE(PREFIX "Applies several attributes to a large tree concurrently")
+{
+    const TempTestDir tmp_dir;
+    const auto native_host = TestEnv().vfs_native;
+    const auto root = tmp_dir.directory / "test";
+    std::vector<std::filesystem::path> paths{root};
+    for( int d = 0; d < 20; ++d ) {
+        const auto dir = root / ("d" + std::to_string(d));
+        REQUIRE(std::filesystem::create_directories(dir));
+        paths.emplace_back(dir);
+        for( int f = 0; f < 50; ++f ) {
+            paths.emplace_back(dir / ("f" + std::to_string(f)));
+            close(creat(paths.back().c_str(), 0755));
+        }
+    }
+    const long mtime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()) - 10'000;
+
+    AttrsChangingCommand cmd;
+    cmd.items = FetchItems(tmp_dir.directory, {"test"}, *native_host);
+    cmd.permissions.emplace();
+    cmd.permissions->oth_r = false;
+    cmd.permissions->oth_x = false;
+    cmd.flags.emplace();
+    cmd.flags->u_hidden = true;
+    cmd.times.emplace();
+    cmd.times->mtime = mtime;
+    cmd.apply_to_subdirs = true;
+
+    AttrsChanging operation{cmd};
+    operation.Start();
+    operation.Wait();
+    REQUIRE(operation.State() == OperationState::Completed);
+
+    for( const auto &path : paths ) {
+        VFSStat st;
+        REQUIRE(native_host->Stat(path.c_str(), st, 0, {}) == VFSError::Ok);
+        CHECK((st.mode & ~S_IFMT) == 0750);
+        CHECK((st.flags & UF_HIDDEN) != 0);
+        CHECK(st.mtime.tv_sec == mtime);
+    }
+}
+
+TEST_CASE(PREFIX "Resolves the errors in the order of the items when processing concurrently")
+{
+    struct MyHost : vfs::NativeHost {
+        using NativeHost::NativeHost;
+        int SetPermissions(std::string_view _path, uint16_t _mode, const VFSCancelChecker &_cancel_checker) override
+        {
+            thread_local std::mt19937 rng{std::random_device{}()};
+            std::this_thread::sleep_for(std::chrono::microseconds{rng() % 1000});
+            if( _path.ends_with("fail") )
+                return VFSError::FromErrno(EPERM);
+            return NativeHost::SetPermissions(_path, _mode, _cancel_checker);
+        }
+    };
+    struct MyOperation : Operation {
+        MyOperation(AttrsChangingCommand _command) : job(std::move(_command)) {}
+        ~MyOperation() override { Wait(); }
+        Job *GetJob() noexcept override { return &job; }
+        AttrsChangingJob job;
+    };
+    const auto host = std::make_shared<MyHost>(*TestEnv().native_fs_man, *TestEnv().fsevents_file_update);
+    const TempTestDir tmp_dir;
+    const auto root = tmp_dir.directory / "test";
+    REQUIRE(std::filesystem::create_directories(root));
+    for( int f = 0; f < 300; ++f )
+        close(creat((root / (std::to_string(f) + (f % 7 == 3 ? "fail" : ""))).c_str(), 0755));
+
+    std::vector<std::string> expected;
+    host->IterateDirectoryListing(root.native(), [&](const VFSDirEnt &_entry) {
+        if( std::string_view{_entry.name}.ends_with("fail") )
+            expected.emplace_back((root / _entry.name).native());
+        return true;
+    });
+
+    AttrsChangingCommand cmd;
+    cmd.items = FetchItems(tmp_dir.directory, {"test"}, *host);
+    cmd.permissions.emplace();
+    cmd.permissions->oth_r = false;
+    cmd.apply_to_subdirs = true;
+    cmd.concurrency.other = 8;
+
+    MyOperation operation{cmd};
+    std::mutex lock;
+    std::vector<std::string> reported;
+    bool was_concurrent = false;
+    operation.job.m_OnChmodError = [&](int, const std::string &_path, VFSHost &) {
+        const auto guard = std::unique_lock{lock, std::try_to_lock};
+        was_concurrent |= !guard.owns_lock();
+        reported.emplace_back(_path);
+        return AttrsChangingJobCallbacks::ChmodErrorResolution::Skip;
+    };
+    operation.Start();
+    operation.Wait();
+    REQUIRE(operation.State() == OperationState::Completed);
+    CHECK(!was_concurrent);
+    CHECK(reported == expected);
+}
+
 static std::vector<VFSListingItem>
 FetchItems(const std::string &_directory_path, const std::vector<std::string> &_filenames, VFSHost &_host)
 {
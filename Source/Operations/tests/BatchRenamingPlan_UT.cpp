@@ -0,0 +1,277 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "../source/BatchRenaming/BatchRenamingPlan.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <map>
+#include <limits>
+#include <random>
+#include <set>
+
+using nc::ops::BatchRenamingPlan;
+using nc::ops::BatchRenamingPlanOptions;
+
+#define PREFIX "nc::ops::BatchRenamingPlan "
+
+static std::string Lowercase(std::string_view _path)
+{
+    std::string key(_path);
+    std::ranges::transform(key, key.begin(), [](char _c) { return static_cast<char>(std::tolower(_c)); });
+    return key;
+}
+
+// A filesystem mock which maps the keys of the names into the original names of the items they hold.
+struct Volume {
+    std::map<std::string, std::string> items;
+    std::function<std::string(std::string_view)> key = [](std::string_view _path) { return std::string(_path); };
+
+    bool Rename(const std::string &_from, const std::string &_to)
+    {
+        const auto from = items.find(key(_from));
+        if( from == items.end() )
+            return false;
+        if( key(_from) != key(_to) && items.contains(key(_to)) )
+            return false; // would overwrite another item
+        auto content = std::move(from->second);
+        items.erase(from);
+        items[key(_to)] = std::move(content);
+        return true;
+    }
+};
+
+// Performs the plan chain by chain and tells whether every single rename succeeded.
+static bool Perform(const BatchRenamingPlan &_plan,
+                    const std::vector<std::string> &_src,
+                    const std::vector<std::string> &_dst,
+                    Volume &_volume)
+{
+    bool ok = true;
+    for( size_t chain = 0; chain != _plan.ChainsCount(); ++chain ) {
+        for( const auto &step : _plan.Chain(chain) ) {
+            switch( step.kind ) {
+                case BatchRenamingPlan::StepKind::Direct:
+                    ok &= _volume.Rename(_src[step.item], _dst[step.item]);
+                    break;
+                case BatchRenamingPlan::StepKind::ToTemporary:
+                    ok &= _volume.Rename(_src[step.item], _plan.Temporary(step.item));
+                    break;
+                case BatchRenamingPlan::StepKind::FromTemporary:
+                    ok &= _volume.Rename(_plan.Temporary(step.item), _dst[step.item]);
+                    break;
+            }
+        }
+    }
+    return ok;
+}
+
+// Checks that no two chains touch the same names, otherwise they couldn't be performed concurrently.
+static bool ChainsAreIndependent(const BatchRenamingPlan &_plan,
+                                 const std::vector<std::string> &_src,
+                                 const std::vector<std::string> &_dst)
+{
+    std::set<std::string> touched;
+    for( size_t chain = 0; chain != _plan.ChainsCount(); ++chain ) {
+        std::set<std::string> names;
+        for( const auto &step : _plan.Chain(chain) ) {
+            names.insert(_src[step.item]);
+            names.insert(_dst[step.item]);
+            if( step.kind != BatchRenamingPlan::StepKind::Direct )
+                names.insert(_plan.Temporary(step.item));
+        }
+        for( const auto &name : names )
+            if( !touched.insert(name).second )
+                return false;
+    }
+    return true;
+}
+
+static size_t StepsCount(const BatchRenamingPlan &_plan)
+{
+    size_t count = 0;
+    for( size_t chain = 0; chain != _plan.ChainsCount(); ++chain )
+        count += _plan.Chain(chain).size();
+    return count;
+}
+
+TEST_CASE(PREFIX "Empty batch")
+{
+    const BatchRenamingPlan plan({}, {});
+    CHECK(plan.ChainsCount() == 0);
+    CHECK(plan.TemporariesCount() == 0);
+    CHECK(plan.IsOrdered());
+}
+
+TEST_CASE(PREFIX "Orders a chain starting from the free destination")
+{
+    const std::vector<std::string> src = {"/d/1", "/d/2", "/d/3"};
+    const std::vector<std::string> dst = {"/d/2", "/d/3", "/d/4"};
+    const BatchRenamingPlan plan(src, dst);
+    REQUIRE(plan.ChainsCount() == 1);
+    CHECK(plan.TemporariesCount() == 0);
+    const auto chain = plan.Chain(0);
+    REQUIRE(chain.size() == 3);
+    CHECK(chain[0].item == 2);
+    CHECK(chain[1].item == 1);
+    CHECK(chain[2].item == 0);
+}
+
+TEST_CASE(PREFIX "Breaks a swap with a single temporary name")
+{
+    const std::vector<std::string> src = {"/d/a", "/d/b"};
+    const std::vector<std::string> dst = {"/d/b", "/d/a"};
+    const BatchRenamingPlan plan(src, dst);
+    REQUIRE(plan.ChainsCount() == 1);
+    REQUIRE(plan.TemporariesCount() == 1);
+    const auto chain = plan.Chain(0);
+    REQUIRE(chain.size() == 3);
+    CHECK(chain[0].item == 0);
+    CHECK(chain[0].kind == BatchRenamingPlan::StepKind::ToTemporary);
+    CHECK(chain[1].item == 1);
+    CHECK(chain[1].kind == BatchRenamingPlan::StepKind::Direct);
+    CHECK(chain[2].item == 0);
+    CHECK(chain[2].kind == BatchRenamingPlan::StepKind::FromTemporary);
+    CHECK(plan.Temporary(0) == "/d/.a.renaming");
+}
+
+TEST_CASE(PREFIX "Picks temporary names which are not occupied")
+{
+    const std::vector<std::string> src = {"/d/a", "/d/b", "/d/.a.renaming 2"};
+    const std::vector<std::string> dst = {"/d/b", "/d/a", "/d/c"};
+    BatchRenamingPlanOptions options;
+    options.exists = [](const std::string &_path) { return _path == "/d/.a.renaming"; };
+    const BatchRenamingPlan plan(src, dst, options);
+    REQUIRE(plan.TemporariesCount() == 1);
+    CHECK(plan.Temporary(0) == "/d/.a.renaming 3");
+}
+
+TEST_CASE(PREFIX "Case-only renames on case-insensitive volumes")
+{
+    BatchRenamingPlanOptions options;
+    options.key = Lowercase;
+    SECTION("A single case-only rename needs no temporary name")
+    {
+        const std::vector<std::string> src = {"/d/A"};
+        const std::vector<std::string> dst = {"/d/a"};
+        const BatchRenamingPlan plan(src, dst, options);
+        CHECK(plan.ChainsCount() == 1);
+        CHECK(plan.TemporariesCount() == 0);
+    }
+    SECTION("A swap which differs only in case")
+    {
+        const std::vector<std::string> src = {"/d/a", "/d/b"};
+        const std::vector<std::string> dst = {"/d/B", "/d/A"};
+        const BatchRenamingPlan plan(src, dst, options);
+        CHECK(plan.ChainsCount() == 1);
+        CHECK(plan.TemporariesCount() == 1);
+        Volume volume;
+        volume.key = Lowercase;
+        volume.items = {{"/d/a", "a"}, {"/d/b", "b"}};
+        REQUIRE(Perform(plan, src, dst, volume));
+        CHECK(volume.items == std::map<std::string, std::string>{{"/d/a", "b"}, {"/d/b", "a"}});
+    }
+    SECTION("Without case-folding the same renames are independent")
+    {
+        const std::vector<std::string> src = {"/d/a", "/d/b"};
+        const std::vector<std::string> dst = {"/d/B", "/d/A"};
+        const BatchRenamingPlan plan(src, dst);
+        CHECK(plan.ChainsCount() == 2);
+        CHECK(plan.TemporariesCount() == 0);
+    }
+}
+
+TEST_CASE(PREFIX "Falls back to the original order on duplicates")
+{
+    const std::vector<std::string> src = {"/d/a", "/d/b", "/d/c"};
+    const std::vector<std::string> dst = {"/d/b", "/d/x", "/d/x"};
+    const BatchRenamingPlan plan(src, dst);
+    CHECK(plan.IsOrdered() == false);
+    REQUIRE(plan.ChainsCount() == 1);
+    const auto chain = plan.Chain(0);
+    REQUIRE(chain.size() == 3);
+    CHECK(chain[0].item == 0);
+    CHECK(chain[1].item == 1);
+    CHECK(chain[2].item == 2);
+}
+
+TEST_CASE(PREFIX "Randomized permutations")
+{
+    std::mt19937 rng(42);
+    for( int round = 0; round != 500; ++round ) {
+        // a random subset of the names is renamed into a random permutation of some other names, partially outside
+        const size_t names_count = std::uniform_int_distribution<size_t>(1, 200)(rng);
+        std::vector<std::string> names(names_count * 2);
+        for( size_t i = 0; i != names.size(); ++i )
+            names[i] = fmt::format("/dir/{}", i);
+        std::vector<std::string> src(names.begin(), names.begin() + static_cast<long>(names_count));
+        std::vector<std::string> dst = names;
+        std::ranges::shuffle(dst, rng);
+        dst.resize(names_count);
+        if( round % 2 ) {
+            // a pure permutation, which consists of cycles only
+            dst = src;
+            std::ranges::shuffle(dst, rng);
+        }
+
+        Volume volume;
+        for( const auto &name : src )
+            volume.items[name] = name;
+
+        const BatchRenamingPlan plan(src, dst);
+        REQUIRE(plan.IsOrdered());
+        REQUIRE(StepsCount(plan) == src.size() + plan.TemporariesCount());
+        REQUIRE(ChainsAreIndependent(plan, src, dst));
+        REQUIRE(Perform(plan, src, dst, volume));
+
+        std::map<std::string, std::string> expected;
+        for( size_t i = 0; i != src.size(); ++i )
+            expected[dst[i]] = src[i];
+        REQUIRE(volume.items == expected);
+
+        // exactly one temporary name per cycle, excluding the fixed points
+        constexpr size_t npos = std::numeric_limits<size_t>::max();
+        std::map<std::string, size_t> src_index;
+        for( size_t i = 0; i != src.size(); ++i )
+            src_index[src[i]] = i;
+        const auto next = [&](size_t _item) {
+            const auto it = src_index.find(dst[_item]);
+            return it == src_index.end() || it->second == _item ? npos : it->second;
+        };
+        std::vector<size_t> walked_from(src.size(), npos);
+        size_t cycles = 0;
+        for( size_t i = 0; i != src.size(); ++i ) {
+            size_t item = i;
+            while( item != npos && walked_from[item] == npos ) {
+                walked_from[item] = i;
+                item = next(item);
+            }
+            if( item != npos && walked_from[item] == i )
+                ++cycles;
+        }
+        REQUIRE(plan.TemporariesCount() == cycles);
+    }
+}
+
+TEST_CASE(PREFIX "Shifting 100K sequentially numbered frames")
+{
+    const size_t frames = 100'000;
+    for( const size_t shift : {size_t(1), size_t(7)} ) {
+        std::vector<std::string> src(frames);
+        std::vector<std::string> dst(frames);
+        for( size_t i = 0; i != frames; ++i ) {
+            src[i] = fmt::format("/frames/frame_{:06}.exr", i);
+            dst[i] = fmt::format("/frames/frame_{:06}.exr", i + shift);
+        }
+        Volume volume;
+        for( const auto &name : src )
+            volume.items[name] = name;
+
+        const BatchRenamingPlan plan(src, dst);
+        CHECK(plan.ChainsCount() == shift);
+        CHECK(plan.TemporariesCount() == 0);
+        CHECK(ChainsAreIndependent(plan, src, dst));
+        REQUIRE(Perform(plan, src, dst, volume));
+        CHECK(volume.items.size() == frames);
+        CHECK(volume.items.at(dst.front()) == src.front());
+        CHECK(volume.items.at(dst.back()) == src.back());
+    }
+}
@@ -0,0 +1,228 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "../source/BatchRenaming/BatchRenamingScheme.h"
+#include "../source/BatchRenaming/BatchRenamingPreview.h"
+#include <fmt/format.h>
+
+using nc::ops::BatchRenamingPreview;
+using nc::ops::BatchRenamingScheme;
+
+#define PREFIX "nc::ops::BatchRenamingScheme "
+
+static std::string ToUTF8(std::u16string_view _str)
+{
+    std::string utf8;
+    for( const char16_t c : _str )
+        utf8 += c < 0x80 ? static_cast<char>(c) : '?';
+    return utf8;
+}
+
+static std::u16string Rename(const BatchRenamingScheme &_scheme, const BatchRenamingScheme::FileInfo &_fi, int _n = 0)
+{
+    std::u16string renamed;
+    _scheme.Rename(_fi, _n, renamed);
+    return renamed;
+}
+
+TEST_CASE(PREFIX "Decomposes masks")
+{
+    using MD = BatchRenamingScheme::MaskDecomposition;
+    struct TC {
+        std::u16string_view input;
+        std::optional<std::vector<MD>> expected;
+    } const tcs[] = {
+        {u"", std::vector<MD>{}},
+        {u"[", std::nullopt},
+        {u"]", std::nullopt},
+        {u"a]", std::nullopt},
+        {u"a", std::vector<MD>{{u"a", false}}},
+        {u"[[", std::vector<MD>{{u"[", false}}},
+        {u"[[[[", std::vector<MD>{{u"[[", false}}},
+        {u"]]", std::vector<MD>{{u"]", false}}},
+        {u"]]]]", std::vector<MD>{{u"]]", false}}},
+        {u"[[[[]]]]", std::vector<MD>{{u"[[]]", false}}},
+        {u"a[N]b", std::vector<MD>{{u"a", false}, {u"N", true}, {u"b", false}}},
+        {u"[N][E]", std::vector<MD>{{u"N", true}, {u"E", true}}},
+    };
+    for( const auto &tc : tcs ) {
+        INFO(ToUTF8(tc.input));
+        CHECK(BatchRenamingScheme::DecomposeMaskIntoPlaceholders(tc.input) == tc.expected);
+    }
+}
+
+TEST_CASE(PREFIX "Extracts text counting UTF-16 code units")
+{
+    BatchRenamingScheme::TextExtraction te;
+    te.direct_range = BatchRenamingScheme::Range(1, 8);
+    te.zero_flag = true;
+    std::u16string extracted;
+    BatchRenamingScheme::ExtractText(u"abc", te, extracted);
+    CHECK(extracted == u"000000bc");
+
+    extracted.clear();
+    te.direct_range = BatchRenamingScheme::Range(0, 2);
+    te.zero_flag = false;
+    BatchRenamingScheme::ExtractText(u"\U0001F600abc", te, extracted);
+    CHECK(extracted == u"\U0001F600");
+
+    extracted = u"prefix";
+    te.direct_range = BatchRenamingScheme::Range(1, 1);
+    BatchRenamingScheme::ExtractText(u"abc", te, extracted);
+    CHECK(extracted == u"prefixb");
+}
+
+TEST_CASE(PREFIX "Renaming - simple cases")
+{
+    const BatchRenamingScheme::FileInfo file_info(u"filename.txt", "/tmp/grandparent_dir/parent_dir/", 0);
+    struct Case {
+        std::u16string_view pattern;
+        bool parsed;
+        std::u16string_view expected;
+    };
+    const Case test_cases[] = {
+        {u"", false, u""},
+        {u"[A]", true, u"filename.txt"},
+        {u"[A-5-2]", true, u"e.tx"},
+        {u"[A-5,100]", true, u"e.txt"},
+        {u"[A05-14]", true, u"00name.txt"},
+        {u"[A 5-14]", true, u"  name.txt"},
+        {u"[N]", true, u"filename"},
+        {u"[N2-]", true, u"ilename"},
+        {u"[N2-3]", true, u"il"},
+        {u"[N-4-]", true, u"name"},
+        {u"[N5]", true, u"n"},
+        {u"[N-5,4]", true, u"enam"},
+        {u"[E]", true, u"txt"},
+        {u"[E-2-]", true, u"xt"},
+        {u"[E3-]", true, u"t"},
+        {u"[E4-]", true, u""},
+        {u"[P]", true, u"parent_dir"},
+        {u"[P1-6]", true, u"parent"},
+        {u"[G]", true, u"grandparent_dir"},
+        {u"[G1-5]", true, u"grand"},
+        {u"[[", true, u"["},
+        {u"]]", true, u"]"},
+        {u"[N][[1]]", true, u"filename[1]"},
+        {u"[N2--3]", true, u"ilena"},
+        {u"[U][N][n].[E]", true, u"FILENAME.txt"},
+        {u"[C10+2:3]_[N]", true, u"010_filename"},
+        {u"[Q]", false, u""},
+    };
+
+    for( const auto &test_case : test_cases ) {
+        INFO(ToUTF8(test_case.pattern));
+        BatchRenamingScheme scheme(BatchRenamingScheme::Platform::Portable());
+        const bool parsed = scheme.BuildActionsScript(test_case.pattern);
+        REQUIRE(parsed == test_case.parsed);
+        if( parsed )
+            CHECK(ToUTF8(Rename(scheme, file_info)) == ToUTF8(test_case.expected));
+    }
+}
+
+TEST_CASE(PREFIX "Formats counters")
+{
+    const BatchRenamingScheme::FileInfo file_info(u"a.txt", "/", 0);
+    BatchRenamingScheme scheme(BatchRenamingScheme::Platform::Portable());
+    REQUIRE(scheme.BuildActionsScript(u"[C5+3/2:4]"));
+    CHECK(Rename(scheme, file_info, 0) == u"0005");
+    CHECK(Rename(scheme, file_info, 1) == u"0005");
+    CHECK(Rename(scheme, file_info, 2) == u"0008");
+    CHECK(Rename(scheme, file_info, 7) == u"0014");
+}
+
+TEST_CASE(PREFIX "Searches and replaces")
+{
+    const BatchRenamingScheme::FileInfo file_info(u"Foo foo.foo", "/", 0);
+    struct Case {
+        std::u16string_view search_for;
+        std::u16string_view replace_with;
+        bool case_sensitive;
+        bool only_first;
+        bool search_in_ext;
+        std::u16string_view expected;
+    } const test_cases[] = {
+        {u"foo", u"bar", false, false, true, u"bar bar.bar"},
+        {u"foo", u"bar", true, false, true, u"Foo bar.bar"},
+        {u"foo", u"bar", false, true, true, u"bar foo.foo"},
+        {u"foo", u"bar", false, false, false, u"bar bar.foo"},
+        {u"o", u"oo", true, false, false, u"Foooo foooo.foo"},
+        {u"o", u"", true, false, true, u"F f.f"},
+        {u"", u"bar", true, false, true, u"Foo foo.foo"},
+        {u"xyz", u"bar", true, false, true, u"Foo foo.foo"},
+    };
+    for( const auto &tc : test_cases ) {
+        INFO(ToUTF8(tc.search_for) + " -> " + ToUTF8(tc.replace_with));
+        BatchRenamingScheme scheme(BatchRenamingScheme::Platform::Portable());
+        scheme.SetReplacingOptions(
+            tc.search_for, tc.replace_with, tc.case_sensitive, tc.only_first, tc.search_in_ext, false);
+        REQUIRE(scheme.BuildActionsScript(u"[A]"));
+        CHECK(ToUTF8(Rename(scheme, file_info)) == ToUTF8(tc.expected));
+    }
+}
+
+TEST_CASE(PREFIX "Transforms the case")
+{
+    const BatchRenamingScheme::FileInfo file_info(u"hello wORLD.Txt", "/", 0);
+    struct Case {
+        BatchRenamingScheme::CaseTransform transform;
+        bool with_ext;
+        std::u16string_view expected;
+    } const test_cases[] = {
+        {BatchRenamingScheme::CaseTransform::Unchanged, false, u"hello wORLD.Txt"},
+        {BatchRenamingScheme::CaseTransform::Uppercase, false, u"HELLO WORLD.Txt"},
+        {BatchRenamingScheme::CaseTransform::Uppercase, true, u"HELLO WORLD.TXT"},
+        {BatchRenamingScheme::CaseTransform::Lowercase, true, u"hello world.txt"},
+        {BatchRenamingScheme::CaseTransform::Capitalized, false, u"Hello World.Txt"},
+    };
+    for( const auto &tc : test_cases ) {
+        BatchRenamingScheme scheme(BatchRenamingScheme::Platform::Portable());
+        scheme.SetCaseTransform(tc.transform, tc.with_ext);
+        REQUIRE(scheme.BuildActionsScript(u"[A]"));
+        CHECK(ToUTF8(Rename(scheme, file_info)) == ToUTF8(tc.expected));
+    }
+}
+
+static std::shared_ptr<const BatchRenamingPreview::FileInfos> MakeFileInfos(size_t _count)
+{
+    auto infos = std::make_shared<BatchRenamingPreview::FileInfos>();
+    for( size_t i = 0; i != _count; ++i ) {
+        const auto name = fmt::format("file_{}.txt", i);
+        infos->emplace_back(std::u16string(name.begin(), name.end()), "/some/dir/", 0);
+    }
+    return infos;
+}
+
+TEST_CASE("nc::ops::BatchRenamingPreview computes the same names as the scheme does")
+{
+    const auto infos = MakeFileInfos(10'000);
+    auto scheme = std::make_shared<BatchRenamingScheme>(BatchRenamingScheme::Platform::Portable());
+    REQUIRE(scheme->BuildActionsScript(u"[C:5]_[U][N3-][n].[E]"));
+
+    BatchRenamingPreview preview(scheme, infos);
+    REQUIRE(preview.Size() == infos->size());
+    preview.Compute(100, 150);
+    for( size_t i = 0; i != preview.Size(); ++i )
+        CHECK(preview.IsComputed(i) == (i >= 100 && i < 150));
+
+    REQUIRE(preview.ComputeRemaining(97));
+    for( size_t i = 0; i != preview.Size(); ++i ) {
+        REQUIRE(preview.IsComputed(i));
+        REQUIRE(preview.Filename(i) == Rename(*scheme, (*infos)[i], static_cast<int>(i)));
+    }
+    CHECK(preview.Filename(12) == u"00013_LE_12.txt");
+}
+
+TEST_CASE("nc::ops::BatchRenamingPreview can be cancelled")
+{
+    const auto infos = MakeFileInfos(1'000);
+    auto scheme = std::make_shared<BatchRenamingScheme>(BatchRenamingScheme::Platform::Portable());
+    REQUIRE(scheme->BuildActionsScript(u"[N]"));
+
+    BatchRenamingPreview preview(scheme, infos);
+    preview.Compute(0, 10);
+    preview.Cancel();
+    CHECK(preview.IsCancelled());
+    CHECK(preview.ComputeRemaining() == false);
+    for( size_t i = 0; i != preview.Size(); ++i )
+        CHECK(preview.IsComputed(i) == (i < 10));
+}
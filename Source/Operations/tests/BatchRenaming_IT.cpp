@@ -0,0 +1,120 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "TestEnv.h"
+#include "../source/BatchRenaming/BatchRenaming.h"
+#include "../source/BatchRenaming/BatchRenamingJob.h"
+#include <VFS/Native.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <sstream>
+
+using namespace nc;
+using namespace nc::ops;
+
+#define PREFIX "Operations::BatchRenaming "
+
+static void WriteFile(const std::filesystem::path &_path, const std::string &_content)
+{
+    std::ofstream(_path) << _content;
+}
+
+static std::string ReadFile(const std::filesystem::path &_path)
+{
+    std::ifstream in(_path);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+TEST_CASE(PREFIX "Renames a cycle of items")
+{
+    const TempTestDir dir;
+    const auto host = TestEnv().vfs_native;
+    for( const auto name : {"a", "b", "c"} )
+        WriteFile(dir.directory / name, name);
+
+    const auto path = [&](const char *_name) { return (dir.directory / _name).native(); };
+    BatchRenaming operation{{path("a"), path("b"), path("c")}, {path("b"), path("c"), path("a")}, host};
+    operation.Start();
+    operation.Wait();
+
+    REQUIRE(operation.State() == OperationState::Completed);
+    CHECK(ReadFile(dir.directory / "b") == "a");
+    CHECK(ReadFile(dir.directory / "c") == "b");
+    CHECK(ReadFile(dir.directory / "a") == "c");
+    CHECK(std::distance(std::filesystem::directory_iterator(dir.directory), {}) == 3);
+}
+
+TEST_CASE(PREFIX "Swaps the names differing only in case")
+{
+    const TempTestDir dir;
+    const auto host = TestEnv().vfs_native;
+    WriteFile(dir.directory / "a", "a");
+    WriteFile(dir.directory / "b", "b");
+
+    const auto path = [&](const char *_name) { return (dir.directory / _name).native(); };
+    BatchRenaming operation{{path("a"), path("b")}, {path("B"), path("A")}, host};
+    operation.Start();
+    operation.Wait();
+
+    REQUIRE(operation.State() == OperationState::Completed);
+    CHECK(ReadFile(dir.directory / "B") == "a");
+    CHECK(ReadFile(dir.directory / "A") == "b");
+    CHECK(std::distance(std::filesystem::directory_iterator(dir.directory), {}) == 2);
+}
+
+TEST_CASE(PREFIX "Shifts sequentially numbered frames")
+{
+    const TempTestDir dir;
+    const auto host = TestEnv().vfs_native;
+    const size_t frames = 1000;
+    std::vector<std::string> src;
+    std::vector<std::string> dst;
+    for( size_t i = 0; i != frames; ++i ) {
+        src.emplace_back(dir.directory / fmt::format("frame_{:04}.exr", i));
+        dst.emplace_back(dir.directory / fmt::format("frame_{:04}.exr", i + 3));
+        WriteFile(src.back(), std::to_string(i));
+    }
+
+    BatchRenaming operation{src, dst, host};
+    operation.Start();
+    operation.Wait();
+
+    REQUIRE(operation.State() == OperationState::Completed);
+    for( size_t i = 0; i != frames; ++i )
+        REQUIRE(ReadFile(dst[i]) == std::to_string(i));
+    CHECK(std::distance(std::filesystem::directory_iterator(dir.directory), {}) == static_cast<long>(frames));
+}
+
+TEST_CASE(PREFIX "Skips the rest of a chain after a failed rename")
+{
+    struct MyOperation : Operation {
+        MyOperation(std::vector<std::string> _src, std::vector<std::string> _dst, std::shared_ptr<VFSHost> _vfs)
+            : job(std::move(_src), std::move(_dst), std::move(_vfs))
+        {
+        }
+        ~MyOperation() override { Wait(); }
+        Job *GetJob() noexcept override { return &job; }
+        BatchRenamingJob job;
+    };
+    const TempTestDir dir;
+    const auto host = TestEnv().vfs_native;
+    for( const auto name : {"1", "2", "3", "4"} )
+        WriteFile(dir.directory / name, name);
+
+    // "4" is occupied by an item outside of the batch, so "3"->"4" fails and "2"->"3", "1"->"2" can't be performed
+    const auto path = [&](const char *_name) { return (dir.directory / _name).native(); };
+    MyOperation operation{{path("1"), path("2"), path("3")}, {path("2"), path("3"), path("4")}, host};
+    std::vector<std::string> reported;
+    operation.job.m_OnRenameError = [&](int, const std::string &_path, VFSHost &) {
+        reported.emplace_back(_path);
+        return BatchRenamingJobCallbacks::RenameErrorResolution::Skip;
+    };
+    operation.Start();
+    operation.Wait();
+
+    REQUIRE(operation.State() == OperationState::Completed);
+    CHECK(reported == std::vector<std::string>{path("4")});
+    for( const auto name : {"1", "2", "3", "4"} )
+        CHECK(ReadFile(dir.directory / name) == name);
+}
@@ -0,0 +1,96 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "../source/Copying/ChunkRing.h"
+#include <array>
+#include <numeric>
+#include <thread>
+
+using nc::ops::copying::ChunkRing;
+
+#define PREFIX "nc::ops::copying::ChunkRing "
+
+TEST_CASE(PREFIX "rejects an empty set of buffers")
+{
+    CHECK_THROWS_AS(ChunkRing({}, 16), std::invalid_argument);
+}
+
+TEST_CASE(PREFIX "passes chunks in order and finishes")
+{
+    std::array<uint8_t, 8> storage[2];
+    const std::array<uint8_t *, 2> buffers{storage[0].data(), storage[1].data()};
+    ChunkRing ring(buffers, 8);
+
+    uint8_t *b1 = ring.AcquireFree();
+    REQUIRE(b1 != nullptr);
+    b1[0] = 1;
+    ring.Push({.data = b1, .size = 3, .offset = 0});
+    uint8_t *b2 = ring.AcquireFree();
+    REQUIRE(b2 != nullptr);
+    CHECK(b1 != b2);
+    b2[0] = 2;
+    ring.Push({.data = b2, .size = 5, .offset = 3});
+    ring.Finish();
+
+    auto c1 = ring.Pop();
+    REQUIRE(c1);
+    CHECK(c1->data[0] == 1);
+    CHECK(c1->size == 3);
+    CHECK(c1->offset == 0);
+    ring.Release(*c1);
+    auto c2 = ring.Pop();
+    REQUIRE(c2);
+    CHECK(c2->data[0] == 2);
+    CHECK(c2->offset == 3);
+    ring.Release(*c2);
+    CHECK(ring.Pop() == std::nullopt);
+    CHECK(ring.ConsumedBytes() == 8);
+}
+
+TEST_CASE(PREFIX "abort wakes up a blocked producer")
+{
+    std::array<uint8_t, 8> storage;
+    const std::array<uint8_t *, 1> buffers{storage.data()};
+    ChunkRing ring(buffers, 8);
+    REQUIRE(ring.AcquireFree() != nullptr); // the only buffer is taken now
+
+    std::thread consumer([&] { ring.Abort(); });
+    CHECK(ring.AcquireFree() == nullptr);
+    consumer.join();
+    CHECK(ring.IsAborted());
+    CHECK(ring.Pop() == std::nullopt);
+}
+
+TEST_CASE(PREFIX "transfers a stream between threads")
+{
+    constexpr uint32_t buffer_size = 7;
+    std::array<uint8_t, buffer_size> storage[3];
+    const std::array<uint8_t *, 3> buffers{storage[0].data(), storage[1].data(), storage[2].data()};
+    ChunkRing ring(buffers, buffer_size);
+
+    std::vector<uint8_t> source(100'000);
+    std::iota(source.begin(), source.end(), uint8_t(0));
+    std::vector<uint8_t> destination;
+    bool offsets_match = true;
+
+    std::thread consumer([&] {
+        while( const auto chunk = ring.Pop() ) {
+            offsets_match &= chunk->offset == destination.size();
+            destination.insert(destination.end(), chunk->data, chunk->data + chunk->size);
+            ring.Release(*chunk);
+        }
+    });
+
+    for( size_t offset = 0; offset < source.size(); offset += buffer_size ) {
+        uint8_t *const buffer = ring.AcquireFree();
+        REQUIRE(buffer != nullptr);
+        const auto size = static_cast<uint32_t>(std::min<size_t>(buffer_size, source.size() - offset));
+        std::copy_n(source.data() + offset, size, buffer);
+        ring.Push({.data = buffer, .size = size, .offset = offset});
+    }
+    ring.Finish();
+    consumer.join();
+
+    CHECK(offsets_match);
+    CHECK(destination == source);
+    CHECK(ring.ConsumedBytes() == source.size());
+}
@@ -10,6 +10,8 @@
 #include <VFS/ArcLA.h>
 #include <Base/algo.h>
 #include <Base/WriteAtomically.h>
+#include <fmt/format.h>
+#include <chrono>
 #include <set>
 #include <span>
 #include <fstream>
@@ -1510,6 +1512,148 @@ TEST_CASE(PREFIX "Copying a native file that is being written to")
     CHECK(sz_b < sz_a);
 }
 
+TEST_CASE(PREFIX "Copying a sparse native file preserves its holes")
+{
+    const TempTestDir dir;
+    const std::filesystem::path p = dir.directory / "a";
+    static constexpr size_t file_size = 128'000'000;
+    static constexpr size_t chunk_size = 1'000'000;
+    const auto noise = MakeNoise(chunk_size);
+    {
+        const int f = open(p.c_str(), O_WRONLY | O_CREAT, S_IWUSR | S_IRUSR);
+        REQUIRE(f >= 0);
+        REQUIRE(pwrite(f, noise.data(), chunk_size, 0) == static_cast<ssize_t>(chunk_size));
+        REQUIRE(pwrite(f, noise.data(), chunk_size, file_size / 2) == static_cast<ssize_t>(chunk_size));
+        REQUIRE(ftruncate(f, file_size) == 0);
+        close(f);
+    }
+
+    CopyingOptions opts;
+    opts.docopy = true;
+    opts.verification = CopyingOptions::ChecksumVerification::Always;
+    auto host = TestEnv().vfs_native;
+    Copying op(FetchItems(dir.directory, {"a"}, *host), dir.directory / "b", host, opts);
+    RunOperationAndCheckSuccess(op);
+
+    struct stat st_a;
+    struct stat st_b;
+    REQUIRE(stat(p.c_str(), &st_a) == 0);
+    REQUIRE(stat((dir.directory / "b").c_str(), &st_b) == 0);
+    CHECK(st_b.st_size == st_a.st_size);
+    CHECK(static_cast<size_t>(st_b.st_blocks) * S_BLKSIZE < file_size / 4);
+
+    std::ifstream in_a(p, std::ios::binary);
+    std::ifstream in_b(dir.directory / "b", std::ios::binary);
+    CHECK(std::equal(std::istreambuf_iterator<char>(in_a),
+                     std::istreambuf_iterator<char>(),
+                     std::istreambuf_iterator<char>(in_b),
+                     std::istreambuf_iterator<char>()));
+}
+
+TEST_CASE(PREFIX "Copying hardlinked native files recreates the hardlinks")
+{
+    const TempTestDir dir;
+    const auto src = dir.directory / "src";
+    REQUIRE(std::filesystem::create_directory(src));
+    REQUIRE(Save(src / "a", MakeNoise(1000)));
+    REQUIRE(link((src / "a").c_str(), (src / "b").c_str()) == 0);
+    REQUIRE(std::filesystem::create_directory(src / "dir"));
+    REQUIRE(link((src / "a").c_str(), (src / "dir" / "c").c_str()) == 0);
+    REQUIRE(Save(src / "d", MakeNoise(1000)));
+
+    CopyingOptions opts;
+    opts.docopy = true;
+    auto host = TestEnv().vfs_native;
+    Copying op(FetchItems(dir.directory, {"src"}, *host), dir.directory / "dst", host, opts);
+    RunOperationAndCheckSuccess(op);
+    CHECK(op.RecreatedHardlinksAmount() == 2);
+
+    struct stat st_a;
+    struct stat st_b;
+    struct stat st_c;
+    struct stat st_d;
+    REQUIRE(stat((dir.directory / "dst" / "a").c_str(), &st_a) == 0);
+    REQUIRE(stat((dir.directory / "dst" / "b").c_str(), &st_b) == 0);
+    REQUIRE(stat((dir.directory / "dst" / "dir" / "c").c_str(), &st_c) == 0);
+    REQUIRE(stat((dir.directory / "dst" / "d").c_str(), &st_d) == 0);
+    CHECK(st_a.st_nlink == 3);
+    CHECK(st_a.st_ino == st_b.st_ino);
+    CHECK(st_a.st_ino == st_c.st_ino);
+    CHECK(st_d.st_nlink == 1);
+    CHECK(st_a.st_size == 1000);
+}
+
+TEST_CASE(PREFIX "Copying a tree ordered by physical locality")
+{
+    const TempTestDir dir;
+    const auto src = dir.directory / "src";
+    MakeShuffledSmallFilesTree(src, 10, 10);
+    REQUIRE(link((src / "d0" / "f0").c_str(), (src / "hardlink").c_str()) == 0);
+    REQUIRE(symlink("d0/f0", (src / "symlink").c_str()) == 0);
+
+    CopyingOptions opts;
+    opts.docopy = true;
+    opts.processing_order = CopyingOptions::ProcessingOrder::PhysicalLocality;
+    auto host = TestEnv().vfs_native;
+    Copying op(FetchItems(dir.directory, {"src"}, *host), dir.directory / "dst", host, opts);
+    RunOperationAndCheckSuccess(op);
+    CHECK(op.RecreatedHardlinksAmount() == 1);
+
+    int result = 0;
+    REQUIRE(VFSCompareEntries(src, host, dir.directory / "dst", host, result) == 0);
+    CHECK(result == 0);
+}
+
+TEST_CASE(PREFIX "Benchmark: copying a small-file tree in scan order vs in physical locality order", "[!benchmark]")
+{
+    // Point NC_OPS_BENCHMARK_DIR to a directory on a spinning disk to get meaningful numbers.
+    // Run as root to let the disk caches be purged before each measurement.
+    const TempTestDir dir;
+    const char *const bench_dir = std::getenv("NC_OPS_BENCHMARK_DIR");
+    const auto root = (bench_dir ? std::filesystem::path(bench_dir) : dir.directory) / "nc_ops_copying_benchmark";
+    const auto cleanup = at_scope_end([&] { std::filesystem::remove_all(root); });
+    MakeShuffledSmallFilesTree(root / "src", 100, 100);
+
+    const auto host = TestEnv().vfs_native;
+    using ProcessingOrder = CopyingOptions::ProcessingOrder;
+    for( const auto order : {ProcessingOrder::AsScanned, ProcessingOrder::PhysicalLocality} ) {
+        std::system("/usr/sbin/purge >/dev/null 2>&1");
+        CopyingOptions opts;
+        opts.docopy = true;
+        opts.processing_order = order;
+        Copying op(FetchItems(root, {"src"}, *host), root / "dst", host, opts);
+        const auto start = std::chrono::steady_clock::now();
+        RunOperationAndCheckSuccess(op);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        WARN((order == ProcessingOrder::AsScanned ? "scan order: " : "physical locality order: ")
+             << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms");
+        std::filesystem::remove_all(root / "dst");
+    }
+}
+
+TEST_CASE(PREFIX "Records a trace when asked to")
+{
+    const TempTestDir dir;
+    const auto src = dir.directory / "src";
+    MakeShuffledSmallFilesTree(src, 1, 2);
+
+    CopyingOptions opts;
+    opts.docopy = true;
+    auto host = TestEnv().vfs_native;
+    Copying op(FetchItems(dir.directory, {"src"}, *host), dir.directory / "dst", host, opts);
+    CHECK(op.ExportTrace().empty());
+    op.EnableTracing();
+    RunOperationAndCheckSuccess(op);
+
+    const auto trace = op.ExportTrace();
+    CHECK(trace.contains(R"({"name":"Preparing","cat":"stage")"));
+    CHECK(trace.contains(R"({"name":"Process","cat":"stage")"));
+    CHECK(trace.contains(R"({"name":"nc::ops::CopyingJob","cat":"job")"));
+    for( const auto name : {"Opened", "First byte", "Last byte", "Set attributes"} )
+        CHECK(trace.contains(fmt::format(R"({{"name":"{}","cat":"io")", name)));
+    CHECK(trace.contains(fmt::format(R"("path":"{}")", (src / "d0" / "f1").native())));
+}
+
 static std::vector<std::byte> MakeNoise(size_t _size)
 {
     std::vector<std::byte> bytes(_size);
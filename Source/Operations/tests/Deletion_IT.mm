@@ -5,8 +5,11 @@
 #include <VFS/Native.h>
 #include <VFS/NetFTP.h>
 #include "../source/Deletion/Deletion.h"
+#include "../source/Statistics.h"
 #include "Environment.h"
+#include <Base/algo.h>
 #include <sys/stat.h>
+#include <chrono>
 #include <iostream>
 
 using namespace nc;
@@ -277,6 +280,163 @@ TEST_CASE(PREFIX "Complex deletion")
     REQUIRE(!host->Exists((dir.directory / "Mail.app").c_str()));
 }
 
+TEST_CASE(PREFIX "Nested removal ordered by physical locality")
+{
+    const TempTestDir dir;
+    auto &d = dir.directory;
+    const auto host = TestEnv().vfs_native;
+    MakeShuffledSmallFilesTree(d / "top", 10, 10);
+    REQUIRE(mkdir((d / "top/d0/nested").c_str(), 0755) == 0);
+    close(creat((d / "top/d0/nested/reg").c_str(), 0755));
+    REQUIRE(symlink("d0", (d / "top/symlink").c_str()) == 0);
+
+    DeletionOptions options;
+    options.type = DeletionType::Permanent;
+    options.processing_order = DeletionOptions::ProcessingOrder::PhysicalLocality;
+    Deletion operation{FetchItems(d.native(), {"top"}, *host), options};
+    operation.Start();
+    operation.Wait();
+
+    REQUIRE(operation.State() == OperationState::Completed);
+    REQUIRE(!host->Exists((d / "top").c_str()));
+}
+
+TEST_CASE(PREFIX "Walks and removes a native tree in parallel")
+{
+    const TempTestDir dir;
+    auto &d = dir.directory;
+    const auto host = TestEnv().vfs_native;
+    MakeShuffledSmallFilesTree(d / "top", 50, 20);
+    std::filesystem::path deep = d / "top";
+    for( int i = 0; i < 64; ++i )
+        deep /= "deep";
+    REQUIRE(std::filesystem::create_directories(deep));
+    close(creat((deep / "reg").c_str(), 0755));
+    REQUIRE(symlink("d0", (d / "top/symlink").c_str()) == 0);
+    close(creat((d / "top/file").c_str(), 0755));
+    close(creat((d / "top/._file").c_str(), 0755));
+
+    DeletionOptions options;
+    options.type = DeletionType::Permanent;
+    options.processing_order = DeletionOptions::ProcessingOrder::AsScanned;
+    Deletion operation{FetchItems(d.native(), {"top"}, *host), options};
+    operation.Start();
+    operation.Wait();
+
+    REQUIRE(operation.State() == OperationState::Completed);
+    REQUIRE(!host->Exists((d / "top").c_str()));
+    // top + 50 dirs with 20 files each + 64 nested dirs + reg + symlink + file + ._file
+    CHECK(operation.Statistics().VolumeProcessed(Statistics::SourceType::Items) == 1 + 50 + 1000 + 64 + 4);
+}
+
+TEST_CASE(PREFIX "Walking a native tree - locked file deep inside")
+{
+    const TempTestDir dir;
+    auto &d = dir.directory;
+    const auto host = TestEnv().vfs_native;
+    REQUIRE(std::filesystem::create_directories(d / "top/a/b"));
+    REQUIRE(std::filesystem::create_directories(d / "top/c"));
+    close(creat((d / "top/a/b/locked").c_str(), 0755));
+    close(creat((d / "top/a/b/regular").c_str(), 0755));
+    close(creat((d / "top/c/regular").c_str(), 0755));
+    REQUIRE(chflags((d / "top/a/b/locked").c_str(), UF_IMMUTABLE) == 0);
+
+    DeletionOptions options;
+    options.type = DeletionType::Permanent;
+    options.processing_order = DeletionOptions::ProcessingOrder::AsScanned;
+    SECTION("Skip: the locked file and its ancestors are kept")
+    {
+        options.locked_items_behaviour = DeletionOptions::LockedItemBehavior::SkipAll;
+        Deletion operation{FetchItems(d.native(), {"top"}, *host), options};
+        operation.Start();
+        operation.Wait();
+        REQUIRE(operation.State() == OperationState::Completed);
+        CHECK(host->Exists((d / "top/a/b/locked").c_str()));
+        CHECK(!host->Exists((d / "top/a/b/regular").c_str()));
+        CHECK(!host->Exists((d / "top/c").c_str()));
+        REQUIRE(chflags((d / "top/a/b/locked").c_str(), 0) == 0);
+    }
+    SECTION("Unlock: removed")
+    {
+        options.locked_items_behaviour = DeletionOptions::LockedItemBehavior::UnlockAll;
+        Deletion operation{FetchItems(d.native(), {"top"}, *host), options};
+        operation.Start();
+        operation.Wait();
+        REQUIRE(operation.State() == OperationState::Completed);
+        CHECK(!host->Exists((d / "top").c_str()));
+    }
+    SECTION("Default: ask => fail")
+    {
+        Deletion operation{FetchItems(d.native(), {"top"}, *host), options};
+        operation.Start();
+        operation.Wait();
+        REQUIRE(operation.State() == OperationState::Stopped);
+        CHECK(host->Exists((d / "top/a/b/locked").c_str()));
+        REQUIRE(chflags((d / "top/a/b/locked").c_str(), 0) == 0);
+    }
+}
+
+TEST_CASE(PREFIX "Benchmark: removing a small-file tree in scan order vs in physical locality order", "[!benchmark]")
+{
+    // Point NC_OPS_BENCHMARK_DIR to a directory on a spinning disk to get meaningful numbers.
+    // Run as root to let the disk caches be purged before each measurement.
+    const TempTestDir dir;
+    const char *const bench_dir = std::getenv("NC_OPS_BENCHMARK_DIR");
+    const auto root = (bench_dir ? std::filesystem::path(bench_dir) : dir.directory) / "nc_ops_deletion_benchmark";
+    const auto cleanup = at_scope_end([&] { std::filesystem::remove_all(root); });
+    MakeShuffledSmallFilesTree(root / "scan", 100, 100);
+    MakeShuffledSmallFilesTree(root / "locality", 100, 100);
+
+    const auto host = TestEnv().vfs_native;
+    using ProcessingOrder = DeletionOptions::ProcessingOrder;
+    for( const auto order : {ProcessingOrder::AsScanned, ProcessingOrder::PhysicalLocality} ) {
+        std::system("/usr/sbin/purge >/dev/null 2>&1");
+        DeletionOptions options;
+        options.type = DeletionType::Permanent;
+        options.processing_order = order;
+        const auto name = order == ProcessingOrder::AsScanned ? "scan" : "locality";
+        Deletion operation{FetchItems(root.native(), {name}, *host), options};
+        const auto start = std::chrono::steady_clock::now();
+        operation.Start();
+        operation.Wait();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        REQUIRE(operation.State() == OperationState::Completed);
+        WARN((order == ProcessingOrder::AsScanned ? "scan order: " : "physical locality order: ")
+             << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms");
+    }
+}
+
+TEST_CASE(PREFIX "Benchmark: walking a native tree vs rm -rf", "[!benchmark]")
+{
+    const TempTestDir dir;
+    const char *const bench_dir = std::getenv("NC_OPS_BENCHMARK_DIR");
+    const auto root = (bench_dir ? std::filesystem::path(bench_dir) : dir.directory) / "nc_ops_deletion_benchmark";
+    const auto cleanup = at_scope_end([&] { std::filesystem::remove_all(root); });
+    MakeShuffledSmallFilesTree(root / "nc", 300, 300);
+    MakeShuffledSmallFilesTree(root / "rm", 300, 300);
+
+    const auto host = TestEnv().vfs_native;
+    {
+        DeletionOptions options;
+        options.type = DeletionType::Permanent;
+        options.processing_order = DeletionOptions::ProcessingOrder::AsScanned;
+        Deletion operation{FetchItems(root.native(), {"nc"}, *host), options};
+        const auto start = std::chrono::steady_clock::now();
+        operation.Start();
+        operation.Wait();
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        REQUIRE(operation.State() == OperationState::Completed);
+        WARN("native tree walk: " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms");
+    }
+    {
+        const auto command = "/bin/rm -rf '" + (root / "rm").native() + "'";
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE(std::system(command.c_str()) == 0);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        WARN("rm -rf: " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms");
+    }
+}
+
 TEST_CASE(PREFIX "Simple delete from FTP")
 {
     VFSHostPtr host;
@@ -0,0 +1,101 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "../source/JobTrace.h"
+#include <thread>
+
+using nc::ops::JobTrace;
+
+#define PREFIX "nc::ops::JobTrace "
+
+static size_t Occurrences(std::string_view _string, std::string_view _substring)
+{
+    size_t count = 0;
+    for( auto pos = _string.find(_substring); pos != std::string_view::npos; pos = _string.find(_substring, pos + 1) )
+        ++count;
+    return count;
+}
+
+TEST_CASE(PREFIX "exports an empty trace")
+{
+    const JobTrace trace;
+    CHECK(trace.EventsCount() == 0);
+    CHECK(trace.ExportChromeTrace() ==
+          R"({"displayTimeUnit":"ms","otherData":{"dropped_events":0},"traceEvents":[]})");
+}
+
+TEST_CASE(PREFIX "records spans and marks")
+{
+    JobTrace trace;
+    {
+        JobTrace::Span span{&trace, "Item", "copying", {{"path", "/a/b"}, {"bytes", 42}}};
+        trace.Mark("First byte", "io");
+        span.AddArg({"result", "skipped"});
+    }
+    CHECK(trace.EventsCount() == 2);
+    const auto json = trace.ExportChromeTrace();
+    CHECK(json.contains(R"({"name":"First byte","cat":"io","ph":"i","pid":1,"tid":0,"ts":)"));
+    CHECK(json.contains(R"({"name":"Item","cat":"copying","ph":"X","pid":1,"tid":0,"ts":)"));
+    CHECK(json.contains(R"("args":{"path":"/a/b","bytes":42,"result":"skipped"}})"));
+    CHECK(Occurrences(json, R"("ph":"M")") == 1);
+}
+
+TEST_CASE(PREFIX "a span without a trace does nothing")
+{
+    JobTrace::Span span{nullptr, "Item", "copying", {{"path", "/a/b"}}};
+    span.AddArg({"bytes", 1});
+    span.End();
+}
+
+TEST_CASE(PREFIX "a moved span is recorded only once")
+{
+    JobTrace trace;
+    {
+        JobTrace::Span span1{&trace, "Span", "test"};
+        JobTrace::Span span2 = std::move(span1);
+        JobTrace::Span span3;
+        span3 = std::move(span2);
+    }
+    CHECK(trace.EventsCount() == 1);
+}
+
+TEST_CASE(PREFIX "records stages as consecutive spans")
+{
+    JobTrace trace;
+    trace.SetStage("Preparing");
+    trace.SetStage("Process");
+    CHECK(trace.EventsCount() == 1);
+    const auto open = trace.ExportChromeTrace(); // the current stage is exported as well
+    CHECK(open.contains(R"({"name":"Preparing","cat":"stage","ph":"X")"));
+    CHECK(open.contains(R"({"name":"Process","cat":"stage","ph":"X")"));
+    trace.SetStage({});
+    CHECK(trace.EventsCount() == 2);
+    CHECK(Occurrences(trace.ExportChromeTrace(), R"("cat":"stage")") == 2);
+}
+
+TEST_CASE(PREFIX "escapes strings")
+{
+    JobTrace trace;
+    trace.Mark("Item", "item", {{"path", "/a\"b\\c\nd\x01"}});
+    CHECK(trace.ExportChromeTrace().contains(R"("args":{"path":"/a\"b\\c\nd\u0001"})"));
+}
+
+TEST_CASE(PREFIX "drops events past the limit")
+{
+    JobTrace trace(3);
+    for( int i = 0; i != 10; ++i )
+        trace.Mark("Mark", "test");
+    CHECK(trace.EventsCount() == 3);
+    CHECK(trace.DroppedEventsCount() == 7);
+    CHECK(trace.ExportChromeTrace().contains(R"("dropped_events":7)"));
+}
+
+TEST_CASE(PREFIX "distinguishes threads")
+{
+    JobTrace trace;
+    trace.Mark("Mark", "test");
+    std::thread([&] { trace.Mark("Mark", "test"); }).join();
+    const auto json = trace.ExportChromeTrace();
+    CHECK(Occurrences(json, R"("ph":"M")") == 2);
+    CHECK(json.contains(R"("ph":"i","pid":1,"tid":0,)"));
+    CHECK(json.contains(R"("ph":"i","pid":1,"tid":1,)"));
+}
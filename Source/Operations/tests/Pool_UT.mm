@@ -1,4 +1,4 @@
-// Copyright (C) 2021-2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2021-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "Tests.h"
 #include "TestEnv.h"
 #include "../source/Pool.h"
@@ -332,3 +332,141 @@ TEST_CASE(PREFIX "Does enqueueing as the callback says")
         CHECK(op2->State() == nc::ops::OperationState::Completed);
     }
 }
+
+TEST_CASE(PREFIX "Limits the concurrency per device")
+{
+    struct MyJob : public Job {
+        void Perform() override
+        {
+            while( !done )
+                std::this_thread::sleep_for(std::chrono::microseconds{100});
+            SetCompleted();
+        }
+        std::atomic_bool done{false};
+    };
+    struct MyOperation : public Operation {
+        MyOperation(std::vector<OperationResource> _resources) { SetResources(std::move(_resources)); }
+        ~MyOperation() override { Wait(); }
+        Job *GetJob() noexcept override { return &job; }
+        MyJob job;
+    };
+    using Kind = OperationResource::Kind;
+    const OperationResource hdd1{Kind::Rotational, "disk1"};
+    const OperationResource hdd2{Kind::Rotational, "disk2"};
+    const OperationResource ssd{Kind::SolidState, "disk3"};
+    const OperationResource ftp{Kind::Remote, "net_ftp:ftp.example.com"};
+
+    auto pool = Pool::Make();
+    pool->SetConcurrency(10);
+    CHECK(pool->ResourceConcurrency(Kind::Rotational) == 1);
+    CHECK(pool->ResourceConcurrency(Kind::SolidState) == 4);
+    CHECK(pool->ResourceConcurrency(Kind::Remote) == 2);
+    pool->SetResourceConcurrency(Kind::Rotational, 1);
+    pool->SetResourceConcurrency(Kind::SolidState, 2);
+    pool->SetResourceConcurrency(Kind::Remote, 1);
+
+    SECTION("Operations on the same HDD are queued, while an operation on another one runs")
+    {
+        auto op1 = std::make_shared<MyOperation>(std::vector{hdd1});
+        auto op2 = std::make_shared<MyOperation>(std::vector{hdd1});
+        auto op3 = std::make_shared<MyOperation>(std::vector{hdd2});
+        pool->Enqueue(op1);
+        pool->Enqueue(op2);
+        pool->Enqueue(op3);
+        CHECK(op1->State() == OperationState::Running);
+        CHECK(op2->State() == OperationState::Cold);
+        CHECK(op3->State() == OperationState::Running);
+        CHECK(pool->RunningOperations() == VecOp{op1, op3});
+
+        op1->job.done = true;
+        CHECK(check_until_or_die([&] { return op2->State() == OperationState::Running; }, 1s));
+        op2->job.done = true;
+        op3->job.done = true;
+        CHECK(check_until_or_die([&] { return pool->Empty(); }, 1s));
+    }
+    SECTION("An SSD admits as many operations as its limit says")
+    {
+        auto op1 = std::make_shared<MyOperation>(std::vector{ssd});
+        auto op2 = std::make_shared<MyOperation>(std::vector{ssd});
+        auto op3 = std::make_shared<MyOperation>(std::vector{ssd});
+        pool->Enqueue(op1);
+        pool->Enqueue(op2);
+        pool->Enqueue(op3);
+        CHECK(op1->State() == OperationState::Running);
+        CHECK(op2->State() == OperationState::Running);
+        CHECK(op3->State() == OperationState::Cold);
+
+        op2->job.done = true;
+        CHECK(check_until_or_die([&] { return op3->State() == OperationState::Running; }, 1s));
+        op1->job.done = true;
+        op3->job.done = true;
+        CHECK(check_until_or_die([&] { return pool->Empty(); }, 1s));
+    }
+    SECTION("An operation occupies all its devices at once")
+    {
+        auto copy_hdd1_to_ftp = std::make_shared<MyOperation>(std::vector{hdd1, ftp});
+        auto delete_on_ftp = std::make_shared<MyOperation>(std::vector{ftp});
+        auto copy_ssd_to_hdd1 = std::make_shared<MyOperation>(std::vector{ssd, hdd1});
+        auto delete_on_ssd = std::make_shared<MyOperation>(std::vector{ssd});
+        pool->Enqueue(copy_hdd1_to_ftp);
+        pool->Enqueue(delete_on_ftp);
+        pool->Enqueue(copy_ssd_to_hdd1);
+        pool->Enqueue(delete_on_ssd);
+        CHECK(copy_hdd1_to_ftp->State() == OperationState::Running);
+        CHECK(delete_on_ftp->State() == OperationState::Cold);
+        CHECK(copy_ssd_to_hdd1->State() == OperationState::Cold);
+        CHECK(delete_on_ssd->State() == OperationState::Running);
+
+        copy_hdd1_to_ftp->job.done = true;
+        CHECK(check_until_or_die(
+            [&] {
+                return delete_on_ftp->State() == OperationState::Running &&
+                       copy_ssd_to_hdd1->State() == OperationState::Running;
+            },
+            1s));
+        delete_on_ftp->job.done = true;
+        copy_ssd_to_hdd1->job.done = true;
+        delete_on_ssd->job.done = true;
+        CHECK(check_until_or_die([&] { return pool->Empty(); }, 1s));
+    }
+    SECTION("The overall concurrency limit still applies")
+    {
+        pool->SetConcurrency(1);
+        auto op1 = std::make_shared<MyOperation>(std::vector{hdd1});
+        auto op2 = std::make_shared<MyOperation>(std::vector{hdd2});
+        pool->Enqueue(op1);
+        pool->Enqueue(op2);
+        CHECK(op1->State() == OperationState::Running);
+        CHECK(op2->State() == OperationState::Cold);
+
+        op1->job.done = true;
+        CHECK(check_until_or_die([&] { return op2->State() == OperationState::Running; }, 1s));
+        op2->job.done = true;
+        CHECK(check_until_or_die([&] { return pool->Empty(); }, 1s));
+    }
+    SECTION("Operations without declared resources are not limited per device")
+    {
+        auto op1 = std::make_shared<MyOperation>(std::vector{hdd1});
+        auto op2 = std::make_shared<MyOperation>(std::vector<OperationResource>{});
+        auto op3 = std::make_shared<MyOperation>(std::vector<OperationResource>{});
+        pool->Enqueue(op1);
+        pool->Enqueue(op2);
+        pool->Enqueue(op3);
+        CHECK(op1->State() == OperationState::Running);
+        CHECK(op2->State() == OperationState::Running);
+        CHECK(op3->State() == OperationState::Running);
+        op1->job.done = true;
+        op2->job.done = true;
+        op3->job.done = true;
+        CHECK(check_until_or_die([&] { return pool->Empty(); }, 1s));
+    }
+    SECTION("Duplicate resources of an operation are counted once")
+    {
+        auto op = std::make_shared<MyOperation>(std::vector{hdd1, hdd1});
+        CHECK(op->Resources() == std::vector{hdd1});
+        pool->Enqueue(op);
+        CHECK(op->State() == OperationState::Running);
+        op->job.done = true;
+        CHECK(check_until_or_die([&] { return pool->Empty(); }, 1s));
+    }
+}
@@ -0,0 +1,171 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "../source/Progress.h"
+#include <numeric>
+#include <thread>
+
+using nc::ops::Progress;
+using namespace std::chrono_literals;
+
+#define PREFIX "nc::ops::Progress "
+
+static double SumOf(const std::vector<Progress::TimePoint> &_data)
+{
+    return std::accumulate(
+        _data.begin(), _data.end(), 0., [](double _sum, const Progress::TimePoint &_tp) { return _sum + _tp.value; });
+}
+
+TEST_CASE(PREFIX "is empty by default")
+{
+    Progress p;
+    p.SetupTiming(0ns);
+    CHECK(p.VolumeProcessed() == 0);
+    CHECK(p.VolumePerSecondDirect() == 0.);
+    CHECK(p.VolumePerSecondAverage() == 0.);
+    CHECK(p.ETA() == std::nullopt);
+    for( size_t level = 0; level != Progress::TimelineLevels; ++level )
+        CHECK(p.Data(level).empty());
+}
+
+TEST_CASE(PREFIX "measures a steady speed and ETA")
+{
+    Progress p;
+    p.SetupTiming(0ns);
+    p.CommitEstimated(10'000'000);
+    // 1000 per 100ms during 5 minutes
+    for( auto t = 100ms; t <= 5min; t += 100ms )
+        p.CommitProcessed(1000, t);
+
+    CHECK(p.VolumeProcessed() == 3'000'000);
+    CHECK(p.VolumePerSecondDirect() == Approx(10'000.));
+    CHECK(p.VolumePerSecondAverage() == Approx(10'000.).epsilon(0.01));
+    REQUIRE(p.ETA());
+    CHECK(double(p.ETA()->count()) == Approx(double(std::chrono::nanoseconds(700s).count())).epsilon(0.001));
+
+    const auto data = p.Data();
+    CHECK(data.size() == Progress::TimelineLevelSamples - 2); // the last commit has just opened a new empty period
+    for( auto &tp : data ) {
+        CHECK(tp.value == Approx(10'000.f).epsilon(0.01));
+        CHECK(tp.fraction == Approx(1.f));
+    }
+}
+
+TEST_CASE(PREFIX "spreads a volume of a sparse commit evenly over the time since the previous one")
+{
+    Progress p;
+    p.SetupTiming(0ns);
+    p.CommitProcessed(100, 1s);
+    p.CommitProcessed(4000, 5s);
+    p.CommitProcessed(50, 5500ms);
+
+    const auto data = p.Data();
+    REQUIRE(data.size() == 6);
+    CHECK(data[0].value == 100.f);
+    for( size_t i = 1; i != 5; ++i )
+        CHECK(data[i].value == Approx(1000.f));
+    CHECK(data[5].value == 50.f);
+    CHECK(data[5].fraction == Approx(0.5f));
+    CHECK(p.VolumePerSecondAverage() == Approx(4150. / 5.5));
+}
+
+TEST_CASE(PREFIX "excludes the slept time")
+{
+    Progress p;
+    p.SetupTiming(0ns);
+    p.CommitProcessed(1000, 10s);
+    p.ReportSleptDelta(60s);
+    p.CommitProcessed(1000, 80s);
+    CHECK(p.VolumePerSecondDirect() == Approx(100.));
+    CHECK(p.VolumePerSecondAverage() == Approx(100.));
+    CHECK(SumOf(p.Data()) == Approx(2000.));
+}
+
+TEST_CASE(PREFIX "follows the speed changes in the recent samples")
+{
+    Progress p;
+    p.SetupTiming(0ns);
+    auto t = 0ns;
+    for( ; t < 100s; t += 250ms )
+        p.CommitProcessed(250, t + 250ms);
+    for( ; t < 200s; t += 250ms )
+        p.CommitProcessed(750, t + 250ms);
+
+    CHECK(p.VolumePerSecondDirect() == Approx(2000.));
+    CHECK(p.VolumePerSecondAverage() == Approx(2000.).epsilon(0.05));
+    for( auto &tp : p.Data() )
+        CHECK(tp.value == Approx(3000.f));
+    const auto coarse = p.Data(1);
+    REQUIRE(coarse.size() == 13);
+    CHECK(coarse.front().value == Approx(16'000.f));
+    CHECK(coarse.back().value == Approx(24'000.f));
+    CHECK(coarse.back().fraction == Approx(0.5f));
+}
+
+TEST_CASE(PREFIX "keeps a bounded timeline during a multi-day run")
+{
+    Progress p;
+    p.SetupTiming(0ns);
+    const uint64_t per_second = 1'000'000;
+    const auto duration = std::chrono::nanoseconds(72h);
+    for( auto t = 1s; t <= duration; t += 1s )
+        p.CommitProcessed(per_second, t);
+
+    CHECK(p.VolumeProcessed() == per_second * 72 * 3600);
+    CHECK(p.VolumePerSecondDirect() == Approx(double(per_second)));
+    CHECK(p.VolumePerSecondAverage() == Approx(double(per_second)));
+    for( size_t level = 0; level != Progress::TimelineLevels; ++level ) {
+        const auto data = p.Data(level);
+        CHECK(data.size() <= Progress::TimelineLevelSamples);
+        const auto period_seconds = double(Progress::TimelineResolution(level).count()) / 1'000'000'000.;
+        for( size_t i = 0; i + 1 < data.size(); ++i )
+            CHECK(data[i].value == Approx(per_second * period_seconds));
+    }
+    // the coarsest level still spans the whole run
+    const auto coarsest = p.Data(Progress::TimelineLevels - 1);
+    CHECK(SumOf(coarsest) == Approx(double(p.VolumeProcessed())));
+}
+
+TEST_CASE(PREFIX "can be committed to and read from concurrently")
+{
+    Progress p;
+    p.SetupTiming();
+    std::atomic_bool done = false;
+    std::thread reader([&] {
+        while( !done ) {
+            for( auto &tp : p.Data() )
+                if( tp.value > 400'000.f || tp.fraction <= 0.f || tp.fraction > 1.f )
+                    done = true;
+            [[maybe_unused]] const auto avg = p.VolumePerSecondAverage();
+        }
+    });
+    std::vector<std::thread> writers;
+    for( int i = 0; i != 4; ++i )
+        writers.emplace_back([&] {
+            for( int j = 0; j != 100'000; ++j )
+                p.CommitProcessed(1);
+        });
+    for( auto &writer : writers )
+        writer.join();
+    const bool reader_was_fine = !done;
+    done = true;
+    reader.join();
+    CHECK(reader_was_fine);
+    CHECK(p.VolumeProcessed() == 400'000);
+    CHECK(SumOf(p.Data()) == Approx(400'000.)); // the commits skipped while recording are picked up eventually
+}
+
+TEST_CASE(PREFIX "accumulates the slept time reported concurrently")
+{
+    Progress p;
+    p.SetupTiming(0ns);
+    std::vector<std::thread> sleepers;
+    for( int i = 0; i != 4; ++i )
+        sleepers.emplace_back([&] {
+            for( int j = 0; j != 1'000; ++j )
+                p.ReportSleptDelta(1ms);
+        });
+    for( auto &sleeper : sleepers )
+        sleeper.join();
+    p.CommitProcessed(1000, 14s);
+    CHECK(p.VolumePerSecondDirect() == Approx(100.));
+}
@@ -12,6 +12,8 @@
 #include <Base/CommonPaths.h>
 #include <Base/dispatch_cpp.h>
 #include <boost/process.hpp>
+#include <fstream>
+#include <random>
 
 #include <spdlog/sinks/stdout_sinks.h>
 #include <VFS/Log.h>
@@ -82,6 +84,24 @@ TempTestDmg::~TempTestDmg()
     Execute(unmount_cmd);
 }
 
+void MakeShuffledSmallFilesTree(const std::filesystem::path &_root, int _dirs, int _files_per_dir)
+{
+    std::vector<std::filesystem::path> files;
+    for( int d = 0; d < _dirs; ++d ) {
+        const auto dir = _root / ("d" + std::to_string(d));
+        REQUIRE(std::filesystem::create_directories(dir));
+        for( int f = 0; f < _files_per_dir; ++f )
+            files.emplace_back(dir / ("f" + std::to_string(f)));
+    }
+    std::ranges::shuffle(files, std::mt19937{42});
+    const std::string content(4096, 'x');
+    for( const auto &file : files ) {
+        std::ofstream out(file, std::ios::out | std::ios::binary);
+        REQUIRE(out);
+        out << content;
+    }
+}
+
 static int Execute(const std::string &_command)
 {
     using namespace boost::process;
@@ -22,6 +22,10 @@ struct TempTestDmg {
     std::filesystem::path directory;
 };
 
+// Creates _dirs directories with _files_per_dir small files each, in a random order, so that the inode numbers of the
+// files don't follow the order in which the directories are listed.
+void MakeShuffledSmallFilesTree(const std::filesystem::path &_root, int _dirs, int _files_per_dir);
+
 #ifndef NCE
 #if __has_include(<.nc_sensitive.h>)
 #include <.nc_sensitive.h>
@@ -1,4 +1,4 @@
-// Copyright (C) 2013-2020 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2013-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <VFS/VFSListing.h>
@@ -253,30 +253,41 @@ public:
 
     /**
      * A batch version of SetCalculatedSizeForDirectory.
+     * The sizes set with _possibly_stale are marked as such until the fresh ones are set.
      * Returns a number of entries found and set.
      */
     size_t SetCalculatedSizesForDirectories(std::span<const std::string_view> _filenames,
                                             std::span<const std::string_view> _directories,
-                                            std::span<const uint64_t> _sizes);
+                                            std::span<const uint64_t> _sizes,
+                                            bool _possibly_stale = false);
 
     /**
      * A batch version of SetCalculatedSizeForDirectory that accepts raw item indices.
+     * The sizes set with _possibly_stale are marked as such until the fresh ones are set.
      * Returns a number of entries found and set.
      */
     size_t SetCalculatedSizesForDirectories(std::span<const unsigned> _raw_items_indices,
-                                            std::span<const uint64_t> _sizes);
+                                            std::span<const uint64_t> _sizes,
+                                            bool _possibly_stale = false);
 
     /**
-     * Call it in emergency case.
+     * Asserts the consistency of the internal state, including the selection statistics against a full recalculation.
+     * The mutators call it after every change, its checks are compiled into the debug builds only.
      */
     void __InvariantCheck() const;
 
 private:
     void DoSortWithHardFiltering();
+    void DoSortWithHardFilteringAdjustingStatistics();
     void CustomFlagsSelectRaw(int _at_raw_pos, bool _is_selected);
     void ClearSelectedFlagsFromHiddenElements();
     void UpdateStatictics();
+    Statistics CalculateStatistics() const;
+    void CountSelected(unsigned _raw_index, bool _is_counted) noexcept;
+    bool SetCalculatedSize(unsigned _raw_index, uint64_t _size, bool _possibly_stale) noexcept;
     void BuildSoftFilteringIndeces();
+    void NarrowSoftFilteringIndeces();
+    void SoftFilter(std::span<const unsigned> _sorted_indices);
     void FinalizeSettingCalculatedSizes();
 
     // m_Listing container will change every time directory change/reloads,
@@ -297,6 +308,10 @@ private:
 
     // sorted and filtered, points at m_EntriesByCustomSort indices, not the raw ones
     std::vector<unsigned> m_EntriesBySoftFiltering;
+
+    // sorted indices of the entries rejected by the soft filter which a narrower filter has to test again anyway,
+    // since their names don't have HasSimpleCaseFolding()
+    std::vector<unsigned> m_SoftFilteringRecheck;
     struct SortMode m_CustomSortMode;
     HardFilter m_HardFiltering;
     TextualFilter m_SoftFiltering;
@@ -49,6 +49,23 @@ private:
     bool IsLessByFilesystemRepresentation(unsigned _1, unsigned _2) const;
 };
 
+// Sorts the indices of the listing items in the order defined by IndirectListingComparator. Instead of comparing the
+// items pairwise, it computes a compact binary key per item once and sorts these keys. The keys of the names only
+// approximate the collations of the system, so the result is verified with the comparator and the indices are sorted by
+// the comparator itself when the approximation doesn't hold.
+void SortIndirectly(const VFSListing &_items,
+                    std::span<const ItemVolatileData> _vd,
+                    SortMode _sort_mode,
+                    std::span<unsigned> _indices);
+
+// The first half of SortIndirectly(): sorts the indices by the keys alone, without verifying the order. Returns false
+// and leaves the indices intact if some names can't be keyed, i.e. the non-ASCII names under the case-insensitive or
+// the natural collation.
+bool SortByCollationKeys(const VFSListing &_items,
+                         std::span<const ItemVolatileData> _vd,
+                         SortMode _sort_mode,
+                         std::span<unsigned> _indices);
+
 class ExternalListingComparator : private ListingComparatorBase
 {
 public:
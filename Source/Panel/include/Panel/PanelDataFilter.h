@@ -42,6 +42,10 @@ struct TextualFilter {
     bool IsValidItem(const VFSListingItem &_item) const;
     void OnPanelDataLoad();
     bool IsFiltering() const noexcept;
+
+    // Tells whether this filter accepts only the items accepted by the _broader filter as well, e.g. when its text
+    // extends the text of the _broader one. Holds only for the items whose names have HasSimpleCaseFolding().
+    bool Narrows(const TextualFilter &_broader) const noexcept;
 } __attribute__((packed));
 
 struct HardFilter {
@@ -55,4 +59,8 @@ struct HardFilter {
 
 std::optional<QuickSearchHiglight> FuzzySearch(NSString *_filename, NSString *_text) noexcept;
 
+// Tells whether every UTF-16 unit of the filename is compared case-insensitively on its own, i.e. the name has no
+// combining marks, surrogate pairs or characters which are folded into several units.
+bool HasSimpleCaseFolding(NSString *_filename) noexcept;
+
 } // namespace nc::panel::data
@@ -63,7 +63,8 @@ struct ItemVolatileData {
     enum {
         flag_selected = 1 << 0,
         flag_shown = 1 << 1,
-        flag_highlight = 1 << 2 // temporary item highlight, for instance for context menu
+        flag_highlight = 1 << 2, // temporary item highlight, for instance for context menu
+        flag_size_stale = 1 << 3 // the calculated size was taken from a cache and can be outdated
     };
 
     // for directories will contain invalid_size or actually calculated size. for other types will contain the original
@@ -83,9 +84,11 @@ struct ItemVolatileData {
     bool is_shown() const noexcept;
     bool is_highlighted() const noexcept;
     bool is_size_calculated() const noexcept;
+    bool is_size_stale() const noexcept;
     void toggle_selected(bool _v) noexcept;
     void toggle_shown(bool _v) noexcept;
     void toggle_highlight(bool _v) noexcept;
+    void toggle_size_stale(bool _v) noexcept;
     constexpr auto operator<=>(const ItemVolatileData &_rhs) const noexcept = default;
 };
 
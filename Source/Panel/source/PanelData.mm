@@ -13,8 +13,8 @@
 
 namespace nc::panel::data {
 
-// Don't bother with parallelism unless we have at least 10'000 items in a listing
-constexpr inline size_t g_ParallelSortThresh = 10'000;
+// Don't bother with parallelism unless we have at least 10'000 items in a filtering pass
+constexpr inline size_t g_ParallelFilterThresh = 10'000;
 
 static void DoRawSort(const VFSListing &_from, std::vector<unsigned> &_to);
 
@@ -412,10 +412,10 @@ void Model::SetSortMode(struct SortMode _mode)
     m_CustomSortMode = _mode;
     DoSortWithHardFiltering();
     BuildSoftFilteringIndeces();
-    UpdateStatictics();
+    __InvariantCheck();
 }
 
-// need to call UpdateStatictics() after this method since we alter selected set
+// the hidden entries aren't counted in the statistics, so deselecting them doesn't change it
 void Model::ClearSelectedFlagsFromHiddenElements()
 {
     for( auto &vd : m_VolatileData )
@@ -430,37 +430,87 @@ SortMode Model::SortMode() const
 
 void Model::UpdateStatictics()
 {
-    m_Stats = Statistics{};
+    m_Stats = CalculateStatistics();
+}
+
+Statistics Model::CalculateStatistics() const
+{
+    Statistics stats;
     if( m_Listing.get() == nullptr )
-        return;
+        return stats;
     assert(m_Listing->Count() == m_VolatileData.size());
 
-    m_Stats.total_entries_amount = m_Listing->Count();
+    stats.total_entries_amount = m_Listing->Count();
     if( !m_Listing->Empty() && m_Listing->IsDotDot(0) )
-        m_Stats.total_entries_amount--;
+        stats.total_entries_amount--;
 
     // calculate totals for directory
     for( const auto &i : *m_Listing )
         if( i.IsReg() ) {
-            m_Stats.bytes_in_raw_reg_files += i.Size();
-            m_Stats.raw_reg_files_amount++;
+            stats.bytes_in_raw_reg_files += i.Size();
+            stats.raw_reg_files_amount++;
         }
 
     // calculate totals for selected. look only for entries which is visible (sorted/filtered ones)
     for( auto n : m_EntriesByCustomSort ) {
         const auto &vd = m_VolatileData[n];
         if( vd.is_selected() ) {
-            m_Stats.bytes_in_selected_entries += vd.is_size_calculated() ? vd.size : 0;
+            stats.bytes_in_selected_entries += vd.is_size_calculated() ? vd.size : 0;
 
-            m_Stats.selected_entries_amount++;
+            stats.selected_entries_amount++;
             if( m_Listing->IsDir(n) )
-                m_Stats.selected_dirs_amount++;
+                stats.selected_dirs_amount++;
             else
-                m_Stats.selected_reg_amount++;
+                stats.selected_reg_amount++;
+        }
+    }
+    return stats;
+}
+
+void Model::CountSelected(unsigned _raw_index, bool _is_counted) noexcept
+{
+    const auto &vd = m_VolatileData[_raw_index];
+    const auto sz = vd.is_size_calculated() ? vd.size : 0;
+    if( _is_counted ) {
+        m_Stats.bytes_in_selected_entries += sz;
+        m_Stats.selected_entries_amount++;
+        if( m_Listing->IsDir(_raw_index) )
+            m_Stats.selected_dirs_amount++;
+        else
+            m_Stats.selected_reg_amount++; // mb another check for reg here?
+    }
+    else {
+        m_Stats.bytes_in_selected_entries =
+            m_Stats.bytes_in_selected_entries >= static_cast<int64_t>(sz) ? m_Stats.bytes_in_selected_entries - sz : 0;
+
+        assert(m_Stats.selected_entries_amount > 0); // sanity check
+        m_Stats.selected_entries_amount--;
+        if( m_Listing->IsDir(_raw_index) ) {
+            assert(m_Stats.selected_dirs_amount > 0);
+            m_Stats.selected_dirs_amount--;
+        }
+        else {
+            assert(m_Stats.selected_reg_amount > 0);
+            m_Stats.selected_reg_amount--;
         }
     }
 }
 
+bool Model::SetCalculatedSize(unsigned _raw_index, uint64_t _size, bool _possibly_stale) noexcept
+{
+    auto &vd = m_VolatileData[_raw_index];
+    if( vd.size == _size && vd.is_size_stale() == _possibly_stale )
+        return false;
+    vd.toggle_size_stale(_possibly_stale);
+    const bool counted = vd.is_selected() && vd.is_shown();
+    if( counted )
+        CountSelected(_raw_index, false);
+    vd.size = _size;
+    if( counted )
+        CountSelected(_raw_index, true);
+    return true;
+}
+
 int Model::SortedIndexForRawIndex(int _index) const noexcept
 {
     if( _index < 0 || static_cast<size_t>(_index) >= m_ReverseToCustomSort.size() )
@@ -519,31 +569,10 @@ void Model::CustomFlagsSelectRaw(int _at_raw_pos, bool _is_selected)
     if( vd.is_selected() == _is_selected ) // check if item is already selected
         return;
 
-    auto sz = vd.is_size_calculated() ? vd.size : 0;
-    if( _is_selected ) {
-        m_Stats.bytes_in_selected_entries += sz;
-        m_Stats.selected_entries_amount++;
-        if( m_Listing->IsDir(_at_raw_pos) )
-            m_Stats.selected_dirs_amount++;
-        else
-            m_Stats.selected_reg_amount++; // mb another check for reg here?
-    }
-    else {
-        m_Stats.bytes_in_selected_entries =
-            m_Stats.bytes_in_selected_entries >= static_cast<int64_t>(sz) ? m_Stats.bytes_in_selected_entries - sz : 0;
-
-        assert(m_Stats.selected_entries_amount > 0); // sanity check
-        m_Stats.selected_entries_amount--;
-        if( m_Listing->IsDir(_at_raw_pos) ) {
-            assert(m_Stats.selected_dirs_amount > 0);
-            m_Stats.selected_dirs_amount--;
-        }
-        else {
-            assert(m_Stats.selected_reg_amount > 0);
-            m_Stats.selected_reg_amount--;
-        }
-    }
+    if( vd.is_shown() )
+        CountSelected(_at_raw_pos, _is_selected);
     vd.toggle_selected(_is_selected);
+    __InvariantCheck();
 }
 
 void Model::CustomFlagsSelectSorted(int _at_sorted_pos, bool _is_selected)
@@ -560,19 +589,16 @@ bool Model::CustomFlagsSelectSorted(const std::vector<bool> &_is_selected)
     for( int i = 0, e = static_cast<int>(std::min(_is_selected.size(), m_EntriesByCustomSort.size())); i != e; ++i ) {
         const auto raw_pos = m_EntriesByCustomSort[i];
         if( !m_Listing->IsDotDot(raw_pos) ) {
-            if( !changed ) {
-                if( m_VolatileData[raw_pos].is_selected() != _is_selected[i] ) {
-                    m_VolatileData[raw_pos].toggle_selected(_is_selected[i]);
-                    changed = true;
-                }
-            }
-            else {
-                m_VolatileData[raw_pos].toggle_selected(_is_selected[i]);
+            auto &vd = m_VolatileData[raw_pos];
+            if( vd.is_selected() != _is_selected[i] ) {
+                if( vd.is_shown() )
+                    CountSelected(raw_pos, _is_selected[i]);
+                vd.toggle_selected(_is_selected[i]);
+                changed = true;
             }
         }
     }
-    if( changed )
-        UpdateStatictics();
+    __InvariantCheck();
     return changed;
 }
 
@@ -620,13 +646,9 @@ bool Model::SetCalculatedSizeForDirectory(std::string_view _filename, std::strin
     for( const auto raw_index : raw_indices ) {
         assert(m_Listing->Filename(raw_index) == _filename);
         if( m_Listing->IsDir(raw_index) && m_Listing->Directory(raw_index) == _directory ) {
-            auto &vd = m_VolatileData[raw_index];
-            if( vd.size == _size )
-                return true;
-
-            vd.size = _size;
-
-            FinalizeSettingCalculatedSizes();
+            if( SetCalculatedSize(raw_index, _size, false) )
+                FinalizeSettingCalculatedSizes();
+            __InvariantCheck();
             return true;
         }
     }
@@ -636,7 +658,8 @@ bool Model::SetCalculatedSizeForDirectory(std::string_view _filename, std::strin
 
 size_t Model::SetCalculatedSizesForDirectories(std::span<const std::string_view> _filenames,
                                                std::span<const std::string_view> _directories,
-                                               std::span<const uint64_t> _sizes)
+                                               std::span<const uint64_t> _sizes,
+                                               bool _possibly_stale)
 {
     if( _filenames.size() != _directories.size() || _filenames.size() != _sizes.size() )
         return 0;
@@ -659,11 +682,8 @@ size_t Model::SetCalculatedSizesForDirectories(std::span<const std::string_view>
             assert(listing->Filename(raw_index) == filename);
             if( listing->IsDir(raw_index) && listing->Directory(raw_index) == directory ) {
                 ++num_set;
-                auto &vd = m_VolatileData[raw_index];
-                if( vd.size != size ) {
-                    vd.size = size;
+                if( SetCalculatedSize(raw_index, size, _possibly_stale) )
                     ++num_changed;
-                }
                 break;
             }
         }
@@ -671,12 +691,14 @@ size_t Model::SetCalculatedSizesForDirectories(std::span<const std::string_view>
 
     if( num_changed != 0 )
         FinalizeSettingCalculatedSizes();
+    __InvariantCheck();
 
     return num_set;
 }
 
 size_t Model::SetCalculatedSizesForDirectories(std::span<const unsigned> _raw_items_indices,
-                                               std::span<const uint64_t> _sizes)
+                                               std::span<const uint64_t> _sizes,
+                                               bool _possibly_stale)
 {
     if( _raw_items_indices.size() != _sizes.size() )
         return 0;
@@ -695,27 +717,25 @@ size_t Model::SetCalculatedSizesForDirectories(std::span<const unsigned> _raw_it
 
         if( listing->IsDir(raw_index) ) {
             ++num_set;
-            auto &vd = m_VolatileData[raw_index];
-            if( vd.size != size ) {
-                vd.size = size;
+            if( SetCalculatedSize(raw_index, size, _possibly_stale) )
                 ++num_changed;
-            }
         }
     }
 
     if( num_changed != 0 )
         FinalizeSettingCalculatedSizes();
+    __InvariantCheck();
 
     return num_set;
 }
 
 void Model::FinalizeSettingCalculatedSizes()
 {
-    // double-check me
+    // the statistics are already adjusted and the sizes don't affect the filtering, only the sorting by size
+    if( m_CustomSortMode.sort != SortMode::SortBySize && m_CustomSortMode.sort != SortMode::SortBySizeRev )
+        return;
     DoSortWithHardFiltering();
-    ClearSelectedFlagsFromHiddenElements();
     BuildSoftFilteringIndeces();
-    UpdateStatictics();
 }
 
 void Model::CustomIconClearAll()
@@ -747,10 +767,9 @@ bool Model::ClearTextFiltering()
         vd.highlight = {};
     }
 
-    DoSortWithHardFiltering();
-    ClearSelectedFlagsFromHiddenElements(); // not sure if this is needed here
+    DoSortWithHardFilteringAdjustingStatistics();
     BuildSoftFilteringIndeces();
-    UpdateStatictics();
+    __InvariantCheck();
     return true;
 }
 
@@ -761,10 +780,9 @@ void Model::SetHardFiltering(const HardFilter &_filter)
 
     m_HardFiltering = _filter;
 
-    DoSortWithHardFiltering();
-    ClearSelectedFlagsFromHiddenElements();
+    DoSortWithHardFilteringAdjustingStatistics();
     BuildSoftFilteringIndeces();
-    UpdateStatictics();
+    __InvariantCheck();
 }
 
 HardFilter Model::HardFiltering() const
@@ -772,6 +790,26 @@ HardFilter Model::HardFiltering() const
     return m_HardFiltering;
 }
 
+void Model::DoSortWithHardFilteringAdjustingStatistics()
+{
+    // only the selected entries which become hidden or shown affect the statistics
+    std::vector<unsigned> counted;
+    for( const unsigned raw_index : m_EntriesByCustomSort )
+        if( m_VolatileData[raw_index].is_selected() )
+            counted.push_back(raw_index);
+    std::ranges::sort(counted);
+
+    DoSortWithHardFiltering();
+
+    for( const unsigned raw_index : counted )
+        if( !m_VolatileData[raw_index].is_shown() )
+            CountSelected(raw_index, false);
+    ClearSelectedFlagsFromHiddenElements();
+    for( const unsigned raw_index : m_EntriesByCustomSort )
+        if( m_VolatileData[raw_index].is_selected() && !std::ranges::binary_search(counted, raw_index) )
+            CountSelected(raw_index, true);
+}
+
 void Model::DoSortWithHardFiltering()
 {
     m_EntriesByCustomSort.clear();
@@ -826,10 +864,7 @@ void Model::DoSortWithHardFiltering()
     const auto first = std::next(m_EntriesByCustomSort.begin(), m_Listing->IsDotDot(0) ? 1 : 0);
     const auto last = std::end(m_EntriesByCustomSort);
 
-    if( m_EntriesByCustomSort.size() < g_ParallelSortThresh )
-        std::sort(first, last, IndirectListingComparator{*m_Listing, m_VolatileData, m_CustomSortMode});
-    else
-        pstld::sort(first, last, IndirectListingComparator{*m_Listing, m_VolatileData, m_CustomSortMode});
+    SortIndirectly(*m_Listing, m_VolatileData, m_CustomSortMode, {first, last});
 
     m_ReverseToCustomSort.resize(size);
     std::ranges::fill(m_ReverseToCustomSort, std::numeric_limits<unsigned>::max());
@@ -842,8 +877,16 @@ void Model::DoSortWithHardFiltering()
 
 void Model::SetSoftFiltering(const TextualFilter &_filter)
 {
+    // typing a quick search text usually extends the previous one, so only the entries accepted by the previous
+    // filter have to be tested again
+    const bool narrowing =
+        _filter.Narrows(m_SoftFiltering) && _filter.hightlight_results == m_SoftFiltering.hightlight_results;
     m_SoftFiltering = _filter;
-    BuildSoftFilteringIndeces();
+    if( narrowing )
+        NarrowSoftFilteringIndeces();
+    else
+        BuildSoftFilteringIndeces();
+    __InvariantCheck();
 }
 
 TextualFilter Model::SoftFiltering() const
@@ -859,26 +902,60 @@ const std::vector<unsigned> &Model::EntriesBySoftFiltering() const noexcept
 void Model::BuildSoftFilteringIndeces()
 {
     if( m_SoftFiltering.IsFiltering() ) {
-        m_EntriesBySoftFiltering.clear();
-        m_EntriesBySoftFiltering.reserve(m_EntriesByCustomSort.size());
-
-        int i = 0;
-        const int e = static_cast<int>(m_EntriesByCustomSort.size());
-        for( ; i != e; ++i ) {
-            QuickSearchHiglight found_range;
-            const int raw_index = m_EntriesByCustomSort[i];
-            if( m_SoftFiltering.IsValidItem(m_Listing->Item(raw_index), found_range) )
-                m_EntriesBySoftFiltering.push_back(i);
-
-            if( m_SoftFiltering.hightlight_results ) {
-                m_VolatileData[raw_index].highlight = found_range;
-            }
-        }
+        std::vector<unsigned> all(m_EntriesByCustomSort.size());
+        // NOLINTNEXTLINE - Xcode16 doesn't have std::ranges::iota
+        std::iota(all.begin(), all.end(), 0);
+        SoftFilter(all);
     }
     else {
         m_EntriesBySoftFiltering.resize(m_EntriesByCustomSort.size());
         // NOLINTNEXTLINE - Xcode16 doesn't have std::ranges::iota
         std::iota(m_EntriesBySoftFiltering.begin(), m_EntriesBySoftFiltering.end(), 0);
+        m_SoftFilteringRecheck.clear();
+    }
+}
+
+void Model::NarrowSoftFilteringIndeces()
+{
+    // the entries rejected before are rejected now as well and already have an empty highlight
+    std::vector<unsigned> candidates(m_EntriesBySoftFiltering.size() + m_SoftFilteringRecheck.size());
+    std::ranges::merge(m_EntriesBySoftFiltering, m_SoftFilteringRecheck, candidates.begin());
+    SoftFilter(candidates);
+}
+
+void Model::SoftFilter(std::span<const unsigned> _sorted_indices)
+{
+    struct Verdict {
+        QuickSearchHiglight highlight;
+        bool accepted = false;
+        bool recheck = false;
+    };
+    auto test = [this](unsigned _sorted_index) {
+        Verdict verdict;
+        const VFSListingItem item = m_Listing->Item(m_EntriesByCustomSort[_sorted_index]);
+        verdict.accepted = m_SoftFiltering.IsValidItem(item, verdict.highlight);
+        verdict.recheck = !verdict.accepted && !HasSimpleCaseFolding(item.DisplayNameNS());
+        return verdict;
+    };
+    std::vector<Verdict> verdicts(_sorted_indices.size());
+    if( _sorted_indices.size() < g_ParallelFilterThresh )
+        std::ranges::transform(_sorted_indices, verdicts.begin(), test);
+    else
+        pstld::transform(_sorted_indices.begin(), _sorted_indices.end(), verdicts.begin(), test);
+
+    m_EntriesBySoftFiltering.clear();
+    m_SoftFilteringRecheck.clear();
+    for( size_t i = 0; i != _sorted_indices.size(); ++i ) {
+        const unsigned sorted_index = _sorted_indices[i];
+        const Verdict &verdict = verdicts[i];
+        if( verdict.accepted )
+            m_EntriesBySoftFiltering.push_back(sorted_index);
+        else if( verdict.recheck )
+            m_SoftFilteringRecheck.push_back(sorted_index);
+
+        if( m_SoftFiltering.hightlight_results ) {
+            m_VolatileData[m_EntriesByCustomSort[sorted_index]].highlight = verdict.highlight;
+        }
     }
 }
 
@@ -917,6 +994,8 @@ void Model::__InvariantCheck() const
     assert(m_EntriesByRawName.size() == m_Listing->Count());
     assert(m_EntriesByCustomSort.size() <= m_Listing->Count());
     assert(m_EntriesBySoftFiltering.size() <= m_EntriesByCustomSort.size());
+    assert(m_EntriesBySoftFiltering.size() + m_SoftFilteringRecheck.size() <= m_EntriesByCustomSort.size());
+    assert(m_Stats == CalculateStatistics());
 }
 
 int Model::RawEntriesCount() const noexcept
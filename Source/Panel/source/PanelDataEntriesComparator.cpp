@@ -2,9 +2,44 @@
 #include "PanelDataEntriesComparator.h"
 #include "PanelDataItemVolatileData.h"
 #include "PanelDataExternalEntryKey.h"
+#include <pstld/pstld.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string_view>
 
 namespace nc::panel::data {
 
+// Don't bother with parallelism unless there are at least 10'000 items to sort
+static constexpr size_t g_ParallelSortThresh = 10'000;
+
+// The primary weight of a number in the natural keys, which is between the punctuation and the letters
+static constexpr unsigned char g_NaturalNumberWeight = 0x40;
+
+// The primary weights of the ASCII characters other than digits and letters in the natural keys. They follow the
+// order of the default Unicode collation, zero marks the characters that aren't keyed.
+static constexpr std::array<unsigned char, 128> g_NaturalPunctuationWeights = [] {
+    std::array<unsigned char, 128> weights = {};
+    const std::string_view order = " _-,;:!?.'\"()[]{}@*/\\&#%`^+<=>|~$";
+    for( size_t i = 0; i != order.size(); ++i )
+        weights[static_cast<unsigned char>(order[i])] = static_cast<unsigned char>(i + 1);
+    return weights;
+}();
+
+namespace {
+
+// The position of an item in the sort order. The keys are compared by the groups, then by the primary values and then
+// by the bytes of the names, which are compared in the reversed order for the reversed sort modes.
+struct CollationKey {
+    uint64_t group = 0;   // the directories-last and the lacks-a-value bits
+    uint64_t primary = 0; // the sorted-by value mapped to the ascending order, if any
+    uint32_t name_offset = 0;
+    uint32_t name_length = 0;
+    unsigned index = 0;
+};
+
+} // namespace
+
 ListingComparatorBase::ListingComparatorBase(const VFSListing &_items,
                                              std::span<const ItemVolatileData> _vd,
                                              SortMode _sort_mode)
@@ -270,6 +305,218 @@ int IndirectListingComparator::CompareNames(unsigned _1, unsigned _2) const
     return Compare(l.DisplayFilenameCF(_1), l.DisplayFilenameCF(_2));
 }
 
+// Approximates [NSString localizedStandardCompare:] for the ASCII names. The primary level compares the punctuation,
+// the numbers by their values and the letters regardless of their case. The tertiary level puts lowercase first.
+static bool AppendNaturalKey(std::string_view _name, std::vector<unsigned char> &_key)
+{
+    const auto is_digit = [](char _c) { return _c >= '0' && _c <= '9'; };
+    for( size_t i = 0; i < _name.size(); ) {
+        const auto c = static_cast<unsigned char>(_name[i]);
+        if( c >= 0x80 )
+            return false;
+        if( is_digit(_name[i]) ) {
+            size_t end = i;
+            while( end != _name.size() && is_digit(_name[end]) )
+                ++end;
+            while( i + 1 != end && _name[i] == '0' )
+                ++i;
+            _key.push_back(g_NaturalNumberWeight);
+            _key.push_back(static_cast<unsigned char>(std::min(end - i, size_t(255))));
+            for( ; i != end; ++i )
+                _key.push_back(static_cast<unsigned char>(_name[i]));
+            continue;
+        }
+        if( c >= 'A' && c <= 'Z' )
+            _key.push_back(static_cast<unsigned char>(c + 32));
+        else if( c >= 'a' && c <= 'z' )
+            _key.push_back(c);
+        else if( g_NaturalPunctuationWeights[c] != 0 )
+            _key.push_back(g_NaturalPunctuationWeights[c]);
+        else
+            return false; // control characters
+        ++i;
+    }
+
+    _key.push_back(0);
+    for( const char c : _name ) {
+        if( c >= 'a' && c <= 'z' )
+            _key.push_back(1);
+        else if( c >= 'A' && c <= 'Z' )
+            _key.push_back(2);
+    }
+    return true;
+}
+
+// Appends the key of the name for the collation, or returns false if the name can't be keyed
+static bool AppendNameKey(std::string_view _name, SortMode::Collation _collation, std::vector<unsigned char> &_key)
+{
+    switch( _collation ) {
+        case SortMode::Collation::Natural:
+            return AppendNaturalKey(_name, _key);
+        case SortMode::Collation::CaseInsensitive:
+            for( const char c : _name ) {
+                const auto u = static_cast<unsigned char>(c);
+                if( u >= 0x80 )
+                    return false;
+                _key.push_back(u >= 'A' && u <= 'Z' ? static_cast<unsigned char>(u + 32) : u);
+            }
+            return true;
+        case SortMode::Collation::CaseSensitive:
+            for( const char c : _name )
+                _key.push_back(static_cast<unsigned char>(c));
+            return true;
+    }
+    return false;
+}
+
+// Appends the key of the extension as ListingComparatorBase::Compare() treats it, followed by a zero terminator
+static void AppendExtensionKey(const char *_extension, SortMode::Collation _collation, std::vector<unsigned char> &_key)
+{
+    const bool fold = _collation != SortMode::Collation::CaseSensitive;
+    for( const char *c = _extension; *c != 0; ++c ) {
+        const auto u = static_cast<unsigned char>(*c);
+        _key.push_back(fold && u >= 'A' && u <= 'Z' ? static_cast<unsigned char>(u + 32) : u);
+    }
+    _key.push_back(0);
+}
+
+static bool BuildCollationKeys(const VFSListing &_items,
+                               std::span<const ItemVolatileData> _vd,
+                               SortMode _sort_mode,
+                               std::span<const unsigned> _indices,
+                               std::vector<CollationKey> &_keys,
+                               std::vector<unsigned char> &_names)
+{
+    using _ = SortMode::Mode;
+    constexpr auto invalid_size = ItemVolatileData::invalid_size;
+    const auto ascending = [](time_t _time) { return static_cast<uint64_t>(_time) ^ (uint64_t(1) << 63); };
+
+    _keys.resize(_indices.size());
+    for( size_t i = 0; i != _indices.size(); ++i ) {
+        const unsigned index = _indices[i];
+        CollationKey &key = _keys[i];
+        key.index = index;
+        key.name_offset = static_cast<uint32_t>(_names.size());
+        if( _sort_mode.sep_dirs && !_items.IsDir(index) )
+            key.group |= 2;
+
+        bool by_name = true;
+        switch( _sort_mode.sort ) {
+            case _::SortNoSort:
+                return false;
+            case _::SortByName:
+            case _::SortByNameRev:
+                break;
+            case _::SortByExt:
+            case _::SortByExtRev: {
+                const bool has_extension =
+                    _items.HasExtension(index) && (!_sort_mode.extensionless_dirs || !_items.IsDir(index));
+                key.group |= has_extension == (_sort_mode.sort == _::SortByExt) ? 1 : 0;
+                if( has_extension )
+                    AppendExtensionKey(_items.Extension(index), _sort_mode.collation, _names);
+                break;
+            }
+            case _::SortByModTime:
+                key.primary = ~ascending(_items.MTime(index));
+                break;
+            case _::SortByModTimeRev:
+                key.primary = ascending(_items.MTime(index));
+                break;
+            case _::SortByBirthTime:
+                key.primary = ~ascending(_items.BTime(index));
+                break;
+            case _::SortByBirthTimeRev:
+                key.primary = ascending(_items.BTime(index));
+                break;
+            case _::SortByAccessTime:
+                key.primary = ~ascending(_items.ATime(index));
+                break;
+            case _::SortByAccessTimeRev:
+                key.primary = ascending(_items.ATime(index));
+                break;
+            case _::SortByAddTime:
+            case _::SortByAddTimeRev: {
+                const bool has_add_time = _items.HasAddTime(index);
+                const bool descending = _sort_mode.sort == _::SortByAddTime;
+                key.group |= has_add_time != descending ? 1 : 0;
+                if( has_add_time )
+                    key.primary = descending ? ~ascending(_items.AddTime(index)) : ascending(_items.AddTime(index));
+                break;
+            }
+            case _::SortBySize:
+            case _::SortBySizeRev: {
+                const uint64_t size = _vd[index].size;
+                const bool has_size = size != invalid_size;
+                const bool descending = _sort_mode.sort == _::SortBySize;
+                key.group |= has_size == descending ? 1 : 0;
+                if( has_size )
+                    key.primary = descending ? ~size : size;
+                break;
+            }
+            case _::SortByRawCName: {
+                const std::string &filename = _items.Filename(index);
+                _names.insert(_names.end(), filename.begin(), filename.end());
+                by_name = false;
+                break;
+            }
+        }
+
+        if( by_name && !AppendNameKey(_items.DisplayFilename(index), _sort_mode.collation, _names) )
+            return false;
+        key.name_length = static_cast<uint32_t>(_names.size() - key.name_offset);
+    }
+    return true;
+}
+
+bool SortByCollationKeys(const VFSListing &_items,
+                         std::span<const ItemVolatileData> _vd,
+                         SortMode _sort_mode,
+                         std::span<unsigned> _indices)
+{
+    std::vector<CollationKey> keys;
+    std::vector<unsigned char> names;
+    if( !BuildCollationKeys(_items, _vd, _sort_mode, _indices, keys, names) )
+        return false;
+
+    const bool reversed_names = _sort_mode.isrevert();
+    const auto less = [&](const CollationKey &_1, const CollationKey &_2) {
+        if( _1.group != _2.group )
+            return _1.group < _2.group;
+        if( _1.primary != _2.primary )
+            return _1.primary < _2.primary;
+        const int cmp = std::memcmp(
+            names.data() + _1.name_offset, names.data() + _2.name_offset, std::min(_1.name_length, _2.name_length));
+        const int names_cmp = cmp != 0 ? cmp : static_cast<int>(_1.name_length) - static_cast<int>(_2.name_length);
+        return reversed_names ? names_cmp > 0 : names_cmp < 0;
+    };
+    if( _indices.size() >= g_ParallelSortThresh )
+        pstld::stable_sort(keys.begin(), keys.end(), less);
+    else
+        std::ranges::stable_sort(keys, less);
+    std::ranges::transform(keys, _indices.begin(), &CollationKey::index);
+    return true;
+}
+
+void SortIndirectly(const VFSListing &_items,
+                    std::span<const ItemVolatileData> _vd,
+                    SortMode _sort_mode,
+                    std::span<unsigned> _indices)
+{
+    const IndirectListingComparator comparator(_items, _vd, _sort_mode);
+    const bool parallel = _indices.size() >= g_ParallelSortThresh;
+
+    // the keys of the names are merely an approximation, so the order is verified with the precise comparisons
+    if( SortByCollationKeys(_items, _vd, _sort_mode, _indices) &&
+        (parallel ? pstld::is_sorted(_indices.begin(), _indices.end(), comparator)
+                  : std::is_sorted(_indices.begin(), _indices.end(), comparator)) )
+        return;
+
+    if( parallel )
+        pstld::sort(_indices.begin(), _indices.end(), comparator);
+    else
+        std::sort(_indices.begin(), _indices.end(), comparator);
+}
+
 ExternalListingComparator::ExternalListingComparator(const VFSListing &_items,
                                                      std::span<const ItemVolatileData> _vd,
                                                      SortMode sort_mode)
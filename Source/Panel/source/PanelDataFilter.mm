@@ -3,7 +3,12 @@
 #include <VFS/VFS.h>
 #include <Base/CFPtr.h>
 #include <Base/CFStackAllocator.h>
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <memory_resource>
+#include <mutex>
+#include <span>
 
 namespace nc::panel::data {
 
@@ -78,11 +83,154 @@ static bool FuzzySearchSatisfiable(CFStringRef _hay,
     return true;
 }
 
-std::optional<QuickSearchHiglight> FuzzySearch(NSString *_filename, NSString *_text) noexcept
+// The texts longer than the number of bits in the bitap state and the names longer than this are matched by NSString.
+static constexpr size_t g_FastFuzzyMaxTextLength = 64;
+static constexpr size_t g_FastFuzzyMaxNameLength = 1024;
+
+// Units that can't be compared on their own are folded into this value.
+static constexpr UniChar g_NotFoldable = 0;
+
+// Computes the case folding of the characters in a block of 256 code units.
+static void FoldBlock(size_t _block, std::span<UniChar, 256> _folded) noexcept
 {
-    assert(_filename != nil);
-    assert(_text != nil);
+    const CFCharacterSetRef non_base = CFCharacterSetGetPredefined(kCFCharacterSetNonBase);
+    const CFCharacterSetRef control = CFCharacterSetGetPredefined(kCFCharacterSetControl);
+    const base::CFStackAllocator alloc;
+    for( size_t i = 0; i != 256; ++i ) {
+        const auto c = static_cast<UniChar>((_block << 8) | i);
+        _folded[i] = g_NotFoldable;
+
+        // surrogates, combining marks, conjoining jamo and format characters form sequences with their neighbours
+        if( (c >= 0xD800 && c <= 0xDFFF) || (c >= 0x1100 && c <= 0x11FF) || (c >= 0xA960 && c <= 0xA97F) ||
+            (c >= 0xD7B0 && c <= 0xD7FF) || CFCharacterSetIsCharacterMember(non_base, c) ||
+            CFCharacterSetIsCharacterMember(control, c) )
+            continue;
+
+        const auto str = base::CFPtr<CFMutableStringRef>::adopt(CFStringCreateMutable(alloc, 0));
+        CFStringAppendCharacters(str.get(), &c, 1);
+        CFStringFold(str.get(), kCFCompareCaseInsensitive, nullptr);
+        CFStringNormalize(str.get(), kCFStringNormalizationFormC);
+        if( CFStringGetLength(str.get()) == 1 ) // e.g. "ß" is folded into "ss"
+            _folded[i] = CFStringGetCharacterAtIndex(str.get(), 0);
+    }
+}
+
+// Returns the case folding of the unit as NSCaseInsensitiveSearch sees it, or g_NotFoldable if the unit has to be
+// compared along with its neighbours or doesn't fold into a single unit.
+static UniChar FoldUnit(UniChar _c) noexcept
+{
+    if( _c < 0x80 )
+        return _c >= 'A' && _c <= 'Z' ? static_cast<UniChar>(_c + 32) : (_c < 0x20 || _c == 0x7F ? g_NotFoldable : _c);
+
+    [[clang::no_destroy]] static std::array<std::once_flag, 256> once;
+    [[clang::no_destroy]] static std::array<std::array<UniChar, 256>, 256> folded;
+    const size_t block = _c >> 8;
+    std::call_once(once[block], [block] { FoldBlock(block, folded[block]); });
+    return folded[block][_c & 0xFF];
+}
+
+// Places the folded units of the string into the buffer. Returns false if any of them can't be folded on its own.
+static bool FoldString(CFStringRef _str, std::span<UniChar> _buffer) noexcept
+{
+    const auto length = static_cast<size_t>(CFStringGetLength(_str));
+    assert(length == _buffer.size());
+    if( const UniChar *const chars = CFStringGetCharactersPtr(_str) )
+        std::copy_n(chars, length, _buffer.data());
+    else
+        CFStringGetCharacters(_str, CFRangeMake(0, static_cast<CFIndex>(length)), _buffer.data());
+    for( UniChar &c : _buffer )
+        if( (c = FoldUnit(c)) == g_NotFoldable )
+            return false;
+    return true;
+}
+
+// The same greedy search as the one done via NSString below, over the folded units. The leftmost occurrences of all
+// the prefixes of the remaining text are found in a single Shift-And pass over the name, while the satisfiability of
+// the rest of the text after a prefix is a lookup in the rightmost starting positions of its suffixes.
+static std::optional<QuickSearchHiglight> FuzzySearchFolded(std::span<const UniChar> _name,
+                                                            std::span<const UniChar> _text) noexcept
+{
+    const size_t name_len = _name.size();
+    const size_t text_len = _text.size();
+    assert(text_len <= g_FastFuzzyMaxTextLength);
+    if( text_len == 0 )
+        return QuickSearchHiglight{};
+
+    // the rest of the text starting at k can be found at or after p iff p <= latest_start[k]
+    std::array<size_t, g_FastFuzzyMaxTextLength + 1> latest_start;
+    latest_start[text_len] = name_len;
+    for( size_t k = text_len, pos = name_len; k-- > 0; ) {
+        do {
+            if( pos == 0 )
+                return std::nullopt;
+            --pos;
+        } while( _name[pos] != _text[k] );
+        latest_start[k] = pos;
+    }
+
+    // the bit i of a character's mask is set if the i-th unit of the text is that character
+    std::array<uint64_t, 128> ascii_masks = {};
+    std::array<UniChar, g_FastFuzzyMaxTextLength> other_chars;
+    std::array<uint64_t, g_FastFuzzyMaxTextLength> other_masks;
+    size_t others = 0;
+    for( size_t i = 0; i != text_len; ++i ) {
+        const UniChar c = _text[i];
+        if( c < 128 ) {
+            ascii_masks[c] |= uint64_t(1) << i;
+            continue;
+        }
+        const auto it = std::find(other_chars.begin(), other_chars.begin() + others, c);
+        if( it == other_chars.begin() + others ) {
+            other_chars[others] = c;
+            other_masks[others++] = 0;
+        }
+        other_masks[static_cast<size_t>(it - other_chars.begin())] |= uint64_t(1) << i;
+    }
+    const auto mask = [&](UniChar _c) -> uint64_t {
+        if( _c < 128 )
+            return ascii_masks[_c];
+        const auto it = std::find(other_chars.begin(), other_chars.begin() + others, _c);
+        return it == other_chars.begin() + others ? 0 : other_masks[static_cast<size_t>(it - other_chars.begin())];
+    };
+
+    std::array<QuickSearchHiglight::Range, g_FastFuzzyMaxTextLength> found;
+    size_t found_count = 0;
+    std::array<size_t, g_FastFuzzyMaxTextLength> first_end; // of the leftmost occurrence of each prefix length - 1
+    size_t name_pos = 0;
+    size_t text_pos = 0;
+    while( text_pos != text_len ) {
+        const size_t rest = text_len - text_pos;
+        const uint64_t all = rest == 64 ? ~uint64_t(0) : (uint64_t(1) << rest) - 1;
+        uint64_t state = 0;
+        uint64_t seen = 0;
+        for( size_t i = name_pos; i != name_len && seen != all; ++i ) {
+            state = ((state << 1) | 1) & (mask(_name[i]) >> text_pos);
+            for( uint64_t fresh = state & ~seen; fresh != 0; fresh &= fresh - 1 )
+                first_end[static_cast<size_t>(std::countr_zero(fresh))] = i + 1;
+            seen |= state;
+        }
+
+        size_t length = rest;
+        for( ; length != 0; --length ) {
+            if( (seen & (uint64_t(1) << (length - 1))) == 0 )
+                continue; // no substring this long
+            if( latest_start[text_pos + length] < first_end[length - 1] )
+                continue; // too greedy - the rest of the criterion is not satisfiable
+            break;
+        }
+        if( length == 0 )
+            return std::nullopt;
+
+        found[found_count++] = {first_end[length - 1] - length, length};
+        name_pos = first_end[length - 1];
+        text_pos += length;
+    }
 
+    return QuickSearchHiglight({found.data(), found_count});
+}
+
+static std::optional<QuickSearchHiglight> FuzzySearchNS(NSString *_filename, NSString *_text) noexcept
+{
     const base::CFPtr<CFStringRef> cf_filename =
         base::CFPtr<CFStringRef>::adopt(static_cast<CFStringRef>(CFBridgingRetain(_filename)));
 
@@ -133,6 +281,38 @@ std::optional<QuickSearchHiglight> FuzzySearch(NSString *_filename, NSString *_t
     return QuickSearchHiglight({found.data(), found.size()}); // might discard some results here
 }
 
+std::optional<QuickSearchHiglight> FuzzySearch(NSString *_filename, NSString *_text) noexcept
+{
+    assert(_filename != nil);
+    assert(_text != nil);
+
+    const auto name_len = static_cast<size_t>(_filename.length);
+    const auto text_len = static_cast<size_t>(_text.length);
+    if( name_len > g_FastFuzzyMaxNameLength || text_len > g_FastFuzzyMaxTextLength )
+        return FuzzySearchNS(_filename, _text);
+
+    std::array<UniChar, g_FastFuzzyMaxNameLength> name;
+    std::array<UniChar, g_FastFuzzyMaxTextLength> text;
+    if( !FoldString((__bridge CFStringRef)_filename, {name.data(), name_len}) ||
+        !FoldString((__bridge CFStringRef)_text, {text.data(), text_len}) )
+        return FuzzySearchNS(_filename, _text);
+
+    return FuzzySearchFolded({name.data(), name_len}, {text.data(), text_len});
+}
+
+bool HasSimpleCaseFolding(NSString *_filename) noexcept
+{
+    assert(_filename != nil);
+    const auto cf_filename = (__bridge CFStringRef)_filename;
+    const CFIndex length = CFStringGetLength(cf_filename);
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer(cf_filename, &buffer, CFRangeMake(0, length));
+    for( CFIndex i = 0; i < length; ++i )
+        if( FoldUnit(CFStringGetCharacterFromInlineBuffer(&buffer, i)) == g_NotFoldable )
+            return false;
+    return true;
+}
+
 bool TextualFilter::IsValidItem(const VFSListingItem &_item, QuickSearchHiglight &_found_range) const
 {
     _found_range = {};
@@ -241,6 +421,46 @@ bool TextualFilter::IsFiltering() const noexcept
     return text != nil && text.length > 0;
 }
 
+bool TextualFilter::Narrows(const TextualFilter &_broader) const noexcept
+{
+    if( !IsFiltering() || !_broader.IsFiltering() || type != _broader.type ||
+        ignore_dot_dot != _broader.ignore_dot_dot )
+        return false;
+
+    NSString *const broader_text = _broader.text;
+    const NSUInteger length = text.length;
+    const NSUInteger broader_length = broader_text.length;
+    if( broader_length > length )
+        return false;
+
+    // the broader text must occupy whole composed character sequences, otherwise e.g. "e" doesn't narrow into "e\u0301"
+    const auto is_boundary = [&](NSUInteger _index) {
+        return _index == length || [text rangeOfComposedCharacterSequenceAtIndex:_index].location == _index;
+    };
+    const auto is_at = [&](NSUInteger _index) {
+        return is_boundary(_index) && is_boundary(_index + broader_length) &&
+               [text compare:broader_text options:NSLiteralSearch range:NSMakeRange(_index, broader_length)] ==
+                   NSOrderedSame;
+    };
+
+    switch( type ) {
+        case Anywhere:
+        case Fuzzy:
+            // the text contains the broader one, which is then a subsequence of it as well
+            for( NSUInteger index = 0; index + broader_length <= length; ++index )
+                if( is_at(index) )
+                    return true;
+            return false;
+        case Beginning:
+            return is_at(0);
+        case Ending:
+            return is_at(length - broader_length);
+        case BeginningOrEnding:
+            return is_at(0) && is_at(length - broader_length);
+    }
+    return false;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////
 // HardFilter
 //////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -103,6 +103,11 @@ bool ItemVolatileData::is_size_calculated() const noexcept
     return size != invalid_size;
 }
 
+bool ItemVolatileData::is_size_stale() const noexcept
+{
+    return (flags & flag_size_stale) != 0;
+}
+
 void ItemVolatileData::toggle_selected(bool _v) noexcept
 {
     flags = (flags & ~flag_selected) | (_v ? flag_selected : 0);
@@ -118,4 +123,9 @@ void ItemVolatileData::toggle_highlight(bool _v) noexcept
     flags = (flags & ~flag_highlight) | (_v ? flag_highlight : 0);
 }
 
+void ItemVolatileData::toggle_size_stale(bool _v) noexcept
+{
+    flags = (flags & ~flag_size_stale) | (_v ? flag_size_stale : 0);
+}
+
 } // namespace nc::panel::data
@@ -1,12 +1,15 @@
 // Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "Tests.h"
+#include <algorithm>
+#include <numeric>
 #include <random>
 #include <fmt/format.h>
 #include <sys/dirent.h>
 #include <VFS/VFS.h>
 #include <VFS/VFSListingInput.h>
 #include "PanelData.h"
+#include "PanelDataEntriesComparator.h"
 #include "PanelDataItemVolatileData.h"
 #include "PanelDataSelection.h"
 
@@ -136,3 +139,36 @@ TEST_CASE("Sorting performace test")
         return model.RawEntriesCount();
     };
 }
+
+TEST_CASE("Natural sorting of ASCII names performance test")
+{
+    // only the ASCII names are keyed under the natural collation, thus the others are left out
+    std::mt19937 rng(42);
+    std::vector<std::string> filenames;
+    while( filenames.size() < 20'000 )
+        if( auto filename = GenerateFilename(rng);
+            std::ranges::all_of(filename, [](char _c) { return static_cast<unsigned char>(_c) < 0x80; }) )
+            filenames.push_back(std::move(filename));
+
+    const auto listing = ProduceDummyListing(filenames);
+    const std::vector<ItemVolatileData> vd(listing->Count());
+    SortMode mode;
+    mode.sort = SortMode::Mode::SortByName;
+    mode.collation = SortMode::Collation::Natural;
+    std::vector<unsigned> shuffled(listing->Count());
+    std::iota(shuffled.begin(), shuffled.end(), 0); // NOLINT
+    std::ranges::shuffle(shuffled, rng);
+
+    BENCHMARK("Comparator")
+    {
+        std::vector<unsigned> indices = shuffled;
+        std::sort(indices.begin(), indices.end(), data::IndirectListingComparator(*listing, vd, mode));
+        return indices;
+    };
+    BENCHMARK("Collation keys")
+    {
+        std::vector<unsigned> indices = shuffled;
+        data::SortIndirectly(*listing, vd, mode, indices);
+        return indices;
+    };
+}
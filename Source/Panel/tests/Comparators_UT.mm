@@ -5,6 +5,8 @@
 #include "PanelDataEntriesComparator.h"
 #include "PanelDataItemVolatileData.h"
 #include <memory>
+#include <numeric>
+#include <random>
 #include <span>
 #include <fmt/format.h>
 #include "Tests.h"
@@ -281,3 +283,144 @@ TEST_CASE(PREFIX "SortByNameRev")
         CHECK(cmp(4, 3) == true);  // b' vs B(b)
     }
 }
+
+// Produces a listing of random names made of the pieces of the alphabet, along with random times and sizes
+static VFSListingPtr ProduceRandomListing(std::span<const std::string> _alphabet,
+                                          size_t _count,
+                                          std::mt19937 &_rng,
+                                          std::vector<ItemVolatileData> &_vd)
+{
+    const auto random = [&](size_t _max) { return std::uniform_int_distribution<size_t>(0, _max)(_rng); };
+    vfs::ListingInput l;
+    l.directories.reset(variable_container<>::type::common);
+    l.directories[0] = "/";
+    l.hosts.reset(variable_container<>::type::common);
+    l.hosts[0] = VFSHost::DummyHost();
+    l.mtimes.reset(variable_container<>::type::dense);
+    l.btimes.reset(variable_container<>::type::dense);
+    l.atimes.reset(variable_container<>::type::dense);
+    _vd.assign(_count, ItemVolatileData{});
+    for( size_t i = 0; i != _count; ++i ) {
+        std::string name;
+        for( size_t length = random(6) + 1; length != 0; --length )
+            name += _alphabet[random(_alphabet.size() - 1)];
+        const bool is_directory = random(3) == 0;
+        l.filenames.emplace_back(name);
+        l.unix_modes.emplace_back(is_directory ? (S_IRUSR | S_IWUSR | S_IFDIR) : (S_IRUSR | S_IWUSR | S_IFREG));
+        l.unix_types.emplace_back(is_directory ? DT_DIR : DT_REG);
+        if( random(9) == 0 )
+            l.display_filenames.insert(i, name + "x");
+        l.mtimes.insert(i, static_cast<time_t>(random(4)) - 2);
+        l.btimes.insert(i, static_cast<time_t>(random(3)));
+        l.atimes.insert(i, static_cast<time_t>(random(2)));
+        if( random(1) == 0 )
+            l.add_times.insert(i, static_cast<time_t>(random(2)));
+        if( random(2) != 0 )
+            _vd[i].size = random(3);
+    }
+    return VFSListing::Build(std::move(l));
+}
+
+static const SortMode::Mode g_AllSortModes[] = {SortMode::SortByName,
+                                                SortMode::SortByNameRev,
+                                                SortMode::SortByExt,
+                                                SortMode::SortByExtRev,
+                                                SortMode::SortBySize,
+                                                SortMode::SortBySizeRev,
+                                                SortMode::SortByModTime,
+                                                SortMode::SortByModTimeRev,
+                                                SortMode::SortByBirthTime,
+                                                SortMode::SortByBirthTimeRev,
+                                                SortMode::SortByAddTime,
+                                                SortMode::SortByAddTimeRev,
+                                                SortMode::SortByAccessTime,
+                                                SortMode::SortByAccessTimeRev,
+                                                SortMode::SortByRawCName};
+
+static const SortMode::Collation g_AllCollations[] = {
+    SortMode::Collation::CaseSensitive, SortMode::Collation::CaseInsensitive, SortMode::Collation::Natural};
+
+TEST_CASE(PREFIX "SortIndirectly gives the same order as the comparator")
+{
+    // names of few characters to have many ties, including the ones which can't be keyed
+    struct Alphabet {
+        std::vector<std::string> pieces;
+        bool keyed; // the order of the keys must match the comparator without falling back to it
+    };
+    const Alphabet alphabets[] = {
+        {.pieces = {"a", "B", "b", "1", "0", "2", " ", ".", "_", "-"}, .keyed = true},
+        {.pieces = {"a",
+                    "A",
+                    "b",
+                    ".",
+                    "x",
+                    reinterpret_cast<const char *>(u8"é"),
+                    reinterpret_cast<const char *>(u8"Я")},
+         .keyed = false},
+    };
+    std::mt19937 rng(42);
+
+    for( const auto &alphabet : alphabets ) {
+        const size_t count = 500;
+        std::vector<ItemVolatileData> vd;
+        const auto listing = ProduceRandomListing(alphabet.pieces, count, rng, vd);
+        for( const auto mode : g_AllSortModes ) {
+            for( const auto collation : g_AllCollations ) {
+                for( const int flags : {0, 1, 2, 3} ) {
+                    SortMode sort;
+                    sort.sort = mode;
+                    sort.collation = collation;
+                    sort.sep_dirs = (flags & 1) != 0;
+                    sort.extensionless_dirs = (flags & 2) != 0;
+                    INFO(fmt::format("mode: {}, collation: {}, flags: {}",
+                                     static_cast<int>(mode),
+                                     static_cast<int>(collation),
+                                     flags));
+                    const IndirectListingComparator cmp(*listing, vd, sort);
+
+                    std::vector<unsigned> indices(count);
+                    std::iota(indices.begin(), indices.end(), 0); // NOLINT
+                    std::ranges::shuffle(indices, rng);
+                    if( alphabet.keyed ) {
+                        std::vector<unsigned> keyed = indices;
+                        REQUIRE(SortByCollationKeys(*listing, vd, sort, keyed));
+                        CHECK(std::is_sorted(keyed.begin(), keyed.end(), cmp));
+                    }
+
+                    SortIndirectly(*listing, vd, sort, indices);
+                    CHECK(std::is_sorted(indices.begin(), indices.end(), cmp));
+                    std::ranges::sort(indices);
+                    CHECK(std::ranges::adjacent_find(indices) == indices.end());
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE(PREFIX "SortByCollationKeys orders large listings like the comparator")
+{
+    // at least g_ParallelSortThresh items, so that the keys are sorted in parallel
+    const std::vector<std::string> alphabet = {"a", "B", "b", "1", "0", "2", " ", ".", "_", "-", "Report", "x10"};
+    const size_t count = 20'000;
+    std::mt19937 rng(42);
+    std::vector<ItemVolatileData> vd;
+    const auto listing = ProduceRandomListing(alphabet, count, rng, vd);
+    for( const auto mode : {SortMode::SortByName, SortMode::SortByExtRev, SortMode::SortBySize} ) {
+        for( const auto collation : g_AllCollations ) {
+            SortMode sort;
+            sort.sort = mode;
+            sort.collation = collation;
+            sort.sep_dirs = true;
+            INFO(fmt::format("mode: {}, collation: {}", static_cast<int>(mode), static_cast<int>(collation)));
+            const IndirectListingComparator cmp(*listing, vd, sort);
+
+            std::vector<unsigned> indices(count);
+            std::iota(indices.begin(), indices.end(), 0); // NOLINT
+            std::ranges::shuffle(indices, rng);
+            REQUIRE(SortByCollationKeys(*listing, vd, sort, indices));
+            CHECK(std::is_sorted(indices.begin(), indices.end(), cmp));
+            std::ranges::sort(indices);
+            CHECK(std::ranges::adjacent_find(indices) == indices.end());
+        }
+    }
+}
@@ -1,6 +1,7 @@
-// Copyright (C) 2023 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2023-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "PanelDataFilter.h"
 #include "Tests.h"
+#include <random>
 
 #define PREFIX "PanelDataFilter "
 
@@ -63,3 +64,73 @@ TEST_CASE(PREFIX "Fuzzy search")
         CHECK(hl == tc.expected);
     }
 }
+
+// The straightforward greedy search done via NSString, which FuzzySearch must agree with
+static std::optional<QuickSearchHiglight> FuzzySearchReference(NSString *_filename, NSString *_text)
+{
+    const auto satisfiable = [&](size_t _name_pos, size_t _text_pos) {
+        for( ; _text_pos < _text.length; ++_text_pos ) {
+            const NSRange r = [_filename rangeOfString:[_text substringWithRange:NSMakeRange(_text_pos, 1)]
+                                               options:NSCaseInsensitiveSearch
+                                                 range:NSMakeRange(_name_pos, _filename.length - _name_pos)];
+            if( r.location == NSNotFound )
+                return false;
+            _name_pos = r.location + 1;
+        }
+        return true;
+    };
+    if( !satisfiable(0, 0) )
+        return std::nullopt;
+
+    std::vector<QuickSearchHiglight::Range> found;
+    size_t name_pos = 0;
+    size_t text_pos = 0;
+    while( text_pos < _text.length ) {
+        size_t length = _text.length - text_pos;
+        for( ; length != 0; --length ) {
+            const NSRange r = [_filename rangeOfString:[_text substringWithRange:NSMakeRange(text_pos, length)]
+                                               options:NSCaseInsensitiveSearch
+                                                 range:NSMakeRange(name_pos, _filename.length - name_pos)];
+            if( r.length == 0 || !satisfiable(r.location + r.length, text_pos + length) )
+                continue;
+            found.push_back({r.location, r.length});
+            name_pos = r.location + r.length;
+            text_pos += r.length;
+            break;
+        }
+        if( length == 0 )
+            return std::nullopt;
+    }
+    return QuickSearchHiglight(found);
+}
+
+TEST_CASE(PREFIX "Fuzzy search agrees with the straightforward greedy search")
+{
+    // plain letters, mixed case, accents both precomposed and combining, "ß" which folds into "ss", Cyrillic
+    NSArray<NSString *> *const alphabets = @[
+        @[@"a", @"b", @"c", @"A", @"B", @"."],
+        @[@"a", @"A", @"e", @"\u00E9", @"\u00C9", @"e\u0301"],
+        @[@"s", @"S", @"\u00DF", @"t"],
+        @[@"\u0430", @"\u0410", @"\u0431", @"a", @"\u0451", @"\u0401"],
+    ];
+    std::mt19937 rng(42);
+    const auto random_string = [&](NSArray<NSString *> *_alphabet, size_t _max_length) {
+        NSMutableString *const str = [NSMutableString string];
+        for( size_t i = std::uniform_int_distribution<size_t>(0, _max_length)(rng); i != 0; --i )
+            [str appendString:_alphabet[std::uniform_int_distribution<NSUInteger>(0, _alphabet.count - 1)(rng)]];
+        return str;
+    };
+    for( int i = 0; i != 20000; ++i ) {
+        NSArray<NSString *> *const alphabet = alphabets[static_cast<NSUInteger>(i) % alphabets.count];
+        NSString *const filename = random_string(alphabet, 24);
+        NSString *text = random_string(alphabet, 6);
+        if( i % 3 == 0 && filename.length != 0 ) {
+            // a piece of the name itself in another case, which is always found
+            const size_t from = std::uniform_int_distribution<size_t>(0, filename.length - 1)(rng);
+            text = [filename substringFromIndex:from].uppercaseString;
+        }
+        INFO(filename.UTF8String);
+        INFO(text.UTF8String);
+        CHECK(FuzzySearch(filename, text) == FuzzySearchReference(filename, text));
+    }
+}
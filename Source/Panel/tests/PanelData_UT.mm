@@ -6,6 +6,7 @@
 #include "PanelDataItemVolatileData.h"
 #include "PanelDataSelection.h"
 #include <memory>
+#include <random>
 #include <set>
 #include "Tests.h"
 
@@ -398,6 +399,63 @@ TEST_CASE(PREFIX "HardFiltering")
     CHECK(data.SortedDirectoryEntries().size() == count);
 }
 
+TEST_CASE(PREFIX "SoftFiltering gives the same results when narrowing incrementally")
+{
+    const auto listing = ProduceDummyListing(std::vector<std::string>{
+        "..",
+        "notes.txt",
+        "Notes-old.txt",
+        "strasse.txt",
+        reinterpret_cast<const char *>(u8"Straße.txt"),
+        reinterpret_cast<const char *>(u8"café.md"),
+        reinterpret_cast<const char *>(u8"cafe\u0301 old.md"),
+        reinterpret_cast<const char *>(u8"заметки.txt"),
+        "report.txt.bak",
+        "reports"});
+    const auto sequences = std::vector<std::vector<NSString *>>{
+        {@"n", @"no", @"not", @"note", @"notes", @"notes.", @"notes.t"},
+        {@"s", @"st", @"str", @"stra", @"stras", @"strass", @"strasse"},
+        {@"s", @"ss", @"ass", @"rasse"},
+        {@"c", @"ca", @"caf", @"cafe", @"cafe\u0301", @"cafe\u0301 "},
+        {@"t", @"xt", @"txt", @".txt", @"s.txt"},
+        {@"\u0437", @"\u0437\u0430", @"\u0437\u0430\u043C"},
+        {@"r", @"re", @"rep", @"repo", @"repor", @"report", @"reports"},
+    };
+
+    const auto snapshot = [](const data::Model &_model) {
+        std::vector<std::pair<unsigned, data::QuickSearchHiglight::Ranges>> result;
+        for( const unsigned sorted_index : _model.EntriesBySoftFiltering() )
+            result.emplace_back(sorted_index,
+                                _model.VolatileDataAtSortPosition(static_cast<int>(sorted_index)).highlight.unpack());
+        return result;
+    };
+
+    for( const auto type : {data::TextualFilter::Anywhere,
+                            data::TextualFilter::Beginning,
+                            data::TextualFilter::Ending,
+                            data::TextualFilter::BeginningOrEnding,
+                            data::TextualFilter::Fuzzy} ) {
+        for( const auto &sequence : sequences ) {
+            data::Model incremental;
+            incremental.Load(listing, data::Model::PanelType::Directory);
+            for( NSString *text : sequence ) {
+                data::TextualFilter filter;
+                filter.type = type;
+                filter.text = text;
+                incremental.SetSoftFiltering(filter);
+
+                data::Model fresh;
+                fresh.Load(listing, data::Model::PanelType::Directory);
+                fresh.SetSoftFiltering(filter);
+
+                INFO(static_cast<int>(type));
+                INFO(text.UTF8String);
+                CHECK(snapshot(incremental) == snapshot(fresh));
+            }
+        }
+    }
+}
+
 TEST_CASE(PREFIX "HardFiltering, edge case - emply panel")
 {
     const auto strings = std::vector<std::string>{"aaa", "bbb"};
@@ -641,6 +699,24 @@ TEST_CASE(PREFIX "SetCalculatedSizesForDirectories")
             CHECK(data.VolatileDataAtRawPosition(1).size == 20);
             CHECK(data.VolatileDataAtRawPosition(2).size == 30);
         }
+        SECTION("Possibly stale")
+        {
+            const unsigned indices[] = {0, 1};
+            const uint64_t stale_sizes[] = {10, 20};
+            const uint64_t fresh_sizes[] = {10, 5};
+            CHECK(data.SetCalculatedSizesForDirectories(indices, stale_sizes, true) == 2);
+            CHECK(data.VolatileDataAtRawPosition(0).is_size_stale());
+            CHECK(data.VolatileDataAtRawPosition(1).is_size_stale());
+            CHECK(data.EntryAtSortPosition(1).Filename() == "Bravo");
+            CHECK(data.EntryAtSortPosition(2).Filename() == "Alpha");
+            CHECK(data.SetCalculatedSizesForDirectories(indices, fresh_sizes) == 2);
+            CHECK(data.VolatileDataAtRawPosition(0).size == 10);
+            CHECK(data.VolatileDataAtRawPosition(1).size == 5);
+            CHECK(!data.VolatileDataAtRawPosition(0).is_size_stale());
+            CHECK(!data.VolatileDataAtRawPosition(1).is_size_stale());
+            CHECK(data.EntryAtSortPosition(1).Filename() == "Alpha");
+            CHECK(data.EntryAtSortPosition(2).Filename() == "Bravo");
+        }
     }
     SECTION("Invalid")
     {
@@ -700,6 +776,77 @@ TEST_CASE(PREFIX "SetCalculatedSizesForDirectories")
     }
 }
 
+TEST_CASE(PREFIX "Stats are maintained through selection, sizes and filtering")
+{
+    const std::vector<std::tuple<std::string, bool>> entries = {{{"..", true},
+                                                                 {"Alpha", true},
+                                                                 {"Bravo", true},
+                                                                 {".Charlie", true},
+                                                                 {"alpha.txt", false},
+                                                                 {"bravo.txt", false},
+                                                                 {".charlie.txt", false},
+                                                                 {"delta.md", false},
+                                                                 {"Echo", true},
+                                                                 {"echo.md", false}}};
+    const auto listing = ProduceDummyListing(entries);
+    const auto filenames = std::vector<std::string>{"Alpha", "Bravo", ".Charlie", "Echo"};
+    const auto texts = std::vector<NSString *>{nil, @"a", @"al", @"txt", @"o", @"e"};
+
+    const auto expected = [](const data::Model &_data) {
+        data::Statistics stats;
+        stats.total_entries_amount = _data.RawEntriesCount() - 1;
+        stats.raw_reg_files_amount = 6;
+        for( int i = 0; i != _data.SortedEntriesCount(); ++i ) {
+            const auto &vd = _data.VolatileDataAtSortPosition(i);
+            if( !vd.is_selected() )
+                continue;
+            stats.bytes_in_selected_entries += vd.is_size_calculated() ? static_cast<int64_t>(vd.size) : 0;
+            stats.selected_entries_amount++;
+            if( _data.EntryAtSortPosition(i).IsDir() )
+                stats.selected_dirs_amount++;
+            else
+                stats.selected_reg_amount++;
+        }
+        return stats;
+    };
+
+    data::Model data;
+    data.Load(listing, data::Model::PanelType::Directory);
+
+    std::mt19937 rng(42);
+    const auto random = [&](size_t _max) { return std::uniform_int_distribution<size_t>(0, _max)(rng); };
+    for( int step = 0; step != 1000; ++step ) {
+        switch( random(5) ) {
+            case 0:
+            case 1:
+                data.CustomFlagsSelectSorted(static_cast<int>(random(static_cast<size_t>(data.SortedEntriesCount()))),
+                                             random(1) == 0);
+                break;
+            case 2:
+                data.SetCalculatedSizeForDirectory(filenames[random(filenames.size() - 1)], "/", random(1000));
+                break;
+            case 3: {
+                auto filtering = data.HardFiltering();
+                filtering.show_hidden = random(1) == 0;
+                filtering.text.text = texts[random(texts.size() - 1)];
+                data.SetHardFiltering(filtering);
+                break;
+            }
+            case 4:
+                data.ClearTextFiltering();
+                break;
+            case 5: {
+                auto sorting = data.SortMode();
+                sorting.sort = random(1) == 0 ? data::SortMode::SortBySize : data::SortMode::SortByName;
+                data.SetSortMode(sorting);
+                break;
+            }
+        }
+        INFO(step);
+        REQUIRE(data.Stats() == expected(data));
+    }
+}
+
 TEST_CASE(PREFIX "ReLoad a temporary listing")
 {
     const VFSListingPtr l1 = ProduceNonUniformDummyListing({{"/D1/", "meow.txt", 10}, {"/D2/", "bark.txt", 20}});
@@ -0,0 +1,105 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "Tests.h"
+#include <random>
+#include <VFS/VFS.h>
+#include <VFS/VFSListingInput.h>
+#include "PanelData.h"
+
+using namespace nc;
+using namespace nc::base;
+using namespace nc::panel;
+using data::Model;
+using data::TextualFilter;
+
+static const std::string_view g_Words[] = {"report",  "summary", "data",   "file",    "document", "notes",
+                                           "project", "meeting", "invoice", "archivo", "bericht",  "datei",
+                                           "отчет",   "данные",  "файл",    "проект",  "报告",     "数据"};
+
+static const std::string_view g_Extensions[] = {".txt", ".pdf", ".jpg", ".docx", ".png", ".csv", ".md"};
+
+static std::string GenerateFilename(std::mt19937 &_rng)
+{
+    std::uniform_int_distribution<size_t> words_dist(0, std::size(g_Words) - 1);
+    std::uniform_int_distribution<size_t> extension_dist(0, std::size(g_Extensions) - 1);
+    std::uniform_int_distribution<int> number_dist(0, 9999);
+    std::string filename = std::string(g_Words[words_dist(_rng)]);
+    filename += "_";
+    filename += g_Words[words_dist(_rng)];
+    filename += std::to_string(number_dist(_rng));
+    filename += g_Extensions[extension_dist(_rng)];
+    return filename;
+}
+
+static VFSListingPtr ProduceDummyListing(const std::vector<std::string> &_filenames)
+{
+    vfs::ListingInput l;
+
+    l.directories.reset(variable_container<>::type::common);
+    l.directories[0] = "/";
+
+    l.hosts.reset(variable_container<>::type::common);
+    l.hosts[0] = VFSHost::DummyHost();
+
+    for( auto &i : _filenames ) {
+        l.filenames.emplace_back(i);
+        l.unix_modes.emplace_back(0);
+        l.unix_types.emplace_back(0);
+    }
+
+    return VFSListing::Build(std::move(l));
+}
+
+// Types the text letter by letter, either narrowing the previous filter or filtering everything from scratch
+static size_t Type(Model &_model, TextualFilter::Where _where, NSString *_text, bool _from_scratch)
+{
+    size_t found = 0;
+    for( NSUInteger length = 1; length <= _text.length; ++length ) {
+        if( _from_scratch )
+            _model.ClearTextFiltering();
+        TextualFilter filter;
+        filter.type = _where;
+        filter.text = [_text substringToIndex:length];
+        _model.SetSoftFiltering(filter);
+        found += _model.EntriesBySoftFiltering().size();
+    }
+    _model.ClearTextFiltering();
+    return found;
+}
+
+TEST_CASE("Soft filtering performance test")
+{
+    std::mt19937 rng(42);
+    std::vector<std::string> filenames;
+    for( int i = 0; i < 100'000; ++i ) {
+        filenames.push_back(GenerateFilename(rng));
+    }
+
+    Model model;
+    model.Load(ProduceDummyListing(filenames), Model::PanelType::Directory);
+
+    BENCHMARK("Anywhere, from scratch")
+    {
+        return Type(model, TextualFilter::Anywhere, @"report_data", true);
+    };
+    BENCHMARK("Anywhere, narrowing")
+    {
+        return Type(model, TextualFilter::Anywhere, @"report_data", false);
+    };
+    BENCHMARK("Beginning, from scratch")
+    {
+        return Type(model, TextualFilter::Beginning, @"report_data", true);
+    };
+    BENCHMARK("Beginning, narrowing")
+    {
+        return Type(model, TextualFilter::Beginning, @"report_data", false);
+    };
+    BENCHMARK("Fuzzy, from scratch")
+    {
+        return Type(model, TextualFilter::Fuzzy, @"rptdt12", true);
+    };
+    BENCHMARK("Fuzzy, narrowing")
+    {
+        return Type(model, TextualFilter::Fuzzy, @"rptdt12", false);
+    };
+}
@@ -45,6 +45,11 @@ public:
      */
     const std::string &Mask() const noexcept;
 
+    /**
+     * Get the type the current file mask was constructed with.
+     */
+    Type MaskType() const noexcept;
+
     /**
      * Return true if _mask is a wildcard(s).
      * If it's a set of fixed names or a single word - return false.
@@ -74,6 +79,9 @@ private:
 
     // The original string this mask was constructed with
     std::string m_Mask;
+
+    // The type of the original string
+    Type m_Type = Type::Mask;
 };
 
 } // namespace nc::utility
@@ -220,6 +220,12 @@ struct NativeFileSystemInfo {
          * True if the volume's device is connected to an internal bus, false if connected to an external bus.
          */
         bool internal : 1 = false;
+
+        /**
+         * True if the volume's media is backed by a rotational device (a hard disk or an optical disc), i.e. the
+         * physical locality of I/O requests significantly affects the throughput.
+         */
+        bool rotational : 1 = false;
     } mount_flags;
 
     struct {
@@ -149,6 +149,37 @@ static std::string ProduceFormCLowercase(std::string_view _string)
     return utf8;
 }
 
+// Lowercases the regular expression while keeping its escape sequences intact, since e.g. \D and \d or \p{Lu} and
+// \p{lu} mean different things.
+static std::string ProduceFormCLowercaseRegex(std::string_view _regex)
+{
+    if( !string_needs_normalization(_regex) )
+        return std::string(_regex);
+
+    std::string result;
+    size_t plain_start = 0;
+    size_t i = 0;
+    while( i < _regex.size() ) {
+        if( _regex[i] != '\\' ) {
+            ++i;
+            continue;
+        }
+        result += ProduceFormCLowercase(_regex.substr(plain_start, i - plain_start));
+        size_t escape_end = std::min(i + 2, _regex.size());
+        while( escape_end < _regex.size() && (static_cast<unsigned char>(_regex[escape_end]) & 0xC0) == 0x80 )
+            ++escape_end; // the escaped character can be a multibyte one
+        if( escape_end < _regex.size() && (_regex[i + 1] == 'p' || _regex[i + 1] == 'P') ) {
+            // a Unicode class, either like \pL or like \p{Lu}
+            const size_t closing = _regex[escape_end] == '{' ? _regex.find('}', escape_end) : escape_end;
+            escape_end = closing == std::string_view::npos ? _regex.size() : closing + 1;
+        }
+        result += _regex.substr(i, escape_end - i);
+        i = plain_start = escape_end;
+    }
+    result += ProduceFormCLowercase(_regex.substr(plain_start));
+    return result;
+}
+
 static std::optional<std::string> GetSimpleMask(const std::string &_regexp)
 {
     const char *str = _regexp.c_str();
@@ -172,7 +203,7 @@ static std::optional<std::string> GetSimpleMask(const std::string &_regexp)
 
 FileMask::FileMask() noexcept = default;
 
-FileMask::FileMask(const std::string_view _mask, const Type _type) : m_Mask(_mask)
+FileMask::FileMask(const std::string_view _mask, const Type _type) : m_Mask(_mask), m_Type(_type)
 {
     if( _mask.empty() )
         return;
@@ -186,8 +217,7 @@ FileMask::FileMask(const std::string_view _mask, const Type _type) : m_Mask(_mas
                 m_Masks.emplace_back(std::move(*sm));
             }
             else {
-                auto regex = std::make_shared<re2::RE2>(string_needs_normalization(s) ? ProduceFormCLowercase(s) : s,
-                                                        re2::RE2::Quiet);
+                auto regex = std::make_shared<re2::RE2>(ProduceFormCLowercaseRegex(s), re2::RE2::Quiet);
                 if( regex->ok() )
                     m_Masks.emplace_back(std::move(regex));
             }
@@ -195,8 +225,7 @@ FileMask::FileMask(const std::string_view _mask, const Type _type) : m_Mask(_mas
     }
 
     if( _type == Type::RegEx ) {
-        auto regex = std::make_shared<re2::RE2>(
-            string_needs_normalization(_mask) ? ProduceFormCLowercase(_mask) : _mask, re2::RE2::Quiet);
+        auto regex = std::make_shared<re2::RE2>(ProduceFormCLowercaseRegex(_mask), re2::RE2::Quiet);
         if( regex->ok() )
             m_Masks.emplace_back(std::move(regex));
     }
@@ -205,7 +234,7 @@ FileMask::FileMask(const std::string_view _mask, const Type _type) : m_Mask(_mas
 bool FileMask::Validate(const std::string_view _mask, const Type _type)
 {
     if( _type == Type::RegEx ) {
-        re2::RE2 const regex(string_needs_normalization(_mask) ? ProduceFormCLowercase(_mask) : _mask, re2::RE2::Quiet);
+        re2::RE2 const regex(ProduceFormCLowercaseRegex(_mask), re2::RE2::Quiet);
         return regex.ok();
     }
     return true;
@@ -304,6 +333,11 @@ const std::string &FileMask::Mask() const noexcept
     return m_Mask;
 }
 
+FileMask::Type FileMask::MaskType() const noexcept
+{
+    return m_Type;
+}
+
 bool FileMask::IsEmpty() const noexcept
 {
     return m_Masks.empty();
@@ -6,6 +6,8 @@
 #include <Base/algo.h>
 #include <Base/dispatch_cpp.h>
 #include <DiskArbitration/DiskArbitration.h>
+#include <IOKit/IOKitLib.h>
+#include <IOKit/storage/IOStorageDeviceCharacteristics.h>
 #include <Utility/FSEventsDirUpdate.h>
 #include <Utility/Log.h>
 #include <Utility/PathManip.h>
@@ -44,6 +46,7 @@ static bool GetVerboseInfo(NativeFileSystemInfo &_volume);
 static bool UpdateSpaceInfo(NativeFileSystemInfo &_volume);
 static bool VolumeHasTrash(const std::string &_volume_path);
 static std::optional<std::string> GetBSDName(const NativeFileSystemInfo &_volume);
+static bool IsBackedByRotationalMedia(const std::string &_bsd_name);
 static std::vector<std::string> GetFullFSList();
 static DASessionRef DASessionForMainThread();
 static std::optional<APFSTree> FetchAPFSTree() noexcept;
@@ -347,6 +350,11 @@ static bool GetVerboseInfo(NativeFileSystemInfo &_volume)
     else
         _volume.mount_flags.internal = false;
 
+    if( auto bsd_name = GetBSDName(_volume) )
+        _volume.mount_flags.rotational = IsBackedByRotationalMedia(*bsd_name);
+    else
+        _volume.mount_flags.rotational = false;
+
     return true;
 }
 
@@ -755,6 +763,42 @@ static std::optional<std::string> GetBSDName(const NativeFileSystemInfo &_volume
     return source.substr(prefix.length());
 }
 
+static bool IsBackedByRotationalMedia(const std::string &_bsd_name)
+{
+    const auto matching = IOBSDNameMatching(kIOMasterPortDefault, 0, _bsd_name.c_str());
+    if( matching == nullptr )
+        return false;
+    // IOServiceGetMatchingService() consumes the matching dictionary
+    const io_service_t media = IOServiceGetMatchingService(kIOMasterPortDefault, matching);
+    if( media == IO_OBJECT_NULL )
+        return false;
+    auto release_media = at_scope_end([&] { IOObjectRelease(media); });
+
+    // optical media is always considered to be rotational
+    for( const char *optical_class : {"IOCDMedia", "IODVDMedia", "IOBDMedia"} )
+        if( IOObjectConformsTo(media, optical_class) )
+            return true;
+
+    // the characteristics are published by the block storage device, which is somewhere up the tree - for APFS
+    // volumes it's above the container and its physical store
+    const auto characteristics = base::CFPtr<CFTypeRef>::adopt(
+        IORegistryEntrySearchCFProperty(media,
+                                        kIOServicePlane,
+                                        CFSTR(kIOPropertyDeviceCharacteristicsKey),
+                                        kCFAllocatorDefault,
+                                        kIORegistryIterateRecursively | kIORegistryIterateParents));
+    if( !characteristics || CFGetTypeID(characteristics.get()) != CFDictionaryGetTypeID() )
+        return false;
+
+    const auto medium_type = CFDictionaryGetValue(static_cast<CFDictionaryRef>(characteristics.get()),
+                                                  CFSTR(kIOPropertyMediumTypeKey));
+    if( medium_type == nullptr || CFGetTypeID(medium_type) != CFStringGetTypeID() )
+        return false;
+
+    return CFStringCompare(static_cast<CFStringRef>(medium_type), CFSTR(kIOPropertyMediumTypeRotationalKey), 0) ==
+           kCFCompareEqualTo;
+}
+
 static std::optional<APFSTree> FetchAPFSTree() noexcept
 {
     try {
@@ -1,4 +1,4 @@
-// Copyright (C) 2014-2022 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2014-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "UnitTests_main.h"
 #include "FileMask.h"
 
@@ -168,6 +168,13 @@ TEST_CASE(PREFIX "MatchName - regexes")
         {.mask = "(meow|woof)\\.txt", .name = "meow.txt", .result = true},
         {.mask = "(meow|woof)\\.txt", .name = "woof.txt", .result = true},
         {.mask = "(meow|woof)\\.txt", .name = "blah.txt", .result = false},
+        {.mask = "MEOW\\D", .name = "meowx", .result = true},
+        {.mask = "MEOW\\D", .name = "meow1", .result = false},
+        {.mask = "MEOW\\d", .name = "Meow1", .result = true},
+        {.mask = "\\p{Ll}+\\.TXT", .name = "Meow.txt", .result = true},
+        {.mask = "\\p{Ll}+\\.TXT", .name = "Meow1.txt", .result = false},
+        {.mask = "\\PL+", .name = "123", .result = true},
+        {.mask = "\\QA+B\\E", .name = "a+b", .result = true},
     };
     for( auto &tc : cases ) {
         INFO(tc.mask);
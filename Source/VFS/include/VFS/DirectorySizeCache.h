@@ -0,0 +1,126 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <VFS/VFS.h>
+
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace nc::vfs {
+
+class NativeHost;
+
+// Remembers the sizes of the directory trees along with the subtotals of every directory inside them, so that a
+// repeated calculation lists only the directories which changed since. A directory is considered unchanged while its
+// device, inode and modification time stay the same and it wasn't invalidated. The modification time of a directory
+// reflects only the changes of its own entries, thus every directory of a tree is still stat'ed, but the files of the
+// unchanged ones are not. A file's size can change without touching its directory, so the owner is expected to
+// invalidate the directories reported by its observation of the filesystem.
+// The changed directories of the native filesystem are read with their entries' attributes in bulk.
+// The cache doesn't distinguish hosts, each host needs a separate one. It can be saved to disk and loaded back.
+// All the methods are thread-safe.
+class DirectorySizeCache
+{
+public:
+    using CancelChecker = std::function<bool()>;
+
+    DirectorySizeCache();
+    DirectorySizeCache(const DirectorySizeCache &) = delete;
+    DirectorySizeCache &operator=(const DirectorySizeCache &) = delete;
+
+    // Reads a cache written by Save(). Returns nullptr if the file is absent, damaged or of an unknown version.
+    static std::unique_ptr<DirectorySizeCache> Load(const std::filesystem::path &_path);
+
+    // Writes the cache into a temporary file next to _path and then moves it over _path. Returns false on failure.
+    bool Save(const std::filesystem::path &_path) const;
+
+    // Calculates the total size of the non-directory entries under the directory, reusing the subtotals of the
+    // unchanged directories and remembering the new ones. The subdirectories which can't be read are skipped.
+    // Both the logical sizes and the space allocated on the disk are remembered, _allocated picks the one to return.
+    // Returns a negative VFSError if the directory itself can't be read or the calculation was canceled.
+    ssize_t Calculate(VFSHost &_host,
+                      std::string_view _dir_path,
+                      const CancelChecker &_cancel = {},
+                      bool _allocated = false);
+
+    // Returns the size of the directory remembered by the last calculation without touching the filesystem.
+    // The value is possibly outdated.
+    std::optional<uint64_t> Lookup(std::string_view _dir_path, bool _allocated = false) const;
+
+    // Makes the next calculation list the directory again. Returns false if the directory is not remembered.
+    bool Invalidate(std::string_view _dir_path);
+
+    // Makes the next calculation list again the directory and all the directories under it.
+    bool InvalidateSubtree(std::string_view _dir_path);
+
+    // Makes the next calculation list again every remembered directory.
+    void InvalidateAll();
+
+    // The number of the remembered directories.
+    size_t Size() const;
+
+    // An opaque value which is saved and loaded along with the cache, e.g. the id of the last change applied to it.
+    uint64_t Mark() const;
+    void SetMark(uint64_t _mark);
+
+private:
+    struct Identity {
+        int64_t device = 0;
+        uint64_t inode = 0;
+        int64_t mtime_sec = 0;
+        int64_t mtime_nsec = 0;
+        bool operator==(const Identity &) const noexcept = default;
+    };
+
+    struct Sizes {
+        uint64_t logical = 0;
+        uint64_t allocated = 0; // the space allocated on the disk, the logical size if the host doesn't report it
+    };
+
+    struct Directory {
+        Identity identity;
+        Sizes files; // the non-directory entries of this directory only
+        Sizes total; // the whole tree, as of the last calculation
+        std::vector<std::string> subdirectories; // sorted
+        bool outdated = false;
+        uint64_t invalidated = 0; // the value of m_Invalidations at the last invalidation, not saved
+    };
+
+    // The subdirectories met by a listing, along with their identities when the listing provides them.
+    using Subdirectories = std::vector<std::pair<std::string, std::optional<Identity>>>;
+
+    using Directories = std::map<std::string, Directory, std::less<>>;
+
+    int Scan(VFSHost &_host,
+             const std::string &_path,
+             const Identity &_identity,
+             const CancelChecker &_cancel,
+             Sizes &_total);
+    static int ListNative(NativeHost &_host,
+                          const std::string &_path,
+                          const CancelChecker &_cancel,
+                          Sizes &_files,
+                          Subdirectories &_subdirectories);
+    static int ListGeneric(VFSHost &_host,
+                           const std::string &_path,
+                           const CancelChecker &_cancel,
+                           Sizes &_files,
+                           Subdirectories &_subdirectories);
+    void EraseSubtree(const std::string &_path);
+
+    mutable std::shared_mutex m_Lock;
+    uint64_t m_Mark = 0;
+    uint64_t m_Invalidations = 0; // counts the invalidations, lets a calculation notice the concurrent ones
+    Directories m_Directories;    // keyed by the paths with a trailing slash
+};
+
+} // namespace nc::vfs
@@ -0,0 +1,128 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <Utility/FileMask.h>
+#include <VFS/VFS.h>
+#include <ankerl/unordered_dense.h>
+
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+
+namespace nc::vfs {
+
+// An index of the names of all the entries under a directory, normally the mount point of a native volume, which
+// lets the searches by filename skip crawling the filesystem. The entries form a tree where every node keeps only its
+// own name and a link to its parent, while the trigrams of the lowercase names lead to the nodes containing them.
+// The index can be saved to disk and loaded back. It's not updated by itself and thus can get outdated, so the
+// entries it yields are only the candidates which have to be checked against the filesystem.
+// All the methods are thread-safe.
+class FilenameIndex
+{
+public:
+    using CancelChecker = std::function<bool()>;
+
+    // Gets the path of a directory with a trailing slash and the name of an entry in it. Returns false to stop.
+    using QueryCallback = std::function<bool(std::string_view _dir_path, std::string_view _filename)>;
+
+    // Walks the whole tree under _root_path with _workers parallel workers. The directories of other devices, i.e.
+    // other mounted volumes, are indexed but not walked into. Returns nullptr if _root_path is not a directory or the
+    // build was canceled.
+    static std::unique_ptr<FilenameIndex>
+    Build(VFSHost &_host, std::string_view _root_path, unsigned _workers = 4, const CancelChecker &_cancel = {});
+
+    // Reads an index written by Save(). Returns nullptr if the file is absent, damaged or of an unknown version.
+    static std::unique_ptr<FilenameIndex> Load(const std::filesystem::path &_path);
+
+    // Writes the index into a temporary file next to _path and then moves it over _path. Returns false on failure.
+    bool Save(const std::filesystem::path &_path) const;
+
+    // The path of the indexed directory, with a trailing slash.
+    const std::string &Root() const noexcept;
+
+    // When the tree was walked by Build().
+    std::chrono::system_clock::time_point BuildTime() const noexcept;
+
+    // The number of the indexed entries, not counting the root.
+    size_t Size() const;
+
+    // An opaque value which is saved and loaded along with the index, e.g. the id of the last change applied to it.
+    uint64_t Mark() const;
+    void SetMark(uint64_t _mark);
+
+    // Tells whether the directory is known to the index.
+    bool Covers(std::string_view _dir_path) const;
+
+    // Makes the directory _source of the index reachable by the path _target as well, like the directories of the APFS
+    // Data volume firmlinked into the root, e.g. "/Users" for "/System/Volumes/Data/Users". Covers() and Query() then
+    // accept the paths under _target, and Query() reports the entries found through it under _target too. Refresh()
+    // accepts such paths as well.
+    void AddFirmlink(std::string_view _target, std::string_view _source);
+
+    // Lists the directory again and brings its entries up to date: the vanished ones are dropped along with their
+    // subtrees and the new directories are walked. Does nothing if the directory is not known to the index or
+    // belongs to another volume mounted inside.
+    void Refresh(VFSHost &_host, std::string_view _dir_path);
+
+    // Yields every entry under the directory whose name matches the mask, in no particular order. Only the names
+    // containing the literal parts of the mask are checked, unless it has no literal parts of at least 3 bytes.
+    // The callback is invoked without holding any locks.
+    void Query(const utility::FileMask &_mask, std::string_view _under_path, const QueryCallback &_callback) const;
+
+private:
+    using NodeID = uint32_t;
+    using Trigram = uint32_t;
+
+    struct Node {
+        NodeID parent;
+        uint32_t name_offset; // in m_Names
+        uint16_t name_length;
+        bool directory;
+        bool removed;
+    };
+
+    struct Firmlink {
+        std::string target; // with a trailing slash
+        std::string source; // with a trailing slash
+    };
+
+    FilenameIndex(std::string _root);
+
+    std::pair<std::string, const Firmlink *> ResolveFirmlink(std::string_view _path) const;
+
+    std::optional<NodeID> FindDirectory(std::string_view _path) const;
+    std::string DirectoryPath(NodeID _node) const;
+    bool IsUnder(NodeID _node, NodeID _directory) const noexcept;
+    std::optional<std::vector<NodeID>> Candidates(const utility::FileMask &_mask) const;
+    std::vector<NodeID> NodesWithTrigrams(std::span<const Trigram> _trigrams) const;
+    NodeID AddNode(NodeID _parent, std::string_view _name, bool _directory, std::span<const Trigram> _trigrams);
+    void RemoveSubtree(NodeID _node);
+    void Walk(VFSHost &_host,
+              std::deque<std::pair<NodeID, std::string>> _directories,
+              int32_t _device,
+              unsigned _workers,
+              const CancelChecker &_cancel);
+
+    mutable std::shared_mutex m_Lock;
+    std::string m_Root;
+    std::chrono::system_clock::time_point m_BuildTime;
+    uint64_t m_Mark = 0;
+    std::vector<Node> m_Nodes; // the node 0 is the root
+    std::string m_Names;       // the names of all the nodes one after another
+    size_t m_Removed = 0;      // the removed nodes are kept until the next build
+    ankerl::unordered_dense::map<NodeID, std::vector<NodeID>> m_Children;
+    ankerl::unordered_dense::map<Trigram, std::vector<NodeID>> m_Trigrams; // the nodes in ascending order
+    std::vector<Firmlink> m_Firmlinks;
+};
+
+} // namespace nc::vfs
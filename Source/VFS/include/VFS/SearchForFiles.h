@@ -7,12 +7,17 @@
 #include <VFS/VFS.h>
 
 #include <functional>
+#include <limits>
+#include <memory>
 #include <string>
-#include <queue>
+#include <vector>
 #include <stdint.h>
 
 namespace nc::vfs {
 
+class FilenameIndex;
+class MultiTextSearch;
+
 class SearchForFiles
 {
 public:
@@ -31,6 +36,12 @@ public:
         bool whole_phrase = false; // search for a phrase, not a part of something
         bool case_sensitive = false;
         bool not_containing = false;
+        bool regular_expression = false; // treat the text as an RE2 pattern
+        bool binary = false; // treat the text as hex bytes with wildcards, e.g. "DE AD ?? EF"
+
+        // Several utf8-encoded texts searched for at once instead of the text, a file matches if it contains any of
+        // them. Only case_sensitive, whole_phrase and not_containing apply to them.
+        std::vector<std::string> any_of_texts;
     };
 
     struct FilterSize {
@@ -38,9 +49,22 @@ public:
         uint64_t max = std::numeric_limits<uint64_t>::max();
     };
 
-    // _content_found used to pass info where requested content was found, or {-1,0} if not used
-    using FoundCallback =
-        std::function<void(const char *_filename, const char *_in_path, VFSHost &_in_host, CFRange _content_found)>;
+    // The directories are listed by the traversal workers, while the files to be filtered by content are read by the
+    // content workers, so that the traversal goes on while the contents are being scanned.
+    struct Concurrency {
+        unsigned traversal_workers = 4;
+        unsigned content_workers = 8;
+
+        // The maximum number of directories listed or files scanned simultaneously on a single host, per stage.
+        unsigned native_host_limit = std::numeric_limits<unsigned>::max();
+        unsigned other_host_limit = 1;
+    };
+
+    // _content_found used to pass info where requested content was found, or {-1,0} if not used.
+    // _text_found is the index of the found text among FilterContent::any_of_texts, zero if those are not used.
+    // The callbacks are invoked from background threads, but never concurrently with themselves.
+    using FoundCallback = std::function<void(
+        const char *_filename, const char *_in_path, VFSHost &_in_host, CFRange _content_found, size_t _text_found)>;
 
     using SpawnArchiveCallback = std::function<VFSHostPtr(const char *_for_path, VFSHost &_in_host)>;
 
@@ -65,6 +89,19 @@ public:
      */
     void SetFilterSize(const FilterSize &_filter);
 
+    /**
+     * Sets the number of background workers. Should not be called with background search going on.
+     */
+    void SetConcurrency(const Concurrency &_concurrency);
+
+    /**
+     * Sets an index to look the filenames up in instead of walking the directories, used when the search goes into
+     * the subdirectories of a native directory the index covers and has a filename filter. The entries found in the
+     * index are checked against the filesystem, but those created after the index was refreshed are not found.
+     * Should not be called with background search going on.
+     */
+    void SetFilenameIndex(std::shared_ptr<const FilenameIndex> _index);
+
     /**
      * Removes all previously set filters, supposing following SetFilerXXX calls.
      * Should not be called with background search going on.
@@ -103,29 +140,54 @@ public:
     bool IsRunning() const noexcept;
 
 private:
+    struct Pipeline;
+    struct Candidate;
+
     void AsyncProc(const char *_from_path, VFSHost &_in_host);
-    void ProcessDirent(const char *_full_path, const char *_dir_path, const VFSDirEnt &_dirent, VFSHost &_in_host);
-    void ProcessValidEntry(const char *_full_path,
+    void RunTraversalWorker(Pipeline &_pipeline);
+    void RunContentWorker(Pipeline &_pipeline);
+    void ListDirectory(const VFSPath &_directory, Pipeline &_pipeline);
+    void LookUpFilenameIndex(const char *_from_path, VFSHost &_in_host, Pipeline &_pipeline);
+    bool CanUseFilenameIndex(const char *_from_path, const VFSHost &_in_host) const;
+    void ProcessDirent(const char *_full_path,
+                       const char *_dir_path,
+                       const VFSDirEnt &_dirent,
+                       VFSHost &_in_host,
+                       Pipeline &_pipeline);
+    void FilterEntry(const char *_full_path,
+                     const char *_dir_path,
+                     const VFSDirEnt &_dirent,
+                     VFSHost &_in_host,
+                     Pipeline &_pipeline);
+    void ProcessValidEntry(const char *_filename,
                            const char *_dir_path,
-                           const VFSDirEnt &_dirent,
                            VFSHost &_in_host,
-                           CFRange _cont_range);
-
-    void NotifyLookingIn(const char *_path, VFSHost &_in_host) const;
-    bool FilterByContent(const char *_full_path, VFSHost &_in_host, CFRange &_r);
+                           CFRange _cont_range,
+                           size_t _text_index,
+                           Pipeline &_pipeline);
+    unsigned HostLimit(const VFSHost &_host, unsigned _workers) const noexcept;
+
+    void NotifyLookingIn(const char *_path, VFSHost &_in_host, Pipeline &_pipeline) const;
+    bool FilterByContent(const char *_full_path,
+                         VFSHost &_in_host,
+                         CFRange &_r,
+                         size_t &_text_index,
+                         Pipeline &_pipeline);
     bool FilterByFilename(const char *_filename) const;
 
     base::SerialQueue m_Queue;
     utility::FileMask m_FilterName;
     std::optional<FilterContent> m_FilterContent;
+    std::unique_ptr<MultiTextSearch> m_MultiTextSearch; // built from FilterContent::any_of_texts
     std::optional<FilterSize> m_FilterSize;
+    Concurrency m_Concurrency;
+    std::shared_ptr<const FilenameIndex> m_FilenameIndex;
 
     FoundCallback m_Callback;
     SpawnArchiveCallback m_SpawnArchiveCallback;
     std::function<void()> m_FinishCallback;
     LookingInCallback m_LookingInCallback;
     int m_SearchOptions;
-    std::queue<VFSPath> m_DirsFIFO;
 };
 
 } // namespace nc::vfs
@@ -6,14 +6,22 @@
 #include <memory>
 #include <functional>
 #include <optional>
+#include <string_view>
 #include <VFS/FileWindow.h>
 #include <Utility/Encodings.h>
 
 namespace nc::vfs {
 
+class BytePattern;
+
 /**
  * Provides a *stateful* searching facilty to find text in VFS file accessible through
  * a FileWindow object.
+ * Whenever possible the text is encoded into the file's encoding beforehand and is searched for
+ * directly in the raw bytes, otherwise the file is decoded window by window.
+ * With the RegularExpression option the text is treated as an RE2 pattern, which is matched against the UTF-8
+ * contents of the windows - either directly or transcoded from the file's encoding.
+ * The binary search looks for a pattern of bytes written in hex, where any nibble can be a wildcard.
  * Is thread agnostic.
  */
 class SearchInFile
@@ -40,6 +48,7 @@ public:
 
     void MoveCurrentPosition(uint64_t _pos);
 
+    // The options take effect upon the next search.
     void SetSearchOptions(Options _options);
     Options SearchOptions() const;
 
@@ -49,6 +58,13 @@ public:
     CFStringRef TextSearchString();         // may be NULL. don't alter it. don't release it
     utility::Encoding TextSearchEncoding(); // may be ENCODING_INVALID
 
+    // The pattern is a sequence of hex bytes, optionally separated by whitespace, where '?' stands for any nibble,
+    // e.g. "DE AD ?? EF" or "7F45?C46". The search options don't apply to it.
+    // TextSearchString() returns the pattern afterwards, searching for an invalid pattern yields Response::Invalid.
+    void ToggleBinarySearch(CFStringRef _pattern);
+    bool IsBinarySearch() const;
+    static bool IsValidBinaryPattern(std::string_view _pattern);
+
     using CancelChecker = std::function<bool()>;
     Result Search(const CancelChecker &_checker = {});
 
@@ -56,12 +72,20 @@ private:
     SearchInFile(const SearchInFile &);   // forbid
     void operator=(const SearchInFile &); // forbid
 
+    struct TextPattern;
+    struct RegExp;
+
     Response SearchText(uint64_t *_offset, uint64_t *_bytes_len, CancelChecker _checker);
+    Response SearchEncodedText(uint64_t *_offset, uint64_t *_bytes_len, const CancelChecker &_checker);
+    Response SearchBinary(uint64_t *_offset, uint64_t *_bytes_len, const CancelChecker &_checker);
+    Response SearchRegExp(uint64_t *_offset, uint64_t *_bytes_len, const CancelChecker &_checker);
+    bool IsWholePhraseAt(uint64_t _offset, uint64_t _bytes_len);
+    void BuildTextPattern();
 
     enum class WorkMode {
         NotSet,
-        Text
-        /* binary(hex) and regexp(tempates) later */
+        Text,
+        Binary
     };
 
     nc::vfs::FileWindow &m_File;
@@ -76,6 +100,7 @@ private:
         struct {
             bool case_sensitive : 1;
             bool find_whole_phrase : 1;
+            bool regular_expression : 1;
         } m_SearchOptionsBits;
     };
 
@@ -89,6 +114,18 @@ private:
     size_t m_DecodedBufferSize = 0;
     CFStringRef m_DecodedBufferString = nullptr;
 
+    // the text encoded into the file's encoding, absent if it can't be searched for in the raw bytes
+    std::unique_ptr<TextPattern> m_TextPattern;
+
+    // the compiled text in the regular expression mode, absent if the expression is invalid
+    std::unique_ptr<RegExp> m_RegExp;
+
+    // the parsed pattern in the binary mode, absent if the pattern is invalid
+    std::unique_ptr<BytePattern> m_BinaryPattern;
+
+    // the text or the options changed since the text pattern was built, it's rebuilt by the next search
+    bool m_TextPatternOutdated = false;
+
     WorkMode m_WorkMode = WorkMode::NotSet;
 };
 
@@ -120,7 +157,12 @@ enum class SearchInFile::Options : int {
     CaseSensitive = 1 << 0,
 
     // default search option is to search regardless of surroundings
-    FindWholePhrase = 1 << 1
+    FindWholePhrase = 1 << 1,
+
+    // treat the text as a regular expression, FindWholePhrase is ignored in this mode - use \b instead.
+    // ^ and $ match at the line boundaries.
+    // matches are looked for in the spans of up to 4MB of the file, a longer match can be missed or found cut.
+    RegularExpression = 1 << 2
 };
 
 inline SearchInFile::Options operator|(SearchInFile::Options _lhs, SearchInFile::Options _rhs)
@@ -24,6 +24,7 @@ struct DirEnt {
 
     uint16_t type;
     uint16_t name_len;
+    uint64_t inode = 0; // file serial number, zero if the host doesn't provide it
     char name[1024];
 };
 
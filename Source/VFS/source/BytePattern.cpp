@@ -0,0 +1,209 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "BytePattern.h"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace nc::vfs {
+
+// the maximum number of values of an anchor position which are compared against a block of data
+static constexpr size_t g_MaxAnchorValues = 4;
+
+#if defined(__SSE2__)
+
+using Block = __m128i;
+static constexpr size_t g_BlockSize = 16;
+static constexpr unsigned g_MaskBitsPerByte = 1;
+
+static inline Block Load(const uint8_t *_p) noexcept
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(_p));
+}
+
+static inline Block Splat(uint8_t _v) noexcept
+{
+    return _mm_set1_epi8(static_cast<char>(_v));
+}
+
+static inline Block Equal(Block _lhs, Block _rhs) noexcept
+{
+    return _mm_cmpeq_epi8(_lhs, _rhs);
+}
+
+static inline Block Or(Block _lhs, Block _rhs) noexcept
+{
+    return _mm_or_si128(_lhs, _rhs);
+}
+
+static inline Block And(Block _lhs, Block _rhs) noexcept
+{
+    return _mm_and_si128(_lhs, _rhs);
+}
+
+// one bit per byte
+static inline uint64_t Mask(Block _v) noexcept
+{
+    return static_cast<uint32_t>(_mm_movemask_epi8(_v));
+}
+
+#elif defined(__ARM_NEON)
+
+using Block = uint8x16_t;
+static constexpr size_t g_BlockSize = 16;
+static constexpr unsigned g_MaskBitsPerByte = 4;
+
+static inline Block Load(const uint8_t *_p) noexcept
+{
+    return vld1q_u8(_p);
+}
+
+static inline Block Splat(uint8_t _v) noexcept
+{
+    return vdupq_n_u8(_v);
+}
+
+static inline Block Equal(Block _lhs, Block _rhs) noexcept
+{
+    return vceqq_u8(_lhs, _rhs);
+}
+
+static inline Block Or(Block _lhs, Block _rhs) noexcept
+{
+    return vorrq_u8(_lhs, _rhs);
+}
+
+static inline Block And(Block _lhs, Block _rhs) noexcept
+{
+    return vandq_u8(_lhs, _rhs);
+}
+
+// NEON has no movemask, narrowing the comparison result gives a nibble per byte instead, one bit of it is kept
+static inline uint64_t Mask(Block _v) noexcept
+{
+    const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(_v), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0) & 0x8888888888888888ULL;
+}
+
+#endif
+
+BytePattern::BytePattern(std::span<const Class> _classes) : m_Classes(_classes.begin(), _classes.end())
+{
+    assert(!m_Classes.empty());
+
+    // The first anchor is the position with the fewest accepted values, the second one is the next most selective
+    // position which is preferably the farthest from the first one - neighbouring bytes tend to correlate.
+    const auto count = [&](size_t _pos) { return m_Classes[_pos].count(); };
+    size_t first = 0;
+    for( size_t pos = 1; pos < m_Classes.size(); ++pos )
+        if( count(pos) < count(first) )
+            first = pos;
+
+    size_t second = first;
+    for( size_t pos = 0; pos < m_Classes.size(); ++pos ) {
+        if( pos == first )
+            continue;
+        const auto distance = [&](size_t _pos) { return _pos > first ? _pos - first : first - _pos; };
+        if( second == first || count(pos) < count(second) ||
+            (count(pos) == count(second) && distance(pos) > distance(second)) )
+            second = pos;
+    }
+
+    if( count(first) == 0 || count(first) > g_MaxAnchorValues || count(second) > g_MaxAnchorValues )
+        return; // such a pattern either never matches or is not selective enough for the vectorized filter
+
+    m_Anchors[0].offset = first;
+    m_Anchors[1].offset = second;
+    for( auto &anchor : m_Anchors ) {
+        const Class &values = m_Classes[anchor.offset];
+        size_t filled = 0;
+        for( size_t value = 0; value < values.size(); ++value )
+            if( values.test(value) )
+                anchor.values[filled++] = static_cast<uint8_t>(value);
+        std::fill(anchor.values.begin() + static_cast<long>(filled), anchor.values.end(), anchor.values[0]);
+        m_AnchorValues = std::max(m_AnchorValues, filled);
+    }
+    m_AnchorValues = std::bit_ceil(m_AnchorValues);
+}
+
+size_t BytePattern::Length() const noexcept
+{
+    return m_Classes.size();
+}
+
+bool BytePattern::MatchesAt(const uint8_t *_data) const noexcept
+{
+    for( size_t pos = 0; pos < m_Classes.size(); ++pos )
+        if( !m_Classes[pos].test(_data[pos]) )
+            return false;
+    return true;
+}
+
+std::optional<size_t> BytePattern::Find(std::span<const uint8_t> _data) const noexcept
+{
+    if( _data.size() < m_Classes.size() )
+        return std::nullopt;
+    switch( m_AnchorValues ) {
+        case 1:
+            return FindVectorized<1>(_data);
+        case 2:
+            return FindVectorized<2>(_data);
+        case 4:
+            return FindVectorized<4>(_data);
+        default:
+            return FindScalar(_data, 0);
+    }
+}
+
+template <size_t N>
+std::optional<size_t> BytePattern::FindVectorized(std::span<const uint8_t> _data) const noexcept
+{
+    size_t pos = 0;
+#if defined(__SSE2__) || defined(__ARM_NEON)
+    Block first_values[N];
+    Block second_values[N];
+    for( size_t i = 0; i < N; ++i ) {
+        first_values[i] = Splat(m_Anchors[0].values[i]);
+        second_values[i] = Splat(m_Anchors[1].values[i]);
+    }
+    const auto matches = [](Block _block, const Block(&_values)[N]) {
+        Block result = Equal(_block, _values[0]);
+        for( size_t i = 1; i < N; ++i )
+            result = Or(result, Equal(_block, _values[i]));
+        return result;
+    };
+
+    const size_t length = m_Classes.size();
+    const uint8_t *const data = _data.data();
+    const size_t reach = std::max(m_Anchors[0].offset, m_Anchors[1].offset) + g_BlockSize;
+    for( ; pos + reach <= _data.size(); pos += g_BlockSize ) {
+        const Block first = matches(Load(data + pos + m_Anchors[0].offset), first_values);
+        const Block second = matches(Load(data + pos + m_Anchors[1].offset), second_values);
+        for( uint64_t mask = Mask(And(first, second)); mask != 0; mask &= mask - 1 ) {
+            const size_t candidate = pos + static_cast<size_t>(std::countr_zero(mask)) / g_MaskBitsPerByte;
+            if( candidate + length > _data.size() )
+                return std::nullopt;
+            if( MatchesAt(data + candidate) )
+                return candidate;
+        }
+    }
+#endif
+    return FindScalar(_data, pos);
+}
+
+std::optional<size_t> BytePattern::FindScalar(std::span<const uint8_t> _data, size_t _from) const noexcept
+{
+    const size_t length = m_Classes.size();
+    const Class &first = m_Classes[m_Anchors[0].offset];
+    for( size_t pos = _from; pos + length <= _data.size(); ++pos )
+        if( first.test(_data[pos + m_Anchors[0].offset]) && MatchesAt(_data.data() + pos) )
+            return pos;
+    return std::nullopt;
+}
+
+} // namespace nc::vfs
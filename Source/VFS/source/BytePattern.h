@@ -0,0 +1,48 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace nc::vfs {
+
+// A fixed-length pattern of bytes where every position accepts a set of values, e.g. both cases of a letter or a
+// single exact byte.
+// The search compares two of the most selective positions of the pattern against a whole block of the data at once
+// (SSE2 or NEON) and verifies the complete pattern only where both of them matched.
+class BytePattern
+{
+public:
+    using Class = std::bitset<256>;
+
+    // Requires a non-empty pattern.
+    explicit BytePattern(std::span<const Class> _classes);
+
+    size_t Length() const noexcept;
+
+    // Returns the offset of the first occurrence of the pattern within the data, if any.
+    std::optional<size_t> Find(std::span<const uint8_t> _data) const noexcept;
+
+    // Tells whether the data starts with the pattern, requires the data to be at least Length() bytes long.
+    bool MatchesAt(const uint8_t *_data) const noexcept;
+
+private:
+    struct Anchor {
+        size_t offset = 0;
+        std::array<uint8_t, 4> values = {}; // padded by repeating the first value
+    };
+
+    template <size_t N>
+    std::optional<size_t> FindVectorized(std::span<const uint8_t> _data) const noexcept;
+    std::optional<size_t> FindScalar(std::span<const uint8_t> _data, size_t _from) const noexcept;
+
+    std::vector<Class> m_Classes;
+    std::array<Anchor, 2> m_Anchors;
+    size_t m_AnchorValues = 0; // 1, 2 or 4, or 0 if no position is selective enough to be vectorized
+};
+
+} // namespace nc::vfs
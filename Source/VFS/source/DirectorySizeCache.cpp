@@ -0,0 +1,370 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "DirectorySizeCache.h"
+#include <VFS/Native.h>
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sys/stat.h>
+#include <type_traits>
+
+namespace nc::vfs {
+
+static constexpr uint32_t g_FileMagic = 0x53444E4E; // "NNDS"
+static constexpr uint32_t g_FileVersion = 2;
+
+static std::string DirectoryPath(std::string_view _path)
+{
+    std::string path(_path);
+    if( path.empty() || path.back() != '/' )
+        path += '/';
+    return path;
+}
+
+template <class T>
+static void Write(std::ostream &_out, const T &_value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    _out.write(reinterpret_cast<const char *>(&_value), sizeof(T));
+}
+
+static void WriteString(std::ostream &_out, std::string_view _string)
+{
+    Write(_out, static_cast<uint64_t>(_string.size()));
+    _out.write(_string.data(), static_cast<std::streamsize>(_string.size()));
+}
+
+template <class T>
+static bool Read(std::istream &_in, T &_value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    return static_cast<bool>(_in.read(reinterpret_cast<char *>(&_value), sizeof(T)));
+}
+
+// The string is sized by the stored length, which can't exceed the size of the file unless the file is damaged.
+static bool ReadString(std::istream &_in, std::string &_string, uint64_t _file_size)
+{
+    uint64_t length = 0;
+    if( !Read(_in, length) || length > _file_size )
+        return false;
+    _string.resize(length);
+    return static_cast<bool>(_in.read(_string.data(), static_cast<std::streamsize>(length)));
+}
+
+DirectorySizeCache::DirectorySizeCache() = default;
+
+ssize_t DirectorySizeCache::Calculate(VFSHost &_host,
+                                      std::string_view _dir_path,
+                                      const CancelChecker &_cancel,
+                                      bool _allocated)
+{
+    if( !_dir_path.starts_with("/") )
+        return VFSError::InvalidCall;
+
+    const std::string path = DirectoryPath(_dir_path);
+    VFSStat st;
+    if( const int rc = _host.Stat(path, st, 0); rc != VFSError::Ok )
+        return rc;
+    if( !st.mode_bits.dir )
+        return VFSError::FromErrno(ENOTDIR);
+
+    const Identity identity{
+        .device = st.dev, .inode = st.inode, .mtime_sec = st.mtime.tv_sec, .mtime_nsec = st.mtime.tv_nsec};
+    Sizes total;
+    if( const int rc = Scan(_host, path, identity, _cancel, total); rc != VFSError::Ok )
+        return rc;
+    return static_cast<ssize_t>(_allocated ? total.allocated : total.logical);
+}
+
+int DirectorySizeCache::Scan(VFSHost &_host,
+                             const std::string &_path,
+                             const Identity &_identity,
+                             const CancelChecker &_cancel,
+                             Sizes &_total)
+{
+    if( _cancel && _cancel() )
+        return VFSError::Cancelled;
+
+    // the remembered entries of an unchanged directory are used without listing it
+    Directory directory;
+    bool listed = false;
+    uint64_t invalidations = 0;
+    {
+        const auto lock = std::shared_lock{m_Lock};
+        const auto it = m_Directories.find(_path);
+        if( it != m_Directories.end() && !it->second.outdated && it->second.identity == _identity ) {
+            directory = it->second;
+        }
+        else {
+            listed = true;
+            invalidations = m_Invalidations;
+        }
+    }
+
+    Subdirectories subdirectories;
+    if( listed ) {
+        directory.identity = _identity;
+        auto *const native_host = dynamic_cast<NativeHost *>(&_host);
+        const int rc = native_host != nullptr
+                           ? ListNative(*native_host, _path, _cancel, directory.files, subdirectories)
+                           : ListGeneric(_host, _path, _cancel, directory.files, subdirectories);
+        if( _cancel && _cancel() )
+            return VFSError::Cancelled;
+        if( rc != VFSError::Ok )
+            return rc;
+        std::ranges::sort(subdirectories, {}, &Subdirectories::value_type::first);
+        directory.subdirectories.reserve(subdirectories.size());
+        for( const auto &subdirectory : subdirectories )
+            directory.subdirectories.emplace_back(subdirectory.first);
+
+        // the subtrees of the directories which are gone are of no use anymore
+        const auto lock = std::lock_guard{m_Lock};
+        if( const auto it = m_Directories.find(_path); it != m_Directories.end() )
+            for( const std::string &name : it->second.subdirectories )
+                if( !std::ranges::binary_search(directory.subdirectories, name) )
+                    EraseSubtree(_path + name + '/');
+    }
+    else {
+        subdirectories.reserve(directory.subdirectories.size());
+        for( const std::string &name : directory.subdirectories )
+            subdirectories.emplace_back(name, std::nullopt);
+    }
+
+    Sizes total = directory.files;
+    for( const auto &[name, listed_identity] : subdirectories ) {
+        const std::string path = _path + name + '/';
+        Identity identity;
+        if( listed_identity ) {
+            identity = *listed_identity;
+        }
+        else {
+            VFSStat st;
+            if( _host.Stat(path, st, VFSFlags::F_NoFollow) != VFSError::Ok || !st.mode_bits.dir )
+                continue;
+            identity = Identity{
+                .device = st.dev, .inode = st.inode, .mtime_sec = st.mtime.tv_sec, .mtime_nsec = st.mtime.tv_nsec};
+        }
+        Sizes subtotal;
+        const int rc = Scan(_host, path, identity, _cancel, subtotal);
+        if( rc == VFSError::Cancelled )
+            return rc;
+        if( rc == VFSError::Ok ) {
+            total.logical += subtotal.logical;
+            total.allocated += subtotal.allocated;
+        }
+    }
+    directory.total = total;
+
+    const auto lock = std::lock_guard{m_Lock};
+    auto &stored = m_Directories[_path];
+    if( listed ) {
+        // an invalidation which happened during the listing might have been missed by it
+        const uint64_t invalidated = stored.invalidated;
+        stored = std::move(directory);
+        stored.outdated = invalidated > invalidations;
+        stored.invalidated = invalidated;
+    }
+    stored.total = total;
+    _total = total;
+    return VFSError::Ok;
+}
+
+int DirectorySizeCache::ListNative(NativeHost &_host,
+                                   const std::string &_path,
+                                   const CancelChecker &_cancel,
+                                   Sizes &_files,
+                                   Subdirectories &_subdirectories)
+{
+    // the entries come with their attributes, so neither the files nor the subdirectories are stat'ed afterwards
+    return _host.IterateDirectoryForSize(_path, [&](const NativeHost::DirectorySizeEntry &_entry) {
+        if( _cancel && _cancel() )
+            return;
+        if( _entry.type == S_IFDIR ) {
+            const Identity identity{.device = _entry.dev,
+                                    .inode = _entry.inode,
+                                    .mtime_sec = _entry.mtime_sec,
+                                    .mtime_nsec = _entry.mtime_nsec};
+            _subdirectories.emplace_back(std::string(_entry.filename), identity);
+        }
+        else {
+            if( _entry.size > 0 )
+                _files.logical += static_cast<uint64_t>(_entry.size);
+            const int64_t allocated = _entry.alloc_size >= 0 ? _entry.alloc_size : _entry.size;
+            if( allocated > 0 )
+                _files.allocated += static_cast<uint64_t>(allocated);
+        }
+    });
+}
+
+int DirectorySizeCache::ListGeneric(VFSHost &_host,
+                                    const std::string &_path,
+                                    const CancelChecker &_cancel,
+                                    Sizes &_files,
+                                    Subdirectories &_subdirectories)
+{
+    return _host.IterateDirectoryListing(_path, [&](const VFSDirEnt &_dirent) {
+        if( _cancel && _cancel() )
+            return false;
+        if( _dirent.type == VFSDirEnt::Dir ) {
+            _subdirectories.emplace_back(_dirent.name, std::nullopt);
+        }
+        else {
+            VFSStat st;
+            if( _host.Stat(_path + _dirent.name, st, VFSFlags::F_NoFollow) == VFSError::Ok ) {
+                _files.logical += st.size;
+                _files.allocated += st.meaning.blocks ? st.blocks * S_BLKSIZE : st.size;
+            }
+        }
+        return true;
+    });
+}
+
+void DirectorySizeCache::EraseSubtree(const std::string &_path)
+{
+    auto it = m_Directories.lower_bound(_path);
+    while( it != m_Directories.end() && it->first.starts_with(_path) )
+        it = m_Directories.erase(it);
+}
+
+std::optional<uint64_t> DirectorySizeCache::Lookup(std::string_view _dir_path, bool _allocated) const
+{
+    const std::string path = DirectoryPath(_dir_path);
+    const auto lock = std::shared_lock{m_Lock};
+    const auto it = m_Directories.find(path);
+    if( it == m_Directories.end() )
+        return std::nullopt;
+    return _allocated ? it->second.total.allocated : it->second.total.logical;
+}
+
+bool DirectorySizeCache::Invalidate(std::string_view _dir_path)
+{
+    const std::string path = DirectoryPath(_dir_path);
+    const auto lock = std::lock_guard{m_Lock};
+    const auto it = m_Directories.find(path);
+    if( it == m_Directories.end() )
+        return false;
+    it->second.outdated = true;
+    it->second.invalidated = ++m_Invalidations;
+    return true;
+}
+
+bool DirectorySizeCache::InvalidateSubtree(std::string_view _dir_path)
+{
+    const std::string path = DirectoryPath(_dir_path);
+    const auto lock = std::lock_guard{m_Lock};
+    const uint64_t invalidated = ++m_Invalidations;
+    bool found = false;
+    for( auto it = m_Directories.lower_bound(path); it != m_Directories.end() && it->first.starts_with(path); ++it ) {
+        it->second.outdated = true;
+        it->second.invalidated = invalidated;
+        found = true;
+    }
+    return found;
+}
+
+void DirectorySizeCache::InvalidateAll()
+{
+    const auto lock = std::lock_guard{m_Lock};
+    const uint64_t invalidated = ++m_Invalidations;
+    for( auto &directory : m_Directories ) {
+        directory.second.outdated = true;
+        directory.second.invalidated = invalidated;
+    }
+}
+
+size_t DirectorySizeCache::Size() const
+{
+    const auto lock = std::shared_lock{m_Lock};
+    return m_Directories.size();
+}
+
+uint64_t DirectorySizeCache::Mark() const
+{
+    const auto lock = std::shared_lock{m_Lock};
+    return m_Mark;
+}
+
+void DirectorySizeCache::SetMark(uint64_t _mark)
+{
+    const auto lock = std::lock_guard{m_Lock};
+    m_Mark = _mark;
+}
+
+bool DirectorySizeCache::Save(const std::filesystem::path &_path) const
+{
+    const auto lock = std::shared_lock{m_Lock};
+    std::filesystem::path temp_path = _path;
+    temp_path += ".tmp";
+    std::error_code ec;
+    {
+        std::ofstream out(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if( !out )
+            return false;
+        Write(out, g_FileMagic);
+        Write(out, g_FileVersion);
+        Write(out, m_Mark);
+        Write(out, static_cast<uint64_t>(m_Directories.size()));
+        for( const auto &[path, directory] : m_Directories ) {
+            WriteString(out, path);
+            Write(out, directory.identity);
+            Write(out, directory.files);
+            Write(out, directory.total);
+            Write(out, static_cast<uint8_t>(directory.outdated));
+            Write(out, static_cast<uint64_t>(directory.subdirectories.size()));
+            for( const std::string &name : directory.subdirectories )
+                WriteString(out, name);
+        }
+        if( !out.flush() ) {
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_path, _path, ec);
+    if( ec ) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<DirectorySizeCache> DirectorySizeCache::Load(const std::filesystem::path &_path)
+{
+    std::error_code ec;
+    const uint64_t file_size = std::filesystem::file_size(_path, ec);
+    if( ec )
+        return nullptr;
+    std::ifstream in(_path, std::ios::in | std::ios::binary);
+    if( !in )
+        return nullptr;
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t mark = 0;
+    uint64_t count = 0;
+    if( !Read(in, magic) || magic != g_FileMagic || !Read(in, version) || version != g_FileVersion ||
+        !Read(in, mark) || !Read(in, count) || count > file_size )
+        return nullptr;
+
+    auto cache = std::make_unique<DirectorySizeCache>();
+    cache->m_Mark = mark;
+    for( uint64_t i = 0; i < count; ++i ) {
+        std::string path;
+        Directory directory;
+        uint8_t outdated = 0;
+        uint64_t subdirectories = 0;
+        if( !ReadString(in, path, file_size) || !path.starts_with('/') || !path.ends_with('/') ||
+            !Read(in, directory.identity) || !Read(in, directory.files) || !Read(in, directory.total) ||
+            !Read(in, outdated) || !Read(in, subdirectories) || subdirectories > file_size )
+            return nullptr;
+        directory.outdated = outdated != 0;
+        directory.subdirectories.resize(subdirectories);
+        for( std::string &name : directory.subdirectories )
+            if( !ReadString(in, name, file_size) || name.empty() || name.find('/') != std::string::npos )
+                return nullptr;
+        if( !std::ranges::is_sorted(directory.subdirectories) )
+            return nullptr;
+        cache->m_Directories.emplace(std::move(path), std::move(directory));
+    }
+    return cache;
+}
+
+} // namespace nc::vfs
@@ -0,0 +1,642 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "FilenameIndex.h"
+#include <Base/CFPtr.h>
+#include <Base/CFString.h>
+#include <Base/DispatchGroup.h>
+#include <Base/algo.h>
+#include <re2/filtered_re2.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <ranges>
+#include <type_traits>
+
+namespace nc::vfs {
+
+static constexpr uint32_t g_FileMagic = 0x49464E4E; // "NNFI"
+static constexpr uint32_t g_FileVersion = 1;
+static constexpr uint32_t g_NoParent = std::numeric_limits<uint32_t>::max();
+
+// the literal parts of the masks shorter than this can't be looked up by trigrams
+static constexpr int g_MinLiteralLength = 3;
+
+// An entry of a listed directory prepared to be added into the index.
+struct ListedEntry {
+    std::string name;
+    bool directory = false;
+    bool walk = false; // a directory of the same device
+    std::vector<uint32_t> trigrams;
+};
+
+static bool NeedsNormalization(std::string_view _str) noexcept
+{
+    return std::ranges::any_of(_str, [](const unsigned char _c) { return _c > 127 || (_c >= 'A' && _c <= 'Z'); });
+}
+
+// Converts the string into the lowercase FormC form, the same which FileMask matches the names in.
+static std::string Normalize(std::string_view _str)
+{
+    if( !NeedsNormalization(_str) )
+        return std::string(_str);
+
+    const auto original = base::CFPtr<CFStringRef>::adopt(base::CFStringCreateWithUTF8StringNoCopy(_str));
+    if( !original )
+        return std::string(_str);
+    const auto normalized =
+        base::CFPtr<CFMutableStringRef>::adopt(CFStringCreateMutableCopy(nullptr, 0, original.get()));
+    if( !normalized )
+        return std::string(_str);
+    CFStringLowercase(normalized.get(), nullptr);
+    CFStringNormalize(normalized.get(), kCFStringNormalizationFormC);
+    return base::CFStringGetUTF8StdString(normalized.get());
+}
+
+// Returns the distinct trigrams of the bytes in ascending order.
+static std::vector<uint32_t> Trigrams(std::string_view _str)
+{
+    std::vector<uint32_t> trigrams;
+    for( size_t i = 0; i + 3 <= _str.size(); ++i )
+        trigrams.push_back((static_cast<uint32_t>(static_cast<uint8_t>(_str[i])) << 16) |
+                           (static_cast<uint32_t>(static_cast<uint8_t>(_str[i + 1])) << 8) |
+                           static_cast<uint32_t>(static_cast<uint8_t>(_str[i + 2])));
+    std::ranges::sort(trigrams);
+    trigrams.erase(std::ranges::unique(trigrams).begin(), trigrams.end());
+    return trigrams;
+}
+
+// Returns the sets of trigrams such that any name matching the mask contains all the trigrams of at least one of them.
+// Returns nothing if a matching name might contain no trigrams of the mask at all.
+static std::optional<std::vector<std::vector<uint32_t>>> MaskTrigrams(const utility::FileMask &_mask)
+{
+    std::vector<std::vector<uint32_t>> alternatives;
+    const std::string &mask = _mask.Mask();
+
+    if( _mask.MaskType() == utility::FileMask::Type::Mask ) {
+        // every comma-separated wildcard is an alternative, which needs all of its literal parts
+        for( const auto part : std::views::split(std::string_view{mask}, ',') ) {
+            const std::string_view wildcard = base::Trim(std::string_view{part});
+            if( wildcard.empty() )
+                continue;
+            std::vector<uint32_t> &trigrams = alternatives.emplace_back();
+            size_t literal_start = 0;
+            for( size_t i = 0; i <= wildcard.size(); ++i ) {
+                if( i != wildcard.size() && wildcard[i] != '*' && wildcard[i] != '?' )
+                    continue;
+                const auto literal = Trigrams(Normalize(wildcard.substr(literal_start, i - literal_start)));
+                trigrams.insert(trigrams.end(), literal.begin(), literal.end());
+                literal_start = i + 1;
+            }
+            if( trigrams.empty() )
+                return std::nullopt;
+            std::ranges::sort(trigrams);
+            trigrams.erase(std::ranges::unique(trigrams).begin(), trigrams.end());
+        }
+        return alternatives;
+    }
+
+    // the strings required by the regular expression are extracted by RE2 itself, any of them can be present
+    re2::FilteredRE2 filter(g_MinLiteralLength);
+    int id = 0;
+    // the expression is taken as is, since lowercasing would change escapes like \D or \p{Lu}, only its atoms are
+    // normalized
+    if( filter.Add(mask, re2::RE2::Options(re2::RE2::Quiet), &id) != re2::RE2::NoError )
+        return std::nullopt; // let the mask itself decide what an unparsable expression matches
+    std::vector<std::string> atoms;
+    filter.Compile(&atoms);
+    std::vector<int> unfiltered;
+    filter.AllPotentials({}, &unfiltered);
+    if( !unfiltered.empty() )
+        return std::nullopt;
+    for( const std::string &atom : atoms ) {
+        alternatives.emplace_back(Trigrams(Normalize(atom)));
+        if( alternatives.back().empty() )
+            return std::nullopt;
+    }
+    return alternatives;
+}
+
+static int List(VFSHost &_host,
+                const std::string &_path,
+                int32_t _device,
+                const FilenameIndex::CancelChecker &_cancel,
+                std::vector<ListedEntry> &_entries)
+{
+    const int rc = _host.IterateDirectoryListing(_path, [&](const VFSDirEnt &_dirent) {
+        if( _cancel && _cancel() )
+            return false;
+        _entries.push_back(ListedEntry{.name = _dirent.name,
+                                       .directory = _dirent.type == VFSDirEnt::Dir,
+                                       .walk = false,
+                                       .trigrams = Trigrams(Normalize(_dirent.name))});
+        return true;
+    });
+
+    // the volumes mounted inside are not walked into
+    for( ListedEntry &entry : _entries ) {
+        VFSStat st;
+        entry.walk = entry.directory && _host.Stat(_path + entry.name, st, VFSFlags::F_NoFollow) == 0 &&
+                     st.dev == _device;
+    }
+    return rc;
+}
+
+template <class T>
+static void Write(std::ostream &_out, const T &_value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    _out.write(reinterpret_cast<const char *>(&_value), sizeof(T));
+}
+
+template <class T>
+static void WriteArray(std::ostream &_out, std::span<const T> _values)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    Write(_out, static_cast<uint64_t>(_values.size()));
+    _out.write(reinterpret_cast<const char *>(_values.data()), static_cast<std::streamsize>(_values.size_bytes()));
+}
+
+template <class T>
+static bool Read(std::istream &_in, T &_value)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    return static_cast<bool>(_in.read(reinterpret_cast<char *>(&_value), sizeof(T)));
+}
+
+// The container is sized by the stored count, which can't exceed the size of the file unless the file is damaged.
+template <class C>
+static bool ReadArray(std::istream &_in, C &_values, uint64_t _file_size)
+{
+    using T = typename C::value_type;
+    static_assert(std::is_trivially_copyable_v<T>);
+    uint64_t count = 0;
+    if( !Read(_in, count) || count > _file_size / sizeof(T) )
+        return false;
+    _values.resize(count);
+    return static_cast<bool>(
+        _in.read(reinterpret_cast<char *>(_values.data()), static_cast<std::streamsize>(count * sizeof(T))));
+}
+
+FilenameIndex::FilenameIndex(std::string _root) : m_Root(std::move(_root))
+{
+    if( m_Root.empty() || m_Root.back() != '/' )
+        m_Root += '/';
+    m_Nodes.push_back(
+        Node{.parent = g_NoParent, .name_offset = 0, .name_length = 0, .directory = true, .removed = false});
+}
+
+std::unique_ptr<FilenameIndex>
+FilenameIndex::Build(VFSHost &_host, std::string_view _root_path, unsigned _workers, const CancelChecker &_cancel)
+{
+    VFSStat st;
+    if( _root_path.empty() || _host.Stat(_root_path, st, 0) != 0 || !S_ISDIR(st.mode) )
+        return nullptr;
+
+    std::unique_ptr<FilenameIndex> index(new FilenameIndex(std::string(_root_path)));
+    index->m_BuildTime = std::chrono::system_clock::now();
+    index->Walk(_host, {{0, index->m_Root}}, st.dev, std::max(_workers, 1u), _cancel);
+    if( _cancel && _cancel() )
+        return nullptr;
+    return index;
+}
+
+void FilenameIndex::Walk(VFSHost &_host,
+                         std::deque<std::pair<NodeID, std::string>> _directories,
+                         int32_t _device,
+                         unsigned _workers,
+                         const CancelChecker &_cancel)
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    unsigned listing = 0; // the number of directories being listed right now
+
+    const auto work = [&] {
+        while( true ) {
+            std::pair<NodeID, std::string> directory;
+            {
+                auto guard = std::unique_lock{lock};
+                cv.wait(guard, [&] { return !_directories.empty() || listing == 0; });
+                if( _directories.empty() )
+                    break;
+                directory = std::move(_directories.front());
+                _directories.pop_front();
+                ++listing;
+            }
+
+            // the listing is done without blocking the readers of the index
+            std::vector<std::pair<NodeID, std::string>> subdirectories;
+            if( !_cancel || !_cancel() ) {
+                std::vector<ListedEntry> entries;
+                List(_host, directory.second, _device, _cancel, entries);
+                const auto index_lock = std::lock_guard{m_Lock};
+                for( const ListedEntry &entry : entries ) {
+                    const NodeID node = AddNode(directory.first, entry.name, entry.directory, entry.trigrams);
+                    if( entry.walk )
+                        subdirectories.emplace_back(node, directory.second + entry.name + '/');
+                }
+            }
+
+            const auto guard = std::lock_guard{lock};
+            for( auto &subdirectory : subdirectories )
+                _directories.emplace_back(std::move(subdirectory));
+            --listing;
+            cv.notify_all();
+        }
+    };
+
+    const base::DispatchGroup group;
+    for( unsigned i = 1; i < _workers; ++i )
+        group.Run(work);
+    work();
+    group.Wait();
+}
+
+FilenameIndex::NodeID
+FilenameIndex::AddNode(NodeID _parent, std::string_view _name, bool _directory, std::span<const Trigram> _trigrams)
+{
+    const auto node = static_cast<NodeID>(m_Nodes.size());
+    m_Nodes.push_back(Node{.parent = _parent,
+                           .name_offset = static_cast<uint32_t>(m_Names.size()),
+                           .name_length = static_cast<uint16_t>(_name.size()),
+                           .directory = _directory,
+                           .removed = false});
+    m_Names += _name;
+    m_Children[_parent].push_back(node);
+    for( const Trigram trigram : _trigrams )
+        m_Trigrams[trigram].push_back(node);
+    return node;
+}
+
+void FilenameIndex::RemoveSubtree(NodeID _node)
+{
+    std::erase(m_Children[m_Nodes[_node].parent], _node);
+
+    // the nodes stay in the trigram lists, marked as removed
+    std::vector<NodeID> stack{_node};
+    while( !stack.empty() ) {
+        const NodeID node = stack.back();
+        stack.pop_back();
+        m_Nodes[node].removed = true;
+        ++m_Removed;
+        if( const auto children = m_Children.find(node); children != m_Children.end() ) {
+            stack.insert(stack.end(), children->second.begin(), children->second.end());
+            m_Children.erase(children);
+        }
+    }
+}
+
+std::optional<FilenameIndex::NodeID> FilenameIndex::FindDirectory(std::string_view _path) const
+{
+    if( _path.size() + 1 == m_Root.size() && m_Root.starts_with(_path) )
+        return 0; // the root without a trailing slash
+    if( !_path.starts_with(m_Root) )
+        return std::nullopt;
+    _path.remove_prefix(m_Root.size());
+
+    NodeID directory = 0;
+    for( const auto part : std::views::split(_path, '/') ) {
+        const std::string_view name(part.begin(), part.end());
+        if( name.empty() )
+            continue;
+        const auto children = m_Children.find(directory);
+        if( children == m_Children.end() )
+            return std::nullopt;
+        const auto child = std::ranges::find_if(children->second, [&](NodeID _child) {
+            const Node &node = m_Nodes[_child];
+            return node.directory && std::string_view(m_Names.data() + node.name_offset, node.name_length) == name;
+        });
+        if( child == children->second.end() )
+            return std::nullopt;
+        directory = *child;
+    }
+    return directory;
+}
+
+std::string FilenameIndex::DirectoryPath(NodeID _node) const
+{
+    std::vector<std::string_view> names;
+    for( NodeID node = _node; node != 0; node = m_Nodes[node].parent )
+        names.emplace_back(m_Names.data() + m_Nodes[node].name_offset, m_Nodes[node].name_length);
+
+    std::string path = m_Root;
+    for( const std::string_view name : std::views::reverse(names) ) {
+        path += name;
+        path += '/';
+    }
+    return path;
+}
+
+bool FilenameIndex::IsUnder(NodeID _node, NodeID _directory) const noexcept
+{
+    if( _directory == 0 )
+        return true;
+    for( NodeID node = m_Nodes[_node].parent; node != g_NoParent; node = m_Nodes[node].parent )
+        if( node == _directory )
+            return true;
+    return false;
+}
+
+std::vector<FilenameIndex::NodeID> FilenameIndex::NodesWithTrigrams(std::span<const Trigram> _trigrams) const
+{
+    std::vector<const std::vector<NodeID> *> lists;
+    for( const Trigram trigram : _trigrams ) {
+        const auto it = m_Trigrams.find(trigram);
+        if( it == m_Trigrams.end() )
+            return {};
+        lists.push_back(&it->second);
+    }
+    if( lists.empty() )
+        return {};
+
+    // intersect starting from the shortest list to keep the intermediate results small
+    std::ranges::sort(lists, {}, [](const std::vector<NodeID> *_list) { return _list->size(); });
+    std::vector<NodeID> nodes = *lists.front();
+    std::vector<NodeID> intersection;
+    for( const std::vector<NodeID> *list : lists | std::views::drop(1) ) {
+        intersection.clear();
+        std::ranges::set_intersection(nodes, *list, std::back_inserter(intersection));
+        nodes.swap(intersection);
+        if( nodes.empty() )
+            break;
+    }
+    return nodes;
+}
+
+std::optional<std::vector<FilenameIndex::NodeID>> FilenameIndex::Candidates(const utility::FileMask &_mask) const
+{
+    const auto alternatives = MaskTrigrams(_mask);
+    if( !alternatives )
+        return std::nullopt;
+
+    std::vector<NodeID> nodes;
+    for( const std::vector<Trigram> &trigrams : *alternatives ) {
+        const std::vector<NodeID> found = NodesWithTrigrams(trigrams);
+        nodes.insert(nodes.end(), found.begin(), found.end());
+    }
+    if( alternatives->size() > 1 ) {
+        std::ranges::sort(nodes);
+        nodes.erase(std::ranges::unique(nodes).begin(), nodes.end());
+    }
+    return nodes;
+}
+
+void FilenameIndex::Query(const utility::FileMask &_mask,
+                          std::string_view _under_path,
+                          const QueryCallback &_callback) const
+{
+    if( _mask.IsEmpty() || !_callback )
+        return;
+
+    std::vector<std::pair<std::string, std::string>> found;
+    {
+        const auto lock = std::shared_lock{m_Lock};
+        const auto resolved = ResolveFirmlink(_under_path);
+        const Firmlink *const firmlink = resolved.second;
+        const auto under = FindDirectory(resolved.first);
+        if( !under )
+            return;
+
+        const auto check = [&](NodeID _node) {
+            const Node &node = m_Nodes[_node];
+            if( node.removed || !IsUnder(_node, *under) )
+                return;
+            const std::string_view name(m_Names.data() + node.name_offset, node.name_length);
+            if( !_mask.MatchName(name) )
+                return;
+            std::string dir_path = DirectoryPath(node.parent);
+            if( firmlink )
+                dir_path.replace(0, firmlink->source.size(), firmlink->target);
+            found.emplace_back(std::move(dir_path), name);
+        };
+
+        if( const auto candidates = Candidates(_mask) ) {
+            for( const NodeID node : *candidates )
+                check(node);
+        }
+        else {
+            for( NodeID node = 1; node < m_Nodes.size(); ++node )
+                check(node);
+        }
+    }
+
+    for( const auto &[dir_path, filename] : found )
+        if( !_callback(dir_path, filename) )
+            return;
+}
+
+void FilenameIndex::Refresh(VFSHost &_host, std::string_view _dir_path)
+{
+    VFSStat root_st;
+    if( _host.Stat(m_Root, root_st, 0) != 0 )
+        return;
+
+    // the events can name the directories by their firmlinked paths
+    std::string path = [&] {
+        const auto lock = std::shared_lock{m_Lock};
+        return ResolveFirmlink(_dir_path).first;
+    }();
+    if( path.empty() || path.back() != '/' )
+        path += '/';
+
+    // a volume mounted inside is indexed as an empty directory
+    if( VFSStat st; _host.Stat(path, st, 0) == 0 && st.dev != root_st.dev )
+        return;
+
+    std::vector<ListedEntry> entries;
+    const int rc = List(_host, path, root_st.dev, {}, entries);
+
+    std::deque<std::pair<NodeID, std::string>> new_directories;
+    {
+        const auto lock = std::lock_guard{m_Lock};
+        const auto directory = FindDirectory(path);
+        if( !directory )
+            return;
+
+        if( rc != VFSError::Ok ) {
+            if( *directory != 0 && !_host.Exists(path) )
+                RemoveSubtree(*directory);
+            return;
+        }
+
+        // the entries which are gone or have changed their kind are dropped, the rest keep their subtrees
+        ankerl::unordered_dense::map<std::string_view, const ListedEntry *> listed;
+        for( const ListedEntry &entry : entries )
+            listed.emplace(entry.name, &entry);
+        const std::vector<NodeID> children = m_Children[*directory];
+        for( const NodeID child : children ) {
+            const Node &node = m_Nodes[child];
+            const auto it = listed.find(std::string_view(m_Names.data() + node.name_offset, node.name_length));
+            if( it == listed.end() || it->second->directory != node.directory )
+                RemoveSubtree(child);
+            else
+                listed.erase(it);
+        }
+
+        for( const ListedEntry &entry : entries ) {
+            if( !listed.contains(entry.name) )
+                continue;
+            const NodeID node = AddNode(*directory, entry.name, entry.directory, entry.trigrams);
+            if( entry.walk )
+                new_directories.emplace_back(node, path + entry.name + '/');
+        }
+    }
+
+    if( !new_directories.empty() )
+        Walk(_host, std::move(new_directories), root_st.dev, 1, {});
+}
+
+bool FilenameIndex::Covers(std::string_view _dir_path) const
+{
+    const auto lock = std::shared_lock{m_Lock};
+    return FindDirectory(ResolveFirmlink(_dir_path).first).has_value();
+}
+
+void FilenameIndex::AddFirmlink(std::string_view _target, std::string_view _source)
+{
+    Firmlink firmlink{.target = std::string(_target), .source = std::string(_source)};
+    if( firmlink.target.empty() || firmlink.source.empty() )
+        return;
+    if( firmlink.target.back() != '/' )
+        firmlink.target += '/';
+    if( firmlink.source.back() != '/' )
+        firmlink.source += '/';
+    const auto lock = std::lock_guard{m_Lock};
+    m_Firmlinks.emplace_back(std::move(firmlink));
+}
+
+// Translates a path reached through a firmlink into the path inside the index, along with the firmlink used.
+std::pair<std::string, const FilenameIndex::Firmlink *> FilenameIndex::ResolveFirmlink(std::string_view _path) const
+{
+    if( !_path.starts_with(m_Root) ) {
+        for( const Firmlink &firmlink : m_Firmlinks ) {
+            const std::string_view target = firmlink.target;
+            if( _path.starts_with(target) )
+                return {firmlink.source + std::string(_path.substr(target.size())), &firmlink};
+            if( _path.size() + 1 == target.size() && target.starts_with(_path) )
+                return {firmlink.source, &firmlink}; // the target without a trailing slash
+        }
+    }
+    return {std::string(_path), nullptr};
+}
+
+const std::string &FilenameIndex::Root() const noexcept
+{
+    return m_Root;
+}
+
+std::chrono::system_clock::time_point FilenameIndex::BuildTime() const noexcept
+{
+    return m_BuildTime;
+}
+
+size_t FilenameIndex::Size() const
+{
+    const auto lock = std::shared_lock{m_Lock};
+    return m_Nodes.size() - 1 - m_Removed;
+}
+
+uint64_t FilenameIndex::Mark() const
+{
+    const auto lock = std::shared_lock{m_Lock};
+    return m_Mark;
+}
+
+void FilenameIndex::SetMark(uint64_t _mark)
+{
+    const auto lock = std::lock_guard{m_Lock};
+    m_Mark = _mark;
+}
+
+bool FilenameIndex::Save(const std::filesystem::path &_path) const
+{
+    const auto lock = std::shared_lock{m_Lock};
+    std::filesystem::path temp_path = _path;
+    temp_path += ".tmp";
+    std::error_code ec;
+    {
+        std::ofstream out(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if( !out )
+            return false;
+        Write(out, g_FileMagic);
+        Write(out, g_FileVersion);
+        Write(out, static_cast<int64_t>(std::chrono::system_clock::to_time_t(m_BuildTime)));
+        Write(out, m_Mark);
+        WriteArray(out, std::span<const char>(m_Root));
+        WriteArray(out, std::span<const Node>(m_Nodes));
+        WriteArray(out, std::span<const char>(m_Names));
+        Write(out, static_cast<uint64_t>(m_Trigrams.size()));
+        for( const auto &[trigram, nodes] : m_Trigrams ) {
+            Write(out, trigram);
+            WriteArray(out, std::span<const NodeID>(nodes));
+        }
+        if( !out.flush() ) {
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(temp_path, _path, ec);
+    if( ec ) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<FilenameIndex> FilenameIndex::Load(const std::filesystem::path &_path)
+{
+    std::error_code ec;
+    const uint64_t file_size = std::filesystem::file_size(_path, ec);
+    if( ec )
+        return nullptr;
+    std::ifstream in(_path, std::ios::in | std::ios::binary);
+    if( !in )
+        return nullptr;
+
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    int64_t build_time = 0;
+    uint64_t mark = 0;
+    std::string root;
+    if( !Read(in, magic) || magic != g_FileMagic || !Read(in, version) || version != g_FileVersion ||
+        !Read(in, build_time) || !Read(in, mark) || !ReadArray(in, root, file_size) || root.empty() ||
+        root.back() != '/' )
+        return nullptr;
+
+    std::unique_ptr<FilenameIndex> index(new FilenameIndex(std::move(root)));
+    index->m_BuildTime = std::chrono::system_clock::from_time_t(static_cast<time_t>(build_time));
+    index->m_Mark = mark;
+    if( !ReadArray(in, index->m_Nodes, file_size) || !ReadArray(in, index->m_Names, file_size) )
+        return nullptr;
+
+    // every parent precedes its children, which are reconstructed from the links to the parents
+    const auto &nodes = index->m_Nodes;
+    if( nodes.empty() || nodes.size() > g_NoParent || nodes[0].parent != g_NoParent )
+        return nullptr;
+    for( NodeID id = 1; id < nodes.size(); ++id ) {
+        const Node &node = nodes[id];
+        if( node.parent >= id || !nodes[node.parent].directory ||
+            uint64_t(node.name_offset) + node.name_length > index->m_Names.size() )
+            return nullptr;
+        if( node.removed )
+            ++index->m_Removed;
+        else
+            index->m_Children[node.parent].push_back(id);
+    }
+
+    uint64_t trigrams_count = 0;
+    if( !Read(in, trigrams_count) || trigrams_count > file_size )
+        return nullptr;
+    for( uint64_t i = 0; i < trigrams_count; ++i ) {
+        Trigram trigram = 0;
+        std::vector<NodeID> list;
+        if( !Read(in, trigram) || !ReadArray(in, list, file_size) || !std::ranges::is_sorted(list) ||
+            (!list.empty() && list.back() >= nodes.size()) )
+            return nullptr;
+        index->m_Trigrams.emplace(trigram, std::move(list));
+    }
+    return index;
+}
+
+} // namespace nc::vfs
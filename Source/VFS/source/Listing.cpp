@@ -292,6 +292,22 @@ ListingInput Listing::Compose(const std::vector<base::intrusive_ptr<const Listin
     return result;
 }
 
+VFSListingPtr Listing::WithTags(const Listing &_original,
+                                std::span<const std::pair<unsigned, std::vector<utility::Tags::Tag>>> _tags)
+{
+    ListingInput result = Compose({VFSListingPtr{&_original}});
+    result.title = _original.Title();
+    for( const auto &[index, tags] : _tags ) {
+        if( index >= _original.Count() )
+            throw std::invalid_argument("VFSListing::WithTags: invalid index");
+        if( tags.empty() )
+            result.tags.erase(index);
+        else
+            result.tags.insert_or_assign(index, tags);
+    }
+    return Build(std::move(result));
+}
+
 VFSListingPtr Listing::ProduceUpdatedTemporaryPanelListing(const Listing &_original, VFSCancelChecker _cancel_checker)
 {
     ListingInput result;
@@ -48,6 +48,14 @@ public:
     static base::intrusive_ptr<const Listing> ProduceUpdatedTemporaryPanelListing(const Listing &_original,
                                                                                   VFSCancelChecker _cancel_checker);
 
+    /**
+     * Returns a copy of the listing with the tags of the specified entries replaced.
+     * Empty tags remove the tags of an entry.
+     * will throw on errors
+     */
+    static base::intrusive_ptr<const Listing>
+    WithTags(const Listing &_original, std::span<const std::pair<unsigned, std::vector<utility::Tags::Tag>>> _tags);
+
     /**
      * Returns items amount in this listing.
      */
@@ -0,0 +1,331 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "MultiTextSearch.h"
+#include <Base/CFPtr.h>
+#include <Base/CFString.h>
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+namespace nc::vfs {
+
+static bool IsSingleByte(utility::Encoding _encoding) noexcept
+{
+    return _encoding >= utility::Encoding::ENCODING_SINGLE_BYTES_FIRST__ &&
+           _encoding <= utility::Encoding::ENCODING_SINGLE_BYTES_LAST__;
+}
+
+static size_t EncodeUTF8(char32_t _character, std::array<uint8_t, 4> &_bytes) noexcept
+{
+    if( _character < 0x80 ) {
+        _bytes[0] = static_cast<uint8_t>(_character);
+        return 1;
+    }
+    if( _character < 0x800 ) {
+        _bytes[0] = static_cast<uint8_t>(0xC0 | (_character >> 6));
+        _bytes[1] = static_cast<uint8_t>(0x80 | (_character & 0x3F));
+        return 2;
+    }
+    if( _character < 0x10000 ) {
+        _bytes[0] = static_cast<uint8_t>(0xE0 | (_character >> 12));
+        _bytes[1] = static_cast<uint8_t>(0x80 | ((_character >> 6) & 0x3F));
+        _bytes[2] = static_cast<uint8_t>(0x80 | (_character & 0x3F));
+        return 3;
+    }
+    _bytes[0] = static_cast<uint8_t>(0xF0 | (_character >> 18));
+    _bytes[1] = static_cast<uint8_t>(0x80 | ((_character >> 12) & 0x3F));
+    _bytes[2] = static_cast<uint8_t>(0x80 | ((_character >> 6) & 0x3F));
+    _bytes[3] = static_cast<uint8_t>(0x80 | (_character & 0x3F));
+    return 4;
+}
+
+// Returns the lowercase form of every UTF-16 code unit, or the unit itself if the lowercase form is not a single unit.
+static std::vector<uint16_t> BuildLowercaseTable()
+{
+    std::vector<uint16_t> table(0x10000);
+    std::iota(table.begin(), table.end(), uint16_t(0));
+
+    // only the letters with a case are converted, which is a tiny fraction of all the units
+    const auto upper = CFCharacterSetGetPredefined(kCFCharacterSetUppercaseLetter);
+    const auto title = CFCharacterSetGetPredefined(kCFCharacterSetCapitalizedLetter);
+    for( size_t unit = 0x80; unit < table.size(); ++unit ) {
+        const UniChar c = static_cast<UniChar>(unit);
+        if( CFStringIsSurrogateHighCharacter(c) || CFStringIsSurrogateLowCharacter(c) )
+            continue;
+        if( !CFCharacterSetIsCharacterMember(upper, c) && !CFCharacterSetIsCharacterMember(title, c) )
+            continue;
+        const auto str = base::CFPtr<CFMutableStringRef>::adopt(CFStringCreateMutable(nullptr, 0));
+        CFStringAppendCharacters(str.get(), &c, 1);
+        CFStringLowercase(str.get(), nullptr);
+        if( CFStringGetLength(str.get()) == 1 )
+            table[unit] = CFStringGetCharacterAtIndex(str.get(), 0);
+    }
+    return table;
+}
+
+// Returns the length of the bytes without an incomplete character at their end.
+static size_t CompleteLength(std::span<const uint8_t> _bytes, utility::Encoding _encoding) noexcept
+{
+    size_t length = _bytes.size();
+    if( _encoding == utility::Encoding::ENCODING_UTF8 ) {
+        // find the start of the last character and check whether all its bytes are present
+        for( size_t back = 1; back <= 4 && back <= _bytes.size(); ++back ) {
+            const uint8_t byte = _bytes[_bytes.size() - back];
+            if( (byte & 0xC0) == 0x80 )
+                continue;
+            const size_t expected = byte < 0x80 ? 1 : (byte & 0xE0) == 0xC0 ? 2 : (byte & 0xF0) == 0xE0 ? 3 : 4;
+            if( expected > back )
+                length = _bytes.size() - back;
+            break;
+        }
+    }
+    else if( _encoding == utility::Encoding::ENCODING_UTF16LE || _encoding == utility::Encoding::ENCODING_UTF16BE ) {
+        length &= ~size_t(1);
+        if( length >= 2 ) {
+            const uint8_t high_byte = _encoding == utility::Encoding::ENCODING_UTF16LE ? _bytes[length - 1]
+                                                                                         : _bytes[length - 2];
+            if( (high_byte & 0xFC) == 0xD8 ) // a high surrogate waiting for its pair
+                length -= 2;
+        }
+    }
+    return length > 0 ? length : _bytes.size();
+}
+
+static bool IsAlphanumeric(char32_t _character) noexcept
+{
+    static const auto alphanumeric = CFCharacterSetGetPredefined(kCFCharacterSetAlphaNumeric);
+    return CFCharacterSetIsLongCharacterMember(alphanumeric, _character);
+}
+
+MultiTextSearch::MultiTextSearch(std::span<const std::string> _texts, bool _case_sensitive, bool _whole_phrase)
+    : m_CaseSensitive(_case_sensitive), m_WholePhrase(_whole_phrase)
+{
+    m_ASCIIOnly = std::ranges::all_of(_texts, [](const std::string &_text) {
+        return std::ranges::all_of(_text, [](char _c) { return static_cast<uint8_t>(_c) < 0x80; });
+    });
+    if( !m_CaseSensitive && !m_ASCIIOnly )
+        m_Lowercase = BuildLowercaseTable();
+
+    // the texts are converted into exactly the same form as the decoded contents of the files are
+    std::vector<std::string> folded;
+    folded.reserve(_texts.size());
+    for( const std::string &text : _texts ) {
+        std::string &bytes = folded.emplace_back();
+        if( text.empty() )
+            continue;
+        const base::CFString cf_text(text);
+        if( !cf_text )
+            continue;
+        const CFIndex length = CFStringGetLength(*cf_text);
+        std::vector<UniChar> units(static_cast<size_t>(length));
+        CFStringGetCharacters(*cf_text, CFRangeMake(0, length), units.data());
+        for( size_t i = 0; i < units.size(); ++i ) {
+            char32_t character = units[i];
+            if( CFStringIsSurrogateHighCharacter(units[i]) && i + 1 < units.size() &&
+                CFStringIsSurrogateLowCharacter(units[i + 1]) ) {
+                character = CFStringGetLongCharacterForSurrogatePair(units[i], units[i + 1]);
+                ++i;
+            }
+            std::array<uint8_t, 4> encoded;
+            const size_t encoded_length = EncodeUTF8(Fold(character), encoded);
+            bytes.append(reinterpret_cast<const char *>(encoded.data()), encoded_length);
+        }
+    }
+    Build(folded);
+}
+
+char32_t MultiTextSearch::Fold(char32_t _character) const noexcept
+{
+    if( m_CaseSensitive )
+        return _character;
+    if( _character >= 'A' && _character <= 'Z' )
+        return _character + ('a' - 'A');
+    if( _character < m_Lowercase.size() )
+        return m_Lowercase[_character];
+    return _character;
+}
+
+bool MultiTextSearch::CanSearchRawBytes(utility::Encoding _encoding) const noexcept
+{
+    if( m_WholePhrase )
+        return false;
+
+    // the single-byte encodings are the supersets of ASCII, while the ASCII bytes are never a part of a multi-byte
+    // character in UTF-8, so the ASCII case can be folded by mapping the bytes
+    if( _encoding == utility::Encoding::ENCODING_UTF8 )
+        return m_CaseSensitive || m_ASCIIOnly;
+    return IsSingleByte(_encoding) && m_ASCIIOnly;
+}
+
+void MultiTextSearch::Build(const std::vector<std::string> &_texts)
+{
+    // only the bytes present in the texts have their own columns in the transitions table
+    std::array<bool, 256> used = {};
+    for( const std::string &text : _texts )
+        for( const char c : text )
+            used[static_cast<uint8_t>(c)] = true;
+    for( size_t byte = 0; byte < used.size(); ++byte )
+        if( used[byte] )
+            m_ByteClasses[byte] = static_cast<uint16_t>(m_ClassesCount++);
+    if( !m_CaseSensitive )
+        for( char c = 'A'; c <= 'Z'; ++c )
+            m_ByteClasses[static_cast<uint8_t>(c)] = m_ByteClasses[static_cast<uint8_t>(c + ('a' - 'A'))];
+
+    // the trie of the texts, where the transition into the root means no transition at all
+    m_Transitions.assign(m_ClassesCount, 0);
+    m_Outputs.assign(1, -1);
+    m_Shorter.assign(_texts.size(), -1);
+    m_Lengths.resize(_texts.size());
+    for( size_t index = 0; index < _texts.size(); ++index ) {
+        const std::string &text = _texts[index];
+        m_Lengths[index] = text.size();
+        if( text.empty() )
+            continue;
+        State state = 0;
+        for( const char c : text ) {
+            const size_t transition = (state * m_ClassesCount) + m_ByteClasses[static_cast<uint8_t>(c)];
+            if( m_Transitions[transition] == 0 ) {
+                m_Transitions[transition] = static_cast<State>(m_Outputs.size());
+                m_Transitions.resize(m_Transitions.size() + m_ClassesCount, 0);
+                m_Outputs.push_back(-1);
+            }
+            state = m_Transitions[transition];
+        }
+        if( m_Outputs[state] < 0 )
+            m_Outputs[state] = static_cast<int32_t>(index);
+        m_MaxLength = std::max(m_MaxLength, text.size());
+    }
+
+    // Turn the trie into a complete automaton in the breadth-first order: the missing transitions follow the ones of
+    // the longest proper suffix present in the trie, and so do the outputs of the states which don't end a text. The
+    // texts which end at a state are its own one followed by the chain of the shorter ones.
+    std::vector<State> suffix(m_Outputs.size(), 0);
+    std::vector<State> queue;
+    for( size_t c = 0; c < m_ClassesCount; ++c )
+        if( m_Transitions[c] != 0 )
+            queue.push_back(m_Transitions[c]);
+    for( size_t head = 0; head < queue.size(); ++head ) {
+        const State state = queue[head];
+        if( m_Outputs[state] < 0 )
+            m_Outputs[state] = m_Outputs[suffix[state]];
+        else
+            m_Shorter[static_cast<size_t>(m_Outputs[state])] = m_Outputs[suffix[state]];
+        for( size_t c = 0; c < m_ClassesCount; ++c ) {
+            State &next = m_Transitions[(state * m_ClassesCount) + c];
+            const State fallback = m_Transitions[(suffix[state] * m_ClassesCount) + c];
+            if( next != 0 ) {
+                suffix[next] = fallback;
+                queue.push_back(next);
+            }
+            else {
+                next = fallback;
+            }
+        }
+    }
+}
+
+MultiTextSearch::Result
+MultiTextSearch::Search(FileWindow &_file, utility::Encoding _encoding, const CancelChecker &_checker) const
+{
+    if( m_MaxLength == 0 )
+        return {.response = Response::Invalid, .match = std::nullopt};
+
+    const bool raw = CanSearchRawBytes(_encoding);
+    const size_t window_size = _file.WindowSize();
+    std::vector<uint16_t> units(raw ? 0 : window_size);
+    std::vector<uint32_t> unit_offsets(raw ? 0 : window_size);
+
+    // The file offsets of the characters which the recently fed bytes belong to, to locate the starts of the matches,
+    // along with whether these characters are alphanumeric, to tell what precedes the matches in the whole-phrase mode.
+    std::vector<uint64_t> origins(std::bit_ceil(m_MaxLength + 1));
+    std::vector<bool> alphanumeric(m_WholePhrase ? origins.size() : 0);
+    const size_t origins_mask = origins.size() - 1;
+    uint64_t fed = 0;
+    State state = 0;
+    const auto feed = [&](uint8_t _byte, uint64_t _origin) {
+        state = m_Transitions[(state * m_ClassesCount) + m_ByteClasses[_byte]];
+        origins[fed++ & origins_mask] = _origin;
+        return m_Outputs[state];
+    };
+    const auto found = [&](int32_t _text, uint64_t _end) {
+        const uint64_t start = origins[(fed - m_Lengths[_text]) & origins_mask];
+        return Result{.response = Response::Found,
+                      .match = Match{.offset = start, .bytes_len = _end - start, .text_index = size_t(_text)}};
+    };
+
+    // A whole-phrase match is the longest of the texts ending at the byte which isn't preceded by an alphanumeric
+    // character. It's pending until the next character tells whether the match is followed by an alphanumeric one.
+    std::optional<Result> pending;
+    const auto starts_phrase = [&](int32_t _text) {
+        const size_t length = m_Lengths[static_cast<size_t>(_text)];
+        return fed == length || !alphanumeric[(fed - length - 1) & origins_mask];
+    };
+
+    // the automaton carries its state from one window to the next, so the windows don't need to overlap
+    uint64_t position = 0;
+    while( position < _file.FileSize() ) {
+        if( _checker && _checker() )
+            return {.response = Response::Canceled, .match = std::nullopt};
+
+        const uint64_t window_pos = std::min(position, uint64_t(_file.FileSize() - window_size));
+        if( _file.MoveWindow(window_pos) != 0 )
+            return {.response = Response::IOErr, .match = std::nullopt};
+        const auto bytes =
+            std::span(static_cast<const uint8_t *>(_file.Window()), window_size).subspan(position - window_pos);
+
+        if( raw ) {
+            for( size_t i = 0; i < bytes.size(); ++i )
+                if( const int32_t text = feed(bytes[i], position + i); text >= 0 )
+                    return found(text, position + i + 1);
+            position += bytes.size();
+            continue;
+        }
+
+        // a character cut by the end of the window is decoded from the next one
+        const bool is_last_window = window_pos + window_size == _file.FileSize();
+        const size_t length = is_last_window ? bytes.size() : CompleteLength(bytes, _encoding);
+        size_t units_count = 0;
+        utility::InterpretAsUnichar(
+            _encoding, bytes.data(), length, units.data(), unit_offsets.data(), &units_count);
+        for( size_t i = 0; i < units_count; ) {
+            char32_t character = units[i];
+            size_t next = i + 1;
+            if( CFStringIsSurrogateHighCharacter(units[i]) && next < units_count &&
+                CFStringIsSurrogateLowCharacter(units[next]) ) {
+                character = CFStringGetLongCharacterForSurrogatePair(units[i], units[next]);
+                ++next;
+            }
+            const uint64_t begin = position + unit_offsets[i];
+            const uint64_t end = position + (next < units_count ? unit_offsets[next] : length);
+            std::array<uint8_t, 4> encoded;
+            const size_t encoded_length = EncodeUTF8(Fold(character), encoded);
+            if( !m_WholePhrase ) {
+                for( size_t b = 0; b < encoded_length; ++b )
+                    if( const int32_t text = feed(encoded[b], begin); text >= 0 )
+                        return found(text, end);
+                i = next;
+                continue;
+            }
+
+            const bool is_alphanumeric = IsAlphanumeric(character);
+            if( pending && !is_alphanumeric )
+                return *pending;
+            pending.reset();
+            for( size_t b = 0; b < encoded_length; ++b ) {
+                int32_t text = feed(encoded[b], begin);
+                alphanumeric[(fed - 1) & origins_mask] = is_alphanumeric;
+                while( text >= 0 && !starts_phrase(text) )
+                    text = m_Shorter[static_cast<size_t>(text)];
+                if( text >= 0 )
+                    pending = found(text, end);
+            }
+            i = next;
+        }
+        position += length;
+    }
+
+    if( pending )
+        return *pending; // the match is followed by the end of the file
+    return {.response = Response::NotFound, .match = std::nullopt};
+}
+
+} // namespace nc::vfs
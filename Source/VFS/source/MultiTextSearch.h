@@ -0,0 +1,67 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#pragma once
+
+#include <VFS/FileWindow.h>
+#include <VFS/SearchInFile.h>
+#include <Utility/Encodings.h>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace nc::vfs {
+
+// Searches a file for any of several texts in a single pass with an Aho-Corasick automaton, so the cost per byte
+// doesn't depend on the number of texts. The automaton is built once and can be shared by concurrent searches.
+// The texts are matched directly against the raw bytes when the encoding allows that, otherwise against the contents
+// decoded from the file's encoding. The case-insensitive search compares the lowercase forms of the characters.
+// The whole-phrase search accepts only the occurrences which are not surrounded by the alphanumeric characters, it
+// always decodes the contents to tell the characters around them.
+class MultiTextSearch
+{
+public:
+    using Response = SearchInFile::Response;
+    using CancelChecker = SearchInFile::CancelChecker;
+
+    struct Match {
+        uint64_t offset;
+        uint64_t bytes_len;
+        size_t text_index; // which of the texts was found
+    };
+
+    struct Result {
+        Response response;
+        std::optional<Match> match;
+    };
+
+    // The texts are UTF-8 encoded, the empty ones are ignored.
+    MultiTextSearch(std::span<const std::string> _texts, bool _case_sensitive, bool _whole_phrase = false);
+
+    // Looks for the occurrence which ends first, the longest one if several of them end at the same byte.
+    // The file window is moved through the whole file. Yields Response::Invalid if there's no text to search for.
+    Result Search(FileWindow &_file, utility::Encoding _encoding, const CancelChecker &_checker = {}) const;
+
+private:
+    using State = uint32_t;
+
+    void Build(const std::vector<std::string> &_texts);
+    char32_t Fold(char32_t _character) const noexcept;
+    bool CanSearchRawBytes(utility::Encoding _encoding) const noexcept;
+
+    bool m_CaseSensitive;
+    bool m_WholePhrase;
+    bool m_ASCIIOnly = true;
+    std::vector<uint16_t> m_Lowercase; // of every UTF-16 code unit, only for the case-insensitive non-ASCII texts
+
+    std::array<uint16_t, 256> m_ByteClasses = {}; // the bytes absent in the texts share the class 0
+    size_t m_ClassesCount = 1;
+    std::vector<State> m_Transitions; // m_ClassesCount per state, the state 0 is the root
+    std::vector<int32_t> m_Outputs;   // the longest text which ends at each state, or -1
+    std::vector<int32_t> m_Shorter;   // the longest text which is a proper suffix of each text, or -1
+    std::vector<size_t> m_Lengths;    // the length of each text in the bytes fed to the automaton
+    size_t m_MaxLength = 0;
+};
+
+} // namespace nc::vfs
@@ -1,20 +1,33 @@
-// Copyright (C) 2014-2020 Michael Kazakov. Subject to GNU General Public License version 3.
+// Copyright (C) 2014-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #pragma once
 
 #include <sys/stat.h>
-#include <optional>
-#include <unordered_map>
+#include <array>
 #include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <vector>
 #include <Base/spinlock.h>
 
 namespace nc::vfs::native {
 
 /**
  * Presumably should be used only on directories.
+ * The entries are spread over independent shards. Each shard is an insert-only open-addressing table, which is read
+ * without any locks: a lookup is a bounded number of atomic loads. Only the insertions into the same shard are
+ * serialized. The strings are kept in the shards' arenas and are never freed, so the returned pointers stay valid for
+ * the lifetime of the cache.
  */
 class DisplayNamesCache
 {
 public:
+    DisplayNamesCache();
+    DisplayNamesCache(const DisplayNamesCache &) = delete;
+    ~DisplayNamesCache();
+    DisplayNamesCache &operator=(const DisplayNamesCache &) = delete;
+
     static DisplayNamesCache &Instance();
 
     // nullptr string means that there's no dispay string for this
@@ -23,20 +36,39 @@ public:
     const char *DisplayName(ino_t _ino, dev_t _dev, const std::string &_path);
 
 private:
-    std::optional<const char *> Fast_Unlocked(ino_t _ino, dev_t _dev, const std::string &_path) const noexcept;
-    void Commit_Locked(ino_t _ino, dev_t _dev, const std::string &_path, const char *_dispay_name);
-
     struct Filename {
+        ino_t ino;
+        dev_t dev;
         const char *fs_filename;
         const char *display_filename;
     };
-    using Inodes = std::unordered_multimap<ino_t, Filename>;
-    using Devices = std::unordered_map<dev_t, Inodes>;
 
-    std::atomic_int m_Readers{0};
-    spinlock m_ReadLock;
-    spinlock m_WriteLock;
-    Devices m_Devices;
+    struct Table {
+        explicit Table(size_t _capacity);
+        size_t mask;
+        std::unique_ptr<std::atomic<const Filename *>[]> slots;
+    };
+
+    struct alignas(64) Shard {
+        std::atomic<const Table *> table = nullptr;
+        spinlock write_lock;
+        size_t size = 0;
+        std::vector<std::unique_ptr<Table>> tables; // the retired ones are kept for the readers still using them
+        std::pmr::monotonic_buffer_resource arena;
+    };
+
+    static constexpr size_t ShardsNumber = 64;
+
+    static std::optional<const char *>
+    Find(const Table &_table, size_t _hash, ino_t _ino, dev_t _dev, const std::string &_path) noexcept;
+    const char *Commit(Shard &_shard,
+                       size_t _hash,
+                       ino_t _ino,
+                       dev_t _dev,
+                       const std::string &_path,
+                       const std::optional<std::string> &_display_name);
+
+    std::array<Shard, ShardsNumber> m_Shards;
 };
 
 } // namespace nc::vfs::native
@@ -2,51 +2,117 @@
 #include "DisplayNamesCache.h"
 #include <Foundation/Foundation.h>
 #include <Utility/StringExtras.h>
+#include <ankerl/unordered_dense.h>
+#include <cstring>
 
 namespace nc::vfs::native {
 
+// a shard's table is grown to keep at least a half of its slots empty, so that the lookups stay short
+static constexpr size_t g_InitialTableCapacity = 16;
+
+DisplayNamesCache::Table::Table(size_t _capacity)
+    : mask(_capacity - 1), slots(std::make_unique<std::atomic<const Filename *>[]>(_capacity))
+{
+    for( size_t i = 0; i != _capacity; ++i )
+        slots[i].store(nullptr, std::memory_order_relaxed);
+}
+
+DisplayNamesCache::DisplayNamesCache()
+{
+    for( Shard &shard : m_Shards ) {
+        shard.tables.emplace_back(std::make_unique<Table>(g_InitialTableCapacity));
+        shard.table.store(shard.tables.back().get(), std::memory_order_release);
+    }
+}
+
+DisplayNamesCache::~DisplayNamesCache() = default;
+
 DisplayNamesCache &DisplayNamesCache::Instance()
 {
     static auto inst = new DisplayNamesCache; // never free
     return *inst;
 }
 
+static size_t Hash(ino_t _ino, dev_t _dev) noexcept
+{
+    return ankerl::unordered_dense::hash<uint64_t>{}(static_cast<uint64_t>(_ino) ^
+                                                     (static_cast<uint64_t>(static_cast<uint32_t>(_dev)) << 40));
+}
+
 static bool is_same_filename(const char *_filename, const std::string &_path)
 {
     const auto p = _path.rfind('/');
     return p != std::string::npos && strcmp(_filename, _path.c_str() + p + 1) == 0;
 }
 
-std::optional<const char *>
-DisplayNamesCache::Fast_Unlocked(ino_t _ino, dev_t _dev, const std::string &_path) const noexcept
+std::optional<const char *> DisplayNamesCache::Find(const Table &_table,
+                                                    const size_t _hash,
+                                                    const ino_t _ino,
+                                                    const dev_t _dev,
+                                                    const std::string &_path) noexcept
 {
-    const auto inodes = m_Devices.find(_dev);
-    if( inodes == end(m_Devices) )
-        return std::nullopt;
-
-    const auto range = inodes->second.equal_range(_ino);
-    for( auto i = range.first; i != range.second; ++i )
-        if( is_same_filename(i->second.fs_filename, _path) )
-            return i->second.display_filename;
-
-    return std::nullopt;
+    // the same inode can be met under different names, each of them has its own entry
+    for( size_t i = (_hash / ShardsNumber) & _table.mask;; i = (i + 1) & _table.mask ) {
+        const Filename *const f = _table.slots[i].load(std::memory_order_acquire);
+        if( f == nullptr )
+            return std::nullopt;
+        if( f->ino == _ino && f->dev == _dev && is_same_filename(f->fs_filename, _path) )
+            return f->display_filename;
+    }
 }
 
-static const char *filename_dup(const std::string &_path)
+static const char *Intern(std::pmr::memory_resource &_arena, std::string_view _string)
 {
-    auto i = _path.rfind('/');
-    if( i == std::string::npos )
-        return "";
-    return strdup(_path.c_str() + i + 1);
+    auto *const str = static_cast<char *>(_arena.allocate(_string.size() + 1, 1));
+    memcpy(str, _string.data(), _string.size());
+    str[_string.size()] = 0;
+    return str;
 }
 
-void DisplayNamesCache::Commit_Locked(ino_t _ino, dev_t _dev, const std::string &_path, const char *_dispay_name)
+const char *DisplayNamesCache::Commit(Shard &_shard,
+                                      const size_t _hash,
+                                      const ino_t _ino,
+                                      const dev_t _dev,
+                                      const std::string &_path,
+                                      const std::optional<std::string> &_display_name)
 {
-    Filename f;
-    f.fs_filename = filename_dup(_path);
-    f.display_filename = _dispay_name;
-    const std::lock_guard<spinlock> guard(m_WriteLock);
-    m_Devices[_dev].insert(std::make_pair(_ino, f));
+    const std::lock_guard<spinlock> guard(_shard.write_lock);
+    const Table *table = _shard.table.load(std::memory_order_relaxed);
+
+    // another thread might have committed the same entry meanwhile
+    if( const auto existed = Find(*table, _hash, _ino, _dev, _path) )
+        return *existed;
+
+    if( (_shard.size + 1) * 2 > table->mask + 1 ) {
+        // the new table is filled before it becomes visible, the old one stays intact for its current readers
+        auto grown = std::make_unique<Table>((table->mask + 1) * 2);
+        for( size_t i = 0; i <= table->mask; ++i ) {
+            const Filename *const f = table->slots[i].load(std::memory_order_relaxed);
+            if( f == nullptr )
+                continue;
+            size_t j = (Hash(f->ino, f->dev) / ShardsNumber) & grown->mask;
+            while( grown->slots[j].load(std::memory_order_relaxed) != nullptr )
+                j = (j + 1) & grown->mask;
+            grown->slots[j].store(f, std::memory_order_relaxed);
+        }
+        table = grown.get();
+        _shard.tables.emplace_back(std::move(grown));
+        _shard.table.store(table, std::memory_order_release);
+    }
+
+    const auto slash = _path.rfind('/');
+    auto *const f = static_cast<Filename *>(_shard.arena.allocate(sizeof(Filename), alignof(Filename)));
+    f->ino = _ino;
+    f->dev = _dev;
+    f->fs_filename = Intern(_shard.arena, slash == std::string::npos ? "" : std::string_view(_path).substr(slash + 1));
+    f->display_filename = _display_name ? Intern(_shard.arena, *_display_name) : nullptr;
+
+    size_t i = (_hash / ShardsNumber) & table->mask;
+    while( table->slots[i].load(std::memory_order_relaxed) != nullptr )
+        i = (i + 1) & table->mask;
+    table->slots[i].store(f, std::memory_order_release);
+    ++_shard.size;
+    return f->display_filename;
 }
 
 const char *DisplayNamesCache::DisplayName(const struct stat &_st, const std::string &_path)
@@ -63,50 +129,37 @@ const char *DisplayNamesCache::DisplayName(const std::string &_path)
 }
 
 static NSFileManager *filemanager = NSFileManager.defaultManager;
-static const char *Slow(const std::string &_path)
+static std::optional<std::string> Slow(const std::string &_path)
 {
     NSString *const path = [NSString stringWithUTF8StdStringNoCopy:_path];
     if( path == nil )
-        return nullptr; // can't create string for this path.
+        return std::nullopt; // can't create string for this path.
 
     NSString *display_name = [filemanager displayNameAtPath:path];
     if( display_name == nil )
-        return nullptr; // something strange has happen
+        return std::nullopt; // something strange has happen
 
     display_name = [display_name decomposedStringWithCanonicalMapping];
     const char *display_utf8_name = display_name.UTF8String;
 
     if( strcmp(_path.c_str() + _path.rfind('/') + 1, display_utf8_name) == 0 )
-        return nullptr; // this display name is exactly like the filesystem one
+        return std::nullopt; // this display name is exactly like the filesystem one
 
-    return strdup(display_utf8_name);
+    return std::string(display_utf8_name);
 }
 
 const char *DisplayNamesCache::DisplayName(ino_t _ino, dev_t _dev, const std::string &_path)
 {
-    // many readers, one writer | readers preference, based on atomic spinlocks
+    const size_t hash = Hash(_ino, _dev);
+    Shard &shard = m_Shards[hash % ShardsNumber];
 
     // FAST PATH BEGINS
-    m_ReadLock.lock();
-    if( (++m_Readers) == 1 )
-        m_WriteLock.lock();
-    m_ReadLock.unlock();
-
-    const auto existed = Fast_Unlocked(_ino, _dev, _path);
-
-    m_ReadLock.lock();
-    if( (--m_Readers) == 0 )
-        m_WriteLock.unlock();
-    m_ReadLock.unlock();
-
-    if( existed )
+    if( const auto existed = Find(*shard.table.load(std::memory_order_acquire), hash, _ino, _dev, _path) )
         return *existed;
     // FAST PATH ENDS
 
     // SLOW PATH BEGINS
-    const auto generated_str = Slow(_path);
-    Commit_Locked(_ino, _dev, _path, generated_str);
-    return generated_str;
+    return Commit(shard, hash, _ino, _dev, _path, Slow(_path));
     // SLOW PATH ENDS
 }
 
@@ -50,6 +50,7 @@ static int LStatByPath(nc::routedio::PosixIOInterface &_io, const char *_path, c
     params.filename = "";
     params.crt_time = stat_buffer.st_birthtimespec.tv_sec;
     params.mod_time = stat_buffer.st_mtimespec.tv_sec;
+    params.mod_time_nsec = stat_buffer.st_mtimespec.tv_nsec;
     params.chg_time = stat_buffer.st_mtimespec.tv_sec;
     params.acc_time = stat_buffer.st_ctimespec.tv_sec;
     params.add_time = -1;
@@ -60,6 +61,8 @@ static int LStatByPath(nc::routedio::PosixIOInterface &_io, const char *_path, c
     params.inode = stat_buffer.st_ino;
     params.flags = stat_buffer.st_flags;
     params.size = stat_buffer.st_size;
+    params.alloc_size = stat_buffer.st_blocks * S_BLKSIZE;
+    params.nlink = stat_buffer.st_nlink;
 
     _cb_param(params);
 
@@ -85,6 +88,8 @@ int Fetching::ReadSingleEntryAttributesByPath(nc::routedio::PosixIOInterface &_i
         u_int32_t flags;
         u_int64_t inode;
         struct timespec add_time;
+        u_int32_t link_count;
+        off_t alloc_size;
         off_t file_size;
         uint64_t ext_flags;
     } __attribute__((aligned(4), packed)) attrs;
@@ -95,7 +100,7 @@ int Fetching::ReadSingleEntryAttributesByPath(nc::routedio::PosixIOInterface &_i
     attr_list.commonattr = ATTR_CMN_RETURNED_ATTRS | ATTR_CMN_DEVID | ATTR_CMN_OBJTYPE | ATTR_CMN_CRTIME |
                            ATTR_CMN_MODTIME | ATTR_CMN_CHGTIME | ATTR_CMN_ACCTIME | ATTR_CMN_OWNERID | ATTR_CMN_GRPID |
                            ATTR_CMN_ACCESSMASK | ATTR_CMN_FLAGS | ATTR_CMN_FILEID | ATTR_CMN_ADDEDTIME;
-    attr_list.fileattr = ATTR_FILE_DATALENGTH;
+    attr_list.fileattr = ATTR_FILE_LINKCOUNT | ATTR_FILE_ALLOCSIZE | ATTR_FILE_DATALENGTH;
     attr_list.forkattr = ATTR_CMNEXT_EXT_FLAGS;
 
     StackAllocator alloc;
@@ -141,6 +146,7 @@ int Fetching::ReadSingleEntryAttributesByPath(nc::routedio::PosixIOInterface &_i
 
     if( attrs.returned.commonattr & ATTR_CMN_MODTIME ) {
         params.mod_time = reinterpret_cast<const struct timespec *>(field)->tv_sec;
+        params.mod_time_nsec = reinterpret_cast<const struct timespec *>(field)->tv_nsec;
         field += sizeof(struct timespec);
     }
 
@@ -186,6 +192,18 @@ int Fetching::ReadSingleEntryAttributesByPath(nc::routedio::PosixIOInterface &_i
     else
         params.add_time = -1;
 
+    if( attrs.returned.fileattr & ATTR_FILE_LINKCOUNT ) {
+        params.nlink = *reinterpret_cast<const u_int32_t *>(field);
+        field += sizeof(u_int32_t);
+    }
+
+    if( attrs.returned.fileattr & ATTR_FILE_ALLOCSIZE ) {
+        params.alloc_size = *reinterpret_cast<const off_t *>(field);
+        field += sizeof(off_t);
+    }
+    else
+        params.alloc_size = -1;
+
     if( attrs.returned.fileattr & ATTR_FILE_DATALENGTH ) {
         params.size = *reinterpret_cast<const off_t *>(field);
         field += sizeof(off_t);
@@ -240,6 +258,7 @@ int Fetching::ReadDirAttributesStat(const int _dir_fd,
             params.filename = std::get<0>(e).c_str();
             params.crt_time = stat_buffer.st_birthtimespec.tv_sec;
             params.mod_time = stat_buffer.st_mtimespec.tv_sec;
+            params.mod_time_nsec = stat_buffer.st_mtimespec.tv_nsec;
             params.chg_time = stat_buffer.st_mtimespec.tv_sec;
             params.acc_time = stat_buffer.st_ctimespec.tv_sec;
             params.add_time = -1;
@@ -251,8 +270,12 @@ int Fetching::ReadDirAttributesStat(const int _dir_fd,
             params.flags = stat_buffer.st_flags;
             params.ext_flags = 0;
             params.size = -1;
-            if( !S_ISDIR(stat_buffer.st_mode) )
+            params.alloc_size = -1;
+            params.nlink = stat_buffer.st_nlink;
+            if( !S_ISDIR(stat_buffer.st_mode) ) {
                 params.size = stat_buffer.st_size;
+                params.alloc_size = stat_buffer.st_blocks * S_BLKSIZE;
+            }
 
             _cb_fetch(1);
             _cb_param(params);
@@ -273,7 +296,7 @@ int Fetching::ReadDirAttributesBulk(const int _dir_fd,
                            ATTR_CMN_OBJTYPE | ATTR_CMN_CRTIME | ATTR_CMN_MODTIME | ATTR_CMN_CHGTIME | ATTR_CMN_ACCTIME |
                            ATTR_CMN_ADDEDTIME | ATTR_CMN_OWNERID | ATTR_CMN_GRPID | ATTR_CMN_ACCESSMASK |
                            ATTR_CMN_FLAGS | ATTR_CMN_FILEID;
-    attr_list.fileattr = ATTR_FILE_DATALENGTH;
+    attr_list.fileattr = ATTR_FILE_LINKCOUNT | ATTR_FILE_ALLOCSIZE | ATTR_FILE_DATALENGTH;
     attr_list.forkattr = ATTR_CMNEXT_EXT_FLAGS;
 
     // TODO: handle ENOTSUP
@@ -336,10 +359,12 @@ int Fetching::ReadDirAttributesBulk(const int _dir_fd,
 
             if( returned.commonattr & ATTR_CMN_MODTIME ) {
                 params.mod_time = reinterpret_cast<const struct timespec *>(field)->tv_sec;
+                params.mod_time_nsec = reinterpret_cast<const struct timespec *>(field)->tv_nsec;
                 field += sizeof(timespec);
             }
             else {
                 params.mod_time = 0;
+                params.mod_time_nsec = 0;
             }
 
             if( returned.commonattr & ATTR_CMN_CHGTIME ) {
@@ -403,6 +428,22 @@ int Fetching::ReadDirAttributesBulk(const int _dir_fd,
                 params.add_time = -1;
             }
 
+            if( returned.fileattr & ATTR_FILE_LINKCOUNT ) {
+                params.nlink = *reinterpret_cast<const u_int32_t *>(field);
+                field += sizeof(u_int32_t);
+            }
+            else {
+                params.nlink = 0;
+            }
+
+            if( returned.fileattr & ATTR_FILE_ALLOCSIZE ) {
+                params.alloc_size = *reinterpret_cast<const off_t *>(field);
+                field += sizeof(off_t);
+            }
+            else {
+                params.alloc_size = -1;
+            }
+
             if( returned.fileattr & ATTR_FILE_DATALENGTH ) {
                 params.size = *reinterpret_cast<const off_t *>(field);
                 field += sizeof(off_t);
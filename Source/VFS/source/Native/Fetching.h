@@ -18,6 +18,7 @@ public:
         const char *filename = nullptr;
         time_t crt_time = 0;
         time_t mod_time = 0;
+        long mod_time_nsec = 0;
         time_t chg_time = 0;
         time_t acc_time = 0;
         time_t add_time = 0; // may be -1 if absent
@@ -29,6 +30,8 @@ public:
         uint32_t flags = 0;
         uint64_t ext_flags = 0; // EF_xxx
         int64_t size = 0;       // will be -1 if absent
+        int64_t alloc_size = 0; // will be -1 if absent
+        uint32_t nlink = 0;     // will be 0 if absent
     };
 
     using Callback = std::function<void(const CallbackParams &_params)>;
@@ -2,6 +2,7 @@
 #pragma once
 
 #include <VFS/Host.h>
+#include <span>
 
 namespace nc::utility {
 class NativeFSManager;
@@ -13,6 +14,27 @@ namespace nc::vfs {
 class NativeHost : public Host
 {
 public:
+    struct DirectorySizeOptions {
+        // count the space allocated for the files on the disk instead of their logical sizes
+        bool allocated = false;
+
+        // count the files with several hard links only once, e.g. the unchanged files in the backup snapshots
+        bool hardlinks_once = false;
+    };
+
+    // An entry of a directory as seen by the directory size calculations.
+    struct DirectorySizeEntry {
+        std::string_view filename;
+        mode_t type = 0; // the S_IFMT bits of the mode
+        dev_t dev = 0;
+        uint64_t inode = 0;
+        int64_t mtime_sec = 0;
+        int64_t mtime_nsec = 0;
+        int64_t size = -1;       // -1 if absent, e.g. for directories
+        int64_t alloc_size = -1; // -1 if absent, e.g. for directories
+        uint32_t nlink = 0;      // 0 if absent
+    };
+
     NativeHost(nc::utility::NativeFSManager &_native_fs_man, nc::utility::FSEventsFileUpdate &_fsevents_file_update);
 
     static const char *UniqueTag;
@@ -59,6 +81,32 @@ public:
 
     ssize_t CalculateDirectorySize(std::string_view _path, const VFSCancelChecker &_cancel_checker) override;
 
+    // Sums the sizes of the files and the symlinks under the directory, walking its subdirectories in parallel.
+    // The subdirectories which can't be read are skipped.
+    // Returns a negative VFSError if the directory itself can't be read or the calculation was canceled.
+    ssize_t CalculateDirectorySize(std::string_view _path,
+                                   const VFSCancelChecker &_cancel_checker,
+                                   const DirectorySizeOptions &_options);
+
+    // Reads the attributes of the directory's entries in bulk, the way CalculateDirectorySize() does, instead of
+    // stat'ing the entries one by one. Symlinks are not followed.
+    // Returns a negative VFSError if the directory can't be read.
+    int IterateDirectoryForSize(std::string_view _path,
+                                const std::function<void(const DirectorySizeEntry &_entry)> &_handler);
+
+    using TagsBatch = std::vector<std::pair<unsigned, std::vector<utility::Tags::Tag>>>;
+
+    // Reads the Finder tags of the entries of a listing fetched from this host without them, e.g. to show the listing
+    // before its tags are loaded. The entries which are known to have no extended attributes are not opened at all,
+    // the others are read in parallel. The entries at _first go first, in the given order, followed by the rest.
+    // _handler is called on the calling thread with the entries whose tags differ from the listing's: the first batch
+    // covers _first, the following ones are twice as large as their predecessors. The batches suit Listing::WithTags().
+    // The cancel checker is called from several threads, though never concurrently.
+    int FetchTags(const VFSListing &_listing,
+                  std::span<const unsigned> _first,
+                  const std::function<void(TagsBatch &&_batch)> &_handler,
+                  const VFSCancelChecker &_cancel_checker);
+
     int ReadSymlink(std::string_view _path,
                     char *_buffer,
                     size_t _buffer_size,
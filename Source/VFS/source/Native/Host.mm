@@ -18,12 +18,20 @@
 #include "../ListingInput.h"
 #include "Fetching.h"
 #include <Base/DispatchGroup.h>
+#include <Base/dispatch_cpp.h>
+#include <Base/UnorderedUtil.h>
 #include <Base/StackAllocator.h>
 #include <Utility/ObjCpp.h>
 #include <Utility/Tags.h>
 #include <sys/mount.h>
+#include <Base/spinlock.h>
+#include <ankerl/unordered_dense.h>
 
 #include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 // hack to access function from libc implementation directly.
 // this func does readdir but without mutex locking
@@ -372,86 +380,143 @@ int NativeHost::CreateFile(std::string_view _path,
     return VFSError::Ok;
 }
 
-// return VFSError on error or cancellation
-static int CalculateDirectoriesSizesHelper(char *_path,
-                                           size_t _path_len,
-                                           std::atomic_bool &_iscancelling,
-                                           const VFSCancelChecker &_checker,
-                                           dispatch_queue &_stat_queue,
-                                           std::atomic_int64_t &_size_stock)
-{
-    if( _checker && _checker() ) {
-        _iscancelling = true;
-        return VFSError::Cancelled;
+// a directory size is calculated by this many threads at most
+static constexpr unsigned g_MaxDirectorySizeWorkers = 8;
+
+// the hardlinked files met by a calculation are remembered in this many independently locked sets
+static constexpr size_t g_HardlinksShards = 16;
+
+struct HardlinkIdentity {
+    dev_t dev = 0;
+    uint64_t inode = 0;
+    bool operator==(const HardlinkIdentity &) const noexcept = default;
+};
+
+struct HardlinkIdentityHash {
+    using is_avalanching = void;
+    size_t operator()(const HardlinkIdentity &_id) const noexcept
+    {
+        return ankerl::unordered_dense::hash<uint64_t>{}(_id.inode ^
+                                                         (static_cast<uint64_t>(static_cast<uint32_t>(_id.dev)) << 40));
     }
+};
 
-    auto &io = routedio::RoutedIO::InterfaceForAccess(_path, R_OK); // <-- sync IO operation
+struct DirectorySizeWalk {
+    NativeHost::DirectorySizeOptions options;
+    const VFSCancelChecker *cancel_checker = nullptr;
+    std::atomic_int64_t size{0};
 
-    const auto dirp = io.opendir(_path); // <-- sync IO operation
-    if( dirp == nullptr )
-        return VFSError::FromErrno();
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<std::string> queue; // processed as LIFO to go depth-first and keep the queue short
+    unsigned busy = 0;
+    bool cancelled = false;
 
-    _path[_path_len] = '/';
-    _path[_path_len + 1] = 0;
-    char *var = _path + _path_len + 1;
+    struct HardlinksShard {
+        spinlock lock;
+        ankerl::unordered_dense::set<HardlinkIdentity, HardlinkIdentityHash> met;
+    };
+    std::array<HardlinksShard, g_HardlinksShards> hardlinks;
+};
 
-    dirent *entp = nullptr;
-    while( (entp = io.readdir(dirp)) != nullptr ) { // <-- sync IO operation
-        if( _checker && _checker() ) {
-            _iscancelling = true;
-            goto cleanup;
-        }
+// returns true if the file wasn't met before by this calculation
+static bool MeetHardlink(DirectorySizeWalk &_walk, const HardlinkIdentity &_id)
+{
+    auto &shard = _walk.hardlinks[HardlinkIdentityHash{}(_id) % g_HardlinksShards];
+    const auto lock = std::lock_guard{shard.lock};
+    return shard.met.emplace(_id).second;
+}
 
-        if( entp->d_ino == 0 )
-            continue; // apple's documentation suggest to skip such files
-        if( entp->d_namlen == 1 && entp->d_name[0] == '.' )
-            continue; // do not process self entry
-        if( entp->d_namlen == 2 && entp->d_name[0] == '.' && entp->d_name[1] == '.' )
-            continue; // do not process parent entry
-
-        memcpy(var, entp->d_name, entp->d_namlen + 1);
-        if( entp->d_type == DT_DIR ) {
-            CalculateDirectoriesSizesHelper(
-                _path, _path_len + entp->d_namlen + 1, _iscancelling, _checker, _stat_queue, _size_stock);
-            if( _iscancelling )
-                goto cleanup;
-        }
-        else if( entp->d_type == DT_REG || entp->d_type == DT_LNK ) {
-            std::string full_path = _path;
-            _stat_queue.async([&, full_path = std::move(full_path)] {
-                if( _iscancelling )
-                    return;
+// Reads the attributes of the directory's entries in bulk, or one by one when Admin Mode routes the access.
+// The path must end with a slash. Returns 0 or an errno value.
+static int FetchDirectoryEntries(const std::string &_path, const Fetching::Callback &_cb_param)
+{
+    auto &io = routedio::RoutedIO::InterfaceForAccess(_path.c_str(), R_OK);
+    const int fd = io.open(_path.c_str(), O_RDONLY | O_NONBLOCK | O_DIRECTORY | O_CLOEXEC);
+    if( fd < 0 )
+        return errno;
+    auto close_fd = at_scope_end([fd] { close(fd); });
 
-                struct stat st;
-                if( io.lstat(full_path.c_str(), &st) == 0 ) // <-- sync IO operation
-                    _size_stock += st.st_size;
-            });
+    const auto cb_fetch = [](size_t) {};
+
+    // when Admin Mode is on - we use different fetch route
+    return io.isrouted() ? Fetching::ReadDirAttributesStat(fd, _path.c_str(), cb_fetch, _cb_param)
+                         : Fetching::ReadDirAttributesBulk(fd, cb_fetch, _cb_param);
+}
+
+// Sums the sizes of the directory's files and queues its subdirectories. The path must end with a slash.
+// Returns 0 or an errno value.
+static int ReadDirectoryForSize(const std::string &_path, DirectorySizeWalk &_walk)
+{
+    int64_t size = 0;
+    std::vector<std::string> subdirectories;
+    const auto cb_param = [&](const Fetching::CallbackParams &_params) {
+        const mode_t type = _params.mode & S_IFMT;
+        if( type == S_IFDIR ) {
+            subdirectories.emplace_back(_path + _params.filename + "/");
         }
-        else if( entp->d_type == DT_UNKNOWN ) {
-            // some filesystems (e.g. ftp) might provide DT_UNKNOWN via readdir, so
-            // need to check them via lstat() before doing further processing
-            struct stat st;
-            if( io.lstat(_path, &st) == 0 ) { // <-- sync IO operation
-                if( S_ISDIR(st.st_mode) ) {
-                    CalculateDirectoriesSizesHelper(
-                        _path, _path_len + entp->d_namlen + 1, _iscancelling, _checker, _stat_queue, _size_stock);
-                    if( _iscancelling )
-                        goto cleanup;
-                }
-                else if( S_ISREG(st.st_mode) || S_ISLNK(st.st_mode) ) {
-                    _size_stock += st.st_size;
-                }
-            }
+        else if( type == S_IFREG || type == S_IFLNK ) {
+            const int64_t entry_size = _walk.options.allocated ? _params.alloc_size : _params.size;
+            if( entry_size <= 0 )
+                return;
+            if( _walk.options.hardlinks_once && _params.nlink > 1 &&
+                !MeetHardlink(_walk, HardlinkIdentity{.dev = _params.dev, .inode = _params.inode}) )
+                return;
+            size += entry_size;
+        }
+    };
+    const int ret = FetchDirectoryEntries(_path, cb_param);
+    _walk.size += size;
+
+    if( !subdirectories.empty() ) {
+        {
+            const auto lock = std::lock_guard{_walk.lock};
+            _walk.queue.insert(_walk.queue.end(),
+                               std::make_move_iterator(subdirectories.begin()),
+                               std::make_move_iterator(subdirectories.end()));
         }
+        _walk.cv.notify_all();
     }
+    return ret;
+}
 
-cleanup:
-    io.closedir(dirp); // <-- sync IO operation
-    _path[_path_len] = 0;
-    return VFSError::Ok;
+static void RunDirectorySizeWorker(DirectorySizeWalk &_walk)
+{
+    auto lock = std::unique_lock{_walk.lock};
+    while( true ) {
+        // the walk is over when there's nothing queued and nobody can queue anything else
+        _walk.cv.wait(lock, [&] { return !_walk.queue.empty() || _walk.busy == 0 || _walk.cancelled; });
+        if( _walk.queue.empty() || _walk.cancelled )
+            break;
+
+        // the checker is called under the lock, so it's never called concurrently
+        if( *_walk.cancel_checker && (*_walk.cancel_checker)() ) {
+            _walk.cancelled = true;
+            break;
+        }
+
+        const std::string path = std::move(_walk.queue.back());
+        _walk.queue.pop_back();
+        ++_walk.busy;
+        lock.unlock();
+
+        ReadDirectoryForSize(path, _walk); // the subdirectories which can't be read are skipped
+
+        lock.lock();
+        if( --_walk.busy == 0 && _walk.queue.empty() )
+            break;
+    }
+    _walk.cv.notify_all();
 }
 
 ssize_t NativeHost::CalculateDirectorySize(std::string_view _path, const VFSCancelChecker &_cancel_checker)
+{
+    return CalculateDirectorySize(_path, _cancel_checker, {});
+}
+
+ssize_t NativeHost::CalculateDirectorySize(std::string_view _path,
+                                           const VFSCancelChecker &_cancel_checker,
+                                           const DirectorySizeOptions &_options)
 {
     if( _cancel_checker && _cancel_checker() )
         return VFSError::Cancelled;
@@ -459,23 +524,150 @@ ssize_t NativeHost::CalculateDirectorySize(std::string_view _path, const VFSCanc
     if( !_path.starts_with("/") )
         return VFSError::InvalidCall;
 
-    std::atomic_bool iscancelling{false};
+    DirectorySizeWalk walk;
+    walk.options = _options;
+    walk.cancel_checker = &_cancel_checker;
+
+    // the directory itself is read right away, so that its failure can be reported
+    if( const int rc = ReadDirectoryForSize(EnsureTrailingSlash(std::string(_path)), walk); rc != 0 )
+        return VFSError::FromErrno(rc);
+
+    {
+        const auto workers_number = std::clamp(std::thread::hardware_concurrency(), 1u, g_MaxDirectorySizeWorkers);
+        const base::DispatchGroup workers;
+        for( unsigned i = 1; i < workers_number; ++i )
+            workers.Run([&] { RunDirectorySizeWorker(walk); });
+        RunDirectorySizeWorker(walk);
+        workers.Wait();
+    }
 
-    // TODO: rewrite without using C-style shenanigans
-    char path[MAXPATHLEN];
-    memcpy(path, _path.data(), _path.length());
-    path[_path.length()] = 0;
+    if( walk.cancelled )
+        return VFSError::Cancelled;
+    return walk.size.load();
+}
 
-    dispatch_queue stat_queue("VFSNativeHost.CalculateDirectoriesSizes");
+int NativeHost::IterateDirectoryForSize(std::string_view _path,
+                                        const std::function<void(const DirectorySizeEntry &_entry)> &_handler)
+{
+    if( !_path.starts_with("/") || !_handler )
+        return VFSError::InvalidCall;
 
-    std::atomic_int64_t size{0};
-    const int result =
-        CalculateDirectoriesSizesHelper(path, strlen(path), iscancelling, _cancel_checker, stat_queue, size);
-    stat_queue.sync([] {});
-    if( result >= 0 )
-        return size;
-    else
-        return result;
+    const auto cb_param = [&](const Fetching::CallbackParams &_params) {
+        const DirectorySizeEntry entry{.filename = _params.filename,
+                                       .type = static_cast<mode_t>(_params.mode & S_IFMT),
+                                       .dev = _params.dev,
+                                       .inode = _params.inode,
+                                       .mtime_sec = _params.mod_time,
+                                       .mtime_nsec = _params.mod_time_nsec,
+                                       .size = _params.size,
+                                       .alloc_size = _params.alloc_size,
+                                       .nlink = _params.nlink};
+        _handler(entry);
+    };
+    if( const int rc = FetchDirectoryEntries(EnsureTrailingSlash(std::string(_path)), cb_param); rc != 0 )
+        return VFSError::FromErrno(rc);
+    return VFSError::Ok;
+}
+
+// the batches following the first one start with this many entries
+static constexpr size_t g_MinTagsBatch = 256;
+
+int NativeHost::FetchTags(const VFSListing &_listing,
+                          std::span<const unsigned> _first,
+                          const std::function<void(TagsBatch &&_batch)> &_handler,
+                          const VFSCancelChecker &_cancel_checker)
+{
+    if( !_listing.IsUniform() || _listing.Host().get() != this || !_handler )
+        return VFSError::InvalidCall;
+    if( std::ranges::any_of(_first, [&](unsigned _ind) { return _ind >= _listing.Count(); }) )
+        return VFSError::InvalidCall;
+
+    const std::string &directory = _listing.Directory();
+    auto &io = routedio::RoutedIO::InterfaceForAccess(directory.c_str(), R_OK);
+    const int fd = io.open(directory.c_str(), O_RDONLY | O_NONBLOCK | O_DIRECTORY | O_CLOEXEC);
+    if( fd < 0 )
+        return VFSError::FromErrno();
+    auto close_fd = at_scope_end([fd] { close(fd); });
+
+    // tags are stored in xattrs, so the entries known to have none can be skipped. The bulk fetching reports that
+    // without touching the entries themselves, while the routed I/O can't tell it.
+    ankerl::unordered_dense::set<std::string, UnorderedStringHashEqual, UnorderedStringHashEqual> with_xattrs;
+    if( !io.isrouted() ) {
+        const int rc = Fetching::ReadDirAttributesBulk(
+            fd, [](size_t) {}, [&](const Fetching::CallbackParams &_params) {
+                if( !(_params.ext_flags & EF_NO_XATTRS) )
+                    with_xattrs.emplace(_params.filename);
+            });
+        if( rc != 0 )
+            return VFSError::FromErrno(rc);
+    }
+    const auto may_have_tags = [&](unsigned _ind) {
+        return !_listing.IsDotDot(_ind) && (io.isrouted() || with_xattrs.contains(_listing.Filename(_ind)));
+    };
+    // the entries which can't have tags anymore are visited as well, to report that
+    const auto is_visited = [&](unsigned _ind) { return may_have_tags(_ind) || _listing.HasTags(_ind); };
+
+    // the requested entries go first, in their order, then the rest of them in the listing's order
+    std::vector<unsigned> order;
+    order.reserve(_listing.Count());
+    std::vector<bool> queued(_listing.Count(), false);
+    for( const unsigned ind : _first )
+        if( !queued[ind] ) {
+            queued[ind] = true;
+            if( is_visited(ind) )
+                order.push_back(ind);
+        }
+    const size_t first_batch = order.size();
+    for( unsigned ind = 0; ind != _listing.Count(); ++ind )
+        if( !queued[ind] && is_visited(ind) )
+            order.push_back(ind);
+
+    std::atomic_bool cancelled = false;
+    spinlock cancel_checker_lock;
+    std::vector<std::vector<utility::Tags::Tag>> tags;
+    size_t batch_begin = 0;
+    size_t batch_size = first_batch;
+    while( batch_begin < order.size() ) {
+        const size_t batch_end = std::min(order.size(), batch_begin + batch_size);
+        tags.clear();
+        tags.resize(batch_end - batch_begin);
+
+        dispatch_apply(batch_end - batch_begin, [&](size_t _n) {
+            if( cancelled )
+                return;
+            if( _cancel_checker ) {
+                const auto lock = std::lock_guard{cancel_checker_lock};
+                if( _cancel_checker() ) {
+                    cancelled = true;
+                    return;
+                }
+            }
+            const unsigned ind = order[batch_begin + _n];
+            if( !may_have_tags(ind) )
+                return;
+            const int entry_fd = openat(fd, _listing.Filename(ind).c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+            if( entry_fd < 0 )
+                return; // guess silenty skipping the errors is ok here...
+            auto close_entry_fd = at_scope_end([entry_fd] { close(entry_fd); });
+            tags[_n] = utility::Tags::ReadTags(entry_fd);
+        });
+        if( cancelled )
+            return VFSError::Cancelled;
+
+        // only the entries whose tags were changed are reported
+        TagsBatch batch;
+        for( size_t n = 0; n != tags.size(); ++n ) {
+            const unsigned ind = order[batch_begin + n];
+            if( !std::ranges::equal(tags[n], _listing.Tags(ind)) )
+                batch.emplace_back(ind, std::move(tags[n]));
+        }
+        if( !batch.empty() )
+            _handler(std::move(batch));
+
+        batch_begin = batch_end;
+        batch_size = batch_begin == first_batch ? g_MinTagsBatch : batch_size * 2;
+    }
+    return VFSError::Ok;
 }
 
 bool NativeHost::IsDirectoryChangeObservationAvailable(std::string_view _path)
@@ -558,6 +750,7 @@ int NativeHost::IterateDirectoryListing(std::string_view _path,
 
         vfs_dirent.type = entp->d_type;
         vfs_dirent.name_len = entp->d_namlen;
+        vfs_dirent.inode = entp->d_ino;
         memcpy(vfs_dirent.name, entp->d_name, entp->d_namlen + 1);
 
         if( !_handler(vfs_dirent) )
@@ -1,11 +1,64 @@
 // Copyright (C) 2014-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "SearchForFiles.h"
+#include "FilenameIndex.h"
+#include "MultiTextSearch.h"
 #include <sys/stat.h>
 #include <VFS/FileWindow.h>
 #include <VFS/SearchInFile.h>
+#include <Base/DispatchGroup.h>
+#include <ankerl/unordered_dense.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
 
 namespace nc::vfs {
 
+// the traversal waits for the content workers once this number of files is pending to be scanned
+static constexpr size_t g_MaxPendingCandidates = 4096;
+
+// the workers waiting for something to do check the stop flag with this period
+static constexpr std::chrono::milliseconds g_StopPollingPeriod{50};
+
+// A file which passed all the filters except the content one.
+struct SearchForFiles::Candidate {
+    VFSHostPtr host;
+    std::string full_path;
+    std::string dir_path;
+    std::string filename;
+};
+
+// The state shared by the workers of a single search. The directories and the candidates are claimed in FIFO order,
+// and the claiming waits while the host of the next one is saturated.
+struct SearchForFiles::Pipeline {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<VFSPath> directories;
+    std::deque<Candidate> candidates;
+    unsigned listing = 0; // the number of directories being listed right now
+    ankerl::unordered_dense::map<const VFSHost *, unsigned> busy_listing;
+    ankerl::unordered_dense::map<const VFSHost *, unsigned> busy_scanning;
+
+    // the callbacks are invoked one at a time
+    std::mutex found_lock;
+    std::mutex looking_in_lock;
+    std::mutex spawn_archive_lock;
+
+    bool TraversalFinished() const noexcept { return directories.empty() && listing == 0; }
+    template <class Predicate>
+    void Wait(std::unique_lock<std::mutex> &_lock, Predicate _predicate);
+};
+
+template <class Predicate>
+void SearchForFiles::Pipeline::Wait(std::unique_lock<std::mutex> &_lock, Predicate _predicate)
+{
+    // Stop() doesn't know about the pipeline, hence the polling
+    while( !cv.wait_for(_lock, g_StopPollingPeriod, _predicate) )
+        continue;
+}
+
 static utility::Encoding EncodingFromXAttr(const VFSFilePtr &_f)
 {
     char buf[128];
@@ -48,6 +101,10 @@ void SearchForFiles::SetFilterContent(const FilterContent &_filter)
     if( IsRunning() )
         throw std::logic_error("Filters can't be changed during background search process");
     m_FilterContent = _filter;
+    m_MultiTextSearch.reset();
+    if( !_filter.any_of_texts.empty() )
+        m_MultiTextSearch = std::make_unique<MultiTextSearch>(
+            _filter.any_of_texts, _filter.case_sensitive, _filter.whole_phrase);
 }
 
 void SearchForFiles::SetFilterSize(const FilterSize &_filter)
@@ -59,12 +116,27 @@ void SearchForFiles::SetFilterSize(const FilterSize &_filter)
     m_FilterSize = _filter;
 }
 
+void SearchForFiles::SetConcurrency(const Concurrency &_concurrency)
+{
+    if( IsRunning() )
+        throw std::logic_error("Concurrency can't be changed during background search process");
+    m_Concurrency = _concurrency;
+}
+
+void SearchForFiles::SetFilenameIndex(std::shared_ptr<const FilenameIndex> _index)
+{
+    if( IsRunning() )
+        throw std::logic_error("Filename index can't be changed during background search process");
+    m_FilenameIndex = std::move(_index);
+}
+
 void SearchForFiles::ClearFilters()
 {
     if( IsRunning() )
         throw std::logic_error("Filters can't be changed during background search process");
     m_FilterName = {};
     m_FilterContent = std::nullopt;
+    m_MultiTextSearch.reset();
     m_FilterSize = std::nullopt;
 }
 
@@ -86,7 +158,6 @@ bool SearchForFiles::Go(const std::string &_from_path,
     m_SpawnArchiveCallback = std::move(_spawn_archive_callback);
     m_LookingInCallback = std::move(_looking_in_callback);
     m_SearchOptions = _options;
-    m_DirsFIFO = {};
 
     m_Queue.Run([=, this] { AsyncProc(_from_path.c_str(), *_in_host); });
 
@@ -108,45 +179,230 @@ void SearchForFiles::Wait()
     m_Queue.Wait();
 }
 
-void SearchForFiles::NotifyLookingIn(const char *_path, VFSHost &_in_host) const
+void SearchForFiles::NotifyLookingIn(const char *_path, VFSHost &_in_host, Pipeline &_pipeline) const
 {
-    if( m_LookingInCallback )
+    if( m_LookingInCallback ) {
+        const auto lock = std::lock_guard{_pipeline.looking_in_lock};
         m_LookingInCallback(_path, _in_host);
+    }
 }
 
 void SearchForFiles::AsyncProc(const char *_from_path, VFSHost &_in_host)
 {
-    m_DirsFIFO.emplace(_in_host.SharedPtr(), _from_path);
+    Pipeline pipeline;
+
+    // the content workers are needed only if there's something to scan
+    const unsigned content_workers = m_FilterContent ? std::max(m_Concurrency.content_workers, 1u) : 0;
+
+    const base::DispatchGroup workers;
+    if( CanUseFilenameIndex(_from_path, _in_host) ) {
+        // the look-up counts as a listing, so that the content workers wait until it's done
+        pipeline.listing = 1;
+        for( unsigned i = 0; i != content_workers; ++i )
+            workers.Run([&] { RunContentWorker(pipeline); });
+        LookUpFilenameIndex(_from_path, _in_host, pipeline);
+        {
+            const auto lock = std::lock_guard{pipeline.lock};
+            pipeline.listing = 0;
+            pipeline.cv.notify_all();
+        }
+        workers.Wait();
+        return;
+    }
 
-    while( !m_DirsFIFO.empty() ) {
+    pipeline.directories.emplace_back(_in_host.SharedPtr(), _from_path);
+    const unsigned traversal_workers = std::max(m_Concurrency.traversal_workers, 1u);
+    for( unsigned i = 0; i != content_workers; ++i )
+        workers.Run([&] { RunContentWorker(pipeline); });
+    for( unsigned i = 1; i < traversal_workers; ++i )
+        workers.Run([&] { RunTraversalWorker(pipeline); });
+    RunTraversalWorker(pipeline);
+    workers.Wait();
+}
+
+bool SearchForFiles::CanUseFilenameIndex(const char *_from_path, const VFSHost &_in_host) const
+{
+    // the index knows nothing about the insides of archives
+    return m_FilenameIndex && !m_FilterName.IsEmpty() && _in_host.IsNativeFS() &&
+           (m_SearchOptions & Options::GoIntoSubDirs) && (m_SearchOptions & Options::LookInArchives) == 0 &&
+           m_FilenameIndex->Covers(_from_path);
+}
+
+void SearchForFiles::LookUpFilenameIndex(const char *_from_path, VFSHost &_in_host, Pipeline &_pipeline)
+{
+    NotifyLookingIn(_from_path, _in_host, _pipeline);
+
+    std::string full_path;
+    std::string dir_path;
+    m_FilenameIndex->Query(m_FilterName, _from_path, [&](std::string_view _dir_path, std::string_view _filename) {
         if( m_Queue.IsStopped() )
-            break;
+            return false;
+
+        // the index might be outdated, thus only the entries which are still there are processed
+        full_path.assign(_dir_path);
+        full_path += _filename;
+        VFSStat st;
+        if( _in_host.Stat(full_path, st, VFSFlags::F_NoFollow) != 0 )
+            return true;
+
+        VFSDirEnt dirent;
+        if( S_ISDIR(st.mode) )
+            dirent.type = VFSDirEnt::Dir;
+        else if( S_ISREG(st.mode) )
+            dirent.type = VFSDirEnt::Reg;
+        else if( S_ISLNK(st.mode) )
+            dirent.type = VFSDirEnt::Link;
+        else
+            dirent.type = VFSDirEnt::Unknown;
+        dirent.name_len = static_cast<uint16_t>(std::min(_filename.size(), sizeof(dirent.name) - 1));
+        std::memcpy(dirent.name, _filename.data(), dirent.name_len);
+        dirent.name[dirent.name_len] = 0;
+        dirent.inode = st.inode;
+
+        dir_path.assign(_dir_path);
+        FilterEntry(full_path.c_str(), dir_path.c_str(), dirent, _in_host, _pipeline);
+        return true;
+    });
+}
 
-        auto path = std::move(m_DirsFIFO.front());
-        m_DirsFIFO.pop();
+void SearchForFiles::RunTraversalWorker(Pipeline &_pipeline)
+{
+    const auto limit = [this](const VFSPath &_dir) {
+        return HostLimit(*_dir.Host(), m_Concurrency.traversal_workers);
+    };
+    while( true ) {
+        VFSPath directory;
+        {
+            auto lock = std::unique_lock{_pipeline.lock};
+            _pipeline.Wait(lock, [&] {
+                if( m_Queue.IsStopped() )
+                    return true;
+                if( _pipeline.directories.empty() )
+                    return _pipeline.listing == 0;
+                const auto &next = _pipeline.directories.front();
+                return _pipeline.busy_listing[next.Host().get()] < limit(next);
+            });
+            if( m_Queue.IsStopped() || _pipeline.directories.empty() )
+                break;
+            directory = std::move(_pipeline.directories.front());
+            _pipeline.directories.pop_front();
+            ++_pipeline.listing;
+            ++_pipeline.busy_listing[directory.Host().get()];
+        }
 
-        NotifyLookingIn(path.Path().c_str(), *path.Host());
+        ListDirectory(directory, _pipeline);
 
-        path.Host()->IterateDirectoryListing(path.Path(), [&](const VFSDirEnt &_dirent) {
-            if( m_Queue.IsStopped() )
-                return false;
+        const auto lock = std::lock_guard{_pipeline.lock};
+        --_pipeline.listing;
+        --_pipeline.busy_listing[directory.Host().get()];
+        _pipeline.cv.notify_all();
+    }
 
-            std::string full_path = path.Path();
-            if( full_path.back() != '/' )
-                full_path += '/';
-            full_path += _dirent.name;
+    const auto lock = std::lock_guard{_pipeline.lock};
+    _pipeline.cv.notify_all();
+}
 
-            ProcessDirent(full_path.c_str(), path.Path().c_str(), _dirent, *path.Host());
+void SearchForFiles::RunContentWorker(Pipeline &_pipeline)
+{
+    const auto limit = [this](const Candidate &_candidate) {
+        return HostLimit(*_candidate.host, m_Concurrency.content_workers);
+    };
+    while( true ) {
+        Candidate candidate;
+        {
+            auto lock = std::unique_lock{_pipeline.lock};
+            _pipeline.Wait(lock, [&] {
+                if( m_Queue.IsStopped() )
+                    return true;
+                if( _pipeline.candidates.empty() )
+                    return _pipeline.TraversalFinished();
+                const auto &next = _pipeline.candidates.front();
+                return _pipeline.busy_scanning[next.host.get()] < limit(next);
+            });
+            if( m_Queue.IsStopped() || _pipeline.candidates.empty() )
+                break;
+            candidate = std::move(_pipeline.candidates.front());
+            _pipeline.candidates.pop_front();
+            ++_pipeline.busy_scanning[candidate.host.get()];
+            _pipeline.cv.notify_all(); // there might be a traversal worker waiting for a free slot
+        }
 
-            return true;
-        });
+        CFRange content_pos{-1, 0};
+        size_t text_index = 0;
+        if( FilterByContent(candidate.full_path.c_str(), *candidate.host, content_pos, text_index, _pipeline) )
+            ProcessValidEntry(candidate.filename.c_str(),
+                              candidate.dir_path.c_str(),
+                              *candidate.host,
+                              content_pos,
+                              text_index,
+                              _pipeline);
+
+        const auto lock = std::lock_guard{_pipeline.lock};
+        --_pipeline.busy_scanning[candidate.host.get()];
+        _pipeline.cv.notify_all();
     }
 }
 
+unsigned SearchForFiles::HostLimit(const VFSHost &_host, unsigned _workers) const noexcept
+{
+    const unsigned host_limit = _host.IsNativeFS() ? m_Concurrency.native_host_limit : m_Concurrency.other_host_limit;
+    return std::max(std::min(host_limit, _workers), 1u);
+}
+
+void SearchForFiles::ListDirectory(const VFSPath &_directory, Pipeline &_pipeline)
+{
+    NotifyLookingIn(_directory.Path().c_str(), *_directory.Host(), _pipeline);
+
+    _directory.Host()->IterateDirectoryListing(_directory.Path(), [&](const VFSDirEnt &_dirent) {
+        if( m_Queue.IsStopped() )
+            return false;
+
+        std::string full_path = _directory.Path();
+        if( full_path.back() != '/' )
+            full_path += '/';
+        full_path += _dirent.name;
+
+        ProcessDirent(full_path.c_str(), _directory.Path().c_str(), _dirent, *_directory.Host(), _pipeline);
+
+        return true;
+    });
+}
+
 void SearchForFiles::ProcessDirent(const char *_full_path,
                                    const char *_dir_path,
                                    const VFSDirEnt &_dirent,
-                                   VFSHost &_in_host)
+                                   VFSHost &_in_host,
+                                   Pipeline &_pipeline)
+{
+    FilterEntry(_full_path, _dir_path, _dirent, _in_host, _pipeline);
+
+    if( m_SearchOptions & Options::GoIntoSubDirs )
+        if( _dirent.type == VFSDirEnt::Dir ) {
+            const auto lock = std::lock_guard{_pipeline.lock};
+            _pipeline.directories.emplace_back(_in_host.SharedPtr(), _full_path);
+            _pipeline.cv.notify_all();
+        }
+
+    if( m_SearchOptions & Options::LookInArchives )
+        if( _dirent.type == VFSDirEnt::Reg && m_SpawnArchiveCallback ) {
+            VFSHostPtr archive_host;
+            {
+                const auto lock = std::lock_guard{_pipeline.spawn_archive_lock};
+                archive_host = m_SpawnArchiveCallback(_full_path, _in_host);
+            }
+            if( archive_host ) {
+                const auto lock = std::lock_guard{_pipeline.lock};
+                _pipeline.directories.emplace_back(archive_host, "/");
+                _pipeline.cv.notify_all();
+            }
+        }
+}
+
+void SearchForFiles::FilterEntry(const char *_full_path,
+                                 const char *_dir_path,
+                                 const VFSDirEnt &_dirent,
+                                 VFSHost &_in_host,
+                                 Pipeline &_pipeline)
 {
     bool failed_filtering = false;
 
@@ -178,30 +434,32 @@ void SearchForFiles::ProcessDirent(const char *_full_path,
             failed_filtering = true;
     }
 
-    // Filter by file content
-    CFRange content_pos{-1, 0};
+    // Filter by file content, which is done by the content workers
     if( !failed_filtering && m_FilterContent ) {
-        if( _dirent.type != VFSDirEnt::Reg || !FilterByContent(_full_path, _in_host, content_pos) )
-            failed_filtering = true;
+        if( _dirent.type == VFSDirEnt::Reg ) {
+            auto lock = std::unique_lock{_pipeline.lock};
+            _pipeline.Wait(lock, [&] {
+                return m_Queue.IsStopped() || _pipeline.candidates.size() < g_MaxPendingCandidates;
+            });
+            _pipeline.candidates.emplace_back(Candidate{_in_host.SharedPtr(), _full_path, _dir_path, _dirent.name});
+            _pipeline.cv.notify_all();
+        }
+        failed_filtering = true;
     }
 
     if( !failed_filtering )
-        ProcessValidEntry(_full_path, _dir_path, _dirent, _in_host, content_pos);
-
-    if( m_SearchOptions & Options::GoIntoSubDirs )
-        if( _dirent.type == VFSDirEnt::Dir )
-            m_DirsFIFO.emplace(_in_host.SharedPtr(), _full_path);
-
-    if( m_SearchOptions & Options::LookInArchives )
-        if( _dirent.type == VFSDirEnt::Reg && m_SpawnArchiveCallback )
-            if( auto archive_host = m_SpawnArchiveCallback(_full_path, _in_host) )
-                m_DirsFIFO.emplace(archive_host, "/");
+        ProcessValidEntry(_dirent.name, _dir_path, _in_host, CFRange{-1, 0}, 0, _pipeline);
 }
 
-bool SearchForFiles::FilterByContent(const char *_full_path, VFSHost &_in_host, CFRange &_r)
+bool SearchForFiles::FilterByContent(const char *_full_path,
+                                     VFSHost &_in_host,
+                                     CFRange &_r,
+                                     size_t &_text_index,
+                                     Pipeline &_pipeline)
 {
     assert(m_FilterContent);
     _r = CFRangeMake(-1, 0);
+    _text_index = 0;
 
     VFSFilePtr file;
     if( _in_host.CreateFile(_full_path, file, nullptr) != 0 )
@@ -210,7 +468,7 @@ bool SearchForFiles::FilterByContent(const char *_full_path, VFSHost &_in_host,
     if( file->Open(VFSFlags::OF_Read) != 0 )
         return false;
 
-    NotifyLookingIn(_full_path, _in_host);
+    NotifyLookingIn(_full_path, _in_host, _pipeline);
 
     nc::vfs::FileWindow fw;
     if( fw.Attach(file) != 0 )
@@ -221,19 +479,38 @@ bool SearchForFiles::FilterByContent(const char *_full_path, VFSHost &_in_host,
         encoding = xattr_enc;
 
     using nc::vfs::SearchInFile;
+    if( m_MultiTextSearch ) {
+        const auto result = m_MultiTextSearch->Search(fw, encoding, [this] { return m_Queue.IsStopped(); });
+        if( result.response == SearchInFile::Response::Found ) {
+            _r = CFRangeMake(result.match->offset, result.match->bytes_len);
+            _text_index = result.match->text_index;
+            return !m_FilterContent->not_containing;
+        }
+        if( result.response == SearchInFile::Response::NotFound )
+            return m_FilterContent->not_containing;
+        return false;
+    }
+
     SearchInFile sif(fw);
 
     const base::CFString request{m_FilterContent->text};
-    sif.ToggleTextSearch(*request, encoding);
-    const auto search_options = [&] {
-        auto options = SearchInFile::Options::None;
-        if( m_FilterContent->case_sensitive )
-            options |= SearchInFile::Options::CaseSensitive;
-        if( m_FilterContent->whole_phrase )
-            options |= SearchInFile::Options::FindWholePhrase;
-        return options;
-    }();
-    sif.SetSearchOptions(search_options);
+    if( m_FilterContent->binary ) {
+        sif.ToggleBinarySearch(*request);
+    }
+    else {
+        sif.ToggleTextSearch(*request, encoding);
+        const auto search_options = [&] {
+            auto options = SearchInFile::Options::None;
+            if( m_FilterContent->case_sensitive )
+                options |= SearchInFile::Options::CaseSensitive;
+            if( m_FilterContent->whole_phrase )
+                options |= SearchInFile::Options::FindWholePhrase;
+            if( m_FilterContent->regular_expression )
+                options |= SearchInFile::Options::RegularExpression;
+            return options;
+        }();
+        sif.SetSearchOptions(search_options);
+    }
 
     const auto result = sif.Search([this] { return m_Queue.IsStopped(); });
     if( result.response == SearchInFile::Response::Found ) {
@@ -252,14 +529,17 @@ bool SearchForFiles::FilterByFilename(const char *_filename) const
     return m_FilterName.MatchName(_filename);
 }
 
-void SearchForFiles::ProcessValidEntry([[maybe_unused]] const char *_full_path,
+void SearchForFiles::ProcessValidEntry(const char *_filename,
                                        const char *_dir_path,
-                                       const VFSDirEnt &_dirent,
                                        VFSHost &_in_host,
-                                       CFRange _cont_range)
+                                       CFRange _cont_range,
+                                       size_t _text_index,
+                                       Pipeline &_pipeline)
 {
-    if( m_Callback ) // change to assert
-        m_Callback(_dirent.name, _dir_path, _in_host, _cont_range);
+    if( m_Callback ) { // change to assert
+        const auto lock = std::lock_guard{_pipeline.found_lock};
+        m_Callback(_filename, _dir_path, _in_host, _cont_range, _text_index);
+    }
 }
 
 bool SearchForFiles::IsRunning() const noexcept
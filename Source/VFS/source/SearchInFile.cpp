@@ -1,14 +1,609 @@
 // Copyright (C) 2013-2024 Michael Kazakov. Subject to GNU General Public License version 3.
 #include "SearchInFile.h"
+#include "BytePattern.h"
+#include <Base/CFPtr.h>
+#include <Base/CFString.h>
 #include <Utility/Encodings.h>
 #include <VFS/FileWindow.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
 #include <exception>
+#include <numeric>
+#include <re2/re2.h>
+#include <string>
+#include <vector>
 
 namespace nc::vfs {
 
 static const unsigned g_MaximumCodeUnit = 2;
 
+// the longest encoding of a single character, in bytes
+static const unsigned g_MaximumCharacterBytes = 4;
+
+// the matches of a regular expression are looked for in the spans of the file this long at most
+static const size_t g_MaximumRegExpSpan = 4 * 1024 * 1024;
+
 static bool IsWholePhrase(CFStringRef _string, CFRange _range);
+static bool IsAlphanumeric(char32_t _character);
+
+// The searched text encoded into the file's encoding. Every character of the text is encoded into one or several
+// alternative byte sequences of the same length, e.g. both cases of a letter. The byte pattern accepts at every
+// position any byte of these alternatives, so its matches are precise only if the alternatives of each character
+// differ in at most one byte - otherwise the matches have to be verified against the alternatives.
+struct SearchInFile::TextPattern {
+    BytePattern bytes;
+    std::vector<std::vector<std::string>> characters;
+    bool needs_verification = false;
+    utility::Encoding encoding = utility::Encoding::ENCODING_INVALID;
+    size_t alignment = 1;                        // UTF-16 is expected to start at even offsets
+    std::array<uint16_t, 256> single_bytes = {}; // the decoding table of a single-byte encoding
+
+    bool Verify(const uint8_t *_data) const noexcept;
+    char32_t DecodeBefore(std::span<const uint8_t> _bytes) const noexcept;
+    char32_t DecodeAfter(std::span<const uint8_t> _bytes) const noexcept;
+};
+
+static bool IsSingleByte(utility::Encoding _encoding) noexcept
+{
+    return _encoding >= utility::Encoding::ENCODING_SINGLE_BYTES_FIRST__ &&
+           _encoding <= utility::Encoding::ENCODING_SINGLE_BYTES_LAST__;
+}
+
+// The compiled regular expression along with the span of the file transcoded into UTF-8, which is required for the
+// encodings other than UTF-8 itself. A match cut by the end of a span can start only within the run of the characters
+// which a match can consist of that reaches the end of the span, so these characters are compiled as well.
+struct SearchInFile::RegExp {
+    RegExp(const std::string &_pattern, const re2::RE2::Options &_options);
+
+    re2::RE2 expression;
+    std::unique_ptr<re2::RE2> run; // the non-empty runs of the characters of the matches ending at the end of the text
+    bool run_unknown = false;      // the characters couldn't be told, the last quarter of a text is assumed to be a run
+    std::vector<uint8_t> bytes;    // the span of the file when it's larger than the window
+    std::vector<uint16_t> units;
+    std::vector<uint32_t> unit_offsets;
+    std::string text;
+    std::vector<uint32_t> offsets; // the span offset of every byte of the text, followed by the end of the span
+
+    void Transcode(std::span<const uint16_t> _units, const uint32_t *_unit_offsets, size_t _span_size);
+    size_t EarliestCut(std::string_view _text, size_t _from) const;
+};
+
+static std::array<uint16_t, 256> SingleBytesTable(utility::Encoding _encoding)
+{
+    std::array<unsigned char, 256> bytes;
+    std::iota(bytes.begin(), bytes.end(), static_cast<unsigned char>(0));
+    std::array<uint16_t, 256> table;
+    utility::InterpretSingleByteBufferAsUniCharPreservingBufferSize(
+        bytes.data(), bytes.size(), table.data(), _encoding);
+    return table;
+}
+
+// Tells whether the case-insensitive comparison of the character is fully described by its case mappings. Elsewhere
+// distinct characters can share a case folding without mapping into each other, e.g. 'ς' and 'σ'.
+static bool HasSimpleCaseVariants(char32_t _character) noexcept
+{
+    return _character < 0x0250 /* Latin */ || (_character >= 0x0400 && _character < 0x0530) /* Cyrillic */;
+}
+
+// Returns the character along with its case variants, only those which are single UTF-16 code units as well.
+static std::vector<char32_t> CaseVariants(char32_t _character)
+{
+    std::vector<char32_t> variants{_character};
+
+    const auto convert = [](char32_t _c, bool _upper) -> std::optional<char32_t> {
+        const UniChar c = static_cast<UniChar>(_c);
+        const auto str = base::CFPtr<CFMutableStringRef>::adopt(CFStringCreateMutable(nullptr, 0));
+        CFStringAppendCharacters(str.get(), &c, 1);
+        if( _upper )
+            CFStringUppercase(str.get(), nullptr);
+        else
+            CFStringLowercase(str.get(), nullptr);
+        if( CFStringGetLength(str.get()) != 1 )
+            return std::nullopt;
+        return CFStringGetCharacterAtIndex(str.get(), 0);
+    };
+
+    // the variants of the variants are collected as well, e.g. 'ǅ' maps into both 'ǆ' and 'Ǆ'
+    for( size_t i = 0; i < variants.size(); ++i )
+        for( const bool upper : {false, true} )
+            if( const auto variant = convert(variants[i], upper);
+                variant && std::ranges::find(variants, *variant) == variants.end() )
+                variants.emplace_back(*variant);
+    return variants;
+}
+
+static void AppendUTF8(std::string &_bytes, char32_t _character)
+{
+    const auto put = [&](char32_t _byte) { _bytes.push_back(static_cast<char>(_byte)); };
+    if( _character < 0x80 ) {
+        put(_character);
+    }
+    else if( _character < 0x800 ) {
+        put(0xC0 | (_character >> 6));
+        put(0x80 | (_character & 0x3F));
+    }
+    else if( _character < 0x10000 ) {
+        put(0xE0 | (_character >> 12));
+        put(0x80 | ((_character >> 6) & 0x3F));
+        put(0x80 | (_character & 0x3F));
+    }
+    else {
+        put(0xF0 | (_character >> 18));
+        put(0x80 | ((_character >> 12) & 0x3F));
+        put(0x80 | ((_character >> 6) & 0x3F));
+        put(0x80 | (_character & 0x3F));
+    }
+}
+
+// Returns the byte sequences which encode the character, none if the encoding can't represent it.
+static std::vector<std::string>
+Encode(char32_t _character, utility::Encoding _encoding, const std::array<uint16_t, 256> &_single_bytes)
+{
+    std::vector<std::string> encoded;
+    if( IsSingleByte(_encoding) ) {
+        for( size_t byte = 0; byte < _single_bytes.size(); ++byte )
+            if( _single_bytes[byte] == _character )
+                encoded.emplace_back(1, static_cast<char>(byte));
+    }
+    else if( _encoding == utility::Encoding::ENCODING_UTF8 ) {
+        std::string bytes;
+        AppendUTF8(bytes, _character);
+        encoded.emplace_back(std::move(bytes));
+    }
+    else if( _encoding == utility::Encoding::ENCODING_UTF16LE || _encoding == utility::Encoding::ENCODING_UTF16BE ) {
+        const bool le = _encoding == utility::Encoding::ENCODING_UTF16LE;
+        std::string bytes;
+        const auto put = [&](char32_t _unit) {
+            bytes.push_back(static_cast<char>(le ? _unit & 0xFF : _unit >> 8));
+            bytes.push_back(static_cast<char>(le ? _unit >> 8 : _unit & 0xFF));
+        };
+        if( _character < 0x10000 ) {
+            put(_character);
+        }
+        else {
+            put(0xD800 + ((_character - 0x10000) >> 10));
+            put(0xDC00 + ((_character - 0x10000) & 0x3FF));
+        }
+        encoded.emplace_back(std::move(bytes));
+    }
+    return encoded;
+}
+
+// Encodes every character of the text into its alternative byte sequences. Returns nothing if the text can't be
+// expressed this way, e.g. when some character can't be represented in the encoding, has no simple case variants or
+// when its case variants are encoded with a different number of bytes.
+static std::optional<std::vector<std::vector<std::string>>> EncodeText(CFStringRef _text,
+                                                                       utility::Encoding _encoding,
+                                                                       bool _case_sensitive,
+                                                                       const std::array<uint16_t, 256> &_single_bytes)
+{
+    const CFIndex length = CFStringGetLength(_text);
+    std::vector<UniChar> units(length);
+    CFStringGetCharacters(_text, CFRangeMake(0, length), units.data());
+
+    std::vector<std::vector<std::string>> characters;
+    for( CFIndex i = 0; i < length; ++i ) {
+        char32_t character = units[i];
+        if( CFStringIsSurrogateHighCharacter(units[i]) ) {
+            if( i + 1 == length || !CFStringIsSurrogateLowCharacter(units[i + 1]) )
+                return std::nullopt;
+            character = CFStringGetLongCharacterForSurrogatePair(units[i], units[i + 1]);
+            ++i;
+        }
+        else if( CFStringIsSurrogateLowCharacter(units[i]) ) {
+            return std::nullopt;
+        }
+
+        if( !_case_sensitive && !HasSimpleCaseVariants(character) )
+            return std::nullopt;
+
+        std::vector<std::string> alternatives;
+        for( const char32_t variant : _case_sensitive ? std::vector<char32_t>{character} : CaseVariants(character) )
+            for( auto &encoded : Encode(variant, _encoding, _single_bytes) )
+                if( std::ranges::find(alternatives, encoded) == alternatives.end() )
+                    alternatives.emplace_back(std::move(encoded));
+
+        if( alternatives.empty() )
+            return std::nullopt;
+        const size_t bytes = alternatives.front().size();
+        if( std::ranges::any_of(alternatives, [&](const std::string &_alt) { return _alt.size() != bytes; }) )
+            return std::nullopt;
+        characters.emplace_back(std::move(alternatives));
+    }
+    return characters;
+}
+
+static std::optional<uint8_t> HexDigit(char _c) noexcept
+{
+    if( _c >= '0' && _c <= '9' )
+        return static_cast<uint8_t>(_c - '0');
+    if( _c >= 'a' && _c <= 'f' )
+        return static_cast<uint8_t>(_c - 'a' + 10);
+    if( _c >= 'A' && _c <= 'F' )
+        return static_cast<uint8_t>(_c - 'A' + 10);
+    return std::nullopt;
+}
+
+// Parses hex bytes like "DE AD ?? EF", where '?' stands for any nibble. Whitespace can separate the bytes, but not
+// the nibbles of a byte.
+static std::optional<std::vector<BytePattern::Class>> ParseBinaryPattern(std::string_view _pattern)
+{
+    std::vector<BytePattern::Class> classes;
+    std::optional<char> high_nibble;
+    for( const char c : _pattern ) {
+        if( c == ' ' || c == '\t' || c == '\n' || c == '\r' ) {
+            if( high_nibble )
+                return std::nullopt;
+            continue;
+        }
+        if( c != '?' && !HexDigit(c) )
+            return std::nullopt;
+        if( !high_nibble ) {
+            high_nibble = c;
+            continue;
+        }
+
+        const std::optional<uint8_t> high = HexDigit(*high_nibble);
+        const std::optional<uint8_t> low = HexDigit(c);
+        BytePattern::Class &values = classes.emplace_back();
+        for( size_t value = 0; value < values.size(); ++value )
+            if( (!high || value >> 4 == size_t(*high)) && (!low || (value & 0xF) == size_t(*low)) )
+                values.set(value);
+        high_nibble.reset();
+    }
+    if( high_nibble || classes.empty() )
+        return std::nullopt;
+    return classes;
+}
+
+static char32_t DecodeUTF8(std::span<const uint8_t> _bytes) noexcept
+{
+    assert(!_bytes.empty());
+    const uint8_t lead = _bytes[0];
+    if( lead < 0x80 )
+        return lead;
+
+    size_t length = 0;
+    char32_t character = 0;
+    if( (lead & 0xE0) == 0xC0 ) {
+        length = 2;
+        character = lead & 0x1F;
+    }
+    else if( (lead & 0xF0) == 0xE0 ) {
+        length = 3;
+        character = lead & 0x0F;
+    }
+    else if( (lead & 0xF8) == 0xF0 ) {
+        length = 4;
+        character = lead & 0x07;
+    }
+    else {
+        return 0xFFFD;
+    }
+
+    if( _bytes.size() < length )
+        return 0xFFFD;
+    for( size_t i = 1; i < length; ++i ) {
+        if( (_bytes[i] & 0xC0) != 0x80 )
+            return 0xFFFD;
+        character = (character << 6) | (_bytes[i] & 0x3F);
+    }
+    return character;
+}
+
+static char32_t DecodeUTF16Unit(const uint8_t *_bytes, bool _le) noexcept
+{
+    return _le ? char32_t(_bytes[0]) | (char32_t(_bytes[1]) << 8) : (char32_t(_bytes[0]) << 8) | char32_t(_bytes[1]);
+}
+
+bool SearchInFile::TextPattern::Verify(const uint8_t *_data) const noexcept
+{
+    size_t offset = 0;
+    for( const auto &alternatives : characters ) {
+        const size_t length = alternatives.front().size();
+        const auto matches = [&](const std::string &_alt) {
+            return std::memcmp(_alt.data(), _data + offset, length) == 0;
+        };
+        if( std::ranges::none_of(alternatives, matches) )
+            return false;
+        offset += length;
+    }
+    return true;
+}
+
+char32_t SearchInFile::TextPattern::DecodeBefore(std::span<const uint8_t> _bytes) const noexcept
+{
+    assert(!_bytes.empty());
+    if( IsSingleByte(encoding) )
+        return single_bytes[_bytes.back()];
+    if( encoding == utility::Encoding::ENCODING_UTF8 ) {
+        // step back over the continuation bytes to the start of the character
+        size_t start = _bytes.size() - 1;
+        while( start > 0 && _bytes.size() - start < g_MaximumCharacterBytes && (_bytes[start] & 0xC0) == 0x80 )
+            --start;
+        return DecodeUTF8(_bytes.subspan(start));
+    }
+    if( _bytes.size() < 2 )
+        return 0xFFFD;
+    return DecodeUTF16Unit(_bytes.data() + _bytes.size() - 2, encoding == utility::Encoding::ENCODING_UTF16LE);
+}
+
+char32_t SearchInFile::TextPattern::DecodeAfter(std::span<const uint8_t> _bytes) const noexcept
+{
+    assert(!_bytes.empty());
+    if( IsSingleByte(encoding) )
+        return single_bytes[_bytes.front()];
+    if( encoding == utility::Encoding::ENCODING_UTF8 )
+        return DecodeUTF8(_bytes);
+    if( _bytes.size() < 2 )
+        return 0xFFFD;
+    return DecodeUTF16Unit(_bytes.data(), encoding == utility::Encoding::ENCODING_UTF16LE);
+}
+
+static size_t UTF8Length(std::string_view _string, size_t _at) noexcept
+{
+    const uint8_t lead = static_cast<uint8_t>(_string[_at]);
+    const size_t length = lead < 0x80 ? 1 : (lead & 0xE0) == 0xC0 ? 2 : (lead & 0xF0) == 0xE0 ? 3 : 4;
+    return std::min(length, _string.size() - _at);
+}
+
+// Lists the expressions of the single characters which can be a part of a match of the valid RE2 pattern, e.g. "a",
+// "[0-9]", "\\pL" or "(?s:.)". The operators and the empty-width assertions are skipped.
+// Returns nothing if the pattern can't be handled.
+static std::optional<std::vector<std::string>> CharacterAtoms(std::string_view _pattern)
+{
+    const size_t size = _pattern.size();
+    const auto is_repetition = [](std::string_view _bounds) {
+        const size_t comma = _bounds.find(',');
+        const auto is_number = [](std::string_view _s) {
+            return std::ranges::all_of(_s, [](char _c) { return _c >= '0' && _c <= '9'; });
+        };
+        return !_bounds.empty() && _bounds.front() != ',' && is_number(_bounds.substr(0, comma)) &&
+               (comma == std::string_view::npos || is_number(_bounds.substr(comma + 1)));
+    };
+
+    std::vector<std::string> atoms;
+    std::vector<bool> dot_nl{false}; // the "s" flag in the enclosing groups, only the dot depends on the flags
+    size_t i = 0;
+    while( i < size ) {
+        const char c = _pattern[i];
+        if( c == '\\' ) {
+            if( i + 1 == size )
+                return std::nullopt;
+            const char escaped = _pattern[i + 1];
+            if( escaped == 'Q' ) {
+                // the quoted characters are taken one by one
+                const size_t end = std::min(_pattern.find("\\E", i + 2), size);
+                const std::string_view quoted = _pattern.substr(i + 2, end - i - 2);
+                for( size_t j = 0; j < quoted.size(); j += UTF8Length(quoted, j) )
+                    atoms.emplace_back(re2::RE2::QuoteMeta(quoted.substr(j, UTF8Length(quoted, j))));
+                i = std::min(end + 2, size);
+                continue;
+            }
+            size_t length = 2;
+            if( (escaped == 'p' || escaped == 'P' || escaped == 'x') && i + 2 < size && _pattern[i + 2] == '{' ) {
+                const size_t close = _pattern.find('}', i + 2);
+                if( close == std::string_view::npos )
+                    return std::nullopt;
+                length = close + 1 - i;
+            }
+            else if( escaped == 'p' || escaped == 'P' ) {
+                length = 3;
+            }
+            else if( escaped == 'x' ) {
+                length = 4;
+            }
+            else if( escaped >= '0' && escaped <= '7' ) {
+                while( length < 4 && i + length < size && _pattern[i + length] >= '0' && _pattern[i + length] <= '7' )
+                    ++length;
+            }
+            else if( static_cast<uint8_t>(escaped) >= 0x80 ) {
+                length = 1 + UTF8Length(_pattern, i + 1);
+            }
+            if( i + length > size )
+                return std::nullopt;
+            if( escaped != 'b' && escaped != 'B' && escaped != 'A' && escaped != 'z' )
+                atoms.emplace_back(_pattern.substr(i, length));
+            i += length;
+        }
+        else if( c == '[' ) {
+            size_t j = i + 1;
+            if( j < size && _pattern[j] == '^' )
+                ++j;
+            if( j < size && _pattern[j] == ']' )
+                ++j;
+            while( j < size && _pattern[j] != ']' ) {
+                if( _pattern[j] == '\\' && j + 2 < size && _pattern[j + 2] == '{' ) {
+                    j = _pattern.find('}', j);
+                    if( j == std::string_view::npos )
+                        return std::nullopt;
+                    ++j;
+                }
+                else if( _pattern[j] == '\\' ) {
+                    j += 2;
+                }
+                else if( _pattern.substr(j, 2) == "[:" ) {
+                    j = _pattern.find(":]", j + 2);
+                    if( j == std::string_view::npos )
+                        return std::nullopt;
+                    j += 2;
+                }
+                else {
+                    ++j;
+                }
+            }
+            if( j >= size )
+                return std::nullopt;
+            atoms.emplace_back(_pattern.substr(i, j + 1 - i));
+            i = j + 1;
+        }
+        else if( c == '.' ) {
+            atoms.emplace_back(dot_nl.back() ? "(?s:.)" : ".");
+            ++i;
+        }
+        else if( c == '(' ) {
+            bool nl = dot_nl.back();
+            ++i;
+            if( i < size && _pattern[i] == '?' ) {
+                ++i;
+                if( i < size && (_pattern[i] == 'P' || _pattern[i] == '<') ) {
+                    // a named group
+                    i = _pattern.find('>', i);
+                    if( i == std::string_view::npos )
+                        return std::nullopt;
+                    ++i;
+                }
+                else {
+                    // the flags of a group or of the rest of the enclosing one
+                    bool negated = false;
+                    for( ; i < size && _pattern[i] != ')' && _pattern[i] != ':'; ++i ) {
+                        if( _pattern[i] == '-' )
+                            negated = true;
+                        else if( _pattern[i] == 's' )
+                            nl = !negated;
+                    }
+                    if( i == size )
+                        return std::nullopt;
+                    if( _pattern[i++] == ')' ) {
+                        dot_nl.back() = nl;
+                        continue;
+                    }
+                }
+            }
+            dot_nl.push_back(nl);
+        }
+        else if( c == ')' ) {
+            if( dot_nl.size() < 2 )
+                return std::nullopt;
+            dot_nl.pop_back();
+            ++i;
+        }
+        else if( c == '{' ) {
+            // a brace which doesn't start a repetition is a literal
+            const size_t close = _pattern.find('}', i);
+            if( close != std::string_view::npos && is_repetition(_pattern.substr(i + 1, close - i - 1)) ) {
+                i = close + 1;
+            }
+            else {
+                atoms.emplace_back("\\{");
+                ++i;
+            }
+        }
+        else if( c == '*' || c == '+' || c == '?' || c == '|' || c == '^' || c == '$' ) {
+            ++i;
+        }
+        else {
+            atoms.emplace_back(re2::RE2::QuoteMeta(_pattern.substr(i, UTF8Length(_pattern, i))));
+            i += UTF8Length(_pattern, i);
+        }
+    }
+
+    std::ranges::sort(atoms);
+    atoms.erase(std::ranges::unique(atoms).begin(), atoms.end());
+    return atoms;
+}
+
+SearchInFile::RegExp::RegExp(const std::string &_pattern, const re2::RE2::Options &_options)
+    : expression(_pattern, _options)
+{
+    if( !expression.ok() )
+        return;
+
+    const auto atoms = CharacterAtoms(_pattern);
+    if( !atoms ) {
+        run_unknown = true;
+        return;
+    }
+    if( atoms->empty() )
+        return; // nothing but the empty matches
+
+    std::string pattern = "(?:";
+    for( const std::string &atom : *atoms ) {
+        if( &atom != &atoms->front() )
+            pattern += '|';
+        pattern += atom;
+    }
+    pattern += ")+\\z";
+
+    // the case-insensitive characters are a superset of the case-sensitive ones, which is fine here
+    re2::RE2::Options options = _options;
+    options.set_case_sensitive(false);
+    run = std::make_unique<re2::RE2>(pattern, options);
+    if( !run->ok() ) {
+        run.reset();
+        run_unknown = true;
+    }
+}
+
+size_t SearchInFile::RegExp::EarliestCut(std::string_view _text, size_t _from) const
+{
+    // a match might start at the last character of the text, which might be incomplete as well
+    size_t last = _text.size();
+    while( last > _from ) {
+        --last;
+        if( (static_cast<uint8_t>(_text[last]) & 0xC0) != 0x80 || _text.size() - last == g_MaximumCharacterBytes )
+            break;
+    }
+
+    if( run_unknown )
+        return std::clamp(_text.size() - _text.size() / 4, _from, last);
+    if( !run )
+        return last;
+
+    // the expression is anchored at the end, so RE2 finds the start of the longest run by scanning backwards
+    const std::string_view head = _text.substr(0, last);
+    re2::StringPiece found;
+    if( !run->Match(head, _from, head.size(), re2::RE2::UNANCHORED, &found, 1) )
+        return last;
+    return static_cast<size_t>(found.data() - head.data());
+}
+
+void SearchInFile::RegExp::Transcode(std::span<const uint16_t> _units,
+                                     const uint32_t *_unit_offsets,
+                                     size_t _span_size)
+{
+    text.clear();
+    offsets.clear();
+    for( size_t i = 0; i < _units.size(); ++i ) {
+        const uint32_t offset = _unit_offsets[i];
+        char32_t character = _units[i];
+        if( CFStringIsSurrogateHighCharacter(_units[i]) && i + 1 < _units.size() &&
+            CFStringIsSurrogateLowCharacter(_units[i + 1]) ) {
+            character = CFStringGetLongCharacterForSurrogatePair(_units[i], _units[i + 1]);
+            ++i;
+        }
+        else if( CFStringIsSurrogateHighCharacter(_units[i]) || CFStringIsSurrogateLowCharacter(_units[i]) ) {
+            character = 0xFFFD;
+        }
+        AppendUTF8(text, character);
+        offsets.resize(text.size(), offset);
+    }
+    offsets.push_back(static_cast<uint32_t>(_span_size));
+}
+
+// Returns the bytes of the file at [_pos, _pos + _size), either right from the window or copied into the buffer when
+// they don't fit into it.
+static std::span<const uint8_t>
+ReadSpan(nc::vfs::FileWindow &_file, uint64_t _pos, size_t _size, std::vector<uint8_t> &_buffer)
+{
+    const size_t window_size = _file.WindowSize();
+    if( _size <= window_size ) {
+        _file.MoveWindow(_pos);
+        return {static_cast<const uint8_t *>(_file.Window()), _size};
+    }
+
+    _buffer.resize(_size);
+    for( size_t copied = 0; copied < _size; ) {
+        const uint64_t window_pos = std::min(_pos + copied, uint64_t(_file.FileSize() - window_size));
+        _file.MoveWindow(window_pos);
+        const size_t skip = _pos + copied - window_pos;
+        const size_t chunk = std::min(window_size - skip, _size - copied);
+        std::memcpy(_buffer.data() + copied, static_cast<const uint8_t *>(_file.Window()) + skip, chunk);
+        copied += chunk;
+    }
+    return _buffer;
+}
 
 SearchInFile::SearchInFile(nc::vfs::FileWindow &_file)
     : m_File(_file), m_TextSearchEncoding(utility::Encoding::ENCODING_INVALID)
@@ -51,15 +646,105 @@ void SearchInFile::ToggleTextSearch(CFStringRef _string, utility::Encoding _enco
     m_TextSearchEncoding = _encoding;
 
     m_WorkMode = WorkMode::Text;
+    m_BinaryPattern.reset();
+    m_TextPatternOutdated = true;
+}
+
+void SearchInFile::ToggleBinarySearch(CFStringRef _pattern)
+{
+    if( m_RequestedTextSearch != nullptr )
+        CFRelease(m_RequestedTextSearch);
+    m_RequestedTextSearch = CFStringCreateCopy(nullptr, _pattern);
+
+    m_WorkMode = WorkMode::Binary;
+    m_TextPattern.reset();
+    m_RegExp.reset();
+    m_BinaryPattern.reset();
+    if( auto classes = ParseBinaryPattern(base::CFStringGetUTF8StdString(_pattern)) )
+        m_BinaryPattern = std::make_unique<BytePattern>(*classes);
+}
+
+bool SearchInFile::IsBinarySearch() const
+{
+    return m_WorkMode == WorkMode::Binary;
+}
+
+bool SearchInFile::IsValidBinaryPattern(std::string_view _pattern)
+{
+    return ParseBinaryPattern(_pattern).has_value();
+}
+
+void SearchInFile::BuildTextPattern()
+{
+    m_TextPatternOutdated = false;
+    if( m_WorkMode != WorkMode::Text )
+        return;
+
+    m_TextPattern.reset();
+    m_RegExp.reset();
+    if( m_RequestedTextSearch == nullptr || !utility::IsValidEncoding(m_TextSearchEncoding) )
+        return;
+
+    if( m_SearchOptionsBits.regular_expression ) {
+        re2::RE2::Options options;
+        options.set_log_errors(false);
+        options.set_case_sensitive(m_SearchOptionsBits.case_sensitive);
+        // ^ and $ match at the line boundaries
+        auto regexp =
+            std::make_unique<RegExp>("(?m)" + base::CFStringGetUTF8StdString(m_RequestedTextSearch), options);
+        if( regexp->expression.ok() )
+            m_RegExp = std::move(regexp);
+        return;
+    }
+
+    std::array<uint16_t, 256> single_bytes = {};
+    if( IsSingleByte(m_TextSearchEncoding) )
+        single_bytes = SingleBytesTable(m_TextSearchEncoding);
+
+    auto characters =
+        EncodeText(m_RequestedTextSearch, m_TextSearchEncoding, m_SearchOptionsBits.case_sensitive, single_bytes);
+    if( !characters || characters->empty() )
+        return;
+
+    std::vector<BytePattern::Class> classes;
+    bool needs_verification = false;
+    for( const auto &alternatives : *characters ) {
+        size_t varying = 0;
+        for( size_t i = 0; i < alternatives.front().size(); ++i ) {
+            BytePattern::Class &values = classes.emplace_back();
+            for( const auto &alternative : alternatives )
+                values.set(static_cast<uint8_t>(alternative[i]));
+            if( values.count() > 1 )
+                ++varying;
+        }
+        needs_verification |= varying > 1;
+    }
+
+    m_TextPattern = std::make_unique<TextPattern>(TextPattern{
+        .bytes = BytePattern(classes),
+        .characters = std::move(*characters),
+        .needs_verification = needs_verification,
+        .encoding = m_TextSearchEncoding,
+        .alignment = static_cast<size_t>(utility::BytesForCodeUnit(m_TextSearchEncoding)),
+        .single_bytes = single_bytes,
+    });
 }
 
 SearchInFile::Result SearchInFile::Search(const CancelChecker &_checker)
 {
-    if( m_WorkMode == WorkMode::Text ) {
+    if( m_TextPatternOutdated )
+        BuildTextPattern();
+
+    if( m_WorkMode == WorkMode::Text || m_WorkMode == WorkMode::Binary ) {
         uint64_t offset = 0;
         uint64_t bytes_len = 0;
         Result result;
-        result.response = SearchText(&offset, &bytes_len, _checker);
+        if( m_WorkMode == WorkMode::Binary )
+            result.response = SearchBinary(&offset, &bytes_len, _checker);
+        else if( m_SearchOptionsBits.regular_expression )
+            result.response = SearchRegExp(&offset, &bytes_len, _checker);
+        else
+            result.response = SearchText(&offset, &bytes_len, _checker);
         if( result.response == Response::Found )
             result.location = {.offset = offset, .bytes_len = bytes_len};
         return result;
@@ -90,6 +775,12 @@ SearchInFile::Response SearchInFile::SearchText(uint64_t *_offset, uint64_t *_by
     if( CFStringGetLength(m_RequestedTextSearch) <= 0 )
         return Response::Invalid;
 
+    // the encoded text along with the surrounding characters has to fit into the window, unless it's the whole file
+    if( m_TextPattern &&
+        (m_TextPattern->bytes.Length() + 2 * g_MaximumCharacterBytes <= m_File.WindowSize() ||
+         m_File.WindowSize() == m_File.FileSize()) )
+        return SearchEncodedText(_offset, _bytes_len, _checker);
+
     while( true ) {
         if( m_Position >= m_File.FileSize() )
             break; // when finished searching
@@ -169,6 +860,249 @@ SearchInFile::Response SearchInFile::SearchText(uint64_t *_offset, uint64_t *_by
     return Response::NotFound;
 }
 
+SearchInFile::Response
+SearchInFile::SearchEncodedText(uint64_t *_offset, uint64_t *_bytes_len, const CancelChecker &_checker)
+{
+    const TextPattern &pattern = *m_TextPattern;
+    const size_t length = pattern.bytes.Length();
+
+    while( m_Position < m_File.FileSize() ) {
+        if( _checker && _checker() )
+            return Response::Canceled;
+
+        // move our load window inside a file
+        const size_t window_pos = std::min(m_Position, uint64_t(m_File.FileSize() - m_File.WindowSize()));
+        m_File.MoveWindow(window_pos);
+        const size_t left_window_gap = m_Position - window_pos;
+        const auto haystack = std::span(static_cast<const uint8_t *>(m_File.Window()), m_File.WindowSize())
+                                  .subspan(left_window_gap);
+
+        std::optional<uint64_t> found;
+        for( size_t from = 0; from + length <= haystack.size(); ) {
+            const auto match = pattern.bytes.Find(haystack.subspan(from));
+            if( !match )
+                break;
+            const size_t pos = from + *match;
+            if( (m_Position + pos) % pattern.alignment == 0 &&
+                (!pattern.needs_verification || pattern.Verify(haystack.data() + pos)) ) {
+                found = m_Position + pos;
+                break;
+            }
+            from = pos + 1;
+        }
+
+        if( !found ) {
+            if( window_pos + m_File.WindowSize() < m_File.FileSize() ) {
+                // the next window overlaps this one to find the text cut between them
+                assert(left_window_gap == 0);
+                m_Position += haystack.size() - (length - 1);
+            }
+            else { // this is the end (c)
+                m_Position = m_File.FileSize();
+            }
+            continue;
+        }
+
+        if( m_SearchOptionsBits.find_whole_phrase && !IsWholePhraseAt(*found, length) ) {
+            // false alarm - just move position beyond found part ang go on
+            m_Position = *found + length;
+            continue;
+        }
+
+        if( _offset != nullptr )
+            *_offset = *found;
+        if( _bytes_len != nullptr )
+            *_bytes_len = length;
+        m_Position = *found + length;
+        return Response::Found;
+    }
+
+    return Response::NotFound;
+}
+
+SearchInFile::Response
+SearchInFile::SearchBinary(uint64_t *_offset, uint64_t *_bytes_len, const CancelChecker &_checker)
+{
+    if( !m_BinaryPattern )
+        return Response::Invalid;
+
+    if( m_File.FileSize() == 0 )
+        return Response::NotFound; // for singular case
+
+    if( m_Position >= m_File.FileSize() )
+        return Response::EndOfFile; // when finished searching
+
+    const size_t length = m_BinaryPattern->Length();
+    if( length > m_File.WindowSize() && m_File.WindowSize() != m_File.FileSize() )
+        return Response::Invalid; // the pattern has to fit into the window
+
+    while( m_Position < m_File.FileSize() ) {
+        if( _checker && _checker() )
+            return Response::Canceled;
+
+        // move our load window inside a file
+        const size_t window_pos = std::min(m_Position, uint64_t(m_File.FileSize() - m_File.WindowSize()));
+        m_File.MoveWindow(window_pos);
+        const size_t left_window_gap = m_Position - window_pos;
+        const auto haystack = std::span(static_cast<const uint8_t *>(m_File.Window()), m_File.WindowSize())
+                                  .subspan(left_window_gap);
+
+        if( const auto found = m_BinaryPattern->Find(haystack) ) {
+            if( _offset != nullptr )
+                *_offset = m_Position + *found;
+            if( _bytes_len != nullptr )
+                *_bytes_len = length;
+            m_Position = m_Position + *found + length;
+            return Response::Found;
+        }
+
+        if( window_pos + m_File.WindowSize() < m_File.FileSize() ) {
+            // the next window overlaps this one to find the pattern cut between them
+            assert(left_window_gap == 0);
+            m_Position += haystack.size() - (length - 1);
+        }
+        else { // this is the end (c)
+            m_Position = m_File.FileSize();
+        }
+    }
+
+    return Response::NotFound;
+}
+
+SearchInFile::Response
+SearchInFile::SearchRegExp(uint64_t *_offset, uint64_t *_bytes_len, const CancelChecker &_checker)
+{
+    if( !m_RegExp )
+        return Response::Invalid;
+
+    if( m_File.FileSize() == 0 )
+        return Response::NotFound; // for singular case
+
+    if( m_Position >= m_File.FileSize() )
+        return Response::EndOfFile; // when finished searching
+
+    RegExp &regexp = *m_RegExp;
+    const bool is_utf8 = m_TextSearchEncoding == utility::Encoding::ENCODING_UTF8;
+    const size_t code_unit = utility::BytesForCodeUnit(m_TextSearchEncoding);
+
+    // A span of the file is searched at once, it grows while a match cut by its end might start at its very beginning.
+    const size_t max_span_size =
+        std::max(m_File.WindowSize(), std::min(g_MaximumRegExpSpan, static_cast<size_t>(m_File.FileSize())));
+    size_t span_size = m_File.WindowSize();
+
+    while( m_Position < m_File.FileSize() ) {
+        if( _checker && _checker() )
+            return Response::Canceled;
+
+        // the span starts a bit before the position to let ^ and \b see the preceding character
+        const uint64_t context = std::min(uint64_t(g_MaximumCharacterBytes), m_Position);
+        const uint64_t span_pos = std::min(m_Position - context, uint64_t(m_File.FileSize() - span_size));
+        const bool is_last_span = span_pos + span_size == m_File.FileSize();
+
+        // multi-byte code units are decoded starting from the aligned offsets only
+        const size_t misalignment = span_pos % code_unit;
+        const uint64_t base = span_pos + misalignment;
+        const auto span = ReadSpan(m_File, span_pos, span_size, regexp.bytes).subspan(misalignment);
+        const size_t from = m_Position > base ? m_Position - base : 0;
+
+        std::string_view text;
+        size_t startpos = from;
+        if( is_utf8 ) {
+            text = std::string_view(reinterpret_cast<const char *>(span.data()), span.size());
+        }
+        else {
+            regexp.units.resize(span.size());
+            regexp.unit_offsets.resize(span.size());
+            size_t units_count = 0;
+            utility::InterpretAsUnichar(m_TextSearchEncoding,
+                                        span.data(),
+                                        span.size(),
+                                        regexp.units.data(),
+                                        regexp.unit_offsets.data(),
+                                        &units_count);
+            regexp.Transcode({regexp.units.data(), units_count}, regexp.unit_offsets.data(), span.size());
+            text = regexp.text;
+            startpos = static_cast<size_t>(std::ranges::lower_bound(regexp.offsets, from) - regexp.offsets.begin());
+        }
+        const auto span_offset = [&](size_t _text_offset) -> size_t {
+            return is_utf8 ? _text_offset : regexp.offsets[_text_offset];
+        };
+
+        // empty matches are of no use, the search goes on past them
+        std::optional<std::pair<size_t, size_t>> match;
+        for( size_t pos = startpos; pos < text.size(); ) {
+            re2::StringPiece found;
+            if( !regexp.expression.Match(text, pos, text.size(), re2::RE2::UNANCHORED, &found, 1) )
+                break;
+            const size_t begin = static_cast<size_t>(found.data() - text.data());
+            if( !found.empty() ) {
+                match.emplace(begin, begin + found.size());
+                break;
+            }
+            pos = begin + 1;
+        }
+
+        const auto report = [&] {
+            const size_t match_begin = span_offset(match->first);
+            const size_t match_end = span_offset(match->second);
+            if( _offset != nullptr )
+                *_offset = base + match_begin;
+            if( _bytes_len != nullptr )
+                *_bytes_len = match_end - match_begin;
+            m_Position = base + match_end;
+            return Response::Found;
+        };
+
+        if( is_last_span ) {
+            if( match )
+                return report();
+            m_Position = m_File.FileSize(); // this is the end (c)
+            continue;
+        }
+
+        // A match starting before the cut is complete and the earliest one, otherwise a match cut by the end of the
+        // span might start earlier or be longer, so the search goes on from the cut.
+        const size_t cut = regexp.EarliestCut(text, startpos);
+        if( match && match->first < cut )
+            return report();
+        if( cut > startpos ) {
+            m_Position = base + span_offset(cut);
+            continue;
+        }
+
+        // the cut match might take the whole span, so a larger one is searched again
+        if( span_size < max_span_size ) {
+            span_size = std::min(span_size * 2, max_span_size);
+            continue;
+        }
+
+        // a match longer than the largest span is taken as is
+        if( match )
+            return report();
+        m_Position = std::max(base + span.size() - g_MaximumCharacterBytes, m_Position + 1);
+    }
+
+    return Response::NotFound;
+}
+
+bool SearchInFile::IsWholePhraseAt(uint64_t _offset, uint64_t _bytes_len)
+{
+    // the characters surrounding the match are decoded directly, the window is moved to cover them if necessary
+    const uint64_t from = _offset > g_MaximumCharacterBytes ? _offset - g_MaximumCharacterBytes : 0;
+    const uint64_t to = std::min(_offset + _bytes_len + g_MaximumCharacterBytes, uint64_t(m_File.FileSize()));
+    if( from < m_File.WindowPos() || to > m_File.WindowPos() + m_File.WindowSize() )
+        m_File.MoveWindow(std::min(from, uint64_t(m_File.FileSize() - m_File.WindowSize())));
+
+    const auto window = std::span(static_cast<const uint8_t *>(m_File.Window()), m_File.WindowSize());
+    const auto before = window.first(_offset - m_File.WindowPos());
+    const auto after = window.subspan(_offset + _bytes_len - m_File.WindowPos());
+    if( !before.empty() && IsAlphanumeric(m_TextPattern->DecodeBefore(before)) )
+        return false;
+    if( !after.empty() && IsAlphanumeric(m_TextPattern->DecodeAfter(after)) )
+        return false;
+    return true;
+}
+
 CFStringRef SearchInFile::TextSearchString()
 {
     return m_RequestedTextSearch;
@@ -181,7 +1115,10 @@ utility::Encoding SearchInFile::TextSearchEncoding()
 
 void SearchInFile::SetSearchOptions(Options _options)
 {
+    if( m_SearchOptions == _options )
+        return;
     m_SearchOptions = _options;
+    m_TextPatternOutdated = true;
 }
 
 SearchInFile::Options SearchInFile::SearchOptions() const
@@ -210,4 +1147,10 @@ static bool IsWholePhrase(CFStringRef _string, CFRange _range)
     return true;
 }
 
+static bool IsAlphanumeric(char32_t _character)
+{
+    static const auto alphanumeric = CFCharacterSetGetPredefined(kCFCharacterSetAlphaNumeric);
+    return CFCharacterSetIsLongCharacterMember(alphanumeric, _character);
+}
+
 } // namespace nc::vfs
@@ -0,0 +1,97 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include <VFS/../../source/BytePattern.h>
+#include <random>
+#include <string_view>
+
+using nc::vfs::BytePattern;
+
+#define PREFIX "nc::vfs::BytePattern "
+
+static std::vector<BytePattern::Class> Exact(std::string_view _bytes)
+{
+    std::vector<BytePattern::Class> classes(_bytes.size());
+    for( size_t i = 0; i < _bytes.size(); ++i )
+        classes[i].set(static_cast<uint8_t>(_bytes[i]));
+    return classes;
+}
+
+static std::span<const uint8_t> Bytes(std::string_view _str)
+{
+    return {reinterpret_cast<const uint8_t *>(_str.data()), _str.size()};
+}
+
+static std::optional<size_t> NaiveFind(const std::vector<BytePattern::Class> &_classes, std::span<const uint8_t> _data)
+{
+    for( size_t pos = 0; pos + _classes.size() <= _data.size(); ++pos ) {
+        bool matches = true;
+        for( size_t i = 0; i < _classes.size() && matches; ++i )
+            matches = _classes[i].test(_data[pos + i]);
+        if( matches )
+            return pos;
+    }
+    return std::nullopt;
+}
+
+TEST_CASE(PREFIX "Finds exact bytes")
+{
+    const BytePattern pattern(Exact("hello"));
+    CHECK(pattern.Length() == 5);
+    CHECK(pattern.Find(Bytes("hello")) == 0);
+    CHECK(pattern.Find(Bytes("0123456789hello, hello")) == 10);
+    CHECK(pattern.Find(Bytes("0123456789abcdefghijklmnopqrstuvwxyz0123456789hell")) == std::nullopt);
+    CHECK(pattern.Find(Bytes("0123456789abcdefghijklmnopqrstuvwxyz0123456789hello")) == 46);
+    CHECK(pattern.Find(Bytes("hell")) == std::nullopt);
+    CHECK(pattern.Find(Bytes("")) == std::nullopt);
+}
+
+TEST_CASE(PREFIX "Accepts alternatives at every position")
+{
+    auto classes = Exact("hello");
+    for( size_t i = 0; i < classes.size(); ++i )
+        classes[i].set(static_cast<uint8_t>("HELLO"[i]));
+    const BytePattern pattern(classes);
+    CHECK(pattern.Find(Bytes("________________________HeLlO")) == 24);
+    CHECK(pattern.Find(Bytes("________________________HELLO")) == 24);
+    CHECK(pattern.Find(Bytes("________________________HELL0")) == std::nullopt);
+}
+
+TEST_CASE(PREFIX "Handles positions which accept any byte")
+{
+    auto classes = Exact("\xDE\xAD?\xEF");
+    classes[2].set(); // a wildcard
+    const BytePattern pattern(classes);
+    CHECK(pattern.Find(Bytes("01234567890123456789\xDE\xAD\x42\xEF")) == 20);
+    CHECK(pattern.Find(Bytes("01234567890123456789\xDE\xAD\x42\xEE")) == std::nullopt);
+
+    std::vector<BytePattern::Class> any(3);
+    for( auto &c : any )
+        c.set();
+    CHECK(BytePattern(any).Find(Bytes("xy")) == std::nullopt);
+    CHECK(BytePattern(any).Find(Bytes("xyz")) == 0);
+}
+
+TEST_CASE(PREFIX "Matches a naive search on random data")
+{
+    std::mt19937 rng(42);
+    for( int round = 0; round != 2000; ++round ) {
+        // a small alphabet makes the matches frequent
+        const uint8_t alphabet = static_cast<uint8_t>(std::uniform_int_distribution<>(2, 6)(rng));
+        std::vector<uint8_t> data(std::uniform_int_distribution<size_t>(0, 300)(rng));
+        for( auto &byte : data )
+            byte = static_cast<uint8_t>(std::uniform_int_distribution<>(0, alphabet - 1)(rng));
+
+        std::vector<BytePattern::Class> classes(std::uniform_int_distribution<size_t>(1, 12)(rng));
+        for( auto &c : classes ) {
+            const int values = std::uniform_int_distribution<>(1, 5)(rng);
+            for( int i = 0; i < values; ++i )
+                c.set(std::uniform_int_distribution<size_t>(0, alphabet)(rng));
+        }
+
+        const BytePattern pattern(classes);
+        for( size_t offset = 0; offset <= data.size(); offset += 7 ) {
+            const auto span = std::span<const uint8_t>(data).subspan(offset);
+            REQUIRE(pattern.Find(span) == NaiveFind(classes, span));
+        }
+    }
+}
@@ -0,0 +1,152 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "TestEnv.h"
+#include "DirectorySizeCache.h"
+#include <filesystem>
+#include <fstream>
+
+using nc::vfs::DirectorySizeCache;
+using nc::vfs::NativeHost;
+
+#define PREFIX "[nc::vfs::DirectorySizeCache] "
+
+static void BuildTestData(const std::string &_root_path);
+static bool Save(const std::string &_filepath, const std::string &_content);
+
+TEST_CASE(PREFIX "Calculates the same sizes as a full scan")
+{
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+
+    DirectorySizeCache cache;
+    CHECK(cache.Lookup(root) == std::nullopt);
+    CHECK(cache.Calculate(host, root) == 21);
+    CHECK(cache.Calculate(host, root) == host.CalculateDirectorySize(root, {}));
+    CHECK(cache.Size() == 4);
+    CHECK(cache.Lookup(root) == 21u);
+    CHECK(cache.Lookup(root.substr(0, root.size() - 1)) == 21u);
+    CHECK(cache.Lookup(root + "Dir") == 16u);
+    CHECK(cache.Lookup(root + "Dir/Sub/") == 10u);
+    CHECK(cache.Lookup(root + "Empty/") == 0u);
+    CHECK(cache.Calculate(host, root + "Dir/Sub") == 10);
+    CHECK(cache.Calculate(host, root + "notes.txt") < 0);
+    CHECK(cache.Calculate(host, root + "Absent") < 0);
+    CHECK(cache.Calculate(host, "relative/path") < 0);
+    CHECK(cache.Calculate(host, root, [] { return true; }) < 0);
+}
+
+TEST_CASE(PREFIX "Lists only the changed directories")
+{
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+
+    DirectorySizeCache cache;
+    REQUIRE(cache.Calculate(host, root) == 21);
+
+    // rewriting a file doesn't touch its directory, so the change is not noticed until the directory is invalidated
+    REQUIRE(Save(root + "Dir/Sub/deep.txt", "0123456789"));
+    CHECK(cache.Calculate(host, root) == 21);
+    CHECK(cache.Invalidate(root + "Dir/Sub"));
+    CHECK(!cache.Invalidate(root + "Absent"));
+    CHECK(cache.Calculate(host, root) == 27);
+
+    // adding a file changes the directory
+    REQUIRE(Save(root + "Dir/added.txt", "12345"));
+    CHECK(cache.Calculate(host, root) == 32);
+    CHECK(cache.Lookup(root + "Dir") == 27u);
+
+    // the subtrees of the removed directories are forgotten
+    std::filesystem::remove_all(root + "Dir/Sub");
+    CHECK(cache.Calculate(host, root) == 16);
+    CHECK(cache.Size() == 3);
+    CHECK(cache.Lookup(root + "Dir/Sub") == std::nullopt);
+
+    REQUIRE(Save(root + "notes.txt", ""));
+    REQUIRE(Save(root + "Dir/Readme.TXT", ""));
+    CHECK(cache.Calculate(host, root) == 16);
+    CHECK(cache.InvalidateSubtree(root));
+    CHECK(cache.Calculate(host, root) == 5);
+    REQUIRE(Save(root + "Dir/added.txt", ""));
+    cache.InvalidateAll();
+    CHECK(cache.Calculate(host, root) == 0);
+}
+
+TEST_CASE(PREFIX "Calculates the same allocated sizes as a full scan")
+{
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+    const auto allocated = host.CalculateDirectorySize(root, {}, NativeHost::DirectorySizeOptions{.allocated = true});
+    REQUIRE(allocated > 0);
+
+    DirectorySizeCache cache;
+    CHECK(cache.Calculate(host, root, {}, true) == allocated);
+    CHECK(cache.Lookup(root, true) == static_cast<uint64_t>(allocated));
+    CHECK(cache.Lookup(root) == 21u);
+
+    // the remembered subtotals serve both kinds of sizes
+    CHECK(cache.Calculate(host, root) == 21);
+    CHECK(cache.Calculate(host, root, {}, true) == allocated);
+}
+
+TEST_CASE(PREFIX "Survives saving and loading")
+{
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+    const std::string path = test_dir.directory / "cache.bin";
+
+    DirectorySizeCache cache;
+    REQUIRE(cache.Calculate(host, root + "Dir") == 16);
+    REQUIRE(cache.Invalidate(root + "Dir/Sub"));
+    cache.SetMark(42);
+    REQUIRE(cache.Save(path));
+
+    const auto loaded = DirectorySizeCache::Load(path);
+    REQUIRE(loaded);
+    CHECK(loaded->Mark() == 42);
+    CHECK(loaded->Size() == 2);
+    CHECK(loaded->Lookup(root + "Dir") == 16u);
+    CHECK(loaded->Lookup(root + "Dir/Sub") == 10u);
+    CHECK(loaded->Lookup(root + "Dir", true) == cache.Lookup(root + "Dir", true));
+
+    // the invalidation is saved along with the sizes
+    REQUIRE(Save(root + "Dir/Sub/deep.txt", ""));
+    CHECK(loaded->Calculate(host, root + "Dir") == 12);
+
+    SECTION("a damaged file is rejected")
+    {
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+        CHECK(DirectorySizeCache::Load(path) == nullptr);
+    }
+    SECTION("an absent file is rejected")
+    {
+        CHECK(DirectorySizeCache::Load(path + ".absent") == nullptr);
+    }
+}
+
+static void BuildTestData(const std::string &_root_path)
+{
+    Save(_root_path + "notes.txt", "12345");
+    std::filesystem::create_directories(_root_path + "Dir/Sub");
+    std::filesystem::create_directories(_root_path + "Empty");
+    Save(_root_path + "Dir/Readme.TXT", "123456");
+    Save(_root_path + "Dir/Sub/deep.txt", "1234");
+    Save(_root_path + "Dir/Sub/picture.psd", "123456");
+}
+
+static bool Save(const std::string &_filepath, const std::string &_content)
+{
+    std::ofstream out(_filepath, std::ios::out | std::ios::binary);
+    if( !out )
+        return false;
+    out << _content;
+    out.close();
+    return true;
+}
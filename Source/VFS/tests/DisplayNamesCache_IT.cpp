@@ -0,0 +1,96 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "../../source/Native/DisplayNamesCache.h" // EVIL!
+#include "Tests.h"
+#include "TestEnv.h"
+#include <VFS/Native.h>
+#include <fmt/core.h>
+#include <atomic>
+#include <map>
+#include <thread>
+
+using nc::vfs::native::DisplayNamesCache;
+
+#define PREFIX "[nc::vfs::native::DisplayNamesCache] "
+
+static std::vector<std::string> DirectoriesInside(const std::vector<std::string> &_paths);
+
+TEST_CASE(PREFIX "Keeps returning the same names while being hammered by concurrent listings")
+{
+    const TestDir test_dir;
+    for( int i = 0; i != 500; ++i )
+        std::filesystem::create_directory(test_dir.directory / fmt::format("Dir{}", i));
+    const std::vector<std::string> listed = {
+        test_dir.directory.native(), "/Applications", "/Library", "/System/Library"};
+    const std::vector<std::string> directories = DirectoriesInside(listed);
+    REQUIRE(directories.size() >= 500);
+
+    // the reference names are fetched by a single thread
+    std::map<std::string, std::optional<std::string>> reference;
+    {
+        DisplayNamesCache cache;
+        for( const std::string &path : directories ) {
+            const char *name = cache.DisplayName(path);
+            reference[path] = name ? std::optional<std::string>{name} : std::nullopt;
+            CHECK(cache.DisplayName(path) == name);
+        }
+    }
+
+    auto &host = *TestEnv().vfs_native;
+    DisplayNamesCache cache;
+    constexpr size_t threads_number = 16;
+    constexpr int rounds = 5;
+    std::atomic_int mismatches{0};
+    std::vector<std::vector<const char *>> returned(threads_number, std::vector<const char *>(directories.size()));
+    std::vector<std::thread> threads;
+    for( size_t t = 0; t != threads_number; ++t )
+        threads.emplace_back([&, t] {
+            for( int round = 0; round != rounds; ++round ) {
+                // the listings go through the shared instance
+                for( const std::string &path : listed ) {
+                    VFSListingPtr listing;
+                    if( host.FetchDirectoryListing(path, listing, VFSFlags::F_LoadDisplayNames, {}) != VFSError::Ok )
+                        continue;
+                    for( unsigned i = 0; i != listing->Count(); ++i ) {
+                        const auto it = reference.find(listing->Path(i));
+                        if( it == reference.end() )
+                            continue; // appeared after the reference was taken
+                        const std::optional<std::string> name =
+                            listing->HasDisplayFilename(i) ? std::optional{listing->DisplayFilename(i)} : std::nullopt;
+                        if( name != it->second )
+                            ++mismatches;
+                    }
+                }
+
+                // each thread goes over the directories in its own order, the pointers must stay the same
+                for( size_t n = 0; n != directories.size(); ++n ) {
+                    const size_t index = (n + t * 131) % directories.size();
+                    const char *name = cache.DisplayName(directories[index]);
+                    const auto &expected = reference.at(directories[index]);
+                    if( (name == nullptr) != !expected.has_value() || (name != nullptr && *expected != name) )
+                        ++mismatches;
+                    if( round == 0 )
+                        returned[t][index] = name;
+                    else if( returned[t][index] != name )
+                        ++mismatches;
+                }
+            }
+        });
+    for( auto &thread : threads )
+        thread.join();
+
+    CHECK(mismatches == 0);
+    for( size_t t = 1; t != threads_number; ++t )
+        CHECK(returned[t] == returned[0]);
+}
+
+static std::vector<std::string> DirectoriesInside(const std::vector<std::string> &_paths)
+{
+    std::vector<std::string> directories;
+    for( const std::string &path : _paths ) {
+        std::error_code ec;
+        for( const auto &entry : std::filesystem::directory_iterator(path, ec) )
+            if( entry.is_directory(ec) && !entry.is_symlink(ec) )
+                directories.emplace_back(entry.path().native());
+    }
+    return directories;
+}
@@ -0,0 +1,238 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "TestEnv.h"
+#include "FilenameIndex.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <set>
+
+using nc::utility::FileMask;
+using nc::vfs::FilenameIndex;
+
+#define PREFIX "[nc::vfs::FilenameIndex] "
+
+static void BuildTestData(const std::string &_root_path);
+static bool Save(const std::string &_filepath, const std::string &_content);
+
+using Paths = std::set<std::string>;
+
+static Paths Query(const FilenameIndex &_index, const FileMask &_mask, const std::string &_under)
+{
+    Paths paths;
+    _index.Query(_mask, _under, [&](std::string_view _dir_path, std::string_view _filename) {
+        paths.emplace(std::string(_dir_path.substr(_under.size())) + std::string(_filename));
+        return true;
+    });
+    return paths;
+}
+
+TEST_CASE(PREFIX "Finds names by masks")
+{
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+
+    const auto index = FilenameIndex::Build(host, root);
+    REQUIRE(index);
+    CHECK(index->Root() == root);
+    CHECK(index->Size() == 7);
+
+    CHECK(Query(*index, FileMask("*.txt"), root) == Paths{"notes.txt", "Dir/Readme.TXT", "Dir/Sub/deep.txt"});
+    CHECK(Query(*index, FileMask("*.TXT, *.psd"), root) ==
+          Paths{"notes.txt", "Dir/Readme.TXT", "Dir/Sub/deep.txt", "Dir/Sub/picture.psd"});
+    CHECK(Query(*index, FileMask("read*"), root) == Paths{"Dir/Readme.TXT"});
+    CHECK(Query(*index, FileMask("*"), root).size() == 7);
+    CHECK(Query(*index, FileMask("?"), root).empty());
+    CHECK(Query(*index, FileMask("*.txt"), root + "Dir/Sub/") == Paths{"deep.txt"});
+    CHECK(Query(*index, FileMask("*.txt"), root + "Absent/").empty());
+    CHECK(Query(*index, FileMask(R"(.*\.(psd|txt))", FileMask::Type::RegEx), root) ==
+          Paths{"notes.txt", "Dir/Readme.TXT", "Dir/Sub/deep.txt", "Dir/Sub/picture.psd"});
+    CHECK(Query(*index, FileMask("s.*", FileMask::Type::RegEx), root) == Paths{"Dir/Sub"});
+    CHECK(Query(*index, FileMask(R"(\D+\.TXT)", FileMask::Type::RegEx), root) ==
+          Paths{"notes.txt", "Dir/Readme.TXT", "Dir/Sub/deep.txt"});
+    CHECK(Query(*index, FileMask(R"(\p{Ll}+\.MD)", FileMask::Type::RegEx), root) ==
+          Paths{reinterpret_cast<const char *>(u8"Dir/привет.md")});
+    CHECK(Query(*index, FileMask(reinterpret_cast<const char *>(u8"*ПРИВЕТ*")), root) ==
+          Paths{reinterpret_cast<const char *>(u8"Dir/привет.md")});
+
+    CHECK(index->Covers(root));
+    CHECK(index->Covers(root + "Dir/Sub"));
+    CHECK(index->Covers(root + "Dir/Sub/"));
+    CHECK(!index->Covers(root + "notes.txt"));
+    CHECK(!index->Covers("/"));
+}
+
+TEST_CASE(PREFIX "Survives saving and loading")
+{
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+    const std::string path = test_dir.directory / "index.bin";
+
+    const auto index = FilenameIndex::Build(host, root);
+    REQUIRE(index);
+    index->SetMark(42);
+    REQUIRE(index->Save(path));
+
+    const auto loaded = FilenameIndex::Load(path);
+    REQUIRE(loaded);
+    CHECK(loaded->Root() == root);
+    CHECK(loaded->Mark() == 42);
+    CHECK(loaded->Size() == index->Size());
+    CHECK(std::chrono::abs(loaded->BuildTime() - index->BuildTime()) < std::chrono::seconds(1));
+    for( const auto *const mask : {"*.txt", "*", "*sub*"} )
+        CHECK(Query(*loaded, FileMask(mask), root) == Query(*index, FileMask(mask), root));
+
+    SECTION("a damaged file is rejected")
+    {
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+        CHECK(FilenameIndex::Load(path) == nullptr);
+    }
+    SECTION("an absent file is rejected")
+    {
+        CHECK(FilenameIndex::Load(path + ".absent") == nullptr);
+    }
+}
+
+TEST_CASE(PREFIX "Refreshes the changed directories")
+{
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+
+    const auto index = FilenameIndex::Build(host, root);
+    REQUIRE(index);
+
+    std::filesystem::remove_all(root + "Dir/Sub");
+    std::filesystem::remove(root + "notes.txt");
+    std::filesystem::create_directories(root + "New/Deeper");
+    Save(root + "New/Deeper/fresh.txt", "");
+    Save(root + "added.txt", "");
+
+    // nothing changes until the directories are refreshed
+    CHECK(Query(*index, FileMask("*.txt"), root) == Paths{"notes.txt", "Dir/Readme.TXT", "Dir/Sub/deep.txt"});
+
+    index->Refresh(host, root + "Dir");
+    CHECK(Query(*index, FileMask("*.txt"), root) == Paths{"notes.txt", "Dir/Readme.TXT"});
+    CHECK(!index->Covers(root + "Dir/Sub"));
+
+    index->Refresh(host, root);
+    CHECK(Query(*index, FileMask("*.txt"), root) == Paths{"added.txt", "Dir/Readme.TXT", "New/Deeper/fresh.txt"});
+    CHECK(index->Size() == 7);
+
+    // a file replaced by a directory of the same name
+    std::filesystem::remove(root + "added.txt");
+    std::filesystem::create_directory(root + "added.txt");
+    Save(root + "added.txt/inner.txt", "");
+    index->Refresh(host, root);
+    CHECK(Query(*index, FileMask("*.txt"), root) ==
+          Paths{"added.txt", "added.txt/inner.txt", "Dir/Readme.TXT", "New/Deeper/fresh.txt"});
+    CHECK(index->Covers(root + "added.txt"));
+}
+
+TEST_CASE(PREFIX "Serves the paths firmlinked into it")
+{
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+
+    // the same way "/Users" of the root leads to "/System/Volumes/Data/Users"
+    const std::string users = "/Users/NCFilenameIndexTest";
+    const auto index = FilenameIndex::Build(host, root);
+    REQUIRE(index);
+    index->AddFirmlink(users, root + "Dir");
+
+    CHECK(index->Covers(users));
+    CHECK(index->Covers(users + "/"));
+    CHECK(index->Covers(users + "/Sub/"));
+    CHECK(!index->Covers(users + "/Absent/"));
+    CHECK(!index->Covers("/Users/"));
+
+    Paths found;
+    index->Query(FileMask("*.txt"), users + "/", [&](std::string_view _dir_path, std::string_view _filename) {
+        found.emplace(std::string(_dir_path) + std::string(_filename));
+        return true;
+    });
+    CHECK(found == Paths{users + "/Readme.TXT", users + "/Sub/deep.txt"});
+    CHECK(Query(*index, FileMask("*.txt"), root) == Paths{"notes.txt", "Dir/Readme.TXT", "Dir/Sub/deep.txt"});
+
+    Save(root + "Dir/Sub/added.txt", "");
+    index->Refresh(host, users + "/Sub");
+    CHECK(Query(*index, FileMask("*.txt"), users + "/") == Paths{"Readme.TXT", "Sub/deep.txt", "Sub/added.txt"});
+}
+
+TEST_CASE(PREFIX "Matches the masks exactly like a full scan does")
+{
+    TestDir test_dir;
+    auto &host = *TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+
+    // a random tree with the names made of few letters to have many trigrams in common
+    std::mt19937 rng(42);
+    const auto random_name = [&] {
+        std::string name;
+        for( size_t i = std::uniform_int_distribution<size_t>(1, 8)(rng); i != 0; --i )
+            name += "abcAB._"[std::uniform_int_distribution<size_t>(0, 6)(rng)];
+        return name;
+    };
+    std::vector<std::string> directories{""};
+    std::vector<std::string> all;
+    for( int i = 0; i != 2000; ++i ) {
+        const std::string path =
+            directories[std::uniform_int_distribution<size_t>(0, directories.size() - 1)(rng)] + random_name();
+        if( std::filesystem::exists(root + path) )
+            continue;
+        if( i % 5 == 0 ) {
+            std::filesystem::create_directory(root + path);
+            directories.emplace_back(path + "/");
+        }
+        else {
+            Save(root + path, "");
+        }
+        all.emplace_back(path);
+    }
+
+    const auto index = FilenameIndex::Build(host, root, 8);
+    REQUIRE(index);
+    CHECK(index->Size() == all.size());
+
+    std::vector<FileMask> masks;
+    for( const auto *const mask : {"*.a*", "*abc*", "*bca", "a*b*c", "*a?b*", "*.ab, *_c*", "*ab.c*, ?"} )
+        masks.emplace_back(mask);
+    for( const auto *const regex :
+         {"ab.*", ".*(abc|cab).*", ".*b[a_]c", "[ab]+\\.c.*", ".*", "AB\\D*", "\\D+\\.C\\w*", "\\p{Lu}.*"} )
+        masks.emplace_back(regex, FileMask::Type::RegEx);
+
+    for( const FileMask &mask : masks ) {
+        Paths expected;
+        for( const std::string &path : all )
+            if( mask.MatchName(std::filesystem::path(path).filename().native()) )
+                expected.emplace(path);
+        CHECK(Query(*index, mask, root) == expected);
+    }
+}
+
+static void BuildTestData(const std::string &_root_path)
+{
+    Save(_root_path + "notes.txt", "");
+    std::filesystem::create_directories(_root_path + "Dir/Sub");
+    Save(_root_path + "Dir/Readme.TXT", "");
+    Save(_root_path + reinterpret_cast<const char *>(u8"Dir/привет.md"), "");
+    Save(_root_path + "Dir/Sub/deep.txt", "");
+    Save(_root_path + "Dir/Sub/picture.psd", "");
+}
+
+static bool Save(const std::string &_filepath, const std::string &_content)
+{
+    std::ofstream out(_filepath, std::ios::out | std::ios::binary);
+    if( !out )
+        return false;
+    out << _content;
+    out.close();
+    return true;
+}
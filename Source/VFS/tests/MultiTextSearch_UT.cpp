@@ -0,0 +1,204 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "VFSGenericMemReadOnlyFile.h"
+#include <VFS/../../source/MultiTextSearch.h>
+#include <Utility/Encodings.h>
+#include <random>
+
+using nc::utility::Encoding;
+using nc::vfs::FileWindow;
+using nc::vfs::GenericMemReadOnlyFile;
+using nc::vfs::MultiTextSearch;
+#define PREFIX "[nc::vfs::MultiTextSearch] "
+
+static MultiTextSearch::Result Search(const MultiTextSearch &_search,
+                                      std::string_view _data,
+                                      Encoding _encoding = Encoding::ENCODING_UTF8,
+                                      int _window_size = FileWindow::DefaultWindowSize)
+{
+    auto mem_file = std::make_shared<GenericMemReadOnlyFile>("", nullptr, _data);
+    mem_file->Open(VFSFlags::OF_Read);
+    FileWindow fw{mem_file, _window_size};
+    return _search.Search(fw, _encoding);
+}
+
+static std::string U8(const char8_t *_str)
+{
+    return reinterpret_cast<const char *>(_str);
+}
+
+TEST_CASE(PREFIX "Doesn't search for empty texts")
+{
+    const std::vector<std::string> texts = {"", ""};
+    CHECK(Search(MultiTextSearch(texts, true), "some data").response == MultiTextSearch::Response::Invalid);
+    CHECK(Search(MultiTextSearch({}, true), "some data").response == MultiTextSearch::Response::Invalid);
+}
+
+TEST_CASE(PREFIX "Tells which of the texts was found")
+{
+    const std::vector<std::string> texts = {"world", "", "hello", "low"};
+    const MultiTextSearch search(texts, true);
+
+    auto result = Search(search, "0123456789hello, world");
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 10);
+    CHECK(result.match->bytes_len == 5);
+    CHECK(result.match->text_index == 2);
+
+    result = Search(search, "0123456789below, world");
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 12);
+    CHECK(result.match->text_index == 3);
+
+    CHECK(Search(search, "0123456789Hello, World").response == MultiTextSearch::Response::NotFound);
+    CHECK(Search(search, "").response == MultiTextSearch::Response::NotFound);
+}
+
+TEST_CASE(PREFIX "Reports the occurrence which ends first")
+{
+    const std::vector<std::string> texts = {"he", "she", "hers", "is"};
+    const MultiTextSearch search(texts, true);
+
+    auto result = Search(search, "ushers");
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 1);
+    CHECK(result.match->bytes_len == 3);
+    CHECK(result.match->text_index == 1);
+
+    result = Search(search, "this is");
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 2);
+    CHECK(result.match->text_index == 3);
+}
+
+TEST_CASE(PREFIX "Case-insensitive search")
+{
+    const std::vector<std::string> texts = {"HELLO", U8(u8"мир"), U8(u8"ÉTÉ")};
+    const MultiTextSearch search(texts, false);
+
+    auto result = Search(search, "0123456789hElLo");
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 10);
+    CHECK(result.match->text_index == 0);
+
+    result = Search(search, U8(u8"Привет, МИР!"));
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 14);
+    CHECK(result.match->bytes_len == 6);
+    CHECK(result.match->text_index == 1);
+
+    result = Search(search, U8(u8"un bel été"));
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 7);
+    CHECK(result.match->bytes_len == 5);
+    CHECK(result.match->text_index == 2);
+
+    const std::string utf16le("h\0e\0l\0L\0o\0 \0\x1C\x04\x18\x04\x20\x04", 18);
+    result = Search(search, utf16le, Encoding::ENCODING_UTF16LE);
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 0);
+    CHECK(result.match->bytes_len == 10);
+    CHECK(result.match->text_index == 0);
+
+    const std::vector<std::string> cyrillic = {U8(u8"мир")};
+    result = Search(MultiTextSearch(cyrillic, false), utf16le, Encoding::ENCODING_UTF16LE);
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 12);
+    CHECK(result.match->bytes_len == 6);
+}
+
+TEST_CASE(PREFIX "Whole-phrase search")
+{
+    const std::vector<std::string> texts = {"foo bar", "bar", "ba", U8(u8"мир")};
+    const MultiTextSearch search(texts, false, true);
+
+    auto result = Search(search, "xfoo bar!");
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 5);
+    CHECK(result.match->bytes_len == 3);
+    CHECK(result.match->text_index == 1);
+
+    result = Search(search, "bars ba");
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 5);
+    CHECK(result.match->text_index == 2);
+
+    result = Search(search, U8(u8"миры, МИР"));
+    REQUIRE(result.response == MultiTextSearch::Response::Found);
+    CHECK(result.match->offset == 10);
+    CHECK(result.match->bytes_len == 6);
+
+    CHECK(Search(search, "foobar bart").response == MultiTextSearch::Response::NotFound);
+}
+
+TEST_CASE(PREFIX "Finds texts cut between file windows")
+{
+    const auto window_size = FileWindow::DefaultWindowSize;
+    const std::vector<std::string> texts = {"hello", U8(u8"привет")};
+    for( const bool case_sensitive : {true, false} ) {
+        const MultiTextSearch search(texts, case_sensitive);
+        for( const size_t offset : {window_size - 4, window_size - 1, 2 * window_size - 7} ) {
+            std::string memory(3 * window_size, ' ');
+            memory.replace(offset, 12, U8(u8"привет"));
+            const auto result = Search(search, memory);
+            REQUIRE(result.response == MultiTextSearch::Response::Found);
+            CHECK(result.match->offset == offset);
+            CHECK(result.match->bytes_len == 12);
+            CHECK(result.match->text_index == 1);
+        }
+    }
+}
+
+TEST_CASE(PREFIX "Matches a naive search on random data")
+{
+    // the alphabet mixes ASCII and two-byte characters in both cases
+    const std::vector<std::string> alphabet = {"a", "b", "A", "B", U8(u8"ж"), U8(u8"Ж")};
+    const std::vector<std::pair<std::string, std::string>> cases = {{"A", "a"}, {"B", "b"}, {U8(u8"Ж"), U8(u8"ж")}};
+    const auto lower = [&](std::string _str) {
+        for( const auto &[from, to] : cases )
+            for( size_t pos = _str.find(from); pos != std::string::npos; pos = _str.find(from, pos) )
+                _str.replace(pos, from.size(), to);
+        return _str;
+    };
+
+    std::mt19937 rng(42);
+    const auto random_string = [&](size_t _min, size_t _max) {
+        std::string str;
+        for( size_t i = std::uniform_int_distribution<size_t>(_min, _max)(rng); i != 0; --i )
+            str += alphabet[std::uniform_int_distribution<size_t>(0, alphabet.size() - 1)(rng)];
+        return str;
+    };
+
+    for( int round = 0; round != 1000; ++round ) {
+        const bool case_sensitive = round % 2 == 0;
+        std::vector<std::string> texts(std::uniform_int_distribution<size_t>(1, 5)(rng));
+        for( auto &text : texts )
+            text = random_string(1, 4);
+        const std::string data = random_string(0, 100);
+
+        // the earliest end of any text, the longest one among those which end at the same byte
+        std::optional<MultiTextSearch::Match> expected;
+        const std::string haystack = case_sensitive ? data : lower(data);
+        for( size_t index = 0; index < texts.size(); ++index ) {
+            const std::string needle = case_sensitive ? texts[index] : lower(texts[index]);
+            const size_t pos = haystack.find(needle);
+            if( pos == std::string::npos )
+                continue;
+            const size_t end = pos + needle.size();
+            if( !expected || end < expected->offset + expected->bytes_len ||
+                (end == expected->offset + expected->bytes_len && needle.size() > expected->bytes_len) )
+                expected = MultiTextSearch::Match{.offset = pos, .bytes_len = needle.size(), .text_index = index};
+        }
+
+        const MultiTextSearch search(texts, case_sensitive);
+        for( const int window_size : {4, 7, 32} ) {
+            const auto result = Search(search, data, Encoding::ENCODING_UTF8, window_size);
+            REQUIRE(result.match.has_value() == expected.has_value());
+            if( expected ) {
+                CHECK(result.match->offset == expected->offset);
+                CHECK(result.match->bytes_len == expected->bytes_len);
+                CHECK(texts[result.match->text_index] == texts[expected->text_index]);
+            }
+        }
+    }
+}
@@ -2,8 +2,12 @@
 #include "Tests.h"
 #include "TestEnv.h"
 #include "SearchForFiles.h"
+#include "FilenameIndex.h"
 #include <Utility/PathManip.h>
 #include <Native.h>
+#include <fmt/format.h>
+#include <atomic>
+#include <map>
 #include <set>
 #include <fstream>
 #include <sys/stat.h>
@@ -14,6 +18,7 @@ using nc::vfs::SearchForFiles;
 #define PREFIX "[nc::vfs::SearchForFiles] "
 
 static void BuildTestData(const std::string &_root_path);
+static void BuildWideTestData(const std::string &_root_path, int _dirs, int _files_per_dir);
 static bool Save(const std::string &_filepath, const std::string &_content);
 static bool MkDir(const std::string &_dir_path);
 
@@ -26,7 +31,7 @@ TEST_CASE(PREFIX "Test basic searching")
 
     using set = std::set<std::string>;
     set filenames;
-    auto callback = [&](const char *_filename, [[maybe_unused]] const char *_in_path, VFSHost &, CFRange) {
+    auto callback = [&](const char *_filename, [[maybe_unused]] const char *_in_path, VFSHost &, CFRange, size_t) {
         filenames.emplace(_filename);
     };
 
@@ -97,7 +102,7 @@ TEST_CASE(PREFIX "Test size filter")
 
     using set = std::set<std::string>;
     set filenames;
-    auto callback = [&](const char *_filename, [[maybe_unused]] const char *_in_path, VFSHost &, CFRange) {
+    auto callback = [&](const char *_filename, [[maybe_unused]] const char *_in_path, VFSHost &, CFRange, size_t) {
         filenames.emplace(_filename);
     };
 
@@ -143,7 +148,7 @@ TEST_CASE(PREFIX "Test content filter")
 
     using set = std::set<std::string>;
     set filenames;
-    auto callback = [&](const char *_filename, [[maybe_unused]] const char *_in_path, VFSHost &, CFRange) {
+    auto callback = [&](const char *_filename, [[maybe_unused]] const char *_in_path, VFSHost &, CFRange, size_t) {
         filenames.emplace(_filename);
     };
 
@@ -224,6 +229,167 @@ TEST_CASE(PREFIX "Test content filter")
     }
 }
 
+TEST_CASE(PREFIX "Test content filter with several texts")
+{
+    using Options = SearchForFiles::Options;
+    TestDir test_dir;
+    BuildTestData(test_dir.directory);
+    auto &host = TestEnv().vfs_native;
+
+    using map = std::map<std::string, std::pair<long, size_t>>;
+    map found;
+    auto callback = [&](const char *_filename, const char *, VFSHost &, CFRange _content, size_t _text) {
+        found[_filename] = {_content.location, _text};
+    };
+
+    SearchForFiles search;
+    auto do_search = [&](const SearchForFiles::FilterContent &_filter) {
+        search.SetFilterContent(_filter);
+        search.Go(test_dir.directory, host, Options::GoIntoSubDirs | Options::SearchForFiles, callback, {});
+        search.Wait();
+    };
+
+    SECTION("any of the texts")
+    {
+        auto filter = SearchForFiles::FilterContent{};
+        filter.any_of_texts = {"absent", "EDGE", reinterpret_cast<const char *>(u8"МИР"), "hello"};
+        do_search(filter);
+        CHECK(found == map{{"filename1.txt", {0, 3}}, {"filename2.txt", {14, 2}}, {"filename3.txt", {7, 1}}});
+    }
+    SECTION("any of the texts, case sensitive")
+    {
+        auto filter = SearchForFiles::FilterContent{};
+        filter.any_of_texts = {"absent", "EDGE", "Hello"};
+        filter.case_sensitive = true;
+        do_search(filter);
+        CHECK(found == map{{"filename1.txt", {0, 2}}});
+    }
+    SECTION("any of the texts, whole phrase")
+    {
+        auto filter = SearchForFiles::FilterContent{};
+        filter.any_of_texts = {"ello", "edg", reinterpret_cast<const char *>(u8"мир")};
+        filter.whole_phrase = true;
+        do_search(filter);
+        CHECK(found == map{{"filename2.txt", {14, 2}}});
+    }
+    SECTION("none of the texts")
+    {
+        auto filter = SearchForFiles::FilterContent{};
+        filter.any_of_texts = {"edge", "hello"};
+        filter.not_containing = true;
+        do_search(filter);
+        CHECK(found == map{{"filename2.txt", {-1, 0}}});
+    }
+}
+
+TEST_CASE(PREFIX "Concurrent searching yields the same results")
+{
+    using Options = SearchForFiles::Options;
+    TestDir test_dir;
+    BuildWideTestData(test_dir.directory, 20, 50);
+    auto &host = TestEnv().vfs_native;
+
+    const auto search_with = [&](SearchForFiles::Concurrency _concurrency, bool _not_containing) {
+        std::set<std::string> paths;
+        std::atomic_int in_callback = 0;
+        bool overlapped = false;
+        bool without_location = false;
+        auto callback = [&](const char *_filename, const char *_in_path, VFSHost &, CFRange _content, size_t) {
+            overlapped |= in_callback.fetch_add(1) != 0;
+            without_location |= _content.location < 0;
+            paths.emplace(nc::utility::PathManip::EnsureTrailingSlash(_in_path) / _filename);
+            in_callback.fetch_sub(1);
+        };
+
+        SearchForFiles search;
+        search.SetConcurrency(_concurrency);
+        auto filter = SearchForFiles::FilterContent{};
+        filter.text = "needle";
+        filter.not_containing = _not_containing;
+        search.SetFilterContent(filter);
+        search.Go(test_dir.directory, host, Options::GoIntoSubDirs | Options::SearchForFiles, callback, {});
+        search.Wait();
+        CHECK(!overlapped);
+        CHECK(without_location == _not_containing);
+        return paths;
+    };
+
+    for( const bool not_containing : {false, true} ) {
+        const auto serial = search_with({.traversal_workers = 1, .content_workers = 1}, not_containing);
+        CHECK(serial.size() == (not_containing ? 20 * 50 - 20 * 5 : 20 * 5));
+        CHECK(search_with({}, not_containing) == serial);
+        CHECK(search_with({.traversal_workers = 8, .content_workers = 16}, not_containing) == serial);
+        CHECK(search_with({.traversal_workers = 2, .content_workers = 4, .native_host_limit = 1}, not_containing) ==
+              serial);
+    }
+}
+
+TEST_CASE(PREFIX "Stopping a concurrent search")
+{
+    using Options = SearchForFiles::Options;
+    TestDir test_dir;
+    BuildWideTestData(test_dir.directory, 20, 50);
+    auto &host = TestEnv().vfs_native;
+
+    SearchForFiles search;
+    auto filter = SearchForFiles::FilterContent{};
+    filter.text = "needle";
+    search.SetFilterContent(filter);
+    std::atomic_int found = 0;
+    auto callback = [&](const char *, const char *, VFSHost &, CFRange, size_t) {
+        if( ++found == 10 )
+            search.Stop();
+    };
+    search.Go(test_dir.directory, host, Options::GoIntoSubDirs | Options::SearchForFiles, callback, {});
+    search.Wait();
+    CHECK(found >= 10);
+    CHECK(found < 20 * 5);
+    CHECK(!search.IsRunning());
+}
+
+TEST_CASE(PREFIX "Searching with a filename index")
+{
+    using Options = SearchForFiles::Options;
+    TestDir test_dir;
+    BuildWideTestData(test_dir.directory, 20, 50);
+    auto &host = TestEnv().vfs_native;
+    const std::string root = test_dir.directory;
+    const std::shared_ptr<const nc::vfs::FilenameIndex> index = nc::vfs::FilenameIndex::Build(*host, root);
+    REQUIRE(index);
+
+    // the index doesn't know about these changes
+    std::filesystem::remove(root + "dir3/file10.txt");
+    Save(root + "dir3/file100.txt", "needle");
+
+    const auto search_with = [&](const std::string &_from, const FileMask &_mask, bool _use_index) {
+        std::set<std::string> paths;
+        auto callback = [&](const char *_filename, const char *_in_path, VFSHost &, CFRange, size_t) {
+            paths.emplace(nc::utility::PathManip::EnsureTrailingSlash(_in_path) / _filename);
+        };
+        SearchForFiles search;
+        search.SetFilterName(_mask);
+        if( _use_index )
+            search.SetFilenameIndex(index);
+        auto filter = SearchForFiles::FilterContent{};
+        filter.text = "needle";
+        search.SetFilterContent(filter);
+        search.Go(_from, host, Options::GoIntoSubDirs | Options::SearchForFiles, callback, {});
+        search.Wait();
+        return paths;
+    };
+
+    const auto indexed = search_with(root, FileMask("*file1*.txt"), true);
+    CHECK(indexed.size() == 19);
+    CHECK(!indexed.contains(root + "dir3/file10.txt"));
+    auto walked = search_with(root, FileMask("*file1*.txt"), false);
+    CHECK(walked.erase(root + "dir3/file100.txt") == 1);
+    CHECK(indexed == walked);
+
+    CHECK(search_with(root + "dir7/", FileMask("file?0.txt"), true) ==
+          std::set<std::string>{root + "dir7/file10.txt", root + "dir7/file20.txt", root + "dir7/file30.txt",
+                                root + "dir7/file40.txt"});
+}
+
 static void BuildTestData(const std::string &_root_path)
 {
     Save(_root_path + "filename1.txt", "Hello, world!");
@@ -232,6 +398,19 @@ static void BuildTestData(const std::string &_root_path)
     Save(_root_path + "Dir/filename3.txt", "Almost edge of the world!");
 }
 
+// Every tenth file contains the word "needle" somewhere in the middle.
+static void BuildWideTestData(const std::string &_root_path, int _dirs, int _files_per_dir)
+{
+    const std::string filler(10'000, 'x');
+    for( int dir = 0; dir != _dirs; ++dir ) {
+        const auto dir_path = fmt::format("{}dir{}/", _root_path, dir);
+        MkDir(dir_path);
+        for( int file = 0; file != _files_per_dir; ++file )
+            Save(fmt::format("{}file{}.txt", dir_path, file),
+                 file % 10 == 0 ? filler + " needle " + filler : filler + filler);
+    }
+}
+
 static bool Save(const std::string &_filepath, const std::string &_content)
 {
     std::ofstream out(_filepath, std::ios::out | std::ios::binary);
@@ -0,0 +1,137 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "SearchInFile.h"
+#include "VFSGenericMemReadOnlyFile.h"
+#include <VFS/../../source/MultiTextSearch.h>
+#include <Utility/Encodings.h>
+#include <Base/CFString.h>
+#include <random>
+
+using namespace nc::base;
+using nc::utility::Encoding;
+using nc::vfs::FileWindow;
+using nc::vfs::GenericMemReadOnlyFile;
+using nc::vfs::MultiTextSearch;
+using nc::vfs::SearchInFile;
+#define PREFIX "[nc::vfs::SearchInFile] "
+
+// 64Mb of words which never contain the searched text
+static const std::string &Text()
+{
+    static const std::string text = [] {
+        const std::string_view words[] = {
+            "lorem ", "ipsum ", "dolor ", "sit ", "amet, ", "consectetur ", "adipiscing ", "elit.\n", "привет "};
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<size_t> dist(0, std::size(words) - 1);
+        std::string str;
+        while( str.size() < 64 * 1024 * 1024 )
+            str += words[dist(rng)];
+        return str;
+    }();
+    return text;
+}
+
+static const std::string &TextUTF16LE()
+{
+    static const std::string text = [] {
+        std::string str;
+        for( const char c : Text().substr(0, Text().size() / 2) ) {
+            str.push_back(c);
+            str.push_back('\0');
+        }
+        return str;
+    }();
+    return text;
+}
+
+static SearchInFile::Response Search(const std::string &_data,
+                                     CFStringRef _text,
+                                     Encoding _encoding,
+                                     SearchInFile::Options _options)
+{
+    auto mem_file = std::make_shared<GenericMemReadOnlyFile>("", nullptr, _data);
+    mem_file->Open(VFSFlags::OF_Read);
+    FileWindow fw{mem_file};
+    SearchInFile search{fw};
+    search.ToggleTextSearch(_text, _encoding);
+    search.SetSearchOptions(_options);
+    return search.Search().response;
+}
+
+TEST_CASE(PREFIX "Throughput of searching for an absent text", "[!benchmark]")
+{
+    const auto needle = CFString("needle");
+    const auto cyrillic = CFString(reinterpret_cast<const char *>(u8"иголка"));
+    const auto utf8 = Encoding::ENCODING_UTF8;
+    BENCHMARK("UTF-8, case-sensitive")
+    {
+        return Search(Text(), *needle, utf8, SearchInFile::Options::CaseSensitive);
+    };
+    BENCHMARK("UTF-8, case-insensitive")
+    {
+        return Search(Text(), *needle, utf8, SearchInFile::Options::None);
+    };
+    BENCHMARK("UTF-8, case-insensitive, Cyrillic")
+    {
+        return Search(Text(), *cyrillic, utf8, SearchInFile::Options::None);
+    };
+    BENCHMARK("UTF-8, whole phrase")
+    {
+        return Search(Text(), *needle, utf8, SearchInFile::Options::FindWholePhrase);
+    };
+    BENCHMARK("Single-byte, case-insensitive")
+    {
+        return Search(Text(), *needle, Encoding::ENCODING_MACOS_ROMAN_WESTERN, SearchInFile::Options::None);
+    };
+    BENCHMARK("UTF-16LE, case-insensitive")
+    {
+        return Search(TextUTF16LE(), *needle, Encoding::ENCODING_UTF16LE, SearchInFile::Options::None);
+    };
+    const auto regexp = CFString("ne+dle [0-9]+");
+    BENCHMARK("UTF-8, regular expression")
+    {
+        return Search(Text(), *regexp, utf8, SearchInFile::Options::RegularExpression);
+    };
+    BENCHMARK("UTF-16LE, regular expression")
+    {
+        return Search(TextUTF16LE(), *regexp, Encoding::ENCODING_UTF16LE, SearchInFile::Options::RegularExpression);
+    };
+    BENCHMARK("Binary pattern with wildcards")
+    {
+        auto mem_file = std::make_shared<GenericMemReadOnlyFile>("", nullptr, Text());
+        mem_file->Open(VFSFlags::OF_Read);
+        FileWindow fw{mem_file};
+        SearchInFile search{fw};
+        search.ToggleBinarySearch(CFSTR("DE AD ?? EF"));
+        return search.Search().response;
+    };
+}
+
+TEST_CASE(PREFIX "Throughput of searching for any of many absent texts", "[!benchmark]")
+{
+    const auto search = [](const std::string &_data, const MultiTextSearch &_texts, Encoding _encoding) {
+        auto mem_file = std::make_shared<GenericMemReadOnlyFile>("", nullptr, _data);
+        mem_file->Open(VFSFlags::OF_Read);
+        FileWindow fw{mem_file};
+        return _texts.Search(fw, _encoding).response;
+    };
+    for( const int count : {1, 10, 500} ) {
+        std::vector<std::string> texts;
+        for( int i = 0; i < count; ++i )
+            texts.emplace_back("key-" + std::to_string(i * 7919));
+        const MultiTextSearch case_sensitive(texts, true);
+        const MultiTextSearch case_insensitive(texts, false);
+        BENCHMARK("UTF-8, case-sensitive, " + std::to_string(count) + " texts")
+        {
+            return search(Text(), case_sensitive, Encoding::ENCODING_UTF8);
+        };
+        BENCHMARK("UTF-8, case-insensitive, " + std::to_string(count) + " texts")
+        {
+            return search(Text(), case_insensitive, Encoding::ENCODING_UTF8);
+        };
+        BENCHMARK("UTF-16LE, case-insensitive, " + std::to_string(count) + " texts")
+        {
+            return search(TextUTF16LE(), case_insensitive, Encoding::ENCODING_UTF16LE);
+        };
+    }
+}
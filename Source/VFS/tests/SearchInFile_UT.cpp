@@ -188,6 +188,29 @@ TEST_CASE(PREFIX "Handles case the sensitivity flag")
     }
 }
 
+TEST_CASE(PREFIX "Applies the options changed between the searches")
+{
+    auto fw = MakeFileWindow("Hello, hello, HELLO");
+    auto search = SearchInFile{fw};
+    search.ToggleTextSearch(CFSTR("HELLO"), Encoding::ENCODING_UTF8);
+    auto result = search.Search();
+    REQUIRE(result.response == SearchInFile::Response::Found);
+    CHECK(result.location->offset == 0);
+
+    search.SetSearchOptions(SearchInFile::Options::CaseSensitive);
+    result = search.Search();
+    REQUIRE(result.response == SearchInFile::Response::Found);
+    CHECK(result.location->offset == 14);
+
+    search.MoveCurrentPosition(0);
+    search.SetSearchOptions(SearchInFile::Options::RegularExpression);
+    search.ToggleTextSearch(CFSTR("h[a-z]+o"), Encoding::ENCODING_UTF8);
+    result = search.Search();
+    REQUIRE(result.response == SearchInFile::Response::Found);
+    CHECK(result.location->offset == 0);
+    CHECK(result.location->bytes_len == 5);
+}
+
 TEST_CASE(PREFIX "Handles case the whole phrase flag")
 {
     auto fw = MakeFileWindow(reinterpret_cast<const char *>(u8"0123456789hello, hello"));
@@ -213,6 +236,258 @@ TEST_CASE(PREFIX "Handles case the whole phrase flag")
     }
 }
 
+TEST_CASE(PREFIX "Searches in UTF-16")
+{
+    const auto cf_string = CFString(reinterpret_cast<const char *>(u8"Привет"));
+    SECTION("Little endian")
+    {
+        // "h" at the odd offset 1 is not aligned, the aligned one is at 4, followed by "привет"
+        const auto memory = std::string("\x00h\x00\x00h\x00\x3F\x04\x40\x04\x38\x04\x32\x04\x35\x04\x42\x04", 18);
+        auto fw = MakeFileWindow(memory);
+        auto search = SearchInFile{fw};
+        search.ToggleTextSearch(*cf_string, Encoding::ENCODING_UTF16LE);
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 6);
+        CHECK(result.location->bytes_len == 12);
+
+        search.MoveCurrentPosition(0);
+        search.ToggleTextSearch(CFSTR("h"), Encoding::ENCODING_UTF16LE);
+        const auto h = search.Search();
+        REQUIRE(h.response == SearchInFile::Response::Found);
+        CHECK(h.location->offset == 4);
+    }
+    SECTION("Big endian")
+    {
+        const auto memory = std::string("0123\x04\x3F\x04\x40\x04\x38\x04\x32\x04\x35\x04\x42", 16);
+        auto fw = MakeFileWindow(memory);
+        auto search = SearchInFile{fw};
+        search.ToggleTextSearch(*cf_string, Encoding::ENCODING_UTF16BE);
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 4);
+        CHECK(result.location->bytes_len == 12);
+    }
+}
+
+TEST_CASE(PREFIX "Ignores the case of Latin characters in single-byte encodings")
+{
+    // "CAF\xC9" is "CAFÉ" in ISO 8859-1
+    auto fw = MakeFileWindow("0123456789CAF\xC9");
+    auto search = SearchInFile{fw};
+    const auto cf_string = CFString(reinterpret_cast<const char *>(u8"café"));
+    search.ToggleTextSearch(*cf_string, Encoding::ENCODING_ISO_8859_1);
+    SECTION("case insensitive")
+    {
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 10);
+        CHECK(result.location->bytes_len == 4);
+    }
+    SECTION("case sensitive")
+    {
+        search.SetSearchOptions(SearchInFile::Options::CaseSensitive);
+        const auto result = search.Search();
+        CHECK(result.response == SearchInFile::Response::NotFound);
+    }
+}
+
+TEST_CASE(PREFIX "Finds text cut between file windows")
+{
+    const auto window_size = FileWindow::DefaultWindowSize;
+    for( const size_t hello_offset : {window_size - 4, window_size - 1, 2 * window_size - 7} ) {
+        std::string memory(3 * window_size, ' ');
+        memory.replace(hello_offset, 5, "hello");
+        auto fw = MakeFileWindow(memory);
+        auto search = SearchInFile{fw};
+        search.ToggleTextSearch(CFSTR("HeLLo"), Encoding::ENCODING_UTF8);
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == hello_offset);
+        CHECK(search.Search().response == SearchInFile::Response::NotFound);
+    }
+}
+
+TEST_CASE(PREFIX "Checks the whole phrase beyond the file window")
+{
+    const auto window_size = FileWindow::DefaultWindowSize;
+    std::string memory(3 * window_size, ' ');
+    const auto word_offset = window_size - 5;
+    memory.replace(word_offset, 6, "helloX");
+    memory.replace(word_offset + 100, 6, "Xhello");
+    memory.replace(word_offset + 200, 5, "hello");
+    auto fw = MakeFileWindow(memory);
+    auto search = SearchInFile{fw};
+    search.ToggleTextSearch(CFSTR("hello"), Encoding::ENCODING_UTF8);
+    search.SetSearchOptions(SearchInFile::Options::FindWholePhrase);
+    const auto result = search.Search();
+    REQUIRE(result.response == SearchInFile::Response::Found);
+    CHECK(result.location->offset == word_offset + 200);
+}
+
+TEST_CASE(PREFIX "Searches for regular expressions")
+{
+    auto fw = MakeFileWindow("2024-01-01 INFO started\n2024-01-01 ERROR disk full\n2024-01-02 error again\n");
+    auto search = SearchInFile{fw};
+    search.ToggleTextSearch(CFSTR("^[0-9-]+ error"), Encoding::ENCODING_UTF8);
+    SECTION("case insensitive")
+    {
+        search.SetSearchOptions(SearchInFile::Options::RegularExpression);
+        auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 24);
+        CHECK(result.location->bytes_len == 16);
+        result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 51);
+        CHECK(search.Search().response == SearchInFile::Response::NotFound);
+    }
+    SECTION("case sensitive")
+    {
+        search.SetSearchOptions(SearchInFile::Options::RegularExpression | SearchInFile::Options::CaseSensitive);
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 51);
+    }
+    SECTION("invalid expression")
+    {
+        search.ToggleTextSearch(CFSTR("error("), Encoding::ENCODING_UTF8);
+        search.SetSearchOptions(SearchInFile::Options::RegularExpression);
+        CHECK(search.Search().response == SearchInFile::Response::Invalid);
+    }
+}
+
+TEST_CASE(PREFIX "Finds regular expressions cut between file windows")
+{
+    const auto window_size = FileWindow::DefaultWindowSize;
+    for( const size_t offset : {window_size - 10, window_size - 1, 2 * window_size - 3000} ) {
+        std::string memory(3 * window_size, 'x');
+        memory.replace(offset, 12, " id=12345678");
+        auto fw = MakeFileWindow(memory);
+        auto search = SearchInFile{fw};
+        search.ToggleTextSearch(CFSTR("\\bid=[0-9]+"), Encoding::ENCODING_UTF8);
+        search.SetSearchOptions(SearchInFile::Options::RegularExpression);
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == offset + 1);
+        CHECK(result.location->bytes_len == 11);
+        CHECK(search.Search().response == SearchInFile::Response::NotFound);
+    }
+}
+
+TEST_CASE(PREFIX "Finds long regular expression matches cut between file windows")
+{
+    const auto window_size = FileWindow::DefaultWindowSize;
+    const std::string digits(window_size, '7');
+    for( const size_t offset : {size_t(0), window_size - 10, window_size + 100, 2 * window_size - 3000} ) {
+        std::string memory(4 * window_size, 'x');
+        memory.replace(offset, digits.size() + 5, " id=" + digits + " ");
+        auto fw = MakeFileWindow(memory);
+        auto search = SearchInFile{fw};
+        search.ToggleTextSearch(CFSTR("\\bid=[0-9]+"), Encoding::ENCODING_UTF8);
+        search.SetSearchOptions(SearchInFile::Options::RegularExpression);
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == offset + 1);
+        CHECK(result.location->bytes_len == digits.size() + 3);
+        CHECK(search.Search().response == SearchInFile::Response::NotFound);
+    }
+}
+
+TEST_CASE(PREFIX "Searches for regular expressions in UTF-16")
+{
+    // "x привет 42" in UTF-16LE
+    const auto memory = std::string("x\x00 \x00\x3F\x04\x40\x04\x38\x04\x32\x04\x35\x04\x42\x04"
+                                    " \x00"
+                                    "4\x00"
+                                    "2\x00",
+                                    22);
+    auto fw = MakeFileWindow(memory);
+    auto search = SearchInFile{fw};
+    const auto cf_string = CFString(reinterpret_cast<const char *>(u8"ПРИВЕТ\\s+\\d+"));
+    search.ToggleTextSearch(*cf_string, Encoding::ENCODING_UTF16LE);
+    search.SetSearchOptions(SearchInFile::Options::RegularExpression);
+    const auto result = search.Search();
+    REQUIRE(result.response == SearchInFile::Response::Found);
+    CHECK(result.location->offset == 4);
+    CHECK(result.location->bytes_len == 18);
+}
+
+TEST_CASE(PREFIX "Validates binary patterns")
+{
+    CHECK(SearchInFile::IsValidBinaryPattern("DE AD BE EF"));
+    CHECK(SearchInFile::IsValidBinaryPattern("deadbeef"));
+    CHECK(SearchInFile::IsValidBinaryPattern("DE ?? B? ?F"));
+    CHECK(SearchInFile::IsValidBinaryPattern(" ?? "));
+    CHECK(!SearchInFile::IsValidBinaryPattern(""));
+    CHECK(!SearchInFile::IsValidBinaryPattern("   "));
+    CHECK(!SearchInFile::IsValidBinaryPattern("DEA"));
+    CHECK(!SearchInFile::IsValidBinaryPattern("D EA"));
+    CHECK(!SearchInFile::IsValidBinaryPattern("DE AG"));
+    CHECK(!SearchInFile::IsValidBinaryPattern("DE*AD"));
+}
+
+TEST_CASE(PREFIX "Searches for binary patterns")
+{
+    const auto memory = std::string("\x00\xDE\xAD\x00\xDE\xAD\x42\xEF\xDE\xAD\x13\xEF\x7F\x45\x4C\x46", 16);
+    auto fw = MakeFileWindow(memory);
+    auto search = SearchInFile{fw};
+    SECTION("Exact bytes")
+    {
+        search.ToggleBinarySearch(CFSTR("7f 45 4c 46"));
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 12);
+        CHECK(result.location->bytes_len == 4);
+    }
+    SECTION("Wildcard bytes")
+    {
+        search.ToggleBinarySearch(CFSTR("DE AD ?? EF"));
+        auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 4);
+        result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 8);
+        CHECK(search.Search().response == SearchInFile::Response::NotFound);
+    }
+    SECTION("Wildcard nibbles")
+    {
+        search.ToggleBinarySearch(CFSTR("DEAD1?EF"));
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == 8);
+    }
+    SECTION("Ignores the text search options")
+    {
+        search.SetSearchOptions(SearchInFile::Options::CaseSensitive | SearchInFile::Options::RegularExpression);
+        search.ToggleBinarySearch(CFSTR("de ad ?? ef"));
+        CHECK(search.IsBinarySearch());
+        CHECK(search.Search().response == SearchInFile::Response::Found);
+    }
+    SECTION("Invalid pattern")
+    {
+        search.ToggleBinarySearch(CFSTR("DE AD ?"));
+        CHECK(search.Search().response == SearchInFile::Response::Invalid);
+    }
+}
+
+TEST_CASE(PREFIX "Finds binary patterns cut between file windows")
+{
+    const auto window_size = FileWindow::DefaultWindowSize;
+    for( const size_t offset : {window_size - 2, window_size - 1, 2 * window_size - 3} ) {
+        std::string memory(3 * window_size, '\xDE');
+        memory.replace(offset, 4, "\xDE\xAD\x01\xEF");
+        auto fw = MakeFileWindow(memory);
+        auto search = SearchInFile{fw};
+        search.ToggleBinarySearch(CFSTR("DE AD ?? EF"));
+        const auto result = search.Search();
+        REQUIRE(result.response == SearchInFile::Response::Found);
+        CHECK(result.location->offset == offset);
+        CHECK(search.Search().response == SearchInFile::Response::NotFound);
+    }
+}
+
 static FileWindow MakeFileWindow(std::string_view _data)
 {
     assert(_data.data() != nullptr);
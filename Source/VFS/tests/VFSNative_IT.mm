@@ -9,6 +9,7 @@
 #include <boost/process.hpp>
 #include <fmt/core.h>
 #include <fstream>
+#include <set>
 #include <unistd.h>
 
 using namespace nc::vfs;
@@ -212,10 +213,13 @@ TEST_CASE(PREFIX "Fetching")
             CHECK((abs(p.add_time - time) < time_eps || p.add_time == -1)); // no add via ReadDirAttributesStat
             CHECK(p.mode == (S_IFREG | 0755));
             CHECK(p.size == 0);
+            CHECK(p.alloc_size == 0);
+            CHECK(p.nlink == 1);
             CHECK(p.flags == 0);
         }
         else if( filename == "non-zero-reg-file" ) {
             CHECK(p.size == std::string_view("Hello, World!").length());
+            CHECK(p.alloc_size >= p.size);
         }
         else if( filename == "symlink" ) {
             CHECK(p.mode == (S_IFLNK | 0755));
@@ -248,6 +252,93 @@ TEST_CASE(PREFIX "Fetching")
     CHECK(to_visit.empty());
 }
 
+TEST_CASE(PREFIX "CalculateDirectorySize")
+{
+    const TestDir test_dir;
+    const std::filesystem::path root = test_dir.directory;
+    auto &host = *TestEnv().vfs_native;
+
+    std::ofstream(root / "a") << "12345";
+    std::filesystem::create_directories(root / "Sub/Deeper");
+    std::ofstream(root / "Sub/b") << "0123456789";
+    std::ofstream(root / "Sub/Deeper/c") << "123";
+    std::filesystem::create_hard_link(root / "Sub/b", root / "Sub/Deeper/b-link");
+    std::filesystem::create_symlink("/hello", root / "symlink");
+    REQUIRE(mkfifo((root / "fifo").c_str(), 0644) == 0);
+
+    // a wide tree to keep all the workers busy
+    for( int i = 0; i != 50; ++i ) {
+        const auto dir = root / fmt::format("Wide/Dir{}", i);
+        std::filesystem::create_directories(dir);
+        for( int j = 0; j != 20; ++j )
+            std::ofstream(dir / fmt::format("file{}", j)) << "x";
+    }
+
+    // the expected allocated sizes are what lstat() reports
+    int64_t allocated = 0;
+    int64_t allocated_once = 0;
+    for( const auto &entry : std::filesystem::recursive_directory_iterator(root) ) {
+        struct stat st;
+        REQUIRE(lstat(entry.path().c_str(), &st) == 0);
+        if( S_ISREG(st.st_mode) || S_ISLNK(st.st_mode) ) {
+            allocated += st.st_blocks * S_BLKSIZE;
+            if( entry.path().filename() != "b-link" )
+                allocated_once += st.st_blocks * S_BLKSIZE;
+        }
+    }
+
+    using Options = NativeHost::DirectorySizeOptions;
+    CHECK(host.CalculateDirectorySize(root.native(), {}) == 1034);
+    CHECK(host.CalculateDirectorySize(root.native(), {}, Options{}) == 1034);
+    CHECK(host.CalculateDirectorySize(root.native(), {}, Options{.hardlinks_once = true}) == 1024);
+    CHECK(host.CalculateDirectorySize(root.native(), {}, Options{.allocated = true}) == allocated);
+    CHECK(host.CalculateDirectorySize(root.native(), {}, Options{.allocated = true, .hardlinks_once = true}) ==
+          allocated_once);
+    CHECK(host.CalculateDirectorySize((root / "Sub").native(), {}) == 23);
+    CHECK(host.CalculateDirectorySize((root / "Sub/").native(), {}) == 23);
+    CHECK(host.CalculateDirectorySize((root / "Absent").native(), {}) == VFSError::FromErrno(ENOENT));
+    CHECK(host.CalculateDirectorySize("relative/path", {}) == VFSError::InvalidCall);
+    CHECK(host.CalculateDirectorySize(root.native(), [] { return true; }) == VFSError::Cancelled);
+
+    // the cancellation is noticed by the workers as well
+    std::atomic_int checks{0};
+    CHECK(host.CalculateDirectorySize(root.native(), [&] { return ++checks > 10; }) == VFSError::Cancelled);
+}
+
+TEST_CASE(PREFIX "IterateDirectoryForSize reports what lstat() does")
+{
+    const TestDir test_dir;
+    const std::filesystem::path root = test_dir.directory;
+    auto &host = *TestEnv().vfs_native;
+
+    std::ofstream(root / "a") << "12345";
+    std::filesystem::create_directories(root / "Sub");
+    std::filesystem::create_hard_link(root / "a", root / "a-link");
+    std::filesystem::create_symlink("/hello", root / "symlink");
+
+    std::set<std::string> met;
+    const auto rc = host.IterateDirectoryForSize(root.native(), [&](const NativeHost::DirectorySizeEntry &_entry) {
+        met.emplace(_entry.filename);
+        struct stat st;
+        REQUIRE(lstat((root / _entry.filename).c_str(), &st) == 0);
+        CHECK(_entry.type == (st.st_mode & S_IFMT));
+        CHECK(_entry.dev == st.st_dev);
+        CHECK(_entry.inode == st.st_ino);
+        CHECK(_entry.mtime_sec == st.st_mtimespec.tv_sec);
+        CHECK(_entry.mtime_nsec == st.st_mtimespec.tv_nsec);
+        if( !S_ISDIR(st.st_mode) ) {
+            CHECK(_entry.size == st.st_size);
+            CHECK(_entry.alloc_size == st.st_blocks * S_BLKSIZE);
+            CHECK(_entry.nlink == st.st_nlink);
+        }
+    });
+    CHECK(rc == VFSError::Ok);
+    CHECK(met == std::set<std::string>{"a", "a-link", "Sub", "symlink"});
+    CHECK(host.IterateDirectoryForSize((root / "a").native(), [](auto &) {}) == VFSError::FromErrno(ENOTDIR));
+    CHECK(host.IterateDirectoryForSize((root / "Absent").native(), [](auto &) {}) == VFSError::FromErrno(ENOENT));
+    CHECK(host.IterateDirectoryForSize("relative/path", [](auto &) {}) == VFSError::InvalidCall);
+}
+
 static int Execute(const std::string &_command)
 {
     using namespace boost::process;
@@ -0,0 +1,98 @@
+// Copyright (C) 2024 Michael Kazakov. Subject to GNU General Public License version 3.
+#include "Tests.h"
+#include "TestEnv.h"
+#include <VFS/Native.h>
+#include <Base/dispatch_cpp.h>
+#include <fmt/core.h>
+#include <atomic>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace nc::vfs;
+#define PREFIX "VFSNative PT "
+
+// 1M files: 100 directories with 100 subdirectories each with 100 files
+static const std::filesystem::path &Tree()
+{
+    static const TestDir test_dir;
+    static const std::filesystem::path tree = [] {
+        const std::filesystem::path root = test_dir.directory / "Tree";
+        for( int i = 0; i != 100; ++i ) {
+            for( int j = 0; j != 100; ++j ) {
+                const auto dir = root / fmt::format("{}/{}", i, j);
+                std::filesystem::create_directories(dir);
+                for( int k = 0; k != 100; ++k ) {
+                    const int fd = creat((dir / fmt::format("{}.txt", k)).c_str(), 0644);
+                    REQUIRE(fd >= 0);
+                    REQUIRE(ftruncate(fd, k) == 0);
+                    close(fd);
+                }
+            }
+        }
+        return root;
+    }();
+    return tree;
+}
+
+// The former implementation of NativeHost::CalculateDirectorySize(): a recursive readdir() walk which stats the files
+// on a serial queue.
+static void SerialCalculateHelper(const std::string &_path, dispatch_queue &_stat_queue, std::atomic_int64_t &_size)
+{
+    DIR *const dirp = opendir(_path.c_str());
+    if( dirp == nullptr )
+        return;
+    while( const dirent *entp = readdir(dirp) ) {
+        if( entp->d_ino == 0 || strcmp(entp->d_name, ".") == 0 || strcmp(entp->d_name, "..") == 0 )
+            continue;
+        std::string path = _path + "/" + entp->d_name;
+        if( entp->d_type == DT_DIR ) {
+            SerialCalculateHelper(path, _stat_queue, _size);
+        }
+        else if( entp->d_type == DT_REG || entp->d_type == DT_LNK ) {
+            _stat_queue.async([&_size, path = std::move(path)] {
+                struct stat st;
+                if( lstat(path.c_str(), &st) == 0 )
+                    _size += st.st_size;
+            });
+        }
+    }
+    closedir(dirp);
+}
+
+static int64_t SerialCalculate(const std::string &_path)
+{
+    dispatch_queue stat_queue("VFSNative PT");
+    std::atomic_int64_t size{0};
+    SerialCalculateHelper(_path, stat_queue, size);
+    stat_queue.sync([] {});
+    return size;
+}
+
+TEST_CASE(PREFIX "Calculating the size of a 1M files tree", "[!benchmark]")
+{
+    const std::string path = Tree().native();
+    auto &host = *TestEnv().vfs_native;
+    using Options = NativeHost::DirectorySizeOptions;
+    constexpr int64_t expected = 10'000 * (99 * 100 / 2);
+    REQUIRE(SerialCalculate(path) == expected);
+    REQUIRE(host.CalculateDirectorySize(path, {}) == expected);
+
+    BENCHMARK("Serial readdir() and lstat()")
+    {
+        return SerialCalculate(path);
+    };
+    BENCHMARK("Parallel bulk fetching")
+    {
+        return host.CalculateDirectorySize(path, {});
+    };
+    BENCHMARK("Parallel bulk fetching, allocated sizes")
+    {
+        return host.CalculateDirectorySize(path, {}, Options{.allocated = true});
+    };
+    BENCHMARK("Parallel bulk fetching, hardlinks once")
+    {
+        return host.CalculateDirectorySize(path, {}, Options{.hardlinks_once = true});
+    };
+}
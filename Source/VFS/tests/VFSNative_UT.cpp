@@ -7,12 +7,22 @@
 #include <sys/xattr.h>
 
 #include <algorithm>
+#include <span>
 
 using namespace nc;
 using namespace nc::vfs;
 using namespace nc::vfs::native;
 #define PREFIX "VFSNative "
 
+static const unsigned char g_XattrBytesGreen[] = {
+    0x62, 0x70, 0x6c, 0x69, 0x73, 0x74, 0x30, 0x30, 0xa1, 0x01, 0x57, 0x47, 0x72, 0x65, 0x65, 0x6e, 0x0a, 0x32,
+    0x08, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12};
+static const unsigned char g_XattrBytesBlue[] = {
+    0x62, 0x70, 0x6c, 0x69, 0x73, 0x74, 0x30, 0x30, 0xa1, 0x01, 0x56, 0x42, 0x6c, 0x75, 0x65, 0x0a, 0x34, 0x08,
+    0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11};
+
 static VFSNativeHost &host()
 {
     return *TestEnv().vfs_native;
@@ -99,29 +109,20 @@ TEST_CASE(PREFIX "Loading tags")
 {
     using Color = utility::Tags::Color;
 
-    unsigned char xattr_bytes_green[] = {0x62, 0x70, 0x6c, 0x69, 0x73, 0x74, 0x30, 0x30, 0xa1, 0x01, 0x57, 0x47, 0x72,
-                                         0x65, 0x65, 0x6e, 0x0a, 0x32, 0x08, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-                                         0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
-                                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x12};
-    unsigned char xattr_bytes_blue[] = {0x62, 0x70, 0x6c, 0x69, 0x73, 0x74, 0x30, 0x30, 0xa1, 0x01, 0x56, 0x42, 0x6c,
-                                        0x75, 0x65, 0x0a, 0x34, 0x08, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
-                                        0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
-                                        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x11};
-
     const TestDir test_dir_holder;
     auto test_dir = test_dir_holder.directory;
     REQUIRE(close(creat((test_dir / "1.txt").c_str(), 0755)) == 0);
     REQUIRE(setxattr((test_dir / "1.txt").c_str(),
                      "com.apple.metadata:_kMDItemUserTags",
-                     xattr_bytes_green,
-                     sizeof(xattr_bytes_green),
+                     g_XattrBytesGreen,
+                     sizeof(g_XattrBytesGreen),
                      0,
                      0) == 0);
     REQUIRE(close(creat((test_dir / "2.txt").c_str(), 0755)) == 0);
     REQUIRE(setxattr((test_dir / "2.txt").c_str(),
                      "com.apple.metadata:_kMDItemUserTags",
-                     xattr_bytes_blue,
-                     sizeof(xattr_bytes_blue),
+                     g_XattrBytesBlue,
+                     sizeof(g_XattrBytesBlue),
                      0,
                      0) == 0);
     VFSListingPtr listing;
@@ -160,3 +161,77 @@ TEST_CASE(PREFIX "Loading tags")
         REQUIRE(!listing->HasTags(0));
     }
 }
+
+TEST_CASE(PREFIX "Loading tags afterwards")
+{
+    using Color = utility::Tags::Color;
+    using TagsBatch = NativeHost::TagsBatch;
+    const auto set_tags = [](const std::filesystem::path &_path, std::span<const unsigned char> _bytes) {
+        return setxattr(_path.c_str(), "com.apple.metadata:_kMDItemUserTags", _bytes.data(), _bytes.size(), 0, 0);
+    };
+    const TestDir test_dir_holder;
+    auto test_dir = test_dir_holder.directory;
+    REQUIRE(close(creat((test_dir / "1.txt").c_str(), 0755)) == 0);
+    REQUIRE(set_tags(test_dir / "1.txt", g_XattrBytesGreen) == 0);
+    REQUIRE(close(creat((test_dir / "2.txt").c_str(), 0755)) == 0);
+    REQUIRE(set_tags(test_dir / "2.txt", g_XattrBytesBlue) == 0);
+    REQUIRE(close(creat((test_dir / "3.txt").c_str(), 0755)) == 0);
+
+    VFSListingPtr listing;
+    REQUIRE(host().FetchDirectoryListing(test_dir.c_str(), listing, 0) == VFSError::Ok);
+    REQUIRE(listing->Count() == 4);
+    const auto index_of = [&](const std::string &_filename) {
+        for( unsigned ind = 0; ind != listing->Count(); ++ind )
+            if( listing->Filename(ind) == _filename )
+                return ind;
+        FAIL();
+        return 0u;
+    };
+
+    // the requested entry goes first and the entries without tags are not reported
+    std::vector<TagsBatch> batches;
+    const auto collect = [&](TagsBatch &&_batch) { batches.emplace_back(std::move(_batch)); };
+    const unsigned first[] = {index_of("2.txt")};
+    REQUIRE(host().FetchTags(*listing, first, collect, {}) == VFSError::Ok);
+    REQUIRE(batches.size() == 2);
+    REQUIRE(batches[0].size() == 1);
+    CHECK(batches[0][0].first == index_of("2.txt"));
+    REQUIRE(batches[0][0].second.size() == 1);
+    CHECK(batches[0][0].second[0].Label() == "Blue");
+    CHECK(batches[0][0].second[0].Color() == Color::Blue);
+    REQUIRE(batches[1].size() == 1);
+    CHECK(batches[1][0].first == index_of("1.txt"));
+    REQUIRE(batches[1][0].second.size() == 1);
+    CHECK(batches[1][0].second[0].Label() == "Green");
+    CHECK(batches[1][0].second[0].Color() == Color::Green);
+
+    // the batches applied to the listing make it the same as if it was fetched with tags
+    for( const auto &batch : batches )
+        listing = VFSListing::WithTags(*listing, batch);
+    REQUIRE(listing->Count() == 4);
+    CHECK(listing->Tags(index_of("1.txt")).size() == 1);
+    CHECK(listing->Tags(index_of("2.txt")).size() == 1);
+    CHECK(!listing->HasTags(index_of("3.txt")));
+    CHECK(!listing->HasTags(index_of("..")));
+
+    // nothing is reported when nothing has changed
+    batches.clear();
+    REQUIRE(host().FetchTags(*listing, {}, collect, {}) == VFSError::Ok);
+    CHECK(batches.empty());
+
+    // the removed tags are reported as empty ones
+    REQUIRE(removexattr((test_dir / "1.txt").c_str(), "com.apple.metadata:_kMDItemUserTags", 0) == 0);
+    REQUIRE(host().FetchTags(*listing, {}, collect, {}) == VFSError::Ok);
+    REQUIRE(batches.size() == 1);
+    REQUIRE(batches[0].size() == 1);
+    CHECK(batches[0][0].first == index_of("1.txt"));
+    CHECK(batches[0][0].second.empty());
+    listing = VFSListing::WithTags(*listing, batches[0]);
+    CHECK(!listing->HasTags(index_of("1.txt")));
+    CHECK(listing->HasTags(index_of("2.txt")));
+
+    // invalid requests and cancellation
+    const unsigned out_of_range[] = {listing->Count()};
+    CHECK(host().FetchTags(*listing, out_of_range, collect, {}) == VFSError::InvalidCall);
+    CHECK(host().FetchTags(*listing, {}, collect, [] { return true; }) == VFSError::Cancelled);
+}
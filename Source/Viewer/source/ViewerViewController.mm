@@ -22,6 +22,8 @@ using namespace nc::viewer;
 static const auto g_ConfigRespectComAppleTextEncoding = "viewer.respectComAppleTextEncoding";
 static const auto g_ConfigSearchCaseSensitive = "viewer.searchCaseSensitive";
 static const auto g_ConfigSearchForWholePhrase = "viewer.searchForWholePhrase";
+static const auto g_ConfigSearchRegularExpression = "viewer.searchRegularExpression";
+static const auto g_ConfigSearchHexBytes = "viewer.searchHexBytes";
 static const auto g_ConfigWindowSize = "viewer.fileWindowSize";
 static const auto g_ConfigAutomaticRefresh = "viewer.automaticRefresh";
 static const auto g_AutomaticRefreshDelay = std::chrono::milliseconds(200);
@@ -346,29 +348,45 @@ struct BackgroundFileOpener {
     item.target = self;
     [menu insertItem:item atIndex:1];
 
+    item = [[NSMenuItem alloc]
+        initWithTitle:NSLocalizedString(@"Regular expression", "Menu item option in internal viewer search")
+               action:@selector(onSearchFieldMenuRegularExpressionAction:)
+        keyEquivalent:@""];
+    item.state = m_Config->GetBool(g_ConfigSearchRegularExpression);
+    item.target = self;
+    [menu insertItem:item atIndex:2];
+
+    item = [[NSMenuItem alloc]
+        initWithTitle:NSLocalizedString(@"Hex bytes", "Menu item option in internal viewer search")
+               action:@selector(onSearchFieldMenuHexBytesAction:)
+        keyEquivalent:@""];
+    item.state = m_Config->GetBool(g_ConfigSearchHexBytes);
+    item.target = self;
+    [menu insertItem:item atIndex:3];
+
     item = [[NSMenuItem alloc]
         initWithTitle:NSLocalizedString(@"Clear Recents", "Menu item title in internal viewer search")
                action:nullptr
         keyEquivalent:@""];
     item.tag = NSSearchFieldClearRecentsMenuItemTag;
-    [menu insertItem:item atIndex:2];
+    [menu insertItem:item atIndex:4];
 
     item = [NSMenuItem separatorItem];
     item.tag = NSSearchFieldRecentsTitleMenuItemTag;
-    [menu insertItem:item atIndex:3];
+    [menu insertItem:item atIndex:5];
 
     item = [[NSMenuItem alloc]
         initWithTitle:NSLocalizedString(@"Recent Searches", "Menu item title in internal viewer search")
                action:nullptr
         keyEquivalent:@""];
     item.tag = NSSearchFieldRecentsTitleMenuItemTag;
-    [menu insertItem:item atIndex:4];
+    [menu insertItem:item atIndex:6];
 
     item = [[NSMenuItem alloc] initWithTitle:NSLocalizedString(@"Recents", "Menu item title in internal viewer search")
                                       action:nullptr
                                keyEquivalent:@""];
     item.tag = NSSearchFieldRecentsMenuItemTag;
-    [menu insertItem:item atIndex:5];
+    [menu insertItem:item atIndex:7];
 
     return menu;
 }
@@ -394,9 +412,18 @@ struct BackgroundFileOpener {
         return;
     }
 
+    // the "Hex bytes" option makes the request a hex pattern like "DE AD ?? EF", which is searched for as bytes
+    const bool binary = m_Config->GetBool(g_ConfigSearchHexBytes);
+    if( binary && !nc::vfs::SearchInFile::IsValidBinaryPattern(str.UTF8String) ) {
+        m_SearchInFileQueue.Stop(); // there's nothing to look for
+        m_View.selectionInFile = CFRangeMake(-1, 0);
+        NSBeep();
+        return;
+    }
+
     if( m_SearchInFile->TextSearchString() == nullptr ||
         [str compare:(__bridge NSString *)m_SearchInFile->TextSearchString()] != NSOrderedSame ||
-        m_SearchInFile->TextSearchEncoding() != m_View.encoding ) {
+        m_SearchInFile->TextSearchEncoding() != m_View.encoding || m_SearchInFile->IsBinarySearch() != binary ) {
         // user did some changes in search request
         m_View.selectionInFile = CFRangeMake(-1, 0); // remove current selection
 
@@ -407,7 +434,10 @@ struct BackgroundFileOpener {
         m_SearchInFileQueue.Wait();
         m_SearchInFileQueue.Run([=] {
             m_SearchInFile->MoveCurrentPosition(view_offset);
-            m_SearchInFile->ToggleTextSearch((__bridge CFStringRef)str, encoding);
+            if( binary )
+                m_SearchInFile->ToggleBinarySearch((__bridge CFStringRef)str);
+            else
+                m_SearchInFile->ToggleTextSearch((__bridge CFStringRef)str, encoding);
         });
     }
     else {
@@ -444,13 +474,23 @@ struct BackgroundFileOpener {
                                      });
 }
 
+// Toggles the search option on the search queue, after stopping the search which might be running with the old ones.
+- (nc::vfs::SearchInFile::Options)toggleSearchOption:(nc::vfs::SearchInFile::Options)_option
+{
+    using Options = nc::vfs::SearchInFile::Options;
+    m_SearchInFileQueue.Stop();
+    m_SearchInFileQueue.Wait();
+    const auto options = static_cast<Options>(
+        InvertBitFlag(static_cast<int>(m_SearchInFile->SearchOptions()), static_cast<int>(_option)));
+    m_SearchInFileQueue.Run([=] { m_SearchInFile->SetSearchOptions(options); });
+    return options;
+}
+
 - (void)onSearchFieldMenuCaseSensitiveAction:(id) [[maybe_unused]] _sender
 {
     using nc::vfs::SearchInFile;
     using Options = SearchInFile::Options;
-    const auto options = static_cast<Options>(
-        InvertBitFlag(static_cast<int>(m_SearchInFile->SearchOptions()), static_cast<int>(Options::CaseSensitive)));
-    m_SearchInFile->SetSearchOptions(options);
+    const auto options = [self toggleSearchOption:Options::CaseSensitive];
 
     auto cell = static_cast<NSSearchFieldCell *>(m_SearchField.cell);
     NSMenu *menu = cell.searchMenuTemplate;
@@ -463,9 +503,7 @@ struct BackgroundFileOpener {
 {
     using nc::vfs::SearchInFile;
     using Options = SearchInFile::Options;
-    const auto options = static_cast<Options>(
-        InvertBitFlag(static_cast<int>(m_SearchInFile->SearchOptions()), static_cast<int>(Options::FindWholePhrase)));
-    m_SearchInFile->SetSearchOptions(options);
+    const auto options = [self toggleSearchOption:Options::FindWholePhrase];
 
     auto cell = static_cast<NSSearchFieldCell *>(m_SearchField.cell);
     NSMenu *menu = cell.searchMenuTemplate;
@@ -474,6 +512,29 @@ struct BackgroundFileOpener {
     m_Config->Set(g_ConfigSearchForWholePhrase, bool(options & Options::FindWholePhrase));
 }
 
+- (void)onSearchFieldMenuRegularExpressionAction:(id) [[maybe_unused]] _sender
+{
+    using nc::vfs::SearchInFile;
+    using Options = SearchInFile::Options;
+    const auto options = [self toggleSearchOption:Options::RegularExpression];
+
+    auto cell = static_cast<NSSearchFieldCell *>(m_SearchField.cell);
+    NSMenu *menu = cell.searchMenuTemplate;
+    [menu itemAtIndex:2].state = (options & Options::RegularExpression) != Options::None;
+    cell.searchMenuTemplate = menu;
+    m_Config->Set(g_ConfigSearchRegularExpression, bool(options & Options::RegularExpression));
+}
+
+- (void)onSearchFieldMenuHexBytesAction:(id) [[maybe_unused]] _sender
+{
+    const bool hex_bytes = !m_Config->GetBool(g_ConfigSearchHexBytes);
+    auto cell = static_cast<NSSearchFieldCell *>(m_SearchField.cell);
+    NSMenu *menu = cell.searchMenuTemplate;
+    [menu itemAtIndex:3].state = hex_bytes;
+    cell.searchMenuTemplate = menu;
+    m_Config->Set(g_ConfigSearchHexBytes, hex_bytes);
+}
+
 - (void)setSearchProgressIndicator:(NSProgressIndicator *)searchProgressIndicator
 {
     dispatch_assert_main_queue();
@@ -711,6 +772,8 @@ int BackgroundFileOpener::Open(VFSHostPtr _vfs,
             opts |= Options::CaseSensitive;
         if( _config.GetBool(g_ConfigSearchForWholePhrase) )
             opts |= Options::FindWholePhrase;
+        if( _config.GetBool(g_ConfigSearchRegularExpression) )
+            opts |= Options::RegularExpression;
         return opts;
     }();
     search_in_file->SetSearchOptions(search_options);